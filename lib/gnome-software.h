@@ -33,6 +33,7 @@
 #include <gs-os-release.h>
 #include <gs-plugin.h>
 #include <gs-plugin-vfuncs.h>
+#include <gs-review-store.h>
 #include <gs-utils.h>
 
 #endif /* __GNOME_SOFTWARE_H__ */
@@ -64,6 +64,38 @@ gs_app_list_get_size_peak (GsAppList *list)
 	return list->size_peak;
 }
 
+/**
+ * gs_app_list_get_size_download:
+ * @list: A #GsAppList
+ *
+ * Gets the total download size of the applications in the list, including
+ * any related applications and runtimes that need to be installed.
+ *
+ * Anything shared between applications, for instance a runtime or a
+ * package that provides more than one application, is only counted once.
+ * Applications with an unknown download size are not included.
+ *
+ * Returns: number of bytes, or 0 for unknown
+ *
+ * Since: 3.26
+ **/
+guint64
+gs_app_list_get_size_download (GsAppList *list)
+{
+	guint64 sz = 0;
+	g_autoptr(GHashTable) seen = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&list->mutex);
+
+	g_return_val_if_fail (GS_IS_APP_LIST (list), 0);
+
+	seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	for (guint i = 0; i < list->array->len; i++) {
+		GsApp *app = g_ptr_array_index (list->array, i);
+		sz += gs_app_get_size_download_dedupe (app, seen);
+	}
+	return sz;
+}
+
 /**
  * gs_app_list_lookup:
  * @list: A #GsAppList
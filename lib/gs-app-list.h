@@ -50,6 +50,7 @@ GsApp		*gs_app_list_index		(GsAppList	*list,
 GsApp		*gs_app_list_lookup		(GsAppList	*list,
 						 const gchar	*unique_id);
 guint		 gs_app_list_length		(GsAppList	*list);
+guint64		 gs_app_list_get_size_download	(GsAppList	*list);
 void		 gs_app_list_sort		(GsAppList	*list,
 						 GsAppListSortFunc func,
 						 gpointer	 user_data);
@@ -33,6 +33,8 @@ void		 gs_app_set_unique_id		(GsApp		*app,
 						 const gchar	*unique_id);
 void		 gs_app_remove_addon		(GsApp		*app,
 						 GsApp		*addon);
+guint64		 gs_app_get_size_download_dedupe (GsApp		*app,
+						 GHashTable	*seen);
 
 G_END_DECLS
 
@@ -2699,6 +2699,64 @@ gs_app_set_size_download (GsApp *app, guint64 size_download)
 	app->size_download = size_download;
 }
 
+/* two apps from different plugins can stand for the same download */
+static gchar *
+gs_app_get_size_key (GsApp *app)
+{
+	GString *key;
+
+	/* several apps can be built from the same package, so what gets
+	 * downloaded is the package and not the app */
+	if (app->source_ids->len > 0) {
+		key = g_string_new (app->management_plugin);
+		for (guint i = 0; i < app->source_ids->len; i++) {
+			g_string_append_c (key, ';');
+			g_string_append (key, g_ptr_array_index (app->source_ids, i));
+		}
+		return g_string_free (key, FALSE);
+	}
+	if (gs_app_get_unique_id (app) != NULL)
+		return g_strdup (gs_app_get_unique_id (app));
+	return g_strdup_printf ("%p", app);
+}
+
+/* like gs_app_get_size_download() but skips anything already in @seen,
+ * and anything with an unknown size */
+guint64
+gs_app_get_size_download_dedupe (GsApp *app, GHashTable *seen)
+{
+	GsApp *runtime;
+	guint64 sz = 0;
+	g_autofree gchar *key = NULL;
+
+	g_return_val_if_fail (GS_IS_APP (app), 0);
+
+	key = gs_app_get_size_key (app);
+	if (!g_hash_table_add (seen, g_steal_pointer (&key)))
+		return 0;
+
+	/* this app */
+	if (app->size_download != GS_APP_SIZE_UNKNOWABLE)
+		sz += app->size_download;
+
+	/* add the runtime if this is not installed */
+	runtime = app->update_runtime != NULL ? app->update_runtime : app->runtime;
+	if (runtime != NULL && gs_app_get_state (runtime) == AS_APP_STATE_AVAILABLE) {
+		key = gs_app_get_size_key (runtime);
+		if (g_hash_table_add (seen, g_steal_pointer (&key)) &&
+		    runtime->size_installed != GS_APP_SIZE_UNKNOWABLE)
+			sz += runtime->size_installed;
+	}
+
+	/* add related apps */
+	for (guint i = 0; i < app->related->len; i++) {
+		GsApp *app_related = g_ptr_array_index (app->related, i);
+		sz += gs_app_get_size_download_dedupe (app_related, seen);
+	}
+
+	return sz;
+}
+
 /**
  * gs_app_get_size_installed:
  * @app: a #GsApp
@@ -46,9 +46,11 @@ typedef struct
 	GsAppList		*global_cache;
 	AsProfile		*profile;
 	SoupSession		*soup_session;
+	GsReviewStore		*review_store;
 	GPtrArray		*auth_array;
 	GPtrArray		*file_monitors;
 	GsPluginStatus		 global_status_last;
+	guint			 global_percentage;
 
 	GMutex			 pending_apps_mutex;
 	GPtrArray		*pending_apps;
@@ -58,6 +60,9 @@ typedef struct
 	GMutex			 events_by_id_mutex;
 	GHashTable		*events_by_id;		/* unique-id : GsPluginEvent */
 
+	GMutex			 partial_jobs_mutex;
+	GHashTable		*partial_jobs;		/* GsAppList : GsPluginLoaderJob */
+
 	gchar			**compatible_projects;
 	guint			 scale;
 
@@ -94,6 +99,7 @@ enum {
 	PROP_EVENTS,
 	PROP_ALLOW_UPDATES,
 	PROP_NETWORK_AVAILABLE,
+	PROP_PERCENTAGE,
 	PROP_LAST
 };
 
@@ -195,6 +201,10 @@ typedef struct {
 	guint				 max_results;
 	GsAppListSortFunc		 sort_func;
 	gpointer			 sort_func_data;
+	GsPluginLoaderPartialFunc	 partial_func;
+	gpointer			 partial_func_data;
+	GMainContext			*partial_context;
+	GCancellable			*partial_cancellable;
 } GsPluginLoaderJob;
 
 static GsPluginLoaderJob *
@@ -208,6 +218,16 @@ gs_plugin_loader_job_new (GsPluginLoader *plugin_loader)
 static void
 gs_plugin_loader_job_free (GsPluginLoaderJob *job)
 {
+	/* no more partial results can arrive */
+	if (job->partial_context != NULL) {
+		GsPluginLoaderPrivate *priv = gs_plugin_loader_get_instance_private (job->plugin_loader);
+		g_mutex_lock (&priv->partial_jobs_mutex);
+		g_hash_table_remove (priv->partial_jobs, job->list);
+		g_mutex_unlock (&priv->partial_jobs_mutex);
+		g_main_context_unref (job->partial_context);
+	}
+	if (job->partial_cancellable != NULL)
+		g_object_unref (job->partial_cancellable);
 	g_object_unref (job->plugin_loader);
 	if (job->category != NULL)
 		g_object_unref (job->category);
@@ -529,18 +549,6 @@ gs_plugin_loader_run_adopt (GsPluginLoader *plugin_loader, GsAppList *list)
 	}
 }
 
-static gint
-gs_plugin_loader_review_score_sort_cb (gconstpointer a, gconstpointer b)
-{
-	AsReview *ra = *((AsReview **) a);
-	AsReview *rb = *((AsReview **) b);
-	if (as_review_get_priority (ra) < as_review_get_priority (rb))
-		return 1;
-	if (as_review_get_priority (ra) > as_review_get_priority (rb))
-		return -1;
-	return 0;
-}
-
 static gboolean
 gs_plugin_loader_call_vfunc (GsPluginLoaderJob *job,
 			     GsPlugin *plugin,
@@ -799,14 +807,12 @@ gs_plugin_loader_run_refine_internal (GsPluginLoaderJob *job,
 		gs_plugin_status_update (plugin, NULL, GS_PLUGIN_STATUS_FINISHED);
 	}
 
-	/* ensure these are sorted by score */
+	/* ensure these are sorted by score; reviews from the store
+	 * already are, so this is only a check in the common case */
 	if ((job->refine_flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEWS) > 0) {
-		GPtrArray *reviews;
 		for (i = 0; i < gs_app_list_length (list); i++) {
 			app = gs_app_list_index (list, i);
-			reviews = gs_app_get_reviews (app);
-			g_ptr_array_sort (reviews,
-					  gs_plugin_loader_review_score_sort_cb);
+			gs_review_store_sort_reviews (gs_app_get_reviews (app));
 		}
 	}
 
@@ -2214,6 +2220,89 @@ gs_plugin_loader_search_finish (GsPluginLoader *plugin_loader,
 
 /******************************************************************************/
 
+/* partial results are delivered in the context the job was started from */
+static void
+gs_plugin_loader_job_set_partial_func (GsPluginLoaderJob *job,
+				       GsPluginLoaderPartialFunc partial_func,
+				       gpointer partial_func_data,
+				       GCancellable *cancellable)
+{
+	GsPluginLoaderPrivate *priv = gs_plugin_loader_get_instance_private (job->plugin_loader);
+
+	if (partial_func == NULL)
+		return;
+	job->partial_func = partial_func;
+	job->partial_func_data = partial_func_data;
+	job->partial_context = g_main_context_ref_thread_default ();
+	if (cancellable != NULL)
+		job->partial_cancellable = g_object_ref (cancellable);
+	g_mutex_lock (&priv->partial_jobs_mutex);
+	g_hash_table_insert (priv->partial_jobs, job->list, job);
+	g_mutex_unlock (&priv->partial_jobs_mutex);
+}
+
+typedef struct {
+	GsPluginLoader			*plugin_loader;
+	GsPluginLoaderPartialFunc	 func;
+	gpointer			 func_data;
+	GCancellable			*cancellable;
+	GsAppList			*list;
+} GsPluginLoaderPartialHelper;
+
+static gboolean
+gs_plugin_loader_partial_results_idle_cb (gpointer user_data)
+{
+	GsPluginLoaderPartialHelper *helper = (GsPluginLoaderPartialHelper *) user_data;
+
+	if (helper->cancellable == NULL ||
+	    !g_cancellable_is_cancelled (helper->cancellable)) {
+		helper->func (helper->plugin_loader,
+			      helper->list,
+			      helper->func_data);
+	}
+	g_object_unref (helper->plugin_loader);
+	if (helper->cancellable != NULL)
+		g_object_unref (helper->cancellable);
+	g_object_unref (helper->list);
+	g_slice_free (GsPluginLoaderPartialHelper, helper);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+gs_plugin_loader_partial_results_cb (GsPlugin *plugin,
+				     GsAppList *list,
+				     GsAppList *partial,
+				     GsPluginLoader *plugin_loader)
+{
+	GsPluginLoaderPrivate *priv = gs_plugin_loader_get_instance_private (plugin_loader);
+	GsPluginLoaderJob *job;
+	GsPluginLoaderPartialHelper *helper;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->partial_jobs_mutex);
+	g_autoptr(GSource) source = NULL;
+
+	/* the caller did not ask for partial results */
+	job = g_hash_table_lookup (priv->partial_jobs, list);
+	if (job == NULL)
+		return;
+
+	/* this is attached before the task returns, and at the same priority,
+	 * so the partial results always arrive before the final ones */
+	helper = g_slice_new0 (GsPluginLoaderPartialHelper);
+	helper->plugin_loader = g_object_ref (plugin_loader);
+	helper->func = job->partial_func;
+	helper->func_data = job->partial_func_data;
+	if (job->partial_cancellable != NULL)
+		helper->cancellable = g_object_ref (job->partial_cancellable);
+	helper->list = gs_app_list_new ();
+	gs_app_list_add_list (helper->list, partial);
+	source = g_idle_source_new ();
+	g_source_set_priority (source, G_PRIORITY_DEFAULT);
+	g_source_set_callback (source, gs_plugin_loader_partial_results_idle_cb, helper, NULL);
+	g_source_attach (source, job->partial_context);
+}
+
+/******************************************************************************/
+
 /**
  * gs_plugin_loader_search_files_async:
  *
@@ -2234,10 +2323,16 @@ gs_plugin_loader_search_finish (GsPluginLoader *plugin_loader,
  *
  * The #GsApps may be in job %AS_APP_STATE_INSTALLED or %AS_APP_STATE_AVAILABLE
  * and the UI may want to filter the two classes of applications differently.
+ *
+ * If @partial_func is set, it is called in the thread-default main context
+ * with any unrefined results that plugins report while the search is still
+ * running. These are replaced by the list returned when the search finishes.
  **/
 void
 gs_plugin_loader_search_files_async (GsPluginLoader *plugin_loader,
                                      const gchar *value,
+                                     GsPluginLoaderPartialFunc partial_func,
+                                     gpointer partial_func_data,
                                      GsPluginRefineFlags refine_flags,
                                      GsPluginFailureFlags failure_flags,
                                      GCancellable *cancellable,
@@ -2259,6 +2354,9 @@ gs_plugin_loader_search_files_async (GsPluginLoader *plugin_loader,
 	job->values = g_new0 (gchar *, 2);
 	job->values[0] = g_strdup (job->value);
 	job->action = GS_PLUGIN_ACTION_SEARCH_FILES;
+	job->function_name = "gs_plugin_add_search_files";
+	gs_plugin_loader_job_set_partial_func (job, partial_func,
+					       partial_func_data, cancellable);
 	gs_plugin_loader_job_debug (job);
 
 	/* run in a thread */
@@ -2308,10 +2406,16 @@ gs_plugin_loader_search_files_finish (GsPluginLoader *plugin_loader,
  *
  * The #GsApps may be in job %AS_APP_STATE_INSTALLED or %AS_APP_STATE_AVAILABLE
  * and the UI may want to filter the two classes of applications differently.
+ *
+ * If @partial_func is set, it is called in the thread-default main context
+ * with any unrefined results that plugins report while the search is still
+ * running. These are replaced by the list returned when the search finishes.
  **/
 void
 gs_plugin_loader_search_what_provides_async (GsPluginLoader *plugin_loader,
                                              const gchar *value,
+                                             GsPluginLoaderPartialFunc partial_func,
+                                             gpointer partial_func_data,
                                              GsPluginRefineFlags refine_flags,
                                              GsPluginFailureFlags failure_flags,
                                              GCancellable *cancellable,
@@ -2334,6 +2438,8 @@ gs_plugin_loader_search_what_provides_async (GsPluginLoader *plugin_loader,
 	job->values[0] = g_strdup (job->value);
 	job->action = GS_PLUGIN_ACTION_SEARCH_PROVIDES;
 	job->function_name = "gs_plugin_add_search_what_provides";
+	gs_plugin_loader_job_set_partial_func (job, partial_func,
+					       partial_func_data, cancellable);
 	gs_plugin_loader_job_debug (job);
 
 	/* run in a thread */
@@ -3292,6 +3398,14 @@ gs_plugin_loader_get_allow_updates (GsPluginLoader *plugin_loader)
 	return FALSE;
 }
 
+/* how far through the current global status the plugins are, or 0 */
+guint
+gs_plugin_loader_get_percentage (GsPluginLoader *plugin_loader)
+{
+	GsPluginLoaderPrivate *priv = gs_plugin_loader_get_instance_private (plugin_loader);
+	return priv->global_percentage;
+}
+
 GsAppList *
 gs_plugin_loader_get_pending (GsPluginLoader *plugin_loader)
 {
@@ -3452,10 +3566,16 @@ gs_plugin_loader_status_changed_cb (GsPlugin *plugin,
 		if (priv->global_status_last != status) {
 			g_debug ("emitting global %s",
 				 gs_plugin_status_to_string (status));
+			priv->global_status_last = status;
+
+			/* the old percentage was for something else */
+			if (priv->global_percentage != 0) {
+				priv->global_percentage = 0;
+				g_object_notify (G_OBJECT (plugin_loader), "percentage");
+			}
 			g_signal_emit (plugin_loader,
 				       signals[SIGNAL_STATUS_CHANGED],
 				       0, app, status);
-			priv->global_status_last = status;
 		}
 		return;
 	}
@@ -3469,6 +3589,18 @@ gs_plugin_loader_status_changed_cb (GsPlugin *plugin,
 		       0, app, status);
 }
 
+static void
+gs_plugin_loader_percentage_changed_cb (GsPlugin *plugin,
+					guint percentage,
+					GsPluginLoader *plugin_loader)
+{
+	GsPluginLoaderPrivate *priv = gs_plugin_loader_get_instance_private (plugin_loader);
+	if (priv->global_percentage == percentage)
+		return;
+	priv->global_percentage = percentage;
+	g_object_notify (G_OBJECT (plugin_loader), "percentage");
+}
+
 static gboolean
 gs_plugin_loader_updates_changed_delay_cb (gpointer user_data)
 {
@@ -3554,7 +3686,14 @@ gs_plugin_loader_open_plugin (GsPluginLoader *plugin_loader,
 	g_signal_connect (plugin, "allow-updates",
 			  G_CALLBACK (gs_plugin_loader_allow_updates_cb),
 			  plugin_loader);
+	g_signal_connect (plugin, "partial-results",
+			  G_CALLBACK (gs_plugin_loader_partial_results_cb),
+			  plugin_loader);
+	g_signal_connect (plugin, "percentage-changed",
+			  G_CALLBACK (gs_plugin_loader_percentage_changed_cb),
+			  plugin_loader);
 	gs_plugin_set_soup_session (plugin, priv->soup_session);
+	gs_plugin_set_review_store (plugin, priv->review_store);
 	gs_plugin_set_auth_array (plugin, priv->auth_array);
 	gs_plugin_set_profile (plugin, priv->profile);
 	gs_plugin_set_locale (plugin, priv->locale);
@@ -4041,6 +4180,9 @@ gs_plugin_loader_get_property (GObject *object, guint prop_id,
 	case PROP_NETWORK_AVAILABLE:
 		g_value_set_boolean (value, gs_plugin_loader_get_network_available (plugin_loader));
 		break;
+	case PROP_PERCENTAGE:
+		g_value_set_uint (value, priv->global_percentage);
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -4086,6 +4228,7 @@ gs_plugin_loader_dispose (GObject *object)
 	}
 	g_clear_object (&priv->network_monitor);
 	g_clear_object (&priv->soup_session);
+	g_clear_object (&priv->review_store);
 	g_clear_object (&priv->profile);
 	g_clear_object (&priv->settings);
 	g_clear_pointer (&priv->auth_array, g_ptr_array_unref);
@@ -4108,9 +4251,11 @@ gs_plugin_loader_finalize (GObject *object)
 	g_ptr_array_unref (priv->file_monitors);
 	g_hash_table_unref (priv->events_by_id);
 	g_hash_table_unref (priv->disallow_updates);
+	g_hash_table_unref (priv->partial_jobs);
 
 	g_mutex_clear (&priv->pending_apps_mutex);
 	g_mutex_clear (&priv->events_by_id_mutex);
+	g_mutex_clear (&priv->partial_jobs_mutex);
 
 	G_OBJECT_CLASS (gs_plugin_loader_parent_class)->finalize (object);
 }
@@ -4141,6 +4286,11 @@ gs_plugin_loader_class_init (GsPluginLoaderClass *klass)
 				      G_PARAM_READABLE);
 	g_object_class_install_property (object_class, PROP_NETWORK_AVAILABLE, pspec);
 
+	pspec = g_param_spec_uint ("percentage", NULL, NULL,
+				   0, 100, 0,
+				   G_PARAM_READABLE);
+	g_object_class_install_property (object_class, PROP_PERCENTAGE, pspec);
+
 	signals [SIGNAL_STATUS_CHANGED] =
 		g_signal_new ("status-changed",
 			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
@@ -4213,14 +4363,22 @@ gs_plugin_loader_init (GsPluginLoader *plugin_loader)
 					            (GEqualFunc) as_utils_unique_id_equal,
 						    g_free,
 						    (GDestroyNotify) g_object_unref);
+	priv->partial_jobs = g_hash_table_new (g_direct_hash, g_direct_equal);
 
-	/* share a soup session (also disable the double-compression) */
+	/* share a soup session (also disable the double-compression); the
+	 * connections are kept alive between requests and each plugin can
+	 * download from the same host without waiting on the others */
 	priv->soup_session = soup_session_new_with_options (SOUP_SESSION_USER_AGENT, gs_user_agent (),
 							    SOUP_SESSION_TIMEOUT, 10,
+							    SOUP_SESSION_MAX_CONNS, 16,
+							    SOUP_SESSION_MAX_CONNS_PER_HOST, 4,
 							    NULL);
 	soup_session_remove_feature_by_type (priv->soup_session,
 					     SOUP_TYPE_CONTENT_DECODER);
 
+	/* reviews downloaded by any plugin */
+	priv->review_store = gs_review_store_new ();
+
 	/* get the locale without the various UTF-8 suffixes */
 	tmp = g_getenv ("GS_SELF_TEST_LOCALE");
 	if (tmp != NULL) {
@@ -4248,6 +4406,7 @@ gs_plugin_loader_init (GsPluginLoader *plugin_loader)
 
 	g_mutex_init (&priv->pending_apps_mutex);
 	g_mutex_init (&priv->events_by_id_mutex);
+	g_mutex_init (&priv->partial_jobs_mutex);
 
 	/* monitor the network as the many UI operations need the network */
 	gs_plugin_loader_monitor_network (plugin_loader);
@@ -50,6 +50,9 @@ struct _GsPluginLoaderClass
 typedef void	 (*GsPluginLoaderFinishedFunc)		(GsPluginLoader	*plugin_loader,
 							 GsApp		*app,
 							 gpointer	 user_data);
+typedef void	 (*GsPluginLoaderPartialFunc)		(GsPluginLoader	*plugin_loader,
+							 GsAppList	*list,
+							 gpointer	 user_data);
 
 GsPluginLoader	*gs_plugin_loader_new			(void);
 void		 gs_plugin_loader_get_installed_async	(GsPluginLoader	*plugin_loader,
@@ -149,6 +152,8 @@ GsAppList	*gs_plugin_loader_search_finish		(GsPluginLoader	*plugin_loader,
 							 GError		**error);
 void		 gs_plugin_loader_search_files_async	(GsPluginLoader	*plugin_loader,
 							 const gchar	*value,
+							 GsPluginLoaderPartialFunc partial_func,
+							 gpointer	 partial_func_data,
 							 GsPluginRefineFlags refine_flags,
 							 GsPluginFailureFlags failure_flags,
 							 GCancellable	*cancellable,
@@ -159,6 +164,8 @@ GsAppList	*gs_plugin_loader_search_files_finish	(GsPluginLoader	*plugin_loader,
 							 GError		**error);
 void		 gs_plugin_loader_search_what_provides_async (GsPluginLoader	*plugin_loader,
 							 const gchar	*value,
+							 GsPluginLoaderPartialFunc partial_func,
+							 gpointer	 partial_func_data,
 							 GsPluginRefineFlags refine_flags,
 							 GsPluginFailureFlags failure_flags,
 							 GCancellable	*cancellable,
@@ -266,6 +273,7 @@ void		 gs_plugin_loader_refresh_async		(GsPluginLoader	*plugin_loader,
 GsAppList	*gs_plugin_loader_get_pending		(GsPluginLoader	*plugin_loader);
 gboolean	 gs_plugin_loader_get_allow_updates	(GsPluginLoader	*plugin_loader);
 gboolean	 gs_plugin_loader_get_network_available	(GsPluginLoader *plugin_loader);
+guint		 gs_plugin_loader_get_percentage	(GsPluginLoader	*plugin_loader);
 gboolean	 gs_plugin_loader_get_network_metered	(GsPluginLoader *plugin_loader);
 gboolean	 gs_plugin_loader_get_plugin_supported	(GsPluginLoader	*plugin_loader,
 							 const gchar	*plugin_func);
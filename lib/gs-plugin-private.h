@@ -59,6 +59,8 @@ void		 gs_plugin_set_auth_array		(GsPlugin	*plugin,
 							 GPtrArray	*auth_array);
 void		 gs_plugin_set_soup_session		(GsPlugin	*plugin,
 							 SoupSession	*soup_session);
+void		 gs_plugin_set_review_store		(GsPlugin	*plugin,
+							 GsReviewStore	*review_store);
 void		 gs_plugin_set_global_cache		(GsPlugin	*plugin,
 							 GsAppList	*global_cache);
 void		 gs_plugin_set_running_other		(GsPlugin	*plugin,
@@ -69,6 +71,7 @@ gpointer	 gs_plugin_get_symbol			(GsPlugin	*plugin,
 							 const gchar	*function_name);
 gchar		*gs_plugin_failure_flags_to_string	(GsPluginFailureFlags failure_flags);
 gchar		*gs_plugin_refine_flags_to_string	(GsPluginRefineFlags refine_flags);
+guint		 gs_plugin_download_get_waiting		(const gchar	*uri);
 
 G_END_DECLS
 
@@ -115,6 +115,9 @@ gboolean	 gs_plugin_add_search			(GsPlugin	*plugin,
  * on the filesystem.
  *
  * Plugins are expected to add new apps using gs_app_list_add().
+ * Slow plugins may also pass apps found so far to
+ * gs_plugin_report_partial_results() so they can be shown before the search
+ * finishes.
  *
  * Returns: %TRUE for success or if not relevant
  **/
@@ -136,6 +139,9 @@ gboolean	 gs_plugin_add_search_files		(GsPlugin	*plugin,
  * for instance a codec string or mime-type.
  *
  * Plugins are expected to add new apps using gs_app_list_add().
+ * Slow plugins may also pass apps found so far to
+ * gs_plugin_report_partial_results() so they can be shown before the search
+ * finishes.
  *
  * Returns: %TRUE for success or if not relevant
  **/
@@ -44,6 +44,8 @@
 
 #include "config.h"
 
+#include <errno.h>
+#include <glib/gstdio.h>
 #include <gio/gdesktopappinfo.h>
 #include <gdk/gdk.h>
 
@@ -66,6 +68,7 @@ typedef struct
 	GsPluginData		*data;			/* for gs-plugin-{name}.c */
 	GsPluginFlags		 flags;
 	SoupSession		*soup_session;
+	GsReviewStore		*review_store;
 	GsAppList		*global_cache;
 	GPtrArray		*rules[GS_PLUGIN_RULE_LAST];
 	GHashTable		*vfuncs;		/* string:pointer */
@@ -98,6 +101,8 @@ enum {
 	SIGNAL_RELOAD,
 	SIGNAL_REPORT_EVENT,
 	SIGNAL_ALLOW_UPDATES,
+	SIGNAL_PARTIAL_RESULTS,
+	SIGNAL_PERCENTAGE_CHANGED,
 	SIGNAL_LAST
 };
 
@@ -203,6 +208,8 @@ gs_plugin_finalize (GObject *object)
 		g_ptr_array_unref (priv->auth_array);
 	if (priv->soup_session != NULL)
 		g_object_unref (priv->soup_session);
+	if (priv->review_store != NULL)
+		g_object_unref (priv->review_store);
 	if (priv->global_cache != NULL)
 		g_object_unref (priv->global_cache);
 	g_hash_table_unref (priv->cache);
@@ -763,6 +770,39 @@ gs_plugin_set_soup_session (GsPlugin *plugin, SoupSession *soup_session)
 	g_set_object (&priv->soup_session, soup_session);
 }
 
+/**
+ * gs_plugin_get_review_store:
+ * @plugin: a #GsPlugin
+ *
+ * Gets the review store shared by all the plugins providing reviews.
+ *
+ * Returns: the #GsReviewStore
+ *
+ * Since: 3.26
+ **/
+GsReviewStore *
+gs_plugin_get_review_store (GsPlugin *plugin)
+{
+	GsPluginPrivate *priv = gs_plugin_get_instance_private (plugin);
+	return priv->review_store;
+}
+
+/**
+ * gs_plugin_set_review_store:
+ * @plugin: a #GsPlugin
+ * @review_store: a #GsReviewStore
+ *
+ * Sets the review store shared by all the plugins providing reviews.
+ *
+ * Since: 3.26
+ **/
+void
+gs_plugin_set_review_store (GsPlugin *plugin, GsReviewStore *review_store)
+{
+	GsPluginPrivate *priv = gs_plugin_get_instance_private (plugin);
+	g_set_object (&priv->review_store, review_store);
+}
+
 /**
  * gs_plugin_set_global_cache:
  * @plugin: a #GsPlugin
@@ -966,6 +1006,39 @@ gs_plugin_status_update (GsPlugin *plugin, GsApp *app, GsPluginStatus status)
 	g_idle_add (gs_plugin_status_update_cb, helper);
 }
 
+static gboolean
+gs_plugin_percentage_update_cb (gpointer user_data)
+{
+	GsPluginStatusHelper *helper = (GsPluginStatusHelper *) user_data;
+	g_signal_emit (helper->plugin,
+		       signals[SIGNAL_PERCENTAGE_CHANGED], 0,
+		       helper->percentage);
+	g_slice_free (GsPluginStatusHelper, helper);
+	return FALSE;
+}
+
+/**
+ * gs_plugin_percentage_update:
+ * @plugin: a #GsPlugin
+ * @percentage: the percentage complete, from 0 to 100
+ *
+ * Update the progress of something the plugin is doing that is not
+ * tied to any one application, for instance downloading all the
+ * updates during a refresh. This is only shown while the global status
+ * stays the same, so set the status first.
+ *
+ * Since: 3.26
+ **/
+void
+gs_plugin_percentage_update (GsPlugin *plugin, guint percentage)
+{
+	GsPluginStatusHelper *helper;
+	helper = g_slice_new0 (GsPluginStatusHelper);
+	helper->plugin = plugin;
+	helper->percentage = MIN (percentage, 100);
+	g_idle_add (gs_plugin_percentage_update_cb, helper);
+}
+
 static gboolean
 gs_plugin_app_launch_cb (gpointer user_data)
 {
@@ -1075,48 +1148,173 @@ gs_plugin_reload (GsPlugin *plugin)
 	g_idle_add (gs_plugin_reload_cb, plugin);
 }
 
+/* size of each read when streaming a download */
+#define GS_PLUGIN_DOWNLOAD_CHUNK_SIZE		(64 * 1024)
+
+/* how often a coalesced download checks its own cancellable */
+#define GS_PLUGIN_DOWNLOAD_WAIT_INTERVAL	(100 * G_TIME_SPAN_MILLISECOND)
+
 typedef struct {
 	GsPlugin	*plugin;
 	GsApp		*app;
-	GCancellable	*cancellable;
+	goffset		 total;
+	goffset		 received;
+	guint		 percentage;
 } GsPluginDownloadHelper;
 
+/* a download in progress that other callers can wait for */
+typedef struct {
+	GCond		 cond;
+	gboolean	 done;
+	guint		 refcount;
+	GError		*error;
+	GBytes		*data;
+	gchar		*filename;
+} GsPluginDownloadRequest;
+
+/* keyed by "data:" or "file:" and then the URI, shared by all plugins */
+static GMutex download_mutex;
+static GHashTable *download_requests = NULL;
+
+/* must be called with download_mutex held */
 static void
-gs_plugin_download_chunk_cb (SoupMessage *msg, SoupBuffer *chunk,
-			     GsPluginDownloadHelper *helper)
+gs_plugin_download_request_unref (GsPluginDownloadRequest *req)
 {
-	GsPluginPrivate *priv = gs_plugin_get_instance_private (helper->plugin);
-	guint percentage;
-	goffset header_size;
-	goffset body_length;
-
-	/* cancelled? */
-	if (g_cancellable_is_cancelled (helper->cancellable)) {
-		g_debug ("cancelling download of %s",
-			 gs_app_get_id (helper->app));
-		soup_session_cancel_message (priv->soup_session,
-					     msg,
-					     SOUP_STATUS_CANCELLED);
+	if (--req->refcount > 0)
 		return;
+	g_cond_clear (&req->cond);
+	if (req->error != NULL)
+		g_error_free (req->error);
+	if (req->data != NULL)
+		g_bytes_unref (req->data);
+	g_free (req->filename);
+	g_free (req);
+}
+
+/* returns %TRUE if the caller has to do the download itself */
+static gboolean
+gs_plugin_download_request_get (const gchar *key, GsPluginDownloadRequest **req)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&download_mutex);
+
+	if (download_requests == NULL)
+		download_requests = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	*req = g_hash_table_lookup (download_requests, key);
+	if (*req != NULL) {
+		(*req)->refcount++;
+		return FALSE;
 	}
+	*req = g_new0 (GsPluginDownloadRequest, 1);
+	g_cond_init (&(*req)->cond);
+	(*req)->refcount = 1;
+	g_hash_table_insert (download_requests, g_strdup (key), *req);
+	return TRUE;
+}
 
-	/* if it's returning "Found" or an error, ignore the percentage */
-	if (msg->status_code != SOUP_STATUS_OK) {
-		g_debug ("ignoring status code %u (%s)",
-			 msg->status_code, msg->reason_phrase);
-		return;
+static void
+gs_plugin_download_request_complete (const gchar *key,
+				     GsPluginDownloadRequest *req,
+				     GBytes *data,
+				     const gchar *filename,
+				     const GError *error)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&download_mutex);
+
+	g_hash_table_remove (download_requests, key);
+	if (data != NULL)
+		req->data = g_bytes_ref (data);
+	req->filename = g_strdup (filename);
+	if (error != NULL)
+		req->error = g_error_copy (error);
+	req->done = TRUE;
+	g_cond_broadcast (&req->cond);
+	gs_plugin_download_request_unref (req);
+}
+
+static gboolean
+gs_plugin_download_request_wait (GsPluginDownloadRequest *req,
+				 GBytes **data,
+				 gchar **filename,
+				 GCancellable *cancellable,
+				 GError **error)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&download_mutex);
+
+	while (!req->done) {
+		if (g_cancellable_is_cancelled (cancellable)) {
+			gs_plugin_download_request_unref (req);
+			g_set_error_literal (error,
+					     GS_PLUGIN_ERROR,
+					     GS_PLUGIN_ERROR_CANCELLED,
+					     "cancelled waiting for download");
+			return FALSE;
+		}
+		g_cond_wait_until (&req->cond, &download_mutex,
+				   g_get_monotonic_time () + GS_PLUGIN_DOWNLOAD_WAIT_INTERVAL);
+	}
+	if (req->error != NULL) {
+		g_propagate_error (error, g_error_copy (req->error));
+		gs_plugin_download_request_unref (req);
+		return FALSE;
 	}
+	if (data != NULL)
+		*data = g_bytes_ref (req->data);
+	if (filename != NULL)
+		*filename = g_strdup (req->filename);
+	gs_plugin_download_request_unref (req);
+	return TRUE;
+}
 
-	/* get data */
-	body_length = msg->response_body->length;
-	header_size = soup_message_headers_get_content_length (msg->response_headers);
+/**
+ * gs_plugin_download_get_waiting:
+ * @uri: a remote URI
+ *
+ * Gets how many callers are waiting for another caller to finish
+ * downloading @uri to memory, which is only useful in the self tests.
+ *
+ * Returns: the number of waiting callers
+ **/
+guint
+gs_plugin_download_get_waiting (const gchar *uri)
+{
+	GsPluginDownloadRequest *req;
+	g_autofree gchar *key = g_strdup_printf ("data:%s", uri);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&download_mutex);
+
+	if (download_requests == NULL)
+		return 0;
+	req = g_hash_table_lookup (download_requests, key);
+	if (req == NULL)
+		return 0;
+	return req->refcount - 1;
+}
+
+/* the download we were waiting on was cancelled by its owner, not us */
+static gboolean
+gs_plugin_download_should_retry (GError *error, GCancellable *cancellable)
+{
+	return g_error_matches (error, GS_PLUGIN_ERROR, GS_PLUGIN_ERROR_CANCELLED) &&
+		!g_cancellable_is_cancelled (cancellable);
+}
+
+static void
+gs_plugin_download_progress (GsPluginDownloadHelper *helper, gsize len)
+{
+	guint percentage;
+
+	helper->received += (goffset) len;
+	if (helper->app == NULL)
+		return;
 
 	/* size is not known */
-	if (header_size < body_length)
+	if (helper->total < helper->received)
 		return;
 
 	/* calulate percentage */
-	percentage = (guint) ((100 * body_length) / header_size);
+	percentage = (guint) ((100 * helper->received) / helper->total);
+	if (percentage == helper->percentage)
+		return;
+	helper->percentage = percentage;
 	g_debug ("%s progress: %u%%", gs_app_get_id (helper->app), percentage);
 	gs_app_set_progress (helper->app, percentage);
 	gs_plugin_status_update (helper->plugin,
@@ -1124,6 +1322,117 @@ gs_plugin_download_chunk_cb (SoupMessage *msg, SoupBuffer *chunk,
 				 GS_PLUGIN_STATUS_DOWNLOADING);
 }
 
+static void
+gs_plugin_download_set_error (GError **error, const gchar *uri, GError *error_local)
+{
+	if (g_error_matches (error_local, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_CANCELLED,
+			     "cancelled download of %s",
+			     uri);
+		return;
+	}
+	g_set_error (error,
+		     GS_PLUGIN_ERROR,
+		     GS_PLUGIN_ERROR_DOWNLOAD_FAILED,
+		     "failed to download %s: %s",
+		     uri, error_local->message);
+}
+
+/* sends the request and returns the body as a stream so that callers
+ * never have to hold the complete response in the SoupMessage */
+static GInputStream *
+gs_plugin_download_send (GsPluginDownloadHelper *helper,
+			 SoupMessage *msg,
+			 const gchar *uri,
+			 GCancellable *cancellable,
+			 GError **error)
+{
+	GsPluginPrivate *priv = gs_plugin_get_instance_private (helper->plugin);
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GInputStream) stream = NULL;
+
+	stream = soup_session_send (priv->soup_session, msg,
+				    cancellable, &error_local);
+	if (stream == NULL) {
+		gs_plugin_download_set_error (error, uri, error_local);
+		return NULL;
+	}
+	if (msg->status_code != SOUP_STATUS_OK &&
+	    msg->status_code != SOUP_STATUS_PARTIAL_CONTENT) {
+		gchar buf[1024];
+		gsize len = 0;
+		g_autoptr(GString) str = g_string_new (NULL);
+		g_string_append (str, soup_status_get_phrase (msg->status_code));
+		if (g_input_stream_read_all (stream, buf, sizeof(buf) - 1, &len,
+					     cancellable, NULL) && len > 0) {
+			buf[len] = '\0';
+			g_string_append (str, ": ");
+			g_string_append (str, buf);
+		}
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_DOWNLOAD_FAILED,
+			     "failed to download %s: %s",
+			     uri, str->str);
+		return NULL;
+	}
+	helper->total = soup_message_headers_get_content_length (msg->response_headers);
+	return g_steal_pointer (&stream);
+}
+
+static GBytes *
+gs_plugin_download_data_internal (GsPlugin *plugin,
+				  GsApp *app,
+				  const gchar *uri,
+				  GCancellable *cancellable,
+				  GError **error)
+{
+	GsPluginDownloadHelper helper = { plugin, app, 0, 0, G_MAXUINT };
+	g_autoptr(GByteArray) buf = NULL;
+	g_autoptr(GInputStream) stream = NULL;
+	g_autoptr(SoupMessage) msg = NULL;
+
+	msg = soup_message_new (SOUP_METHOD_GET, uri);
+	if (msg == NULL) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_DOWNLOAD_FAILED,
+			     "failed to parse url %s",
+			     uri);
+		return NULL;
+	}
+	stream = gs_plugin_download_send (&helper, msg, uri, cancellable, error);
+	if (stream == NULL)
+		return NULL;
+
+	/* read straight into the buffer that becomes the GBytes */
+	if (helper.total > 0 && helper.total < G_MAXUINT)
+		buf = g_byte_array_sized_new ((guint) helper.total);
+	else
+		buf = g_byte_array_new ();
+	while (TRUE) {
+		gssize len;
+		guint offset = buf->len;
+		g_autoptr(GError) error_local = NULL;
+
+		g_byte_array_set_size (buf, offset + GS_PLUGIN_DOWNLOAD_CHUNK_SIZE);
+		len = g_input_stream_read (stream, buf->data + offset,
+					   GS_PLUGIN_DOWNLOAD_CHUNK_SIZE,
+					   cancellable, &error_local);
+		if (len < 0) {
+			gs_plugin_download_set_error (error, uri, error_local);
+			return NULL;
+		}
+		g_byte_array_set_size (buf, offset + (guint) len);
+		if (len == 0)
+			break;
+		gs_plugin_download_progress (&helper, (gsize) len);
+	}
+	return g_byte_array_free_to_bytes (g_steal_pointer (&buf));
+}
+
 /**
  * gs_plugin_download_data:
  * @plugin: a #GsPlugin
@@ -1132,7 +1441,8 @@ gs_plugin_download_chunk_cb (SoupMessage *msg, SoupBuffer *chunk,
  * @cancellable: a #GCancellable, or %NULL
  * @error: a #GError, or %NULL
  *
- * Downloads data.
+ * Downloads data. If the same URI is already being downloaded by this or
+ * any other plugin then the result of that download is shared.
  *
  * Returns: the downloaded data, or %NULL
  *
@@ -1146,9 +1456,7 @@ gs_plugin_download_data (GsPlugin *plugin,
 			 GError **error)
 {
 	GsPluginPrivate *priv = gs_plugin_get_instance_private (plugin);
-	GsPluginDownloadHelper helper;
-	guint status_code;
-	g_autoptr(SoupMessage) msg = NULL;
+	g_autofree gchar *key = NULL;
 
 	g_return_val_if_fail (GS_IS_PLUGIN (plugin), NULL);
 	g_return_val_if_fail (uri != NULL, NULL);
@@ -1168,37 +1476,214 @@ gs_plugin_download_data (GsPlugin *plugin,
 				     uri, error_local->message);
 			return NULL;
 		}
-		return g_bytes_new (contents, length);
+		return g_bytes_new_take (g_steal_pointer (&contents), length);
 	}
 
 	/* remote */
-	g_debug ("downloading %s from plugin %s", uri, priv->name);
+	key = g_strdup_printf ("data:%s", uri);
+	while (TRUE) {
+		GBytes *data = NULL;
+		GsPluginDownloadRequest *req = NULL;
+		g_autoptr(GError) error_local = NULL;
+
+		if (gs_plugin_download_request_get (key, &req)) {
+			g_debug ("downloading %s from plugin %s", uri, priv->name);
+			data = gs_plugin_download_data_internal (plugin, app, uri,
+								 cancellable,
+								 &error_local);
+			gs_plugin_download_request_complete (key, req, data,
+							     NULL, error_local);
+		} else {
+			g_debug ("waiting for existing download of %s in plugin %s",
+				 uri, priv->name);
+			if (!gs_plugin_download_request_wait (req, &data, NULL,
+							      cancellable,
+							      &error_local) &&
+			    gs_plugin_download_should_retry (error_local, cancellable))
+				continue;
+		}
+		if (data == NULL) {
+			g_propagate_error (error, g_steal_pointer (&error_local));
+			return NULL;
+		}
+		return data;
+	}
+}
+
+static gboolean
+gs_plugin_download_file_internal (GsPlugin *plugin,
+				  GsApp *app,
+				  const gchar *uri,
+				  const gchar *filename,
+				  GCancellable *cancellable,
+				  GError **error)
+{
+	GsPluginDownloadHelper helper = { plugin, app, 0, 0, G_MAXUINT };
+	const gchar *last_modified;
+	goffset offset = 0;
+	g_autofree gchar *filename_partial = NULL;
+	g_autofree guint8 *buf = NULL;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GFile) file_partial = NULL;
+	g_autoptr(GFileOutputStream) ostream = NULL;
+	g_autoptr(GInputStream) stream = NULL;
+	g_autoptr(SoupMessage) msg = NULL;
+
 	msg = soup_message_new (SOUP_METHOD_GET, uri);
-	if (app != NULL) {
-		helper.plugin = plugin;
-		helper.app = app;
-		helper.cancellable = cancellable;
-		g_signal_connect (msg, "got-chunk",
-				  G_CALLBACK (gs_plugin_download_chunk_cb),
-				  &helper);
+	if (msg == NULL) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_DOWNLOAD_FAILED,
+			     "failed to parse url %s",
+			     uri);
+		return FALSE;
 	}
-	status_code = soup_session_send_message (priv->soup_session, msg);
-	if (status_code != SOUP_STATUS_OK) {
-		g_autoptr(GString) str = g_string_new (NULL);
-		g_string_append (str, soup_status_get_phrase (status_code));
-		if (msg->response_body->data != NULL) {
-			g_string_append (str, ": ");
-			g_string_append (str, msg->response_body->data);
+
+	/* an earlier attempt was interrupted, so try to continue it; the
+	 * partial file has the Last-Modified time of the resource so the
+	 * server sends the whole file again if it has since changed */
+	filename_partial = g_strdup_printf ("%s.partial", filename);
+	file_partial = g_file_new_for_path (filename_partial);
+	if (g_file_test (filename_partial, G_FILE_TEST_EXISTS)) {
+		g_autoptr(GFileInfo) info = NULL;
+		info = g_file_query_info (file_partial,
+					  G_FILE_ATTRIBUTE_STANDARD_SIZE ","
+					  G_FILE_ATTRIBUTE_TIME_MODIFIED,
+					  G_FILE_QUERY_INFO_NONE,
+					  cancellable, NULL);
+		if (info != NULL && g_file_info_get_size (info) > 0) {
+			guint64 mtime;
+			g_autofree gchar *date_str = NULL;
+			g_autoptr(SoupDate) date = NULL;
+
+			offset = g_file_info_get_size (info);
+			mtime = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+			date = soup_date_new_from_time_t ((time_t) mtime);
+			date_str = soup_date_to_string (date, SOUP_DATE_HTTP);
+			soup_message_headers_set_range (msg->request_headers, offset, -1);
+			soup_message_headers_append (msg->request_headers,
+						     "If-Range", date_str);
+			g_debug ("resuming download of %s at %" G_GOFFSET_FORMAT,
+				 uri, offset);
+		}
+	}
+	stream = gs_plugin_download_send (&helper, msg, uri, cancellable, &error_local);
+	if (stream == NULL) {
+		/* the partial file is already complete or is bigger, so
+		 * throw it away and start again from the beginning */
+		if (offset > 0 &&
+		    msg->status_code == SOUP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE) {
+			g_debug ("cannot resume download of %s: %s",
+				 uri, error_local->message);
+			g_unlink (filename_partial);
+			return gs_plugin_download_file_internal (plugin, app, uri,
+								 filename,
+								 cancellable,
+								 error);
+		}
+		g_propagate_error (error, g_steal_pointer (&error_local));
+		return FALSE;
+	}
+
+	/* continue where we left off, or start again */
+	if (msg->status_code == SOUP_STATUS_PARTIAL_CONTENT) {
+		goffset start = 0;
+		goffset end = 0;
+		goffset total = 0;
+		if (!soup_message_headers_get_content_range (msg->response_headers,
+							     &start, &end, &total) ||
+		    start != offset) {
+			g_set_error (error,
+				     GS_PLUGIN_ERROR,
+				     GS_PLUGIN_ERROR_DOWNLOAD_FAILED,
+				     "failed to download %s: invalid range",
+				     uri);
+			g_unlink (filename_partial);
+			return FALSE;
+		}
+		helper.total += offset;
+		helper.received = offset;
+		ostream = g_file_append_to (file_partial, G_FILE_CREATE_NONE,
+					    cancellable, &error_local);
+	} else {
+		g_unlink (filename_partial);
+		ostream = g_file_create (file_partial, G_FILE_CREATE_NONE,
+					 cancellable, &error_local);
+	}
+	if (ostream == NULL) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_WRITE_FAILED,
+			     "Failed to save file: %s",
+			     error_local->message);
+		return FALSE;
+	}
+
+	/* stream to the partial file, which only replaces the destination
+	 * when the download is complete */
+	buf = g_malloc (GS_PLUGIN_DOWNLOAD_CHUNK_SIZE);
+	while (TRUE) {
+		gssize len;
+		len = g_input_stream_read (stream, buf,
+					   GS_PLUGIN_DOWNLOAD_CHUNK_SIZE,
+					   cancellable, &error_local);
+		if (len < 0) {
+			gs_plugin_download_set_error (error, uri, error_local);
+			break;
 		}
+		if (len == 0)
+			break;
+		if (!g_output_stream_write_all (G_OUTPUT_STREAM (ostream),
+						buf, (gsize) len, NULL,
+						cancellable, &error_local)) {
+			g_set_error (error,
+				     GS_PLUGIN_ERROR,
+				     GS_PLUGIN_ERROR_WRITE_FAILED,
+				     "Failed to save file: %s",
+				     error_local->message);
+			break;
+		}
+		gs_plugin_download_progress (&helper, (gsize) len);
+	}
+	if (error_local == NULL) {
+		g_output_stream_close (G_OUTPUT_STREAM (ostream),
+				       cancellable, &error_local);
+		if (error_local != NULL) {
+			g_set_error (error,
+				     GS_PLUGIN_ERROR,
+				     GS_PLUGIN_ERROR_WRITE_FAILED,
+				     "Failed to save file: %s",
+				     error_local->message);
+		}
+	} else {
+		g_output_stream_close (G_OUTPUT_STREAM (ostream), NULL, NULL);
+	}
+
+	/* keep what we have if the server can tell us later if it changed */
+	if (error_local != NULL) {
+		g_autoptr(SoupDate) date = NULL;
+		last_modified = soup_message_headers_get_one (msg->response_headers,
+							      "Last-Modified");
+		if (last_modified != NULL)
+			date = soup_date_new_from_string (last_modified);
+		if (date == NULL ||
+		    !g_file_set_attribute_uint64 (file_partial,
+						  G_FILE_ATTRIBUTE_TIME_MODIFIED,
+						  (guint64) soup_date_to_time_t (date),
+						  G_FILE_QUERY_INFO_NONE,
+						  NULL, NULL))
+			g_unlink (filename_partial);
+		return FALSE;
+	}
+	if (g_rename (filename_partial, filename) != 0) {
 		g_set_error (error,
 			     GS_PLUGIN_ERROR,
-			     GS_PLUGIN_ERROR_DOWNLOAD_FAILED,
-			     "failed to download %s: %s",
-			     uri, str->str);
-		return NULL;
+			     GS_PLUGIN_ERROR_WRITE_FAILED,
+			     "Failed to save file %s: %s",
+			     filename, g_strerror (errno));
+		return FALSE;
 	}
-	return g_bytes_new (msg->response_body->data,
-			    (gsize) msg->response_body->length);
+	return TRUE;
 }
 
 /**
@@ -1210,7 +1695,9 @@ gs_plugin_download_data (GsPlugin *plugin,
  * @cancellable: a #GCancellable, or %NULL
  * @error: a #GError, or %NULL
  *
- * Downloads data and saves it to a file.
+ * Downloads data and saves it to a file. If the same URI is already being
+ * downloaded by this or any other plugin then the result of that download
+ * is shared, and interrupted downloads are resumed where possible.
  *
  * Returns: %TRUE for success
  *
@@ -1225,10 +1712,7 @@ gs_plugin_download_file (GsPlugin *plugin,
 			 GError **error)
 {
 	GsPluginPrivate *priv = gs_plugin_get_instance_private (plugin);
-	GsPluginDownloadHelper helper;
-	guint status_code;
-	g_autoptr(GError) error_local = NULL;
-	g_autoptr(SoupMessage) msg = NULL;
+	g_autofree gchar *key = NULL;
 
 	g_return_val_if_fail (GS_IS_PLUGIN (plugin), FALSE);
 	g_return_val_if_fail (uri != NULL, FALSE);
@@ -1239,6 +1723,7 @@ gs_plugin_download_file (GsPlugin *plugin,
 	if (g_str_has_prefix (uri, "file://")) {
 		gsize length = 0;
 		g_autofree gchar *contents = NULL;
+		g_autoptr(GError) error_local = NULL;
 		g_debug ("copying %s from plugin %s", uri, priv->name);
 		if (!g_file_get_contents (uri + 7, &contents, &length, &error_local)) {
 			g_set_error (error,
@@ -1260,40 +1745,120 @@ gs_plugin_download_file (GsPlugin *plugin,
 	}
 
 	/* remote */
-	g_debug ("downloading %s to %s from plugin %s", uri, filename, priv->name);
-	msg = soup_message_new (SOUP_METHOD_GET, uri);
-	if (app != NULL) {
-		helper.plugin = plugin;
-		helper.app = app;
-		helper.cancellable = cancellable;
-		g_signal_connect (msg, "got-chunk",
-				  G_CALLBACK (gs_plugin_download_chunk_cb),
-				  &helper);
-	}
-	status_code = soup_session_send_message (priv->soup_session, msg);
-	if (status_code != SOUP_STATUS_OK) {
-		g_autoptr(GString) str = g_string_new (NULL);
-		g_string_append (str, soup_status_get_phrase (status_code));
-		if (msg->response_body->data != NULL) {
-			g_string_append (str, ": ");
-			g_string_append (str, msg->response_body->data);
+	key = g_strdup_printf ("file:%s", uri);
+	while (TRUE) {
+		GsPluginDownloadRequest *req = NULL;
+		g_autofree gchar *filename_shared = NULL;
+		g_autoptr(GError) error_local = NULL;
+		g_autoptr(GFile) file_dest = NULL;
+		g_autoptr(GFile) file_src = NULL;
+
+		if (gs_plugin_download_request_get (key, &req)) {
+			gboolean ret;
+			g_debug ("downloading %s to %s from plugin %s",
+				 uri, filename, priv->name);
+			ret = gs_plugin_download_file_internal (plugin, app,
+								uri, filename,
+								cancellable,
+								&error_local);
+			gs_plugin_download_request_complete (key, req, NULL,
+							     ret ? filename : NULL,
+							     error_local);
+			if (!ret) {
+				g_propagate_error (error, g_steal_pointer (&error_local));
+				return FALSE;
+			}
+			return TRUE;
 		}
+
+		/* somebody else is already downloading this */
+		g_debug ("waiting for existing download of %s in plugin %s",
+			 uri, priv->name);
+		if (!gs_plugin_download_request_wait (req, NULL,
+						      &filename_shared,
+						      cancellable,
+						      &error_local)) {
+			if (gs_plugin_download_should_retry (error_local, cancellable))
+				continue;
+			g_propagate_error (error, g_steal_pointer (&error_local));
+			return FALSE;
+		}
+		if (g_strcmp0 (filename_shared, filename) == 0)
+			return TRUE;
+		file_src = g_file_new_for_path (filename_shared);
+		file_dest = g_file_new_for_path (filename);
+		if (!g_file_copy (file_src, file_dest,
+				  G_FILE_COPY_OVERWRITE,
+				  cancellable, NULL, NULL,
+				  &error_local)) {
+			g_set_error (error,
+				     GS_PLUGIN_ERROR,
+				     GS_PLUGIN_ERROR_WRITE_FAILED,
+				     "Failed to save file: %s",
+				     error_local->message);
+			return FALSE;
+		}
+		return TRUE;
+	}
+}
+
+/**
+ * gs_plugin_download_file_with_checksum:
+ * @plugin: a #GsPlugin
+ * @app: a #GsApp, or %NULL
+ * @uri: a remote URI
+ * @filename: a local filename
+ * @checksum_type: a #GChecksumType, e.g. %G_CHECKSUM_SHA1
+ * @checksum: the expected checksum of the file
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Downloads data and saves it to a file, as for gs_plugin_download_file(),
+ * and then verifies the complete file. If the checksum does not match then
+ * the file is deleted.
+ *
+ * Returns: %TRUE for success
+ *
+ * Since: 3.26
+ **/
+gboolean
+gs_plugin_download_file_with_checksum (GsPlugin *plugin,
+				       GsApp *app,
+				       const gchar *uri,
+				       const gchar *filename,
+				       GChecksumType checksum_type,
+				       const gchar *checksum,
+				       GCancellable *cancellable,
+				       GError **error)
+{
+	g_autofree gchar *checksum_actual = NULL;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GMappedFile) mapped = NULL;
+
+	g_return_val_if_fail (checksum != NULL, FALSE);
+
+	if (!gs_plugin_download_file (plugin, app, uri, filename,
+				      cancellable, error))
+		return FALSE;
+	mapped = g_mapped_file_new (filename, FALSE, &error_local);
+	if (mapped == NULL) {
 		g_set_error (error,
 			     GS_PLUGIN_ERROR,
-			     GS_PLUGIN_ERROR_DOWNLOAD_FAILED,
-			     "failed to download %s: %s",
-			     uri, str->str);
+			     GS_PLUGIN_ERROR_FAILED,
+			     "failed to verify %s: %s",
+			     filename, error_local->message);
 		return FALSE;
 	}
-	if (!g_file_set_contents (filename,
-				  msg->response_body->data,
-				  msg->response_body->length,
-				  &error_local)) {
+	checksum_actual = g_compute_checksum_for_data (checksum_type,
+						       (const guchar *) g_mapped_file_get_contents (mapped),
+						       g_mapped_file_get_length (mapped));
+	if (g_ascii_strcasecmp (checksum, checksum_actual) != 0) {
 		g_set_error (error,
 			     GS_PLUGIN_ERROR,
-			     GS_PLUGIN_ERROR_WRITE_FAILED,
-			     "Failed to save file: %s",
-			     error_local->message);
+			     GS_PLUGIN_ERROR_INVALID_FORMAT,
+			     "%s does not match checksum, expected %s got %s",
+			     filename, checksum, checksum_actual);
+		g_unlink (filename);
 		return FALSE;
 	}
 	return TRUE;
@@ -1471,6 +2036,34 @@ gs_plugin_set_allow_updates (GsPlugin *plugin, gboolean allow_updates)
 	g_signal_emit (plugin, signals[SIGNAL_ALLOW_UPDATES], 0, allow_updates);
 }
 
+/**
+ * gs_plugin_report_partial_results:
+ * @plugin: a #GsPlugin
+ * @list: the #GsAppList passed to the plugin vfunc
+ * @partial: the #GsApp's found so far that have not been reported yet
+ *
+ * Reports some of the results of a search before the vfunc returns, so
+ * that the UI can show something while a slow query is still running.
+ *
+ * The apps in @partial are not refined or filtered, and the plugin must
+ * still add its results to @list. Callers that did not ask for partial
+ * results ignore this.
+ *
+ * Since: 3.26
+ **/
+void
+gs_plugin_report_partial_results (GsPlugin *plugin,
+				  GsAppList *list,
+				  GsAppList *partial)
+{
+	g_return_if_fail (GS_IS_PLUGIN (plugin));
+	g_return_if_fail (GS_IS_APP_LIST (list));
+	g_return_if_fail (GS_IS_APP_LIST (partial));
+	if (gs_app_list_length (partial) == 0)
+		return;
+	g_signal_emit (plugin, signals[SIGNAL_PARTIAL_RESULTS], 0, list, partial);
+}
+
 /**
  * gs_plugin_error_to_string:
  * @error: a #GsPluginError, e.g. %GS_PLUGIN_ERROR_NO_NETWORK
@@ -1785,6 +2378,20 @@ gs_plugin_class_init (GsPluginClass *klass)
 			      G_STRUCT_OFFSET (GsPluginClass, allow_updates),
 			      NULL, NULL, g_cclosure_marshal_VOID__BOOLEAN,
 			      G_TYPE_NONE, 1, G_TYPE_BOOLEAN);
+
+	signals [SIGNAL_PARTIAL_RESULTS] =
+		g_signal_new ("partial-results",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GsPluginClass, partial_results),
+			      NULL, NULL, g_cclosure_marshal_generic,
+			      G_TYPE_NONE, 2, GS_TYPE_APP_LIST, GS_TYPE_APP_LIST);
+
+	signals [SIGNAL_PERCENTAGE_CHANGED] =
+		g_signal_new ("percentage-changed",
+			      G_TYPE_FROM_CLASS (object_class), G_SIGNAL_RUN_LAST,
+			      G_STRUCT_OFFSET (GsPluginClass, percentage_changed),
+			      NULL, NULL, g_cclosure_marshal_VOID__UINT,
+			      G_TYPE_NONE, 1, G_TYPE_UINT);
 }
 
 static void
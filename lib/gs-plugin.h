@@ -34,6 +34,7 @@
 #include "gs-category.h"
 #include "gs-plugin-event.h"
 #include "gs-plugin-types.h"
+#include "gs-review-store.h"
 
 G_BEGIN_DECLS
 
@@ -53,7 +54,12 @@ struct _GsPluginClass
 							 GsPluginEvent	*event);
 	void			(*allow_updates)	(GsPlugin	*plugin,
 							 gboolean	 allow_updates);
-	gpointer		 padding[26];
+	void			(*partial_results)	(GsPlugin	*plugin,
+							 GsAppList	*list,
+							 GsAppList	*partial);
+	void			(*percentage_changed)	(GsPlugin	*plugin,
+							 guint		 percentage);
+	gpointer		 padding[24];
 };
 
 typedef struct	GsPluginData	GsPluginData;
@@ -85,6 +91,7 @@ const gchar	*gs_plugin_get_locale			(GsPlugin	*plugin);
 const gchar	*gs_plugin_get_language			(GsPlugin	*plugin);
 AsProfile	*gs_plugin_get_profile			(GsPlugin	*plugin);
 SoupSession	*gs_plugin_get_soup_session		(GsPlugin	*plugin);
+GsReviewStore	*gs_plugin_get_review_store		(GsPlugin	*plugin);
 void		 gs_plugin_add_auth			(GsPlugin	*plugin,
 							 GsAuth		*auth);
 GsAuth		*gs_plugin_get_auth_by_id		(GsPlugin	*plugin,
@@ -105,6 +112,14 @@ gboolean	 gs_plugin_download_file		(GsPlugin	*plugin,
 							 const gchar	*filename,
 							 GCancellable	*cancellable,
 							 GError		**error);
+gboolean	 gs_plugin_download_file_with_checksum	(GsPlugin	*plugin,
+							 GsApp		*app,
+							 const gchar	*uri,
+							 const gchar	*filename,
+							 GChecksumType	 checksum_type,
+							 const gchar	*checksum,
+							 GCancellable	*cancellable,
+							 GError		**error);
 gboolean	 gs_plugin_check_distro_id		(GsPlugin	*plugin,
 							 const gchar	*distro_id);
 GsApp		*gs_plugin_cache_lookup			(GsPlugin	*plugin,
@@ -118,6 +133,8 @@ void		 gs_plugin_cache_invalidate		(GsPlugin	*plugin);
 void		 gs_plugin_status_update		(GsPlugin	*plugin,
 							 GsApp		*app,
 							 GsPluginStatus	 status);
+void		 gs_plugin_percentage_update		(GsPlugin	*plugin,
+							 guint		 percentage);
 gboolean	 gs_plugin_app_launch			(GsPlugin	*plugin,
 							 GsApp		*app,
 							 GError		**error);
@@ -128,6 +145,9 @@ void		 gs_plugin_report_event			(GsPlugin	*plugin,
 							 GsPluginEvent	*event);
 void		 gs_plugin_set_allow_updates		(GsPlugin	*plugin,
 							 gboolean	 allow_updates);
+void		 gs_plugin_report_partial_results	(GsPlugin	*plugin,
+							 GsAppList	*list,
+							 GsAppList	*partial);
 
 G_END_DECLS
 
@@ -0,0 +1,599 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/**
+ * SECTION:gs-review-store
+ * @title: GsReviewStore
+ * @include: gnome-software.h
+ * @stability: Unstable
+ * @short_description: Reviews shared between all plugins
+ *
+ * This object stores the reviews downloaded by plugins, indexed by the
+ * application ID and already sorted by score. The store is saved to a
+ * single file that is mapped when loaded, and the reviews for each
+ * application are only deserialized when they are first requested.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "gs-review-store.h"
+#include "gs-plugin.h"
+#include "gs-utils.h"
+
+/* bump this if the format changes */
+#define GS_REVIEW_STORE_VERSION		1
+
+/* entries not refreshed in this time are not saved again */
+#define GS_REVIEW_STORE_AGE_MAX		(60 * 60 * 24 * 7 * 4)
+
+#define GS_REVIEW_STORE_REVIEW_TYPE	"(ssssssiixta{ss})"
+#define GS_REVIEW_STORE_ENTRY_TYPE	"(sxa" GS_REVIEW_STORE_REVIEW_TYPE ")"
+#define GS_REVIEW_STORE_TYPE		"(ua" GS_REVIEW_STORE_ENTRY_TYPE ")"
+
+typedef struct {
+	gint64			 timestamp;
+	GPtrArray		*reviews;	/* of AsReview, sorted */
+	GVariant		*data;		/* not yet deserialized */
+} GsReviewStoreEntry;
+
+struct _GsReviewStore
+{
+	GObject			 parent_instance;
+
+	GMutex			 mutex;
+	gchar			*filename;
+	gboolean		 loaded;
+	gboolean		 changed;
+	GHashTable		*entries;	/* app-id : GsReviewStoreEntry */
+};
+
+G_DEFINE_TYPE (GsReviewStore, gs_review_store, G_TYPE_OBJECT)
+
+static void
+gs_review_store_entry_free (GsReviewStoreEntry *entry)
+{
+	if (entry->reviews != NULL)
+		g_ptr_array_unref (entry->reviews);
+	if (entry->data != NULL)
+		g_variant_unref (entry->data);
+	g_free (entry);
+}
+
+static gint
+gs_review_store_score_sort_cb (gconstpointer a, gconstpointer b)
+{
+	AsReview *ra = *((AsReview **) a);
+	AsReview *rb = *((AsReview **) b);
+	if (as_review_get_priority (ra) < as_review_get_priority (rb))
+		return 1;
+	if (as_review_get_priority (ra) > as_review_get_priority (rb))
+		return -1;
+	return 0;
+}
+
+/**
+ * gs_review_store_sort_reviews:
+ * @reviews: (element-type AsReview): an array of reviews
+ *
+ * Sorts the reviews so the highest scoring are first. Nothing is done
+ * if the reviews are already in order, which is the case for reviews
+ * returned from the store.
+ *
+ * Since: 3.26
+ **/
+void
+gs_review_store_sort_reviews (GPtrArray *reviews)
+{
+	guint i;
+
+	for (i = 1; i < reviews->len; i++) {
+		if (gs_review_store_score_sort_cb (&g_ptr_array_index (reviews, i - 1),
+						   &g_ptr_array_index (reviews, i)) > 0) {
+			g_ptr_array_sort (reviews, gs_review_store_score_sort_cb);
+			return;
+		}
+	}
+}
+
+static const gchar *
+gs_review_store_str_or_null (const gchar *str)
+{
+	if (str == NULL || str[0] == '\0')
+		return NULL;
+	return str;
+}
+
+static AsReview *
+gs_review_store_review_from_variant (GVariant *value)
+{
+	AsReview *review = as_review_new ();
+	GVariantIter iter;
+	const gchar *id, *summary, *description;
+	const gchar *reviewer_id, *reviewer_name, *version;
+	const gchar *key, *val;
+	gint32 rating, priority;
+	gint64 date;
+	guint64 flags;
+	g_autoptr(GVariant) metadata = NULL;
+
+	g_variant_get (value, "(&s&s&s&s&s&siixt@a{ss})",
+		       &id, &summary, &description,
+		       &reviewer_id, &reviewer_name, &version,
+		       &rating, &priority, &date, &flags, &metadata);
+	as_review_set_id (review, gs_review_store_str_or_null (id));
+	as_review_set_summary (review, gs_review_store_str_or_null (summary));
+	as_review_set_description (review, gs_review_store_str_or_null (description));
+	as_review_set_reviewer_id (review, gs_review_store_str_or_null (reviewer_id));
+	as_review_set_reviewer_name (review, gs_review_store_str_or_null (reviewer_name));
+	as_review_set_version (review, gs_review_store_str_or_null (version));
+	as_review_set_rating (review, rating);
+	as_review_set_priority (review, priority);
+	as_review_set_flags (review, (AsReviewFlags) flags);
+	if (date != 0) {
+		g_autoptr(GDateTime) dt = g_date_time_new_from_unix_utc (date);
+		as_review_set_date (review, dt);
+	}
+	g_variant_iter_init (&iter, metadata);
+	while (g_variant_iter_next (&iter, "{&s&s}", &key, &val))
+		as_review_add_metadata (review, key, val);
+	return review;
+}
+
+static GVariant *
+gs_review_store_review_to_variant (AsReview *review)
+{
+	GDateTime *dt = as_review_get_date (review);
+	GHashTable *metadata = as_review_get_metadata (review);
+	GVariantBuilder builder;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{ss}"));
+	if (metadata != NULL) {
+		GHashTableIter iter;
+		gpointer key, value;
+		g_hash_table_iter_init (&iter, metadata);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			g_variant_builder_add (&builder, "{ss}",
+					       (const gchar *) key,
+					       value != NULL ? (const gchar *) value : "");
+		}
+	}
+	return g_variant_new ("(ssssssiixta{ss})",
+			      as_review_get_id (review) != NULL ? as_review_get_id (review) : "",
+			      as_review_get_summary (review) != NULL ? as_review_get_summary (review) : "",
+			      as_review_get_description (review) != NULL ? as_review_get_description (review) : "",
+			      as_review_get_reviewer_id (review) != NULL ? as_review_get_reviewer_id (review) : "",
+			      as_review_get_reviewer_name (review) != NULL ? as_review_get_reviewer_name (review) : "",
+			      as_review_get_version (review) != NULL ? as_review_get_version (review) : "",
+			      (gint32) as_review_get_rating (review),
+			      (gint32) as_review_get_priority (review),
+			      dt != NULL ? g_date_time_to_unix (dt) : (gint64) 0,
+			      (guint64) as_review_get_flags (review),
+			      &builder);
+}
+
+/* the reviews get flags and metadata set once added to an app, so the
+ * stored ones are never handed out directly */
+static AsReview *
+gs_review_store_review_copy (AsReview *review)
+{
+	g_autoptr(GVariant) value = NULL;
+	value = g_variant_ref_sink (gs_review_store_review_to_variant (review));
+	return gs_review_store_review_from_variant (value);
+}
+
+/* must be called with the mutex held */
+static GPtrArray *
+gs_review_store_entry_get_reviews (GsReviewStoreEntry *entry)
+{
+	GVariantIter iter;
+	GVariant *child;
+
+	if (entry->reviews != NULL)
+		return entry->reviews;
+
+	/* deserialize on first use */
+	entry->reviews = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_variant_iter_init (&iter, entry->data);
+	while ((child = g_variant_iter_next_value (&iter)) != NULL) {
+		g_ptr_array_add (entry->reviews,
+				 gs_review_store_review_from_variant (child));
+		g_variant_unref (child);
+	}
+	gs_review_store_sort_reviews (entry->reviews);
+	g_clear_pointer (&entry->data, g_variant_unref);
+	return entry->reviews;
+}
+
+/* must be called with the mutex held */
+static gboolean
+gs_review_store_ensure_filename (GsReviewStore *store, GError **error)
+{
+	if (store->filename != NULL)
+		return TRUE;
+	store->filename = gs_utils_get_cache_filename ("reviews",
+						       "reviews.gvariant",
+						       GS_UTILS_CACHE_FLAG_WRITEABLE,
+						       error);
+	return store->filename != NULL;
+}
+
+/* must be called with the mutex held */
+static gboolean
+gs_review_store_load_unlocked (GsReviewStore *store, GError **error)
+{
+	GVariantIter iter;
+	GVariant *child;
+	guint32 version;
+	g_autoptr(GBytes) bytes = NULL;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GMappedFile) mapped_file = NULL;
+	g_autoptr(GVariant) entries = NULL;
+	g_autoptr(GVariant) root = NULL;
+
+	store->loaded = TRUE;
+	if (!gs_review_store_ensure_filename (store, error))
+		return FALSE;
+	if (!g_file_test (store->filename, G_FILE_TEST_EXISTS))
+		return TRUE;
+
+	mapped_file = g_mapped_file_new (store->filename, FALSE, &error_local);
+	if (mapped_file == NULL) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_FAILED,
+			     "failed to load %s: %s",
+			     store->filename, error_local->message);
+		return FALSE;
+	}
+	bytes = g_mapped_file_get_bytes (mapped_file);
+	root = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (GS_REVIEW_STORE_TYPE),
+							     bytes, FALSE));
+	g_variant_get (root, "(u@a" GS_REVIEW_STORE_ENTRY_TYPE ")", &version, &entries);
+	if (version != GS_REVIEW_STORE_VERSION) {
+		g_debug ("ignoring %s with version %u", store->filename, version);
+		return TRUE;
+	}
+
+	/* only index, the reviews are parsed when they are needed */
+	g_variant_iter_init (&iter, entries);
+	while ((child = g_variant_iter_next_value (&iter)) != NULL) {
+		GsReviewStoreEntry *entry = g_new0 (GsReviewStoreEntry, 1);
+		const gchar *app_id;
+		g_variant_get (child, "(&sx@a" GS_REVIEW_STORE_REVIEW_TYPE ")",
+			       &app_id, &entry->timestamp, &entry->data);
+		if (!g_hash_table_contains (store->entries, app_id)) {
+			g_hash_table_insert (store->entries,
+					     g_strdup (app_id),
+					     entry);
+		} else {
+			gs_review_store_entry_free (entry);
+		}
+		g_variant_unref (child);
+	}
+	g_debug ("loaded reviews for %u apps from %s",
+		 g_hash_table_size (store->entries), store->filename);
+	return TRUE;
+}
+
+/* must be called with the mutex held */
+static void
+gs_review_store_ensure_loaded (GsReviewStore *store)
+{
+	g_autoptr(GError) error = NULL;
+	if (store->loaded)
+		return;
+	if (!gs_review_store_load_unlocked (store, &error))
+		g_warning ("failed to load reviews: %s", error->message);
+}
+
+/**
+ * gs_review_store_load:
+ * @store: a #GsReviewStore
+ * @error: a #GError, or %NULL
+ *
+ * Loads the store from disk. This is done automatically the first time
+ * the store is used if not called explicitly.
+ *
+ * Returns: %TRUE for success
+ *
+ * Since: 3.26
+ **/
+gboolean
+gs_review_store_load (GsReviewStore *store, GError **error)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_return_val_if_fail (GS_IS_REVIEW_STORE (store), FALSE);
+	locker = g_mutex_locker_new (&store->mutex);
+	if (store->loaded)
+		return TRUE;
+	return gs_review_store_load_unlocked (store, error);
+}
+
+/**
+ * gs_review_store_save:
+ * @store: a #GsReviewStore
+ * @error: a #GError, or %NULL
+ *
+ * Saves the store to disk if it has been changed, dropping any entries
+ * that have not been refreshed for a long time.
+ *
+ * Returns: %TRUE for success
+ *
+ * Since: 3.26
+ **/
+gboolean
+gs_review_store_save (GsReviewStore *store, GError **error)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+	GVariantBuilder builder;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GVariant) root = NULL;
+
+	g_return_val_if_fail (GS_IS_REVIEW_STORE (store), FALSE);
+
+	locker = g_mutex_locker_new (&store->mutex);
+	if (!store->changed)
+		return TRUE;
+	if (!gs_review_store_ensure_filename (store, error))
+		return FALSE;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a" GS_REVIEW_STORE_ENTRY_TYPE));
+	g_hash_table_iter_init (&iter, store->entries);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		GsReviewStoreEntry *entry = (GsReviewStoreEntry *) value;
+		GVariant *data;
+
+		/* expired */
+		if (now - entry->timestamp > GS_REVIEW_STORE_AGE_MAX) {
+			g_hash_table_iter_remove (&iter);
+			continue;
+		}
+
+		/* reuse the serialized data if it was never parsed */
+		if (entry->data != NULL) {
+			data = entry->data;
+		} else {
+			GVariantBuilder builder_reviews;
+			guint i;
+			g_variant_builder_init (&builder_reviews,
+						G_VARIANT_TYPE ("a" GS_REVIEW_STORE_REVIEW_TYPE));
+			for (i = 0; i < entry->reviews->len; i++) {
+				AsReview *review = g_ptr_array_index (entry->reviews, i);
+				g_variant_builder_add_value (&builder_reviews,
+							     gs_review_store_review_to_variant (review));
+			}
+			data = g_variant_builder_end (&builder_reviews);
+		}
+		g_variant_builder_add (&builder, "(sx@a" GS_REVIEW_STORE_REVIEW_TYPE ")",
+				       (const gchar *) key, entry->timestamp, data);
+	}
+	root = g_variant_ref_sink (g_variant_new ("(u@a" GS_REVIEW_STORE_ENTRY_TYPE ")",
+						  (guint32) GS_REVIEW_STORE_VERSION,
+						  g_variant_builder_end (&builder)));
+
+	/* the old file may still be mapped, so replace it atomically */
+	if (!g_file_set_contents (store->filename,
+				  g_variant_get_data (root),
+				  (gssize) g_variant_get_size (root),
+				  &error_local)) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_WRITE_FAILED,
+			     "failed to save %s: %s",
+			     store->filename, error_local->message);
+		return FALSE;
+	}
+	store->changed = FALSE;
+	return TRUE;
+}
+
+/**
+ * gs_review_store_add_reviews:
+ * @store: a #GsReviewStore
+ * @app_id: an application ID
+ * @reviews: (element-type AsReview): reviews for the application
+ *
+ * Replaces all the reviews stored for the application. The reviews are
+ * copied and sorted when added, so they never need sorting when read
+ * back and changing @reviews afterwards does not affect the store.
+ *
+ * Since: 3.26
+ **/
+void
+gs_review_store_add_reviews (GsReviewStore *store,
+			     const gchar *app_id,
+			     GPtrArray *reviews)
+{
+	GsReviewStoreEntry *entry;
+	guint i;
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	g_return_if_fail (GS_IS_REVIEW_STORE (store));
+	g_return_if_fail (app_id != NULL);
+
+	locker = g_mutex_locker_new (&store->mutex);
+	gs_review_store_ensure_loaded (store);
+	entry = g_new0 (GsReviewStoreEntry, 1);
+	entry->timestamp = g_get_real_time () / G_USEC_PER_SEC;
+	entry->reviews = g_ptr_array_new_full (reviews->len, (GDestroyNotify) g_object_unref);
+	for (i = 0; i < reviews->len; i++)
+		g_ptr_array_add (entry->reviews,
+				 gs_review_store_review_copy (g_ptr_array_index (reviews, i)));
+	gs_review_store_sort_reviews (entry->reviews);
+	g_hash_table_replace (store->entries, g_strdup (app_id), entry);
+	store->changed = TRUE;
+}
+
+/**
+ * gs_review_store_get_reviews:
+ * @store: a #GsReviewStore
+ * @app_id: an application ID
+ * @cache_age: the maximum age of the reviews in seconds
+ *
+ * Gets copies of the stored reviews for an application, highest score
+ * first. The copies can be changed without affecting the store.
+ *
+ * Returns: (transfer container) (element-type AsReview): reviews, or
+ * %NULL if there are none or they are older than @cache_age
+ *
+ * Since: 3.26
+ **/
+GPtrArray *
+gs_review_store_get_reviews (GsReviewStore *store,
+			     const gchar *app_id,
+			     guint cache_age)
+{
+	GsReviewStoreEntry *entry;
+	GPtrArray *reviews;
+	GPtrArray *copy;
+	gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+	guint i;
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	g_return_val_if_fail (GS_IS_REVIEW_STORE (store), NULL);
+	g_return_val_if_fail (app_id != NULL, NULL);
+
+	locker = g_mutex_locker_new (&store->mutex);
+	gs_review_store_ensure_loaded (store);
+	entry = g_hash_table_lookup (store->entries, app_id);
+	if (entry == NULL)
+		return NULL;
+	if (now - entry->timestamp >= (gint64) cache_age)
+		return NULL;
+	reviews = gs_review_store_entry_get_reviews (entry);
+	copy = g_ptr_array_new_full (reviews->len, (GDestroyNotify) g_object_unref);
+	for (i = 0; i < reviews->len; i++)
+		g_ptr_array_add (copy, gs_review_store_review_copy (g_ptr_array_index (reviews, i)));
+	return copy;
+}
+
+/**
+ * gs_review_store_invalidate:
+ * @store: a #GsReviewStore
+ * @app_id: an application ID
+ *
+ * Removes the stored reviews for an application, for instance when the
+ * user has submitted a new review.
+ *
+ * Since: 3.26
+ **/
+void
+gs_review_store_invalidate (GsReviewStore *store, const gchar *app_id)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	g_return_if_fail (GS_IS_REVIEW_STORE (store));
+	g_return_if_fail (app_id != NULL);
+
+	locker = g_mutex_locker_new (&store->mutex);
+	gs_review_store_ensure_loaded (store);
+	if (g_hash_table_remove (store->entries, app_id))
+		store->changed = TRUE;
+}
+
+/**
+ * gs_review_store_get_filename:
+ * @store: a #GsReviewStore
+ *
+ * Gets the filename used to store the reviews.
+ *
+ * Returns: a filename, or %NULL if the default has not been worked out yet
+ *
+ * Since: 3.26
+ **/
+const gchar *
+gs_review_store_get_filename (GsReviewStore *store)
+{
+	g_return_val_if_fail (GS_IS_REVIEW_STORE (store), NULL);
+	return store->filename;
+}
+
+/**
+ * gs_review_store_set_filename:
+ * @store: a #GsReviewStore
+ * @filename: a filename
+ *
+ * Sets the filename used to store the reviews, which is otherwise in the
+ * user cache directory. This has to be set before the store is used.
+ *
+ * Since: 3.26
+ **/
+void
+gs_review_store_set_filename (GsReviewStore *store, const gchar *filename)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_return_if_fail (GS_IS_REVIEW_STORE (store));
+	locker = g_mutex_locker_new (&store->mutex);
+	g_free (store->filename);
+	store->filename = g_strdup (filename);
+}
+
+static void
+gs_review_store_finalize (GObject *object)
+{
+	GsReviewStore *store = GS_REVIEW_STORE (object);
+
+	g_free (store->filename);
+	g_hash_table_unref (store->entries);
+	g_mutex_clear (&store->mutex);
+
+	G_OBJECT_CLASS (gs_review_store_parent_class)->finalize (object);
+}
+
+static void
+gs_review_store_class_init (GsReviewStoreClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = gs_review_store_finalize;
+}
+
+static void
+gs_review_store_init (GsReviewStore *store)
+{
+	g_mutex_init (&store->mutex);
+	store->entries = g_hash_table_new_full (g_str_hash, g_str_equal,
+						g_free,
+						(GDestroyNotify) gs_review_store_entry_free);
+}
+
+/**
+ * gs_review_store_new:
+ *
+ * Creates a new, empty review store.
+ *
+ * Returns: a #GsReviewStore
+ *
+ * Since: 3.26
+ **/
+GsReviewStore *
+gs_review_store_new (void)
+{
+	GsReviewStore *store;
+	store = g_object_new (GS_TYPE_REVIEW_STORE, NULL);
+	return GS_REVIEW_STORE (store);
+}
+
+/* vim: set noexpandtab: */
@@ -0,0 +1,56 @@
+ /* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GS_REVIEW_STORE_H
+#define __GS_REVIEW_STORE_H
+
+#include <glib-object.h>
+#include <appstream-glib.h>
+
+G_BEGIN_DECLS
+
+#define GS_TYPE_REVIEW_STORE (gs_review_store_get_type ())
+
+G_DECLARE_FINAL_TYPE (GsReviewStore, gs_review_store, GS, REVIEW_STORE, GObject)
+
+GsReviewStore	*gs_review_store_new		(void);
+const gchar	*gs_review_store_get_filename	(GsReviewStore	*store);
+void		 gs_review_store_set_filename	(GsReviewStore	*store,
+						 const gchar	*filename);
+gboolean	 gs_review_store_load		(GsReviewStore	*store,
+						 GError		**error);
+gboolean	 gs_review_store_save		(GsReviewStore	*store,
+						 GError		**error);
+void		 gs_review_store_add_reviews	(GsReviewStore	*store,
+						 const gchar	*app_id,
+						 GPtrArray	*reviews);
+GPtrArray	*gs_review_store_get_reviews	(GsReviewStore	*store,
+						 const gchar	*app_id,
+						 guint		 cache_age);
+void		 gs_review_store_invalidate	(GsReviewStore	*store,
+						 const gchar	*app_id);
+void		 gs_review_store_sort_reviews	(GPtrArray	*reviews);
+
+G_END_DECLS
+
+#endif /* __GS_REVIEW_STORE_H */
+
+/* vim: set noexpandtab: */
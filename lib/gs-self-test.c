@@ -21,6 +21,9 @@
 
 #include "config.h"
 
+#include <string.h>
+#include <glib/gstdio.h>
+
 #include "gnome-software-private.h"
 
 #include "gs-test.h"
@@ -146,6 +149,329 @@ gs_plugin_global_cache_func (void)
 	g_assert (app2 != NULL);
 }
 
+#define GS_PLUGIN_DOWNLOAD_TEST_LAST_MODIFIED	"Wed, 21 Oct 2015 07:28:00 GMT"
+
+typedef struct {
+	GBytes		*blob;
+	guint		 requests;
+	gchar		*range;		/* of the last request */
+	guint		 status_code;	/* of the last request */
+	gboolean	 pause;
+	GPtrArray	*paused;
+} GsPluginDownloadTestServer;
+
+static void
+gs_plugin_download_server_cb (SoupServer *server,
+			      SoupMessage *msg,
+			      const char *path,
+			      GHashTable *query,
+			      SoupClientContext *client,
+			      gpointer user_data)
+{
+	GsPluginDownloadTestServer *test_server = (GsPluginDownloadTestServer *) user_data;
+	GBytes *blob = test_server->blob;
+
+	if (g_strcmp0 (path, "/blob") == 0) {
+		SoupRange *ranges = NULL;
+		const gchar *if_range;
+		gint n_ranges = 0;
+		goffset start = 0;
+		gsize size = g_bytes_get_size (blob);
+
+		test_server->requests++;
+		g_free (test_server->range);
+		test_server->range = g_strdup (soup_message_headers_get_one (msg->request_headers,
+									     "Range"));
+
+		/* only send the rest if the client has the same version */
+		if_range = soup_message_headers_get_one (msg->request_headers, "If-Range");
+		if (g_strcmp0 (if_range, GS_PLUGIN_DOWNLOAD_TEST_LAST_MODIFIED) == 0 &&
+		    soup_message_headers_get_ranges (msg->request_headers, size,
+						     &ranges, &n_ranges)) {
+			start = ranges[0].start;
+			soup_message_headers_free_ranges (msg->request_headers, ranges);
+			soup_message_set_status (msg, SOUP_STATUS_PARTIAL_CONTENT);
+			soup_message_headers_set_content_range (msg->response_headers,
+								start, size - 1,
+								size);
+		} else if (g_strcmp0 (if_range, GS_PLUGIN_DOWNLOAD_TEST_LAST_MODIFIED) == 0 &&
+			   test_server->range != NULL) {
+			/* the client already has more than there is */
+			soup_message_set_status (msg, SOUP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE);
+			soup_message_headers_set_content_range (msg->response_headers,
+								-1, -1, size);
+			test_server->status_code = msg->status_code;
+			return;
+		} else {
+			soup_message_set_status (msg, SOUP_STATUS_OK);
+		}
+		test_server->status_code = msg->status_code;
+		soup_message_headers_append (msg->response_headers,
+					     "Last-Modified",
+					     GS_PLUGIN_DOWNLOAD_TEST_LAST_MODIFIED);
+		soup_message_body_append (msg->response_body, SOUP_MEMORY_COPY,
+					  (const guint8 *) g_bytes_get_data (blob, NULL) + start,
+					  size - (gsize) start);
+
+		/* hold the response back until the test says so */
+		if (test_server->pause) {
+			soup_server_pause_message (server, msg);
+			g_ptr_array_add (test_server->paused, g_object_ref (msg));
+		}
+		return;
+	}
+	soup_message_set_status (msg, SOUP_STATUS_NOT_FOUND);
+	soup_message_body_append (msg->response_body, SOUP_MEMORY_STATIC,
+				  "not here", 8);
+}
+
+typedef struct {
+	GsPlugin	*plugin;
+	gchar		*uri;
+	const gchar	*filename;
+	const gchar	*checksum;
+	GBytes		*data;
+	GError		*error;
+	gint		 done;
+} GsPluginDownloadTestHelper;
+
+static gpointer
+gs_plugin_download_thread_cb (gpointer user_data)
+{
+	GsPluginDownloadTestHelper *helper = (GsPluginDownloadTestHelper *) user_data;
+	if (helper->checksum != NULL) {
+		gs_plugin_download_file_with_checksum (helper->plugin, NULL,
+						       helper->uri,
+						       helper->filename,
+						       G_CHECKSUM_SHA256,
+						       helper->checksum,
+						       NULL, &helper->error);
+	} else if (helper->filename != NULL) {
+		gs_plugin_download_file (helper->plugin, NULL,
+					 helper->uri, helper->filename,
+					 NULL, &helper->error);
+	} else {
+		helper->data = gs_plugin_download_data (helper->plugin, NULL,
+							helper->uri,
+							NULL, &helper->error);
+	}
+	g_atomic_int_set (&helper->done, TRUE);
+	g_main_context_wakeup (NULL);
+	return NULL;
+}
+
+/* the server runs in the default context, so download in a thread */
+static void
+gs_plugin_download_test_run (GsPluginDownloadTestHelper *helper)
+{
+	GThread *thread;
+	thread = g_thread_new ("download", gs_plugin_download_thread_cb, helper);
+	while (!g_atomic_int_get (&helper->done))
+		g_main_context_iteration (NULL, TRUE);
+	g_thread_join (thread);
+}
+
+static void
+gs_plugin_download_func (void)
+{
+	GSList *uris;
+	GThread *thread1;
+	GThread *thread2;
+	gboolean ret;
+	gsize len = 0;
+	guint i;
+	g_autofree gchar *checksum = NULL;
+	g_autofree gchar *contents = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *filename_partial = NULL;
+	g_autofree gchar *uri_base = NULL;
+	g_autofree guint8 *data = NULL;
+	g_autoptr(GBytes) blob = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file_partial = NULL;
+	g_autoptr(GsPlugin) plugin = NULL;
+	g_autoptr(SoupDate) date = NULL;
+	g_autoptr(SoupServer) server = NULL;
+	g_autoptr(SoupSession) session = NULL;
+	GsPluginDownloadTestHelper helper = { NULL, NULL, NULL, NULL, NULL, NULL, FALSE };
+	GsPluginDownloadTestHelper helper1 = { NULL, NULL, NULL, NULL, NULL, NULL, FALSE };
+	GsPluginDownloadTestHelper helper2 = { NULL, NULL, NULL, NULL, NULL, NULL, FALSE };
+	GsPluginDownloadTestServer test_server = { NULL, 0, NULL, 0, FALSE, NULL };
+
+	/* something larger than a single read */
+	data = g_malloc (1024 * 1024);
+	for (i = 0; i < 1024 * 1024; i++)
+		data[i] = (guint8) (i % 251);
+	blob = g_bytes_new_static (data, 1024 * 1024);
+
+	/* local test server */
+	test_server.blob = blob;
+	test_server.paused = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	server = soup_server_new (SOUP_SERVER_SERVER_HEADER, "gs-self-test", NULL);
+	soup_server_add_handler (server, NULL,
+				 gs_plugin_download_server_cb,
+				 &test_server, NULL);
+	ret = soup_server_listen_local (server, 0,
+					SOUP_SERVER_LISTEN_IPV4_ONLY,
+					&error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	uris = soup_server_get_uris (server);
+	uri_base = soup_uri_to_string (uris->data, FALSE);
+	g_slist_free_full (uris, (GDestroyNotify) soup_uri_free);
+
+	session = soup_session_new ();
+	plugin = gs_plugin_new ();
+	gs_plugin_set_soup_session (plugin, session);
+	helper.plugin = plugin;
+
+	/* download to memory */
+	helper.uri = g_build_path ("/", uri_base, "blob", NULL);
+	gs_plugin_download_test_run (&helper);
+	g_assert_no_error (helper.error);
+	g_assert (helper.data != NULL);
+	g_assert (g_bytes_equal (helper.data, blob));
+	g_clear_pointer (&helper.data, g_bytes_unref);
+	g_assert_cmpint (test_server.requests, ==, 1);
+	g_assert_cmpstr (test_server.range, ==, NULL);
+
+	/* two downloads of the same URI at once only fetch it once */
+	test_server.requests = 0;
+	test_server.pause = TRUE;
+	helper1.plugin = plugin;
+	helper1.uri = helper.uri;
+	helper2.plugin = plugin;
+	helper2.uri = helper.uri;
+	thread1 = g_thread_new ("download1", gs_plugin_download_thread_cb, &helper1);
+	while (test_server.paused->len == 0)
+		g_main_context_iteration (NULL, TRUE);
+	thread2 = g_thread_new ("download2", gs_plugin_download_thread_cb, &helper2);
+	while (gs_plugin_download_get_waiting (helper.uri) == 0)
+		g_thread_yield ();
+	while (g_main_context_iteration (NULL, FALSE));
+	g_assert_cmpint (test_server.requests, ==, 1);
+	test_server.pause = FALSE;
+	for (i = 0; i < test_server.paused->len; i++)
+		soup_server_unpause_message (server, g_ptr_array_index (test_server.paused, i));
+	g_ptr_array_set_size (test_server.paused, 0);
+	while (!g_atomic_int_get (&helper1.done) || !g_atomic_int_get (&helper2.done))
+		g_main_context_iteration (NULL, TRUE);
+	g_thread_join (thread1);
+	g_thread_join (thread2);
+	g_assert_no_error (helper1.error);
+	g_assert_no_error (helper2.error);
+	g_assert (g_bytes_equal (helper1.data, blob));
+	g_assert (g_bytes_equal (helper2.data, blob));
+	g_clear_pointer (&helper1.data, g_bytes_unref);
+	g_clear_pointer (&helper2.data, g_bytes_unref);
+	g_assert_cmpint (test_server.requests, ==, 1);
+
+	/* stream to a file */
+	filename = g_build_filename (g_get_tmp_dir (), "gs-self-test-download", NULL);
+	g_unlink (filename);
+	helper.filename = filename;
+	helper.done = FALSE;
+	gs_plugin_download_test_run (&helper);
+	g_assert_no_error (helper.error);
+	ret = g_file_get_contents (filename, &contents, &len, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (len, ==, 1024 * 1024);
+	g_assert (memcmp (contents, data, len) == 0);
+	g_clear_pointer (&contents, g_free);
+
+	/* resume an interrupted download */
+	g_unlink (filename);
+	filename_partial = g_strdup_printf ("%s.partial", filename);
+	ret = g_file_set_contents (filename_partial, (const gchar *) data,
+				   512 * 1024, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	date = soup_date_new_from_string (GS_PLUGIN_DOWNLOAD_TEST_LAST_MODIFIED);
+	file_partial = g_file_new_for_path (filename_partial);
+	ret = g_file_set_attribute_uint64 (file_partial,
+					   G_FILE_ATTRIBUTE_TIME_MODIFIED,
+					   (guint64) soup_date_to_time_t (date),
+					   G_FILE_QUERY_INFO_NONE,
+					   NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	helper.done = FALSE;
+	gs_plugin_download_test_run (&helper);
+	g_assert_no_error (helper.error);
+	g_assert_cmpstr (test_server.range, ==, "bytes=524288-");
+	g_assert_cmpint (test_server.status_code, ==, SOUP_STATUS_PARTIAL_CONTENT);
+	ret = g_file_get_contents (filename, &contents, &len, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (len, ==, 1024 * 1024);
+	g_assert (memcmp (contents, data, len) == 0);
+	g_assert (!g_file_test (filename_partial, G_FILE_TEST_EXISTS));
+	g_clear_pointer (&contents, g_free);
+
+	/* a partial file bigger than the resource is downloaded again */
+	g_unlink (filename);
+	test_server.requests = 0;
+	ret = g_file_set_contents (filename_partial, (const gchar *) data,
+				   1024 * 1024, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = g_file_set_attribute_uint64 (file_partial,
+					   G_FILE_ATTRIBUTE_TIME_MODIFIED,
+					   (guint64) soup_date_to_time_t (date),
+					   G_FILE_QUERY_INFO_NONE,
+					   NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	helper.done = FALSE;
+	gs_plugin_download_test_run (&helper);
+	g_assert_no_error (helper.error);
+	g_assert_cmpint (test_server.requests, ==, 2);
+	g_assert_cmpstr (test_server.range, ==, NULL);
+	g_assert_cmpint (test_server.status_code, ==, SOUP_STATUS_OK);
+	ret = g_file_get_contents (filename, &contents, &len, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (len, ==, 1024 * 1024);
+	g_assert (memcmp (contents, data, len) == 0);
+	g_clear_pointer (&contents, g_free);
+
+	/* the complete file is verified */
+	g_unlink (filename);
+	checksum = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, blob);
+	helper.checksum = checksum;
+	helper.done = FALSE;
+	gs_plugin_download_test_run (&helper);
+	g_assert_no_error (helper.error);
+	g_assert (g_file_test (filename, G_FILE_TEST_EXISTS));
+
+	/* and deleted if it is not what was expected */
+	helper.checksum = "0000000000000000000000000000000000000000000000000000000000000000";
+	helper.done = FALSE;
+	gs_plugin_download_test_run (&helper);
+	g_assert_error (helper.error, GS_PLUGIN_ERROR, GS_PLUGIN_ERROR_INVALID_FORMAT);
+	g_assert (!g_file_test (filename, G_FILE_TEST_EXISTS));
+	g_clear_error (&helper.error);
+	helper.checksum = NULL;
+	g_free (helper.uri);
+
+	/* a failed download does not clobber the existing file */
+	ret = g_file_set_contents (filename, "old", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	helper.uri = g_build_path ("/", uri_base, "missing", NULL);
+	helper.done = FALSE;
+	gs_plugin_download_test_run (&helper);
+	g_assert_error (helper.error, GS_PLUGIN_ERROR, GS_PLUGIN_ERROR_DOWNLOAD_FAILED);
+	g_assert (g_strstr_len (helper.error->message, -1, "not here") != NULL);
+	g_assert (g_file_test (filename, G_FILE_TEST_EXISTS));
+	g_clear_error (&helper.error);
+	g_free (helper.uri);
+	g_unlink (filename);
+	g_free (test_server.range);
+	g_ptr_array_unref (test_server.paused);
+}
+
 static void
 gs_plugin_func (void)
 {
@@ -416,6 +742,66 @@ gs_app_addons_func (void)
 	gs_app_remove_addon (app, addon);
 }
 
+static void
+gs_app_list_size_func (void)
+{
+	g_autoptr(GsApp) app1 = gs_app_new ("app1.desktop");
+	g_autoptr(GsApp) app2 = gs_app_new ("app2.desktop");
+	g_autoptr(GsApp) app3 = gs_app_new ("app3.desktop");
+	g_autoptr(GsApp) app4 = gs_app_new ("app4.desktop");
+	g_autoptr(GsApp) app5 = gs_app_new ("app5.desktop");
+	g_autoptr(GsApp) os_update = gs_app_new (NULL);
+	g_autoptr(GsApp) pkg1 = gs_app_new (NULL);
+	g_autoptr(GsApp) pkg2 = gs_app_new (NULL);
+	g_autoptr(GsApp) runtime = gs_app_new ("org.gnome.Platform");
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+
+	/* two apps that need the same runtime */
+	gs_app_set_size_download (app1, 1000);
+	gs_app_set_runtime (app1, runtime);
+	gs_app_set_size_download (app2, 2000);
+	gs_app_set_runtime (app2, runtime);
+	gs_app_set_size_installed (runtime, 50000);
+	gs_app_set_state (runtime, AS_APP_STATE_AVAILABLE);
+	gs_app_list_add (list, app1);
+	gs_app_list_add (list, app2);
+	g_assert_cmpint (gs_app_get_size_download (app1) + gs_app_get_size_download (app2), ==, 103000);
+	g_assert_cmpint (gs_app_list_get_size_download (list), ==, 53000);
+
+	/* a package that is in the OS update and also shown on its own */
+	gs_app_add_source_id (pkg1, "kernel;4.12;x86_64;fedora");
+	gs_app_set_management_plugin (pkg1, "packagekit");
+	gs_app_set_size_download (pkg1, 400);
+	gs_app_add_source_id (pkg2, "kernel;4.12;x86_64;fedora");
+	gs_app_set_management_plugin (pkg2, "packagekit");
+	gs_app_set_size_download (pkg2, 400);
+	gs_app_add_related (os_update, pkg1);
+	gs_app_list_add (list, os_update);
+	gs_app_list_add (list, pkg2);
+	g_assert_cmpint (gs_app_list_get_size_download (list), ==, 53400);
+
+	/* unknown sizes are left out rather than overflowing */
+	gs_app_set_size_download (app3, GS_APP_SIZE_UNKNOWABLE);
+	gs_app_list_add (list, app3);
+	g_assert_cmpint (gs_app_list_get_size_download (list), ==, 53400);
+
+	/* two desktop apps built from the same update package */
+	gs_app_add_source_id (app4, "gimp;2.8.22;x86_64;updates");
+	gs_app_set_management_plugin (app4, "packagekit");
+	gs_app_set_size_download (app4, 7000);
+	gs_app_add_source_id (app5, "gimp;2.8.22;x86_64;updates");
+	gs_app_set_management_plugin (app5, "packagekit");
+	gs_app_set_size_download (app5, 7000);
+	gs_app_list_add (list, app4);
+	gs_app_list_add (list, app5);
+	g_assert_cmpint (gs_app_list_get_size_download (list), ==, 60400);
+
+	/* the runtime is already installed */
+	gs_app_set_state (runtime, AS_APP_STATE_UNKNOWN);
+	gs_app_set_state (runtime, AS_APP_STATE_INSTALLED);
+	g_assert_cmpint (gs_app_list_get_size_download (list), ==, 10400);
+}
+
 static void
 gs_app_func (void)
 {
@@ -508,6 +894,83 @@ gs_auth_secret_func (void)
 	g_assert_cmpstr (gs_auth_get_metadata_item (auth2, "day"), ==, "monday");
 }
 
+static AsReview *
+gs_review_store_test_review (const gchar *summary, gint priority)
+{
+	AsReview *review = as_review_new ();
+	as_review_set_summary (review, summary);
+	as_review_set_priority (review, priority);
+	as_review_set_rating (review, 80);
+	as_review_add_metadata (review, "user_skey", "skey");
+	return review;
+}
+
+static void
+gs_review_store_func (void)
+{
+	AsReview *review;
+	gboolean ret;
+	g_autofree gchar *fn = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) reviews = NULL;
+	g_autoptr(GPtrArray) reviews_loaded = NULL;
+	g_autoptr(GsReviewStore) store = gs_review_store_new ();
+	g_autoptr(GsReviewStore) store_loaded = gs_review_store_new ();
+
+	fn = g_build_filename (g_get_tmp_dir (), "gs-self-test-reviews.gvariant", NULL);
+	g_unlink (fn);
+	gs_review_store_set_filename (store, fn);
+	gs_review_store_set_filename (store_loaded, fn);
+
+	/* nothing stored yet */
+	g_assert (gs_review_store_get_reviews (store, "a.desktop", G_MAXUINT) == NULL);
+
+	/* sorted when added */
+	reviews = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_ptr_array_add (reviews, gs_review_store_test_review ("low", 1));
+	g_ptr_array_add (reviews, gs_review_store_test_review ("high", 10));
+	g_ptr_array_add (reviews, gs_review_store_test_review ("middle", 5));
+	gs_review_store_add_reviews (store, "a.desktop", reviews);
+	g_ptr_array_unref (reviews);
+	reviews = gs_review_store_get_reviews (store, "a.desktop", G_MAXUINT);
+	g_assert (reviews != NULL);
+	g_assert_cmpint (reviews->len, ==, 3);
+	g_assert_cmpstr (as_review_get_summary (g_ptr_array_index (reviews, 0)), ==, "high");
+	g_assert_cmpstr (as_review_get_summary (g_ptr_array_index (reviews, 2)), ==, "low");
+
+	/* changing what was returned does not change the store */
+	as_review_set_summary (g_ptr_array_index (reviews, 0), "changed");
+	as_review_add_flags (g_ptr_array_index (reviews, 0), AS_REVIEW_FLAG_VOTED);
+	g_ptr_array_unref (reviews);
+	reviews = gs_review_store_get_reviews (store, "a.desktop", G_MAXUINT);
+	g_assert (reviews != NULL);
+	review = g_ptr_array_index (reviews, 0);
+	g_assert_cmpstr (as_review_get_summary (review), ==, "high");
+	g_assert_cmpint (as_review_get_flags (review), ==, AS_REVIEW_FLAG_NONE);
+
+	/* too old */
+	g_assert (gs_review_store_get_reviews (store, "a.desktop", 0) == NULL);
+
+	/* round trip through the file */
+	ret = gs_review_store_save (store, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	reviews_loaded = gs_review_store_get_reviews (store_loaded, "a.desktop", G_MAXUINT);
+	g_assert (reviews_loaded != NULL);
+	g_assert_cmpint (reviews_loaded->len, ==, 3);
+	review = g_ptr_array_index (reviews_loaded, 1);
+	g_assert_cmpstr (as_review_get_summary (review), ==, "middle");
+	g_assert_cmpint (as_review_get_priority (review), ==, 5);
+	g_assert_cmpint (as_review_get_rating (review), ==, 80);
+	g_assert_cmpstr (as_review_get_metadata_item (review, "user_skey"), ==, "skey");
+	g_assert (as_review_get_reviewer_name (review) == NULL);
+
+	/* invalidated */
+	gs_review_store_invalidate (store_loaded, "a.desktop");
+	g_assert (gs_review_store_get_reviews (store_loaded, "a.desktop", G_MAXUINT) == NULL);
+	g_unlink (fn);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -526,9 +989,12 @@ main (int argc, char **argv)
 	g_test_add_func ("/gnome-software/lib/app{addons}", gs_app_addons_func);
 	g_test_add_func ("/gnome-software/lib/app{unique-id}", gs_app_unique_id_func);
 	g_test_add_func ("/gnome-software/lib/app{thread}", gs_app_thread_func);
+	g_test_add_func ("/gnome-software/lib/app-list{size}", gs_app_list_size_func);
 	g_test_add_func ("/gnome-software/lib/plugin", gs_plugin_func);
 	g_test_add_func ("/gnome-software/lib/plugin{global-cache}", gs_plugin_global_cache_func);
+	g_test_add_func ("/gnome-software/lib/plugin{download}", gs_plugin_download_func);
 	g_test_add_func ("/gnome-software/lib/auth{secret}", gs_auth_secret_func);
+	g_test_add_func ("/gnome-software/lib/review-store", gs_review_store_func);
 
 	return g_test_run ();
 }
@@ -21,15 +21,158 @@
 
 #include <config.h>
 
+#include <stdlib.h>
+
 #include <gnome-software.h>
 
+/*
+ * SECTION:
+ * Extracts the most common colors from the application icon.
+ *
+ * The results are cached on disk using the checksum of the icon pixels
+ * so each icon only has to be processed once.
+ */
+
+/* icons not seen for this long are forgotten */
+#define GS_PLUGIN_KEY_COLORS_CACHE_AGE_MAX	(60 * 60 * 24 * 90)
+
+/* only keep the most recently used icons */
+#define GS_PLUGIN_KEY_COLORS_CACHE_MAX		2000
+
+/* only record a hit if the last one was on a different day */
+#define GS_PLUGIN_KEY_COLORS_USED_FUZZ		(60 * 60 * 24)
+
+/* save after this many new results rather than only when shutting down */
+#define GS_PLUGIN_KEY_COLORS_SAVE_INTERVAL	50
+
+struct GsPluginData {
+	GKeyFile		*cache;
+	gchar			*cache_fn;	/* NULL if running uncached */
+	GMutex			 cache_lock;
+	guint			 cache_changed;
+};
+
 void
 gs_plugin_initialize (GsPlugin *plugin)
 {
+	GsPluginData *priv = gs_plugin_alloc_data (plugin, sizeof(GsPluginData));
+	priv->cache = g_key_file_new ();
+	g_mutex_init (&priv->cache_lock);
+
 	/* need icon */
 	gs_plugin_add_rule (plugin, GS_PLUGIN_RULE_RUN_AFTER, "icons");
 }
 
+static gchar *
+gs_plugin_key_colors_get_cache_fn (GError **error)
+{
+	return gs_utils_get_cache_filename ("key-colors",
+					    "key-colors.ini",
+					    GS_UTILS_CACHE_FLAG_WRITEABLE,
+					    error);
+}
+
+typedef struct {
+	gchar			*checksum;
+	gint64			 used;
+} GsKeyColorsEntry;
+
+static gint
+gs_plugin_key_colors_entry_sort_cb (gconstpointer a, gconstpointer b)
+{
+	const GsKeyColorsEntry *e1 = a;
+	const GsKeyColorsEntry *e2 = b;
+	if (e1->used < e2->used)
+		return 1;
+	if (e1->used > e2->used)
+		return -1;
+	return 0;
+}
+
+/* drops old entries, then the least recently used above the maximum;
+ * must be called with cache_lock held */
+static void
+gs_plugin_key_colors_prune (GsPlugin *plugin)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+	gsize n_groups = 0;
+	guint i;
+	guint n_entries = 0;
+	g_auto(GStrv) groups = NULL;
+	g_autofree GsKeyColorsEntry *entries = NULL;
+
+	groups = g_key_file_get_groups (priv->cache, &n_groups);
+	entries = g_new0 (GsKeyColorsEntry, n_groups);
+	for (i = 0; i < n_groups; i++) {
+		gint64 used = g_key_file_get_int64 (priv->cache, groups[i],
+						    "Used", NULL);
+		if (now - used > GS_PLUGIN_KEY_COLORS_CACHE_AGE_MAX) {
+			g_key_file_remove_group (priv->cache, groups[i], NULL);
+			continue;
+		}
+		entries[n_entries].checksum = groups[i];
+		entries[n_entries].used = used;
+		n_entries++;
+	}
+	if (n_entries <= GS_PLUGIN_KEY_COLORS_CACHE_MAX)
+		return;
+	qsort (entries, n_entries, sizeof(GsKeyColorsEntry),
+	       gs_plugin_key_colors_entry_sort_cb);
+	for (i = GS_PLUGIN_KEY_COLORS_CACHE_MAX; i < n_entries; i++)
+		g_key_file_remove_group (priv->cache, entries[i].checksum, NULL);
+}
+
+/* must be called with cache_lock held */
+static void
+gs_plugin_key_colors_save (GsPlugin *plugin)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	g_autoptr(GError) error = NULL;
+
+	if (priv->cache_fn == NULL || priv->cache_changed == 0)
+		return;
+	gs_plugin_key_colors_prune (plugin);
+	if (!g_key_file_save_to_file (priv->cache, priv->cache_fn, &error))
+		g_warning ("failed to save key colors: %s", error->message);
+	priv->cache_changed = 0;
+}
+
+void
+gs_plugin_destroy (GsPlugin *plugin)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+
+	/* save any newly calculated colors */
+	g_mutex_lock (&priv->cache_lock);
+	gs_plugin_key_colors_save (plugin);
+	g_mutex_unlock (&priv->cache_lock);
+	g_key_file_unref (priv->cache);
+	g_free (priv->cache_fn);
+	g_mutex_clear (&priv->cache_lock);
+}
+
+gboolean
+gs_plugin_setup (GsPlugin *plugin, GCancellable *cancellable, GError **error)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	g_autoptr(GError) error_local = NULL;
+
+	/* the colors can always be calculated again */
+	priv->cache_fn = gs_plugin_key_colors_get_cache_fn (&error_local);
+	if (priv->cache_fn == NULL) {
+		g_warning ("not caching key colors: %s", error_local->message);
+		return TRUE;
+	}
+
+	/* a missing or invalid cache file just means calculating again */
+	if (!g_key_file_load_from_file (priv->cache, priv->cache_fn,
+					G_KEY_FILE_NONE, &error_local) &&
+	    !g_error_matches (error_local, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+		g_debug ("failed to load %s: %s", priv->cache_fn, error_local->message);
+	return TRUE;
+}
+
 typedef struct {
 	guint8		 R;
 	guint8		 G;
@@ -49,6 +192,19 @@ typedef struct {
 	guint		cnt;
 } GsColorBin;
 
+/* one exact color and how many pixels use it */
+typedef struct {
+	guint32		rgb;
+	guint		cnt;
+} GsColorHist;
+
+/* open addressing slot used to merge the histogram into bins */
+typedef struct {
+	guint32		key;
+	guint		generation;
+	guint		idx;
+} GsColorSlot;
+
 static gint
 gs_color_bin_sort_cb (gconstpointer a, gconstpointer b)
 {
@@ -61,6 +217,24 @@ gs_color_bin_sort_cb (gconstpointer a, gconstpointer b)
 	return 0;
 }
 
+static gint
+gs_color_bin_sort_with_data_cb (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	return gs_color_bin_sort_cb (a, b);
+}
+
+static gint
+gs_color_rgb_sort_cb (gconstpointer a, gconstpointer b)
+{
+	guint32 rgb1 = *((guint32 *) a);
+	guint32 rgb2 = *((guint32 *) b);
+	if (rgb1 < rgb2)
+		return -1;
+	if (rgb1 > rgb2)
+		return 1;
+	return 0;
+}
+
 /* convert range of 0..255 to 0..1 */
 static gdouble
 _convert_from_rgb8 (guchar val)
@@ -68,72 +242,136 @@ _convert_from_rgb8 (guchar val)
 	return (gdouble) val / 255.f;
 }
 
-static void
-gs_plugin_key_colors_set_for_pixbuf (GsApp *app, GdkPixbuf *pb, guint number)
+/* builds a histogram of the exact opaque colors in one pass */
+static GArray *
+gs_plugin_key_colors_get_histogram (GdkPixbuf *pb)
 {
-	GList *l;
+	GArray *hist;
+	gboolean has_alpha;
 	gint rowstride, n_channels;
 	gint x, y;
+	gint width, height;
 	guchar *pixels, *p;
-	guint bin_size = 200;
 	guint i;
-	guint number_of_bins;
-	g_autoptr(AsImage) im = NULL;
+	guint n_rgb = 0;
+	g_autofree guint32 *rgb = NULL;
 
-	/* go through each pixel */
 	n_channels = gdk_pixbuf_get_n_channels (pb);
+	has_alpha = gdk_pixbuf_get_has_alpha (pb);
 	rowstride = gdk_pixbuf_get_rowstride (pb);
 	pixels = gdk_pixbuf_get_pixels (pb);
+	width = gdk_pixbuf_get_width (pb);
+	height = gdk_pixbuf_get_height (pb);
+	rgb = g_new (guint32, (gsize) width * (gsize) height);
+	for (y = 0; y < height; y++) {
+		p = pixels + y * rowstride;
+		for (x = 0; x < width; x++, p += n_channels) {
+			/* disregard any with alpha */
+			if (has_alpha && p[3] != 255)
+				continue;
+			rgb[n_rgb++] = (guint32) p[0] |
+				       (guint32) p[1] << 8 |
+				       (guint32) p[2] << 16;
+		}
+	}
+
+	/* collapse runs of the same color */
+	hist = g_array_new (FALSE, FALSE, sizeof(GsColorHist));
+	qsort (rgb, n_rgb, sizeof(guint32), gs_color_rgb_sort_cb);
+	for (i = 0; i < n_rgb; i++) {
+		GsColorHist *h;
+		if (hist->len > 0) {
+			h = &g_array_index (hist, GsColorHist, hist->len - 1);
+			if (h->rgb == rgb[i]) {
+				h->cnt++;
+				continue;
+			}
+		}
+		g_array_set_size (hist, hist->len + 1);
+		h = &g_array_index (hist, GsColorHist, hist->len - 1);
+		h->rgb = rgb[i];
+		h->cnt = 1;
+	}
+	return hist;
+}
+
+static void
+gs_plugin_key_colors_set_for_pixbuf (GsApp *app, GdkPixbuf *pb, guint number)
+{
+	guint bin_size;
+	guint generation = 0;
+	guint i;
+	guint mask;
+	guint number_of_bins;
+	g_autoptr(GArray) hist = NULL;
+	g_autofree GsColorBin *bins = NULL;
+	g_autofree GsColorSlot *slots = NULL;
+
+	/* every coarser bin size is derived by merging the exact colors
+	 * rather than by going back over each pixel */
+	hist = gs_plugin_key_colors_get_histogram (pb);
+
+	/* there can never be more bins than unique colors */
+	if (hist->len < number)
+		goto out;
+
+	/* a fixed table at most half full, reset using the generation */
+	mask = 1;
+	while (mask < hist->len * 2)
+		mask <<= 1;
+	slots = g_new0 (GsColorSlot, mask);
+	mask--;
+	bins = g_new (GsColorBin, hist->len);
 	for (bin_size = 250; bin_size > 0; bin_size -= 2) {
-		g_autoptr(GHashTable) hash = NULL;
-		hash = g_hash_table_new_full (g_direct_hash,  g_direct_equal,
-					      NULL, g_free);
-		for (y = 0; y < gdk_pixbuf_get_height (pb); y++) {
-			for (x = 0; x < gdk_pixbuf_get_width (pb); x++) {
-				CdColorRGB8 tmp;
-				GsColorBin *s;
-				gpointer key;
-
-				/* disregard any with alpha */
-				p = pixels + y * rowstride + x * n_channels;
-				if (p[3] != 255)
-					continue;
-
-				/* find in cache */
-				tmp.R = (guint8) (p[0] / bin_size);
-				tmp.G = (guint8) (p[1] / bin_size);
-				tmp.B = (guint8) (p[2] / bin_size);
-				key = GUINT_TO_POINTER (cd_color_rgb8_to_uint32 (&tmp));
-				s = g_hash_table_lookup (hash, key);
-				if (s != NULL) {
-					s->color.red += _convert_from_rgb8 (p[0]);
-					s->color.green += _convert_from_rgb8 (p[1]);
-					s->color.blue += _convert_from_rgb8 (p[2]);
-					s->cnt++;
-					continue;
-				}
-
-				/* add to hash table */
-				s = g_new0 (GsColorBin, 1);
-				s->color.red = _convert_from_rgb8 (p[0]);
-				s->color.green = _convert_from_rgb8 (p[1]);
-				s->color.blue = _convert_from_rgb8 (p[2]);
+		number_of_bins = 0;
+		generation++;
+		for (i = 0; i < hist->len; i++) {
+			GsColorHist *h = &g_array_index (hist, GsColorHist, i);
+			GsColorBin *s;
+			CdColorRGB8 tmp;
+			guchar r = (guchar) (h->rgb & 0xff);
+			guchar g = (guchar) ((h->rgb >> 8) & 0xff);
+			guchar b = (guchar) ((h->rgb >> 16) & 0xff);
+			guint32 key;
+			guint slot;
+
+			/* find the bin */
+			tmp.R = (guint8) (r / bin_size);
+			tmp.G = (guint8) (g / bin_size);
+			tmp.B = (guint8) (b / bin_size);
+			key = cd_color_rgb8_to_uint32 (&tmp);
+			slot = (key * 2654435761u) & mask;
+			while (slots[slot].generation == generation &&
+			       slots[slot].key != key)
+				slot = (slot + 1) & mask;
+
+			/* add new bin */
+			if (slots[slot].generation != generation) {
+				slots[slot].generation = generation;
+				slots[slot].key = key;
+				slots[slot].idx = number_of_bins++;
+				s = &bins[slots[slot].idx];
+				s->color.red = 0.f;
+				s->color.green = 0.f;
+				s->color.blue = 0.f;
 				s->color.alpha = 1.0;
-				s->cnt = 1;
-				g_hash_table_insert (hash, key, s);
+				s->cnt = 0;
+			} else {
+				s = &bins[slots[slot].idx];
 			}
+			s->color.red += _convert_from_rgb8 (r) * h->cnt;
+			s->color.green += _convert_from_rgb8 (g) * h->cnt;
+			s->color.blue += _convert_from_rgb8 (b) * h->cnt;
+			s->cnt += h->cnt;
 		}
 
-		number_of_bins = g_hash_table_size (hash);
-//		g_debug ("number of colors: %i", number_of_bins);
 		if (number_of_bins >= number) {
-			g_autoptr(GList) values = NULL;
-
 			/* order by most popular */
-			values = g_hash_table_get_values (hash);
-			values = g_list_sort (values, gs_color_bin_sort_cb);
-			for (l = values; l != NULL; l = l->next) {
-				GsColorBin *s = l->data;
+			g_qsort_with_data (bins, (gint) number_of_bins,
+					   sizeof(GsColorBin),
+					   gs_color_bin_sort_with_data_cb, NULL);
+			for (i = 0; i < number_of_bins; i++) {
+				GsColorBin *s = &bins[i];
 				g_autofree GdkRGBA *color = g_new0 (GdkRGBA, 1);
 				color->red = s->color.red / s->cnt;
 				color->green = s->color.green / s->cnt;
@@ -143,7 +381,7 @@ gs_plugin_key_colors_set_for_pixbuf (GsApp *app, GdkPixbuf *pb, guint number)
 			return;
 		}
 	}
-
+out:
 	/* the algorithm failed, so just return a monochrome ramp */
 	for (i = 0; i < 3; i++) {
 		g_autofree GdkRGBA *color = g_new0 (GdkRGBA, 1);
@@ -155,6 +393,89 @@ gs_plugin_key_colors_set_for_pixbuf (GsApp *app, GdkPixbuf *pb, guint number)
 	}
 }
 
+static gchar *
+gs_plugin_key_colors_get_checksum (GdkPixbuf *pb)
+{
+	g_autoptr(GChecksum) csum = g_checksum_new (G_CHECKSUM_SHA1);
+	gint height = gdk_pixbuf_get_height (pb);
+	gint rowstride = gdk_pixbuf_get_rowstride (pb);
+	gint dims[3];
+	gsize len;
+	const guchar *pixels;
+
+	dims[0] = gdk_pixbuf_get_width (pb);
+	dims[1] = height;
+	dims[2] = gdk_pixbuf_get_n_channels (pb);
+	g_checksum_update (csum, (const guchar *) dims, sizeof(dims));
+
+	/* the last row may not be padded to the full rowstride */
+	pixels = gdk_pixbuf_get_pixels (pb);
+	len = (gsize) (height - 1) * (gsize) rowstride +
+	      (gsize) dims[0] * (gsize) ((dims[2] * gdk_pixbuf_get_bits_per_sample (pb) + 7) / 8);
+	g_checksum_update (csum, pixels, (gssize) len);
+	return g_strdup (g_checksum_get_string (csum));
+}
+
+static gboolean
+gs_plugin_key_colors_load_cached (GsPlugin *plugin, GsApp *app, const gchar *checksum)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	gint64 now;
+	gint64 used;
+	gsize len = 0;
+	guint i;
+	g_autofree gdouble *values = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->cache_lock);
+
+	values = g_key_file_get_double_list (priv->cache, checksum,
+					     "KeyColors", &len, NULL);
+	if (values == NULL || len == 0 || len % 3 != 0)
+		return FALSE;
+
+	/* keep icons that are still being shown */
+	now = g_get_real_time () / G_USEC_PER_SEC;
+	used = g_key_file_get_int64 (priv->cache, checksum, "Used", NULL);
+	if (now - used >= GS_PLUGIN_KEY_COLORS_USED_FUZZ) {
+		g_key_file_set_int64 (priv->cache, checksum, "Used", now);
+		priv->cache_changed++;
+	}
+	for (i = 0; i < len; i += 3) {
+		g_autofree GdkRGBA *color = g_new0 (GdkRGBA, 1);
+		color->red = values[i + 0];
+		color->green = values[i + 1];
+		color->blue = values[i + 2];
+		color->alpha = 1.0;
+		gs_app_add_key_color (app, color);
+	}
+	return TRUE;
+}
+
+static void
+gs_plugin_key_colors_save_cached (GsPlugin *plugin, GsApp *app, const gchar *checksum)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	GPtrArray *key_colors = gs_app_get_key_colors (app);
+	guint i;
+	g_autofree gdouble *values = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->cache_lock);
+
+	values = g_new (gdouble, key_colors->len * 3);
+	for (i = 0; i < key_colors->len; i++) {
+		GdkRGBA *color = g_ptr_array_index (key_colors, i);
+		values[i * 3 + 0] = color->red;
+		values[i * 3 + 1] = color->green;
+		values[i * 3 + 2] = color->blue;
+	}
+	g_key_file_set_double_list (priv->cache, checksum, "KeyColors",
+				    values, key_colors->len * 3);
+	g_key_file_set_int64 (priv->cache, checksum, "Used",
+			      g_get_real_time () / G_USEC_PER_SEC);
+
+	/* do not lose everything if the process does not exit cleanly */
+	if (++priv->cache_changed >= GS_PLUGIN_KEY_COLORS_SAVE_INTERVAL)
+		gs_plugin_key_colors_save (plugin);
+}
+
 gboolean
 gs_plugin_refine_app (GsPlugin *plugin,
 		      GsApp *app,
@@ -163,6 +484,7 @@ gs_plugin_refine_app (GsPlugin *plugin,
 		      GError **error)
 {
 	GdkPixbuf *pb;
+	g_autofree gchar *checksum = NULL;
 	g_autoptr(GdkPixbuf) pb_small = NULL;
 
 	/* add a rating */
@@ -180,8 +502,14 @@ gs_plugin_refine_app (GsPlugin *plugin,
 		return TRUE;
 	}
 
+	/* already calculated for this icon */
+	checksum = gs_plugin_key_colors_get_checksum (pb);
+	if (gs_plugin_key_colors_load_cached (plugin, app, checksum))
+		return TRUE;
+
 	/* get a list of key colors */
 	pb_small = gdk_pixbuf_scale_simple (pb, 32, 32, GDK_INTERP_BILINEAR);
 	gs_plugin_key_colors_set_for_pixbuf (app, pb_small, 10);
+	gs_plugin_key_colors_save_cached (plugin, app, checksum);
 	return TRUE;
 }
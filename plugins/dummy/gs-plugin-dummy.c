@@ -274,6 +274,38 @@ gs_plugin_add_search (GsPlugin *plugin,
 	return TRUE;
 }
 
+gboolean
+gs_plugin_add_search_what_provides (GsPlugin *plugin,
+				    gchar **values,
+				    GsAppList *list,
+				    GCancellable *cancellable,
+				    GError **error)
+{
+	g_autoptr(GsApp) app = NULL;
+	g_autoptr(GsAppList) partial = gs_app_list_new ();
+
+	/* we're very specific */
+	if (g_strcmp0 (values[0], "dummy-partial") != 0)
+		return TRUE;
+
+	/* report the app before the search has finished */
+	app = gs_app_new ("pandora.desktop");
+	gs_app_set_name (app, GS_APP_QUALITY_NORMAL, "Pandora");
+	gs_app_set_summary (app, GS_APP_QUALITY_NORMAL, "A box of codecs");
+	gs_app_set_kind (app, AS_APP_KIND_DESKTOP);
+	gs_app_set_state (app, AS_APP_STATE_AVAILABLE);
+	gs_app_set_management_plugin (app, gs_plugin_get_name (plugin));
+	gs_app_list_add (partial, app);
+	gs_plugin_report_partial_results (plugin, list, partial);
+
+	/* spin */
+	if (!gs_plugin_dummy_delay (plugin, NULL, 100, cancellable, error))
+		return FALSE;
+
+	gs_app_list_add (list, app);
+	return TRUE;
+}
+
 gboolean
 gs_plugin_add_updates (GsPlugin *plugin,
 		       GsAppList *list,
@@ -372,6 +372,87 @@ gs_plugins_dummy_search_func (GsPluginLoader *plugin_loader)
 	g_assert_cmpint (gs_app_get_kind (app), ==, AS_APP_KIND_DESKTOP);
 }
 
+typedef struct {
+	GMainLoop	*loop;
+	GsAppList	*list;
+	GError		*error;
+	guint		 n_partial;
+	gboolean	 finished;
+} GsPluginsDummyPartialHelper;
+
+static void
+gs_plugins_dummy_partial_cb (GsPluginLoader *plugin_loader,
+			     GsAppList *list,
+			     gpointer user_data)
+{
+	GsPluginsDummyPartialHelper *helper = (GsPluginsDummyPartialHelper *) user_data;
+
+	/* these must arrive before the final results */
+	g_assert (!helper->finished);
+	g_assert_cmpint (gs_app_list_length (list), ==, 1);
+	g_assert_cmpstr (gs_app_get_id (gs_app_list_index (list, 0)), ==, "pandora.desktop");
+	helper->n_partial++;
+}
+
+static void
+gs_plugins_dummy_partial_finish_cb (GObject *source,
+				    GAsyncResult *res,
+				    gpointer user_data)
+{
+	GsPluginsDummyPartialHelper *helper = (GsPluginsDummyPartialHelper *) user_data;
+	helper->list = gs_plugin_loader_search_what_provides_finish (GS_PLUGIN_LOADER (source),
+								     res,
+								     &helper->error);
+	helper->finished = TRUE;
+	g_main_loop_quit (helper->loop);
+}
+
+static void
+gs_plugins_dummy_partial_results_func (GsPluginLoader *plugin_loader)
+{
+	GsPluginsDummyPartialHelper helper = { NULL };
+	g_autoptr(GCancellable) cancellable = g_cancellable_new ();
+	g_autoptr(GMainLoop) loop = g_main_loop_new (NULL, FALSE);
+
+	/* the partial results are delivered before the search finishes */
+	helper.loop = loop;
+	gs_plugin_loader_search_what_provides_async (plugin_loader,
+						     "dummy-partial",
+						     gs_plugins_dummy_partial_cb,
+						     &helper,
+						     GS_PLUGIN_REFINE_FLAGS_DEFAULT,
+						     GS_PLUGIN_FAILURE_FLAGS_FATAL_ANY,
+						     NULL,
+						     gs_plugins_dummy_partial_finish_cb,
+						     &helper);
+	g_main_loop_run (loop);
+	g_assert_no_error (helper.error);
+	g_assert (helper.list != NULL);
+	g_assert_cmpint (helper.n_partial, ==, 1);
+	g_clear_object (&helper.list);
+
+	/* nothing is delivered once the search has been cancelled */
+	helper.n_partial = 0;
+	helper.finished = FALSE;
+	gs_plugin_loader_search_what_provides_async (plugin_loader,
+						     "dummy-partial",
+						     gs_plugins_dummy_partial_cb,
+						     &helper,
+						     GS_PLUGIN_REFINE_FLAGS_DEFAULT,
+						     GS_PLUGIN_FAILURE_FLAGS_FATAL_ANY,
+						     cancellable,
+						     gs_plugins_dummy_partial_finish_cb,
+						     &helper);
+	g_cancellable_cancel (cancellable);
+	g_main_loop_run (loop);
+	gs_test_flush_main_context ();
+	g_assert (g_error_matches (helper.error, GS_PLUGIN_ERROR, GS_PLUGIN_ERROR_CANCELLED) ||
+		  g_error_matches (helper.error, G_IO_ERROR, G_IO_ERROR_CANCELLED));
+	g_assert (helper.list == NULL);
+	g_assert_cmpint (helper.n_partial, ==, 0);
+	g_clear_error (&helper.error);
+}
+
 static void
 gs_plugins_dummy_url_to_app_func (GsPluginLoader *plugin_loader)
 {
@@ -657,6 +738,9 @@ main (int argc, char **argv)
 	g_test_add_data_func ("/gnome-software/plugins/dummy/search",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_dummy_search_func);
+	g_test_add_data_func ("/gnome-software/plugins/dummy/partial-results",
+			      plugin_loader,
+			      (GTestDataFunc) gs_plugins_dummy_partial_results_func);
 	g_test_add_data_func ("/gnome-software/plugins/dummy/url-to-app",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_dummy_url_to_app_func);
@@ -0,0 +1,165 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <config.h>
+
+#include "gs-flatpak.h"
+#include "gs-flatpak-update.h"
+
+void
+gs_flatpak_update_job_free (GsFlatpakUpdateJob *job)
+{
+	g_ptr_array_unref (job->apps);
+	g_free (job->ref);
+	g_free (job->name);
+	g_free (job->arch);
+	g_free (job->branch);
+	g_free (job->remote_name);
+	g_clear_error (&job->error);
+	g_free (job);
+}
+
+/* the same format as gs_flatpak_build_ref_key() */
+static gchar *
+gs_flatpak_update_build_ref (GsApp *app)
+{
+	return g_strdup_printf ("%s/%s/%s/%s",
+				gs_app_get_flatpak_kind_as_str (app),
+				gs_app_get_flatpak_name (app),
+				gs_app_get_flatpak_arch (app),
+				gs_app_get_flatpak_branch (app));
+}
+
+static void
+gs_flatpak_update_jobs_add (GPtrArray *jobs, GHashTable *jobs_hash, GsApp *app)
+{
+	GsFlatpakUpdateJob *job;
+	g_autofree gchar *ref = NULL;
+
+	/* nothing to pull */
+	if (gs_app_get_flatpak_name (app) == NULL ||
+	    gs_app_get_origin (app) == NULL)
+		return;
+
+	/* already being pulled for another app */
+	ref = gs_flatpak_update_build_ref (app);
+	job = g_hash_table_lookup (jobs_hash, ref);
+	if (job != NULL) {
+		g_ptr_array_add (job->apps, g_object_ref (app));
+		return;
+	}
+
+	job = g_new0 (GsFlatpakUpdateJob, 1);
+	job->apps = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_ptr_array_add (job->apps, g_object_ref (app));
+	job->ref = g_steal_pointer (&ref);
+	if (g_strcmp0 (gs_app_get_flatpak_kind_as_str (app), "runtime") == 0)
+		job->kind = FLATPAK_REF_KIND_RUNTIME;
+	else
+		job->kind = FLATPAK_REF_KIND_APP;
+	job->name = g_strdup (gs_app_get_flatpak_name (app));
+	job->arch = g_strdup (gs_app_get_flatpak_arch (app));
+	job->branch = g_strdup (gs_app_get_flatpak_branch (app));
+	job->remote_name = g_strdup (gs_app_get_origin (app));
+	job->idx = jobs->len;
+	job->depth = G_MAXUINT;
+	g_hash_table_insert (jobs_hash, job->ref, job);
+	g_ptr_array_add (jobs, job);
+}
+
+/* a ref is one deeper than the deepest runtime that any of its apps uses,
+ * if that runtime is also being pulled */
+static guint
+gs_flatpak_update_job_get_depth (GsFlatpakUpdateJob *job,
+				 GHashTable *jobs_hash,
+				 guint limit)
+{
+	/* already known, or a loop in the metadata */
+	if (job->depth != G_MAXUINT)
+		return job->depth;
+	job->depth = 0;
+	if (limit == 0)
+		return job->depth;
+
+	for (guint i = 0; i < job->apps->len; i++) {
+		GsApp *app = g_ptr_array_index (job->apps, i);
+		GsApp *runtime = gs_app_get_runtime (app);
+		GsFlatpakUpdateJob *job_runtime;
+		g_autofree gchar *ref = NULL;
+		guint depth;
+
+		if (runtime == NULL || gs_app_get_flatpak_name (runtime) == NULL)
+			continue;
+		ref = gs_flatpak_update_build_ref (runtime);
+		job_runtime = g_hash_table_lookup (jobs_hash, ref);
+		if (job_runtime == NULL || job_runtime == job)
+			continue;
+		depth = gs_flatpak_update_job_get_depth (job_runtime, jobs_hash,
+							 limit - 1) + 1;
+		job->depth = MAX (job->depth, depth);
+	}
+	return job->depth;
+}
+
+/* stable: refs at the same depth keep the order of the list */
+static gint
+gs_flatpak_update_job_sort_cb (gconstpointer a, gconstpointer b)
+{
+	GsFlatpakUpdateJob *job1 = *((GsFlatpakUpdateJob **) a);
+	GsFlatpakUpdateJob *job2 = *((GsFlatpakUpdateJob **) b);
+	if (job1->depth != job2->depth)
+		return job1->depth < job2->depth ? -1 : 1;
+	if (job1->idx != job2->idx)
+		return job1->idx < job2->idx ? -1 : 1;
+	return 0;
+}
+
+/* makes one job for each ref in @list, looking inside proxy apps, so that a
+ * runtime shared by several apps is only pulled once; runtimes come before
+ * the refs that use them and everything else keeps the order of @list */
+GPtrArray *
+gs_flatpak_update_jobs_new (GsAppList *list)
+{
+	GPtrArray *jobs;
+	g_autoptr(GHashTable) jobs_hash = NULL;
+
+	jobs = g_ptr_array_new_with_free_func ((GDestroyNotify) gs_flatpak_update_job_free);
+	jobs_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+		if (gs_app_has_quirk (app, AS_APP_QUIRK_IS_PROXY)) {
+			GPtrArray *related = gs_app_get_related (app);
+			for (guint j = 0; j < related->len; j++) {
+				GsApp *app_tmp = g_ptr_array_index (related, j);
+				if (gs_app_is_updatable (app_tmp))
+					gs_flatpak_update_jobs_add (jobs, jobs_hash, app_tmp);
+			}
+			continue;
+		}
+		gs_flatpak_update_jobs_add (jobs, jobs_hash, app);
+	}
+	for (guint i = 0; i < jobs->len; i++) {
+		GsFlatpakUpdateJob *job = g_ptr_array_index (jobs, i);
+		gs_flatpak_update_job_get_depth (job, jobs_hash, jobs->len);
+	}
+	g_ptr_array_sort (jobs, gs_flatpak_update_job_sort_cb);
+	return jobs;
+}
@@ -0,0 +1,49 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __GS_FLATPAK_UPDATE_H
+#define __GS_FLATPAK_UPDATE_H
+
+#include <flatpak.h>
+#include <gnome-software.h>
+
+G_BEGIN_DECLS
+
+/* one ref to pull, which may be shared by several apps */
+typedef struct {
+	GPtrArray		*apps;		/* of GsApp */
+	gchar			*ref;		/* kind/name/arch/branch */
+	FlatpakRefKind		 kind;
+	gchar			*name;
+	gchar			*arch;
+	gchar			*branch;
+	gchar			*remote_name;
+	guint			 depth;
+	guint			 idx;
+	GError			*error;
+} GsFlatpakUpdateJob;
+
+void		 gs_flatpak_update_job_free	(GsFlatpakUpdateJob	*job);
+GPtrArray	*gs_flatpak_update_jobs_new	(GsAppList		*list);
+
+G_END_DECLS
+
+#endif /* __GS_FLATPAK_UPDATE_H */
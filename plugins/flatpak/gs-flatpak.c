@@ -29,11 +29,20 @@
 
 #include <config.h>
 
+#include <string.h>
 #include <flatpak.h>
+#include <glib/gstdio.h>
 
 #include "gs-appstream.h"
 #include "gs-flatpak.h"
 #include "gs-flatpak-symlinks.h"
+#include "gs-flatpak-update.h"
+
+/* remote metadata never changes for a commit, so only drop it when unused */
+#define GS_FLATPAK_REMOTE_CACHE_AGE_MAX	(60 * 60 * 24 * 30)
+
+/* only record when an entry was used to the nearest day */
+#define GS_FLATPAK_REMOTE_CACHE_USED_FUZZ	(60 * 60 * 24)
 
 struct _GsFlatpak {
 	GObject			 parent_instance;
@@ -46,14 +55,51 @@ struct _GsFlatpak {
 	AsStore			*store;
 	gchar			*id;
 	guint			 changed_id;
+	GMutex			 installed_refs_mutex;
+	GPtrArray		*installed_refs;	/* of FlatpakInstalledRef */
+	GHashTable		*installed_refs_index;	/* ref : FlatpakInstalledRef */
+	GPtrArray		*installed_refs_for_update;
+	GMutex			 remote_cache_mutex;
+	GKeyFile		*remote_cache;		/* remote:ref@commit : data */
+	gboolean		 remote_cache_loaded;
+	gboolean		 remote_cache_changed;
+	GHashTable		*remote_commits;	/* remote:ref : commit */
+	GHashTable		*remote_commits_listed;	/* remote : TRUE */
+	GMutex			 desktop_files_mutex;
+	GHashTable		*desktop_files;		/* filename : GsFlatpakDesktopFile */
+	GMutex			 updates_pulled_mutex;
+	GHashTable		*updates_pulled;	/* ref : TRUE */
 };
 
+/* an installed desktop file, so it is only parsed again if it changes */
+typedef struct {
+	guint64			 inode;
+	gint64			 mtime;
+	gint64			 size;
+	AsApp			*app;
+} GsFlatpakDesktopFile;
+
+static void
+gs_flatpak_desktop_file_free (GsFlatpakDesktopFile *desktop_file)
+{
+	g_object_unref (desktop_file->app);
+	g_free (desktop_file);
+}
+
 G_DEFINE_TYPE (GsFlatpak, gs_flatpak, G_TYPE_OBJECT)
 
+typedef struct _GsFlatpakProgress GsFlatpakProgress;
+
 static gboolean
 gs_flatpak_refresh_appstream (GsFlatpak *self, guint cache_age,
 			      GsPluginRefreshFlags flags,
+			      GsFlatpakProgress *progress,
 			      GCancellable *cancellable, GError **error);
+static void
+gs_flatpak_rescan_installed (GsFlatpak *self,
+			     gboolean store_cleared,
+			     GCancellable *cancellable,
+			     GError **error);
 
 void
 gs_plugin_flatpak_error_convert (GError **perror)
@@ -139,6 +185,154 @@ gs_flatpak_create_app (GsFlatpak *self, FlatpakRef *xref)
 	return g_steal_pointer (&app);
 }
 
+static gchar *
+gs_flatpak_build_ref_key (FlatpakRefKind kind,
+			  const gchar *name,
+			  const gchar *arch,
+			  const gchar *branch)
+{
+	return g_strdup_printf ("%s/%s/%s/%s",
+				kind == FLATPAK_REF_KIND_APP ? "app" : "runtime",
+				name, arch, branch);
+}
+
+/* drop the snapshot of installed refs so the next user lists them again */
+static void
+gs_flatpak_invalidate_installed_refs (GsFlatpak *self)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->installed_refs_mutex);
+	g_clear_pointer (&self->installed_refs, g_ptr_array_unref);
+	g_clear_pointer (&self->installed_refs_index, g_hash_table_unref);
+	g_clear_pointer (&self->installed_refs_for_update, g_ptr_array_unref);
+}
+
+/* lists the installed refs if there is no snapshot, and must be called
+ * with installed_refs_mutex held */
+static gboolean
+gs_flatpak_ensure_installed_refs_locked (GsFlatpak *self,
+					 GCancellable *cancellable,
+					 GError **error)
+{
+	g_autoptr(GPtrArray) xrefs = NULL;
+
+	if (self->installed_refs != NULL)
+		return TRUE;
+	xrefs = flatpak_installation_list_installed_refs (self->installation,
+							  cancellable,
+							  error);
+	if (xrefs == NULL) {
+		gs_plugin_flatpak_error_convert (error);
+		return FALSE;
+	}
+	self->installed_refs_index = g_hash_table_new_full (g_str_hash,
+							    g_str_equal,
+							    g_free,
+							    NULL);
+	for (guint i = 0; i < xrefs->len; i++) {
+		FlatpakRef *xref = g_ptr_array_index (xrefs, i);
+		g_hash_table_insert (self->installed_refs_index,
+				     gs_flatpak_build_ref_key (flatpak_ref_get_kind (xref),
+							       flatpak_ref_get_name (xref),
+							       flatpak_ref_get_arch (xref),
+							       flatpak_ref_get_branch (xref)),
+				     xref);
+	}
+	self->installed_refs = g_steal_pointer (&xrefs);
+	return TRUE;
+}
+
+/* returns the installed refs, only walking the repo once per change */
+static GPtrArray *
+gs_flatpak_get_installed_refs (GsFlatpak *self,
+			       GCancellable *cancellable,
+			       GError **error)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->installed_refs_mutex);
+
+	if (!gs_flatpak_ensure_installed_refs_locked (self, cancellable, error))
+		return NULL;
+	return g_ptr_array_ref (self->installed_refs);
+}
+
+/* as above, but for the refs with updates in the cached remote summaries */
+static GPtrArray *
+gs_flatpak_get_installed_refs_for_update (GsFlatpak *self,
+					  GCancellable *cancellable,
+					  GError **error)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->installed_refs_mutex);
+
+	if (self->installed_refs_for_update == NULL) {
+		GPtrArray *xrefs;
+		xrefs = flatpak_installation_list_installed_refs_for_update (self->installation,
+									     cancellable,
+									     error);
+		if (xrefs == NULL) {
+			gs_plugin_flatpak_error_convert (error);
+			return NULL;
+		}
+		self->installed_refs_for_update = xrefs;
+	}
+	return g_ptr_array_ref (self->installed_refs_for_update);
+}
+
+/* the commits may have changed on the server */
+static void
+gs_flatpak_invalidate_remote_commits (GsFlatpak *self)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->remote_cache_mutex);
+	g_hash_table_remove_all (self->remote_commits);
+	g_hash_table_remove_all (self->remote_commits_listed);
+}
+
+/* returns %TRUE and sets @xref_out if the ref is installed */
+static gboolean
+gs_flatpak_lookup_installed_ref (GsFlatpak *self,
+				 FlatpakRefKind kind,
+				 const gchar *name,
+				 const gchar *arch,
+				 const gchar *branch,
+				 FlatpakInstalledRef **xref_out,
+				 GCancellable *cancellable,
+				 GError **error)
+{
+	FlatpakInstalledRef *xref = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->installed_refs_mutex);
+
+	/* the snapshot cannot be invalidated while we are using it */
+	if (!gs_flatpak_ensure_installed_refs_locked (self, cancellable, error))
+		return FALSE;
+
+	*xref_out = NULL;
+	if (name == NULL)
+		return TRUE;
+	if (arch != NULL && branch != NULL) {
+		g_autofree gchar *key = NULL;
+		key = gs_flatpak_build_ref_key (kind, name, arch, branch);
+		xref = g_hash_table_lookup (self->installed_refs_index, key);
+	} else {
+		/* not enough is known for the index, so match what we can */
+		for (guint i = 0; i < self->installed_refs->len; i++) {
+			FlatpakRef *xref_tmp = g_ptr_array_index (self->installed_refs, i);
+			if (flatpak_ref_get_kind (xref_tmp) != kind)
+				continue;
+			if (g_strcmp0 (flatpak_ref_get_name (xref_tmp), name) != 0)
+				continue;
+			if (arch != NULL &&
+			    g_strcmp0 (flatpak_ref_get_arch (xref_tmp), arch) != 0)
+				continue;
+			if (branch != NULL &&
+			    g_strcmp0 (flatpak_ref_get_branch (xref_tmp), branch) != 0)
+				continue;
+			xref = FLATPAK_INSTALLED_REF (xref_tmp);
+			break;
+		}
+	}
+	if (xref != NULL)
+		*xref_out = g_object_ref (xref);
+	return TRUE;
+}
+
 static void
 gs_plugin_flatpak_changed_cb (GFileMonitor *monitor,
 			      GFile *child,
@@ -149,6 +343,10 @@ gs_plugin_flatpak_changed_cb (GFileMonitor *monitor,
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GError) error_md = NULL;
 
+	/* whoever made the change, the installed refs are now stale */
+	gs_flatpak_invalidate_installed_refs (self);
+	gs_flatpak_invalidate_remote_commits (self);
+
 	/* don't refresh when it's us ourselves doing the change */
 	if (gs_plugin_has_flags (self->plugin, GS_PLUGIN_FLAGS_RUNNING_SELF))
 		return;
@@ -161,10 +359,13 @@ gs_plugin_flatpak_changed_cb (GFileMonitor *monitor,
 	}
 
 	/* if this is a new remote, get the AppStream data */
-	if (!gs_flatpak_refresh_appstream (self, G_MAXUINT, 0, NULL, &error_md)) {
+	if (!gs_flatpak_refresh_appstream (self, G_MAXUINT, 0, NULL, NULL, &error_md)) {
 		g_warning ("failed to get initial available data: %s",
 			   error_md->message);
 	}
+
+	/* pick up just the desktop files that were added or removed */
+	gs_flatpak_rescan_installed (self, FALSE, NULL, NULL);
 }
 
 static void
@@ -187,24 +388,300 @@ gs_flatpak_remove_prefixed_names (AsApp *app)
 	}
 }
 
+/* the state while streaming the AppStream data of one remote */
+typedef struct {
+	GsFlatpak		*self;
+	const gchar		*remote_name;
+	const gchar		*only_app_id;
+	const gchar		*default_branch;
+	const gchar		*icon_path;
+	GPtrArray		*apps;		/* of AsApp */
+	AsNodeContext		*ctx;		/* from the <components> root */
+	gchar			*architecture;
+	guint			 depth;
+	GString			*xml;		/* component being read, or NULL */
+	gboolean		 skip;		/* component already rejected */
+	GString			*text;		/* of the id or bundle */
+	gboolean		 in_id;
+	gboolean		 in_bundle;
+	gchar			*branch;
+	guint			 n_rejected;
+} GsFlatpakAppstreamFilter;
+
+static void
+gs_flatpak_appstream_filter_reject (GsFlatpakAppstreamFilter *filter)
+{
+	filter->skip = TRUE;
+	filter->n_rejected++;
+	g_string_truncate (filter->xml, 0);
+}
+
+static void
+gs_flatpak_appstream_filter_start_cb (GMarkupParseContext *context,
+				      const gchar *element_name,
+				      const gchar **attribute_names,
+				      const gchar **attribute_values,
+				      gpointer user_data,
+				      GError **error)
+{
+	GsFlatpakAppstreamFilter *filter = (GsFlatpakAppstreamFilter *) user_data;
+
+	filter->depth++;
+
+	/* what AsStore would apply to every component */
+	if (filter->depth == 1) {
+		for (guint i = 0; attribute_names[i] != NULL; i++) {
+			if (g_strcmp0 (attribute_names[i], "version") == 0) {
+				as_node_context_set_version (filter->ctx,
+							     g_ascii_strtod (attribute_values[i], NULL));
+			} else if (g_strcmp0 (attribute_names[i], "media_baseurl") == 0) {
+				as_node_context_set_media_base_url (filter->ctx,
+								    attribute_values[i]);
+			} else if (g_strcmp0 (attribute_names[i], "architecture") == 0) {
+				g_free (filter->architecture);
+				filter->architecture = g_strdup (attribute_values[i]);
+			}
+		}
+		return;
+	}
+
+	/* start of a component */
+	if (filter->depth == 2 &&
+	    (g_strcmp0 (element_name, "component") == 0 ||
+	     g_strcmp0 (element_name, "application") == 0)) {
+		filter->xml = g_string_new ("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+		filter->skip = FALSE;
+		g_clear_pointer (&filter->branch, g_free);
+	}
+	if (filter->xml == NULL || filter->skip)
+		return;
+
+	/* copy the element */
+	g_string_append_printf (filter->xml, "<%s", element_name);
+	for (guint i = 0; attribute_names[i] != NULL; i++) {
+		g_autofree gchar *tmp = g_markup_escape_text (attribute_values[i], -1);
+		g_string_append_printf (filter->xml, " %s=\"%s\"",
+					attribute_names[i], tmp);
+	}
+	g_string_append (filter->xml, ">");
+
+	/* the parts that are filtered on */
+	if (filter->depth == 3 && g_strcmp0 (element_name, "id") == 0) {
+		filter->in_id = TRUE;
+		g_string_truncate (filter->text, 0);
+	} else if (filter->depth == 3 && g_strcmp0 (element_name, "bundle") == 0) {
+		for (guint i = 0; attribute_names[i] != NULL; i++) {
+			if (g_strcmp0 (attribute_names[i], "type") == 0 &&
+			    g_strcmp0 (attribute_values[i], "flatpak") == 0) {
+				filter->in_bundle = TRUE;
+				g_string_truncate (filter->text, 0);
+			}
+		}
+	}
+}
+
+static void
+gs_flatpak_appstream_filter_text_cb (GMarkupParseContext *context,
+				     const gchar *text,
+				     gsize text_len,
+				     gpointer user_data,
+				     GError **error)
+{
+	GsFlatpakAppstreamFilter *filter = (GsFlatpakAppstreamFilter *) user_data;
+	g_autofree gchar *tmp = NULL;
+
+	if (filter->xml == NULL || filter->skip)
+		return;
+	tmp = g_markup_escape_text (text, (gssize) text_len);
+	g_string_append (filter->xml, tmp);
+	if (filter->in_id || filter->in_bundle)
+		g_string_append_len (filter->text, text, (gssize) text_len);
+}
+
+static void
+gs_flatpak_appstream_filter_add (GsFlatpakAppstreamFilter *filter)
+{
+	GNode *node;
+	GNode *root;
+	GPtrArray *icons;
+	gboolean ret;
+	g_autoptr(AsApp) app = as_app_new ();
+	g_autoptr(GError) error_local = NULL;
+
+	root = as_node_from_xml (filter->xml->str,
+				 AS_NODE_FROM_XML_FLAG_ONLY_NATIVE_LANGS,
+				 &error_local);
+	if (root == NULL) {
+		g_warning ("failed to parse component in %s: %s",
+			   filter->remote_name, error_local->message);
+		return;
+	}
+	node = as_node_find (root, "component");
+	if (node == NULL)
+		node = as_node_find (root, "application");
+
+	/* cached icons are relative to the AppStream data */
+	as_app_set_icon_path (app, filter->icon_path);
+	if (filter->architecture != NULL)
+		as_app_add_arch (app, filter->architecture);
+	ret = node != NULL && as_app_node_parse (app, node, filter->ctx, &error_local);
+	as_node_unref (root);
+	if (!ret) {
+		g_warning ("failed to parse component in %s: %s",
+			   filter->remote_name,
+			   error_local != NULL ? error_local->message : "no component");
+		return;
+	}
+	icons = as_app_get_icons (app);
+	for (guint i = 0; i < icons->len; i++) {
+		AsIcon *ic = g_ptr_array_index (icons, i);
+		if (as_icon_get_kind (ic) == AS_ICON_KIND_CACHED &&
+		    as_icon_get_prefix (ic) == NULL)
+			as_icon_set_prefix (ic, filter->icon_path);
+	}
+
+	/* the bundle is not the only place the branch can come from */
+	if (filter->default_branch != NULL &&
+	    g_strcmp0 (as_app_get_branch (app), filter->default_branch) != 0) {
+		g_debug ("not adding app with branch %s as filtering to %s",
+			 as_app_get_branch (app), filter->default_branch);
+		filter->n_rejected++;
+		return;
+	}
+
+	/* fix the names when using old versions of appstream-compose */
+	gs_flatpak_remove_prefixed_names (app);
+
+	/* add */
+	as_app_set_scope (app, filter->self->scope);
+	as_app_set_origin (app, filter->remote_name);
+#if !AS_CHECK_VERSION(0,6,13)
+	/* add the origin as a keyword */
+	as_app_add_keyword (app, NULL, filter->remote_name);
+#endif
+	as_app_add_keyword (app, NULL, "flatpak");
+	g_debug ("adding %s", as_app_get_unique_id (app));
+	g_ptr_array_add (filter->apps, g_steal_pointer (&app));
+}
+
+static void
+gs_flatpak_appstream_filter_end_cb (GMarkupParseContext *context,
+				    const gchar *element_name,
+				    gpointer user_data,
+				    GError **error)
+{
+	GsFlatpakAppstreamFilter *filter = (GsFlatpakAppstreamFilter *) user_data;
+
+	if (filter->xml != NULL && !filter->skip)
+		g_string_append_printf (filter->xml, "</%s>", element_name);
+
+	/* only add the specific app for noenumerate=true */
+	if (filter->in_id) {
+		filter->in_id = FALSE;
+		if (filter->only_app_id != NULL &&
+		    g_strcmp0 (filter->text->str, filter->only_app_id) != 0)
+			gs_flatpak_appstream_filter_reject (filter);
+	}
+
+	/* filter by branch, e.g. app/org.gnome.Builder/x86_64/stable */
+	if (filter->in_bundle) {
+		g_auto(GStrv) split = g_strsplit (filter->text->str, "/", -1);
+		filter->in_bundle = FALSE;
+		if (g_strv_length (split) == 4)
+			filter->branch = g_strdup (split[3]);
+		if (filter->default_branch != NULL &&
+		    filter->branch != NULL &&
+		    g_strcmp0 (filter->branch, filter->default_branch) != 0) {
+			g_debug ("not adding app with branch %s as filtering to %s",
+				 filter->branch, filter->default_branch);
+			gs_flatpak_appstream_filter_reject (filter);
+		}
+	}
+
+	/* end of a component */
+	if (filter->depth == 2 && filter->xml != NULL) {
+		if (!filter->skip)
+			gs_flatpak_appstream_filter_add (filter);
+		g_string_free (filter->xml, TRUE);
+		filter->xml = NULL;
+	}
+	filter->depth--;
+}
+
+/* parses the compressed AppStream data a chunk at a time, only creating
+ * AsApps for the components that are not filtered out */
+static gboolean
+gs_flatpak_appstream_filter_file (GsFlatpakAppstreamFilter *filter,
+				  GFile *file,
+				  GCancellable *cancellable,
+				  GError **error)
+{
+	const GMarkupParser parser = {
+		gs_flatpak_appstream_filter_start_cb,
+		gs_flatpak_appstream_filter_end_cb,
+		gs_flatpak_appstream_filter_text_cb,
+		NULL,
+		NULL };
+	g_autofree gchar *uri = NULL;
+	g_autoptr(GConverter) decompressor = NULL;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GInputStream) stream_data = NULL;
+	g_autoptr(GInputStream) stream_gz = NULL;
+	g_autoptr(GMarkupParseContext) ctx = NULL;
+
+	stream_gz = G_INPUT_STREAM (g_file_read (file, cancellable, error));
+	if (stream_gz == NULL) {
+		gs_utils_error_convert_gio (error);
+		return FALSE;
+	}
+	decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+	stream_data = g_converter_input_stream_new (stream_gz, decompressor);
+	ctx = g_markup_parse_context_new (&parser, G_MARKUP_TREAT_CDATA_AS_TEXT,
+					  filter, NULL);
+	while (TRUE) {
+		gchar buf[32 * 1024];
+		gssize len;
+		len = g_input_stream_read (stream_data, buf, sizeof (buf),
+					   cancellable, error);
+		if (len < 0) {
+			gs_utils_error_convert_gio (error);
+			return FALSE;
+		}
+		if (len == 0)
+			break;
+		if (!g_markup_parse_context_parse (ctx, buf, len, &error_local))
+			break;
+	}
+	if (error_local == NULL &&
+	    g_markup_parse_context_end_parse (ctx, &error_local))
+		return TRUE;
+	uri = g_file_get_uri (file);
+	g_set_error (error,
+		     GS_PLUGIN_ERROR,
+		     GS_PLUGIN_ERROR_INVALID_FORMAT,
+		     "failed to parse %s: %s",
+		     uri, error_local->message);
+	return FALSE;
+}
+
 static gboolean
 gs_flatpak_add_apps_from_xremote (GsFlatpak *self,
 				  FlatpakRemote *xremote,
 				  GCancellable *cancellable,
 				  GError **error)
 {
-	GPtrArray *apps;
-	guint i;
+	GsFlatpakAppstreamFilter filter;
+	gboolean ret;
 	g_autofree gchar *appstream_dir_fn = NULL;
 	g_autofree gchar *appstream_fn = NULL;
 	g_autofree gchar *default_branch = NULL;
+	g_autofree gchar *icon_path = NULL;
 	g_autofree gchar *only_app_id = NULL;
 	g_autoptr(AsProfileTask) ptask = NULL;
-	g_autoptr(AsStore) store = NULL;
 	g_autoptr(GFile) appstream_dir = NULL;
 	g_autoptr(GFile) file = NULL;
 	g_autoptr(GSettings) settings = NULL;
-	g_autoptr(GPtrArray) app_filtered = NULL;
+	g_autoptr(GPtrArray) apps = NULL;
 
 	/* profile */
 	ptask = as_profile_start (gs_plugin_get_profile (self->plugin),
@@ -221,7 +698,7 @@ gs_flatpak_add_apps_from_xremote (GsFlatpak *self,
 		return TRUE;
 	}
 
-	/* load the file into a temp store */
+	/* find the file */
 	appstream_dir_fn = g_file_get_path (appstream_dir);
 	appstream_fn = g_build_filename (appstream_dir_fn,
 					 "appstream.xml.gz", NULL);
@@ -232,45 +709,7 @@ gs_flatpak_add_apps_from_xremote (GsFlatpak *self,
 		return TRUE;
 	}
 	file = g_file_new_for_path (appstream_fn);
-	store = as_store_new ();
-	as_store_set_add_flags (store,
-				AS_STORE_ADD_FLAG_USE_UNIQUE_ID |
-				AS_STORE_ADD_FLAG_ONLY_NATIVE_LANGS);
-	as_store_set_search_match (store,
-				   AS_APP_SEARCH_MATCH_MIMETYPE |
-				   AS_APP_SEARCH_MATCH_PKGNAME |
-				   AS_APP_SEARCH_MATCH_COMMENT |
-				   AS_APP_SEARCH_MATCH_NAME |
-				   AS_APP_SEARCH_MATCH_KEYWORD |
-#if AS_CHECK_VERSION(0,6,13)
-				   AS_APP_SEARCH_MATCH_ORIGIN |
-#endif
-				   AS_APP_SEARCH_MATCH_ID);
-	if (!as_store_from_file (store, file, NULL, cancellable, error)) {
-		gs_utils_error_convert_appstream (error);
-		return FALSE;
-	}
-
-	/* override the *AppStream* origin */
-	apps = as_store_get_apps (store);
-	for (i = 0; i < apps->len; i++) {
-		AsApp *app = g_ptr_array_index (apps, i);
-		as_app_set_origin (app, flatpak_remote_get_name (xremote));
-	}
-
-#if !AS_CHECK_VERSION(0,6,13)
-	/* add the origin as a keyword */
-	for (i = 0; i < apps->len; i++) {
-		AsApp *app = g_ptr_array_index (apps, i);
-		g_debug ("adding keyword '%s' to %s",
-			 flatpak_remote_get_name (xremote),
-			 as_app_get_id (app));
-		as_app_add_keyword (app, NULL, flatpak_remote_get_name (xremote));
-	}
-#endif
-
-	/* ensure the token cache */
-	as_store_load_search_cache (store);
+	icon_path = g_build_filename (appstream_dir_fn, "icons", NULL);
 
 	/* only add the specific app for noenumerate=true */
 	if (flatpak_remote_get_noenumerate (xremote)) {
@@ -285,53 +724,118 @@ gs_flatpak_add_apps_from_xremote (GsFlatpak *self,
 	if (g_settings_get_boolean (settings, "filter-default-branch"))
 		default_branch = flatpak_remote_get_default_branch (xremote);
 
-	/* get all the apps and fix them up */
-	app_filtered = g_ptr_array_new ();
-	for (i = 0; i < apps->len; i++) {
-		AsApp *app = g_ptr_array_index (apps, i);
+	/* filter while reading, so rejected components are never built */
+	apps = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	memset (&filter, 0, sizeof (filter));
+	filter.self = self;
+	filter.remote_name = flatpak_remote_get_name (xremote);
+	filter.only_app_id = only_app_id;
+	filter.default_branch = default_branch;
+	filter.icon_path = icon_path;
+	filter.apps = apps;
+	filter.text = g_string_new (NULL);
+	filter.ctx = as_node_context_new ();
+#if AS_CHECK_VERSION(0,6,9)
+	as_node_context_set_format_kind (filter.ctx, AS_FORMAT_KIND_APPSTREAM);
+#else
+	as_node_context_set_source_kind (filter.ctx, AS_APP_SOURCE_KIND_APPSTREAM);
+#endif
+	ret = gs_flatpak_appstream_filter_file (&filter, file, cancellable, error);
+	if (filter.xml != NULL)
+		g_string_free (filter.xml, TRUE);
+	g_string_free (filter.text, TRUE);
+	as_node_context_free (filter.ctx);
+	g_free (filter.architecture);
+	g_free (filter.branch);
+	if (!ret)
+		return FALSE;
+	g_debug ("added %u and filtered %u components from %s",
+		 apps->len, filter.n_rejected, filter.remote_name);
 
-		/* filter to app */
-		if (only_app_id != NULL &&
-		    g_strcmp0 (as_app_get_id (app), only_app_id) != 0) {
-			as_app_set_kind (app, AS_APP_KIND_UNKNOWN);
-			continue;
-		}
+	/* add them to the main store */
+	as_store_add_apps (self->store, apps);
+	return TRUE;
+}
 
-		/* filter by branch */
-		if (default_branch != NULL &&
-		    g_strcmp0 (as_app_get_branch (app), default_branch) != 0) {
-			g_debug ("not adding app with branch %s as filtering to %s",
-				 as_app_get_branch (app), default_branch);
-			continue;
-		}
+static AsApp *
+gs_flatpak_parse_desktop_file (GsFlatpak *self,
+			       const gchar *fn_desktop,
+			       const gchar *path_exports)
+{
+	GPtrArray *icons;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(AsApp) app = NULL;
 
-		/* fix the names when using old versions of appstream-compose */
-		gs_flatpak_remove_prefixed_names (app);
+	/* parse desktop files */
+	app = as_app_new ();
+	if (!as_app_parse_file (app, fn_desktop, 0, &error_local)) {
+		g_warning ("failed to parse %s: %s",
+			   fn_desktop, error_local->message);
+		return NULL;
+	}
 
-		/* add */
-		as_app_set_scope (app, self->scope);
-		as_app_set_origin (app, flatpak_remote_get_name (xremote));
-		as_app_add_keyword (app, NULL, "flatpak");
-		g_debug ("adding %s", as_app_get_unique_id (app));
-		g_ptr_array_add (app_filtered, app);
+	/* fix up icons */
+	icons = as_app_get_icons (app);
+	for (guint i = 0; i < icons->len; i++) {
+		AsIcon *ic = g_ptr_array_index (icons, i);
+		if (as_icon_get_kind (ic) == AS_ICON_KIND_UNKNOWN) {
+			as_icon_set_kind (ic, AS_ICON_KIND_STOCK);
+			as_icon_set_prefix (ic, path_exports);
+		}
 	}
 
-	/* add them to the main store */
-	as_store_add_apps (self->store, app_filtered);
-	return TRUE;
+	/* fix the names when using old versions of appstream-compose */
+	gs_flatpak_remove_prefixed_names (app);
+
+	/* add */
+	as_app_set_state (app, AS_APP_STATE_INSTALLED);
+	as_app_set_scope (app, self->scope);
+#if AS_CHECK_VERSION(0,6,9)
+{
+	g_autoptr(AsFormat) format = as_format_new ();
+	as_format_set_kind (format, AS_FORMAT_KIND_DESKTOP);
+	as_format_set_filename (format, fn_desktop);
+	as_app_add_format (app, format);
+}
+#else
+	as_app_set_source_kind (app, AS_APP_SOURCE_KIND_DESKTOP);
+	as_app_set_source_file (app, fn_desktop);
+#endif
+	as_app_set_icon_path (app, path_exports);
+	as_app_add_keyword (app, NULL, "flatpak");
+	return g_steal_pointer (&app);
+}
+
+/* only remove the app if the store did not prefer another with the same ID */
+static void
+gs_flatpak_remove_desktop_app (GsFlatpak *self, AsApp *app)
+{
+	AsApp *app_tmp;
+	app_tmp = as_store_get_app_by_unique_id (self->store,
+						 as_app_get_unique_id (app),
+						 AS_STORE_SEARCH_FLAG_NONE);
+	if (app_tmp == app)
+		as_store_remove_app (self->store, app);
 }
 
+/* if @store_cleared is set then all the apps are added again, otherwise
+ * only the desktop files that were added, changed or removed are */
 static void
 gs_flatpak_rescan_installed (GsFlatpak *self,
+			     gboolean store_cleared,
 			     GCancellable *cancellable,
 			     GError **error)
 {
-	GPtrArray *icons;
 	const gchar *fn;
-	guint i;
+	GHashTableIter iter;
+	gpointer key;
+	gpointer value;
+	guint parsed = 0;
 	g_autoptr(AsProfileTask) ptask = NULL;
 	g_autoptr(GFile) path = NULL;
 	g_autoptr(GDir) dir = NULL;
+	g_autoptr(GHashTable) seen = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
 	g_autofree gchar *path_str = NULL;
 	g_autofree gchar *path_exports = NULL;
 	g_autofree gchar *path_apps = NULL;
@@ -343,62 +847,74 @@ gs_flatpak_rescan_installed (GsFlatpak *self,
 	g_assert (ptask != NULL);
 
 	/* add all installed desktop files */
+	locker = g_mutex_locker_new (&self->desktop_files_mutex);
+	seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 	path = flatpak_installation_get_path (self->installation);
 	path_str = g_file_get_path (path);
 	path_exports = g_build_filename (path_str, "exports", NULL);
 	path_apps = g_build_filename (path_exports, "share", "applications", NULL);
 	dir = g_dir_open (path_apps, 0, NULL);
-	if (dir == NULL)
-		return;
-	while ((fn = g_dir_read_name (dir)) != NULL) {
+	while (dir != NULL && (fn = g_dir_read_name (dir)) != NULL) {
+		GStatBuf buf;
+		GsFlatpakDesktopFile *desktop_file;
 		g_autofree gchar *fn_desktop = NULL;
-		g_autoptr(GError) error_local = NULL;
-		g_autoptr(AsApp) app = NULL;
 
 		/* ignore */
 		if (g_strcmp0 (fn, "mimeinfo.cache") == 0)
 			continue;
 
-		/* parse desktop files */
-		app = as_app_new ();
+		/* unchanged since last time */
 		fn_desktop = g_build_filename (path_apps, fn, NULL);
-		if (!as_app_parse_file (app, fn_desktop, 0, &error_local)) {
-			g_warning ("failed to parse %s: %s",
-				   fn_desktop, error_local->message);
+		if (g_stat (fn_desktop, &buf) != 0)
+			continue;
+		desktop_file = g_hash_table_lookup (self->desktop_files, fn_desktop);
+		if (desktop_file != NULL &&
+		    desktop_file->inode == (guint64) buf.st_ino &&
+		    desktop_file->mtime == (gint64) buf.st_mtime &&
+		    desktop_file->size == (gint64) buf.st_size) {
+			g_hash_table_add (seen, g_strdup (fn_desktop));
+			if (store_cleared)
+				as_store_add_app (self->store, desktop_file->app);
 			continue;
 		}
 
-		/* fix up icons */
-		icons = as_app_get_icons (app);
-		for (i = 0; i < icons->len; i++) {
-			AsIcon *ic = g_ptr_array_index (icons, i);
-			if (as_icon_get_kind (ic) == AS_ICON_KIND_UNKNOWN) {
-				as_icon_set_kind (ic, AS_ICON_KIND_STOCK);
-				as_icon_set_prefix (ic, path_exports);
-			}
+		/* new or changed */
+		if (desktop_file != NULL && !store_cleared)
+			gs_flatpak_remove_desktop_app (self, desktop_file->app);
+		g_hash_table_remove (self->desktop_files, fn_desktop);
+		desktop_file = g_new0 (GsFlatpakDesktopFile, 1);
+		desktop_file->app = gs_flatpak_parse_desktop_file (self,
+								   fn_desktop,
+								   path_exports);
+		parsed++;
+		if (desktop_file->app == NULL) {
+			g_free (desktop_file);
+			continue;
 		}
-
-		/* fix the names when using old versions of appstream-compose */
-		gs_flatpak_remove_prefixed_names (app);
-
-		/* add */
-		as_app_set_state (app, AS_APP_STATE_INSTALLED);
-		as_app_set_scope (app, self->scope);
-#if AS_CHECK_VERSION(0,6,9)
-{
-		g_autoptr(AsFormat) format = as_format_new ();
-		as_format_set_kind (format, AS_FORMAT_KIND_DESKTOP);
-		as_format_set_filename (format, fn_desktop);
-		as_app_add_format (app, format);
-}
-#else
-		as_app_set_source_kind (app, AS_APP_SOURCE_KIND_DESKTOP);
-		as_app_set_source_file (app, fn_desktop);
-#endif
-		as_app_set_icon_path (app, path_exports);
-		as_app_add_keyword (app, NULL, "flatpak");
-		as_store_add_app (self->store, app);
-	}
+		desktop_file->inode = (guint64) buf.st_ino;
+		desktop_file->mtime = (gint64) buf.st_mtime;
+		desktop_file->size = (gint64) buf.st_size;
+		as_store_add_app (self->store, desktop_file->app);
+		g_hash_table_insert (self->desktop_files,
+				     g_strdup (fn_desktop),
+				     desktop_file);
+		g_hash_table_add (seen, g_strdup (fn_desktop));
+	}
+
+	/* drop the apps for files that have gone */
+	g_hash_table_iter_init (&iter, self->desktop_files);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		GsFlatpakDesktopFile *desktop_file = value;
+		if (g_hash_table_contains (seen, key))
+			continue;
+		g_debug ("%s was removed", (const gchar *) key);
+		if (!store_cleared)
+			gs_flatpak_remove_desktop_app (self, desktop_file->app);
+		g_hash_table_iter_remove (&iter);
+	}
+	g_debug ("parsed %u of %u desktop files in %s", parsed,
+		 g_hash_table_size (self->desktop_files),
+		 gs_flatpak_get_id (self));
 }
 
 static gboolean
@@ -437,8 +953,11 @@ gs_flatpak_rescan_appstream_store (GsFlatpak *self,
 			return FALSE;
 	}
 
+	/* ensure the token cache, once for all the remotes */
+	as_store_load_search_cache (self->store);
+
 	/* add any installed files without AppStream info */
-	gs_flatpak_rescan_installed (self, cancellable, error);
+	gs_flatpak_rescan_installed (self, TRUE, cancellable, error);
 
 	return TRUE;
 }
@@ -454,7 +973,7 @@ gs_flatpak_setup (GsFlatpak *self, GCancellable *cancellable, GError **error)
 				  gs_flatpak_get_id (self));
 	g_assert (ptask != NULL);
 
-	if (!gs_flatpak_refresh_appstream (self, G_MAXUINT, 0,
+	if (!gs_flatpak_refresh_appstream (self, G_MAXUINT, 0, NULL,
 					   cancellable,
 					   &error_md)) {
 		g_warning ("failed to get initial available data on setup: %s",
@@ -493,8 +1012,240 @@ gs_flatpak_setup (GsFlatpak *self, GCancellable *cancellable, GError **error)
 	return TRUE;
 }
 
+typedef struct {
+	GPtrArray		*jobs;
+	GsFlatpakPoolFunc	 func;
+	gpointer		 user_data;
+	GMutex			 mutex;
+	guint			 next;
+	guint			 next_worker;
+} GsFlatpakPool;
+
+/* each worker takes the next job until there are none left */
+static gpointer
+gs_flatpak_pool_thread_cb (gpointer user_data)
+{
+	GsFlatpakPool *pool = (GsFlatpakPool *) user_data;
+	guint worker;
+
+	g_mutex_lock (&pool->mutex);
+	worker = pool->next_worker++;
+	g_mutex_unlock (&pool->mutex);
+
+	while (TRUE) {
+		gpointer job;
+
+		g_mutex_lock (&pool->mutex);
+		if (pool->next >= pool->jobs->len) {
+			g_mutex_unlock (&pool->mutex);
+			break;
+		}
+		job = g_ptr_array_index (pool->jobs, pool->next++);
+		g_mutex_unlock (&pool->mutex);
+
+		pool->func (job, worker, pool->user_data);
+	}
+	return NULL;
+}
+
+/* runs @func on every item in @jobs using up to GS_FLATPAK_POOL_MAX_WORKERS
+ * threads, of which the calling thread is one; @worker is unique to the
+ * thread and less than the number of workers */
+void
+gs_flatpak_run_pool (GPtrArray *jobs, GsFlatpakPoolFunc func, gpointer user_data)
+{
+	GsFlatpakPool pool;
+	guint n_workers = MIN (jobs->len, GS_FLATPAK_POOL_MAX_WORKERS);
+	g_autoptr(GPtrArray) threads = NULL;
+
+	memset (&pool, 0, sizeof (pool));
+	pool.jobs = jobs;
+	pool.func = func;
+	pool.user_data = user_data;
+	g_mutex_init (&pool.mutex);
+	threads = g_ptr_array_new ();
+	for (guint i = 1; i < n_workers; i++) {
+		g_ptr_array_add (threads, g_thread_new ("gs-flatpak-pool",
+							gs_flatpak_pool_thread_cb,
+							&pool));
+	}
+	gs_flatpak_pool_thread_cb (&pool);
+	for (guint i = 0; i < threads->len; i++)
+		g_thread_join (g_ptr_array_index (threads, i));
+	g_mutex_clear (&pool.mutex);
+}
+
+typedef void (*GsFlatpakJobFunc)	(GsFlatpak		*self,
+					 FlatpakInstallation	*installation,
+					 gpointer		 job,
+					 GCancellable		*cancellable);
+
+typedef struct {
+	GsFlatpak		*self;
+	GPtrArray		*installations;	/* one per worker */
+	GsFlatpakJobFunc	 func;
+	GCancellable		*cancellable;
+} GsFlatpakParallelHelper;
+
+static void
+gs_flatpak_run_parallel_cb (gpointer job, guint worker, gpointer user_data)
+{
+	GsFlatpakParallelHelper *helper = (GsFlatpakParallelHelper *) user_data;
+	helper->func (helper->self,
+		      g_ptr_array_index (helper->installations, worker),
+		      job, helper->cancellable);
+}
+
+/* runs @func on every item in @jobs at the same time -- each worker uses its
+ * own view of the installation, as one OstreeRepo can only have one
+ * transaction open at a time; if @system_serial is set then system
+ * installations do one job at a time, as the system helper would */
+static void
+gs_flatpak_run_parallel (GsFlatpak *self,
+			 GPtrArray *jobs,
+			 gboolean system_serial,
+			 GsFlatpakJobFunc func,
+			 GCancellable *cancellable)
+{
+	GsFlatpakParallelHelper helper;
+	gboolean is_user = flatpak_installation_get_is_user (self->installation);
+	guint n_workers = MIN (jobs->len, GS_FLATPAK_POOL_MAX_WORKERS);
+	g_autoptr(GPtrArray) installations = NULL;
+
+	installations = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	if (n_workers > 1 && (is_user || !system_serial)) {
+		g_autoptr(GFile) path = flatpak_installation_get_path (self->installation);
+		for (guint i = 0; i < n_workers; i++) {
+			FlatpakInstallation *installation;
+			g_autoptr(GError) error_local = NULL;
+			installation = flatpak_installation_new_for_path (path, is_user,
+									  cancellable,
+									  &error_local);
+			if (installation == NULL) {
+				g_debug ("failed to open %s, not running in parallel: %s",
+					 gs_flatpak_get_id (self),
+					 error_local->message);
+				g_ptr_array_set_size (installations, 0);
+				break;
+			}
+			g_ptr_array_add (installations, installation);
+		}
+	}
+	if (installations->len == 0) {
+		for (guint i = 0; i < jobs->len; i++) {
+			func (self, self->installation,
+			      g_ptr_array_index (jobs, i), cancellable);
+		}
+		return;
+	}
+
+	helper.self = self;
+	helper.installations = installations;
+	helper.func = func;
+	helper.cancellable = cancellable;
+	gs_flatpak_run_pool (jobs, gs_flatpak_run_parallel_cb, &helper);
+}
+
+/* the progress of several jobs as one percentage, where the current jobs
+ * are the part from @offset to @offset + @scale of the whole */
+struct _GsFlatpakProgress {
+	GMutex			 mutex;
+	GsFlatpakProgressFunc	 func;
+	gpointer		 user_data;
+	guint			*percentages;
+	guint			 n_jobs;
+	guint			 offset;
+	guint			 scale;
+	guint			 last;
+};
+
+static void
+gs_flatpak_progress_init (GsFlatpakProgress *progress,
+			  GsFlatpakProgressFunc func,
+			  gpointer user_data)
+{
+	memset (progress, 0, sizeof (GsFlatpakProgress));
+	g_mutex_init (&progress->mutex);
+	progress->func = func;
+	progress->user_data = user_data;
+	progress->scale = 100;
+	progress->last = G_MAXUINT;
+}
+
+static void
+gs_flatpak_progress_clear (GsFlatpakProgress *progress)
+{
+	g_free (progress->percentages);
+	g_mutex_clear (&progress->mutex);
+}
+
+/* must be called with the mutex held */
+static void
+gs_flatpak_progress_emit (GsFlatpakProgress *progress)
+{
+	guint64 done = 0;
+	guint percentage;
+
+	if (progress->func == NULL)
+		return;
+	for (guint i = 0; i < progress->n_jobs; i++)
+		done += progress->percentages[i];
+	if (progress->n_jobs == 0)
+		percentage = progress->offset + progress->scale;
+	else
+		percentage = progress->offset +
+			(guint) (done * progress->scale / (progress->n_jobs * 100));
+	if (percentage == progress->last)
+		return;
+	progress->last = percentage;
+	progress->func (percentage, progress->user_data);
+}
+
+/* the jobs that are started next cover @scale percent from @offset */
+static void
+gs_flatpak_progress_set_range (GsFlatpakProgress *progress,
+			       guint offset,
+			       guint scale)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	if (progress == NULL)
+		return;
+	locker = g_mutex_locker_new (&progress->mutex);
+	progress->offset = offset;
+	progress->scale = scale;
+}
+
+static void
+gs_flatpak_progress_start (GsFlatpakProgress *progress, guint n_jobs)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	if (progress == NULL)
+		return;
+	locker = g_mutex_locker_new (&progress->mutex);
+	g_free (progress->percentages);
+	progress->percentages = g_new0 (guint, n_jobs);
+	progress->n_jobs = n_jobs;
+	gs_flatpak_progress_emit (progress);
+}
+
+static void
+gs_flatpak_progress_set (GsFlatpakProgress *progress,
+			 guint job,
+			 guint percentage)
+{
+	g_autoptr(GMutexLocker) locker = NULL;
+	if (progress == NULL)
+		return;
+	locker = g_mutex_locker_new (&progress->mutex);
+	if (job >= progress->n_jobs)
+		return;
+	progress->percentages[job] = MIN (percentage, 100);
+	gs_flatpak_progress_emit (progress);
+}
+
 static gboolean
 gs_flatpak_refresh_appstream_remote (GsFlatpak *self,
+				     FlatpakInstallation *installation,
 				     const gchar *remote_name,
 				     GCancellable *cancellable,
 				     GError **error)
@@ -505,7 +1256,7 @@ gs_flatpak_refresh_appstream_remote (GsFlatpak *self,
 				  gs_flatpak_get_id (self),
 				  remote_name);
 	g_assert (ptask != NULL);
-	if (!flatpak_installation_update_appstream_sync (self->installation,
+	if (!flatpak_installation_update_appstream_sync (installation,
 							 remote_name,
 							 NULL,
 							 NULL,
@@ -517,15 +1268,45 @@ gs_flatpak_refresh_appstream_remote (GsFlatpak *self,
 	return TRUE;
 }
 
+typedef struct {
+	gchar			*remote_name;
+	guint			 idx;
+	GsFlatpakProgress	*progress;
+	GError			*error;
+} GsFlatpakRemoteJob;
+
+static void
+gs_flatpak_remote_job_free (GsFlatpakRemoteJob *job)
+{
+	g_free (job->remote_name);
+	g_clear_error (&job->error);
+	g_free (job);
+}
+
+static void
+gs_flatpak_refresh_appstream_job_cb (GsFlatpak *self,
+				     FlatpakInstallation *installation,
+				     gpointer user_data,
+				     GCancellable *cancellable)
+{
+	GsFlatpakRemoteJob *job = (GsFlatpakRemoteJob *) user_data;
+	gs_flatpak_refresh_appstream_remote (self, installation,
+					     job->remote_name,
+					     cancellable,
+					     &job->error);
+	gs_flatpak_progress_set (job->progress, job->idx, 100);
+}
+
 static gboolean
 gs_flatpak_refresh_appstream (GsFlatpak *self, guint cache_age,
 			      GsPluginRefreshFlags flags,
+			      GsFlatpakProgress *progress,
 			      GCancellable *cancellable, GError **error)
 {
-	gboolean ret;
 	gboolean something_changed = FALSE;
 	guint i;
 	g_autoptr(AsProfileTask) ptask = NULL;
+	g_autoptr(GPtrArray) jobs = NULL;
 	g_autoptr(GPtrArray) xremotes = NULL;
 
 	/* profile */
@@ -546,14 +1327,13 @@ gs_flatpak_refresh_appstream (GsFlatpak *self, guint cache_age,
 		gs_plugin_flatpak_error_convert (error);
 		return FALSE;
 	}
+	jobs = g_ptr_array_new_with_free_func ((GDestroyNotify) gs_flatpak_remote_job_free);
 	for (i = 0; i < xremotes->len; i++) {
 		const gchar *remote_name;
 		guint tmp;
-		g_autoptr(GError) error_local = NULL;
-		g_autoptr(GFile) file = NULL;
 		g_autoptr(GFile) file_timestamp = NULL;
-		g_autofree gchar *appstream_fn = NULL;
 		FlatpakRemote *xremote = g_ptr_array_index (xremotes, i);
+		GsFlatpakRemoteJob *job;
 
 		/* not enabled */
 		if (flatpak_remote_get_disabled (xremote))
@@ -579,43 +1359,53 @@ gs_flatpak_refresh_appstream (GsFlatpak *self, guint cache_age,
 		/* download new data */
 		g_debug ("%s is %u seconds old, so downloading new data",
 			 remote_name, tmp);
-		ret = gs_flatpak_refresh_appstream_remote (self,
-							   remote_name,
-							   cancellable,
-							   &error_local);
-		if (!ret) {
-			if (g_error_matches (error_local,
+		job = g_new0 (GsFlatpakRemoteJob, 1);
+		job->remote_name = g_strdup (remote_name);
+		job->idx = jobs->len;
+		job->progress = progress;
+		g_ptr_array_add (jobs, job);
+	}
+
+	/* remotes are usually on different servers, so download from a few
+	 * at once, each one counting as done when it finishes */
+	gs_flatpak_progress_start (progress, jobs->len);
+	gs_flatpak_run_parallel (self, jobs, TRUE,
+				 gs_flatpak_refresh_appstream_job_cb,
+				 cancellable);
+
+	/* look at the results in the same order as the remotes */
+	for (i = 0; i < jobs->len; i++) {
+		GsFlatpakRemoteJob *job = g_ptr_array_index (jobs, i);
+
+		if (job->error != NULL) {
+			if (g_error_matches (job->error,
 					     GS_PLUGIN_ERROR,
 					     GS_PLUGIN_ERROR_FAILED)) {
 				g_debug ("Failed to get AppStream metadata: %s",
-					 error_local->message);
+					 job->error->message);
 				/* don't try to fetch this again until refresh() */
 				g_hash_table_insert (self->broken_remotes,
-						     g_strdup (remote_name),
+						     g_strdup (job->remote_name),
 						     GUINT_TO_POINTER (1));
 				continue;
 			}
 			if ((flags & GS_PLUGIN_REFRESH_FLAGS_INTERACTIVE) == 0) {
 				g_warning ("Failed to get AppStream metadata: %s [%s:%i]",
-					   error_local->message,
-					   g_quark_to_string (error_local->domain),
-					   error_local->code);
+					   job->error->message,
+					   g_quark_to_string (job->error->domain),
+					   job->error->code);
 				continue;
 			}
 			g_set_error (error,
 				     GS_PLUGIN_ERROR,
 				     GS_PLUGIN_ERROR_NOT_SUPPORTED,
 				     "Failed to get AppStream metadata: %s",
-				     error_local->message);
+				     job->error->message);
 			return FALSE;
 		}
 
-		/* add the new AppStream repo to the shared store */
-		file = flatpak_remote_get_appstream_dir (xremote, NULL);
-		appstream_fn = g_file_get_path (file);
-		g_debug ("using AppStream metadata found at: %s", appstream_fn);
-
 		/* trigger the symlink rebuild */
+		g_debug ("got new AppStream metadata for %s", job->remote_name);
 		something_changed = TRUE;
 	}
 
@@ -774,12 +1564,9 @@ gs_flatpak_add_installed (GsFlatpak *self, GsAppList *list,
 	guint i;
 
 	/* get apps and runtimes */
-	xrefs = flatpak_installation_list_installed_refs (self->installation,
-							  cancellable, error);
-	if (xrefs == NULL) {
-		gs_plugin_flatpak_error_convert (error);
+	xrefs = gs_flatpak_get_installed_refs (self, cancellable, error);
+	if (xrefs == NULL)
 		return FALSE;
-	}
 	for (i = 0; i < xrefs->len; i++) {
 		FlatpakInstalledRef *xref = g_ptr_array_index (xrefs, i);
 		g_autoptr(GError) error_local = NULL;
@@ -813,13 +1600,9 @@ gs_flatpak_add_sources (GsFlatpak *self, GsAppList *list,
 	guint j;
 
 	/* get installed apps and runtimes */
-	xrefs = flatpak_installation_list_installed_refs (self->installation,
-							  cancellable,
-							  error);
-	if (xrefs == NULL) {
-		gs_plugin_flatpak_error_convert (error);
+	xrefs = gs_flatpak_get_installed_refs (self, cancellable, error);
+	if (xrefs == NULL)
 		return FALSE;
-	}
 
 	/* get available remotes */
 	xremotes = flatpak_installation_list_remotes (self->installation,
@@ -1039,13 +1822,9 @@ gs_flatpak_add_updates (GsFlatpak *self, GsAppList *list,
 	g_autoptr(GsAppList) list_tmp = NULL;
 
 	/* get all the installed apps (no network I/O) */
-	xrefs = flatpak_installation_list_installed_refs (self->installation,
-							  cancellable,
-							  error);
-	if (xrefs == NULL) {
-		gs_plugin_flatpak_error_convert (error);
+	xrefs = gs_flatpak_get_installed_refs (self, cancellable, error);
+	if (xrefs == NULL)
 		return FALSE;
-	}
 
 	/* look at each installed xref */
 	list_tmp = gs_app_list_new ();
@@ -1107,13 +1886,9 @@ gs_flatpak_add_updates_pending (GsFlatpak *self, GsAppList *list,
 	g_autoptr(GsAppList) list_tmp = gs_app_list_new ();
 
 	/* get all the updatable apps and runtimes (no network I/O) */
-	xrefs = flatpak_installation_list_installed_refs_for_update (self->installation,
-								     cancellable,
-								     error);
-	if (xrefs == NULL) {
-		gs_plugin_flatpak_error_convert (error);
+	xrefs = gs_flatpak_get_installed_refs_for_update (self, cancellable, error);
+	if (xrefs == NULL)
 		return FALSE;
-	}
 	for (guint i = 0; i < xrefs->len; i++) {
 		FlatpakInstalledRef *xref = g_ptr_array_index (xrefs, i);
 		guint64 download_size = 0;
@@ -1169,12 +1944,32 @@ gs_flatpak_progress_cb (const gchar *status,
 	gs_app_set_progress (app, progress);
 }
 
-gboolean
-gs_flatpak_refresh (GsFlatpak *self,
-		    guint cache_age,
-		    GsPluginRefreshFlags flags,
-		    GCancellable *cancellable,
-		    GError **error)
+/* sets the progress of both the app and the refresh as a whole */
+typedef struct {
+	GsApp			*app;
+	GsFlatpakProgress	*progress;
+	guint			 idx;
+} GsFlatpakRefreshPull;
+
+static void
+gs_flatpak_refresh_pull_progress_cb (const gchar *status,
+				     guint progress,
+				     gboolean estimating,
+				     gpointer user_data)
+{
+	GsFlatpakRefreshPull *pull = (GsFlatpakRefreshPull *) user_data;
+	if (pull->app != NULL)
+		gs_app_set_progress (pull->app, progress);
+	gs_flatpak_progress_set (pull->progress, pull->idx, progress);
+}
+
+static gboolean
+gs_flatpak_refresh_with_progress (GsFlatpak *self,
+				  guint cache_age,
+				  GsPluginRefreshFlags flags,
+				  GsFlatpakProgress *progress,
+				  GCancellable *cancellable,
+				  GError **error)
 {
 	guint i;
 	g_autoptr(GPtrArray) xrefs = NULL;
@@ -1189,10 +1984,16 @@ gs_flatpak_refresh (GsFlatpak *self,
 		gs_plugin_flatpak_error_convert (error);
 		return FALSE;
 	}
+	gs_flatpak_invalidate_installed_refs (self);
+	gs_flatpak_invalidate_remote_commits (self);
 
-	/* update AppStream metadata */
+	/* update AppStream metadata, which is half the work if the
+	 * updates are being downloaded too */
 	if (flags & GS_PLUGIN_REFRESH_FLAGS_METADATA) {
+		gs_flatpak_progress_set_range (progress, 0,
+					       flags & GS_PLUGIN_REFRESH_FLAGS_PAYLOAD ? 50 : 100);
 		if (!gs_flatpak_refresh_appstream (self, cache_age, flags,
+						   progress,
 						   cancellable, error))
 			return FALSE;
 	}
@@ -1202,21 +2003,24 @@ gs_flatpak_refresh (GsFlatpak *self,
 		return TRUE;
 
 	/* get all the updates available from all remotes */
-	xrefs = flatpak_installation_list_installed_refs_for_update (self->installation,
-								     cancellable,
-								     error);
-	if (xrefs == NULL) {
-		gs_plugin_flatpak_error_convert (error);
+	xrefs = gs_flatpak_get_installed_refs_for_update (self, cancellable, error);
+	if (xrefs == NULL)
 		return FALSE;
-	}
+	if (flags & GS_PLUGIN_REFRESH_FLAGS_METADATA)
+		gs_flatpak_progress_set_range (progress, 50, 50);
+	gs_flatpak_progress_start (progress, xrefs->len);
 	for (i = 0; i < xrefs->len; i++) {
 		FlatpakInstalledRef *xref = g_ptr_array_index (xrefs, i);
+		GsFlatpakRefreshPull pull;
 		g_autoptr(GsApp) app = NULL;
 		g_autoptr(FlatpakInstalledRef) xref2 = NULL;
 
 		/* try to create a GsApp so we can do progress reporting */
 		app = gs_flatpak_create_installed (self, xref,
 						   NULL);
+		pull.app = app;
+		pull.progress = progress;
+		pull.idx = i;
 
 		/* fetch but do not deploy */
 		g_debug ("pulling update for %s",
@@ -1227,17 +2031,42 @@ gs_flatpak_refresh (GsFlatpak *self,
 						     flatpak_ref_get_name (FLATPAK_REF (xref)),
 						     flatpak_ref_get_arch (FLATPAK_REF (xref)),
 						     flatpak_ref_get_branch (FLATPAK_REF (xref)),
-						     gs_flatpak_progress_cb, app,
+						     gs_flatpak_refresh_pull_progress_cb,
+						     &pull,
 						     cancellable, error);
 		if (xref2 == NULL) {
 			gs_plugin_flatpak_error_convert (error);
+			gs_flatpak_invalidate_installed_refs (self);
 			return FALSE;
 		}
+		gs_flatpak_progress_set (progress, i, 100);
 	}
 
+	/* the latest commits have changed */
+	gs_flatpak_invalidate_installed_refs (self);
 	return TRUE;
 }
 
+gboolean
+gs_flatpak_refresh (GsFlatpak *self,
+		    guint cache_age,
+		    GsPluginRefreshFlags flags,
+		    GsFlatpakProgressFunc progress_func,
+		    gpointer progress_data,
+		    GCancellable *cancellable,
+		    GError **error)
+{
+	GsFlatpakProgress progress;
+	gboolean ret;
+
+	gs_flatpak_progress_init (&progress, progress_func, progress_data);
+	ret = gs_flatpak_refresh_with_progress (self, cache_age, flags,
+						&progress,
+						cancellable, error);
+	gs_flatpak_progress_clear (&progress);
+	return ret;
+}
+
 static gboolean
 gs_plugin_refine_item_origin_ui (GsFlatpak *self, GsApp *app,
 				 GCancellable *cancellable,
@@ -1387,6 +2216,27 @@ gs_flatpak_refine_origin_from_installation (GsFlatpak *self,
 	guint i;
 	g_autoptr(GPtrArray) xremotes = NULL;
 
+	/* installed refs already know where they came from */
+	if (installation == self->installation) {
+		g_autoptr(FlatpakInstalledRef) xref = NULL;
+		if (!gs_flatpak_lookup_installed_ref (self,
+						      gs_app_get_flatpak_kind (app),
+						      gs_app_get_flatpak_name (app),
+						      gs_app_get_flatpak_arch (app),
+						      gs_app_get_flatpak_branch (app),
+						      &xref,
+						      cancellable,
+						      error))
+			return FALSE;
+		if (xref != NULL &&
+		    flatpak_installed_ref_get_origin (xref) != NULL) {
+			g_debug ("found installed origin %s",
+				 flatpak_installed_ref_get_origin (xref));
+			gs_app_set_origin (app, flatpak_installed_ref_get_origin (xref));
+			return TRUE;
+		}
+	}
+
 	xremotes = flatpak_installation_list_remotes (installation,
 						      cancellable,
 						      error);
@@ -1570,7 +2420,7 @@ gs_plugin_refine_item_state (GsFlatpak *self,
 			     GError **error)
 {
 	guint i;
-	g_autoptr(GPtrArray) xrefs = NULL;
+	g_autoptr(FlatpakInstalledRef) xref_installed = NULL;
 	g_autoptr(AsProfileTask) ptask = NULL;
 
 	/* already found */
@@ -1586,23 +2436,20 @@ gs_plugin_refine_item_state (GsFlatpak *self,
 				  "%s::refine-action",
 				  gs_flatpak_get_id (self));
 	g_assert (ptask != NULL);
-	xrefs = flatpak_installation_list_installed_refs (self->installation,
-							  cancellable, error);
-	if (xrefs == NULL) {
-		gs_plugin_flatpak_error_convert (error);
+	if (!gs_flatpak_lookup_installed_ref (self,
+					      gs_app_get_flatpak_kind (app),
+					      gs_app_get_flatpak_name (app),
+					      gs_app_get_flatpak_arch (app),
+					      gs_app_get_flatpak_branch (app),
+					      &xref_installed,
+					      cancellable,
+					      error))
 		return FALSE;
-	}
-	for (i = 0; i < xrefs->len; i++) {
-		FlatpakInstalledRef *xref = g_ptr_array_index (xrefs, i);
-
-		/* check xref is app */
-		if (!gs_flatpak_app_matches_xref (self, app, FLATPAK_REF(xref)))
-			continue;
-
+	if (xref_installed != NULL) {
 		/* mark as installed */
 		g_debug ("marking %s as installed with flatpak",
 			 gs_app_get_id (app));
-		gs_flatpak_set_metadata_installed (self, app, xref);
+		gs_flatpak_set_metadata_installed (self, app, xref_installed);
 		if (gs_app_get_state (app) == AS_APP_STATE_UNKNOWN)
 			gs_app_set_state (app, AS_APP_STATE_INSTALLED);
 	}
@@ -1778,12 +2625,221 @@ gs_flatpak_set_app_metadata (GsFlatpak *self,
 	return TRUE;
 }
 
+static gchar *
+gs_flatpak_remote_cache_get_filename (GsFlatpak *self, GError **error)
+{
+	g_autofree gchar *basename = NULL;
+	basename = g_strdup_printf ("remote-metadata-%s.ini", gs_flatpak_get_id (self));
+	return gs_utils_get_cache_filename ("flatpak",
+					    basename,
+					    GS_UTILS_CACHE_FLAG_WRITEABLE,
+					    error);
+}
+
+/* must be called with remote_cache_mutex held */
+static void
+gs_flatpak_remote_cache_ensure_loaded (GsFlatpak *self)
+{
+	g_autofree gchar *fn = NULL;
+	g_autoptr(GError) error = NULL;
+
+	if (self->remote_cache_loaded)
+		return;
+	self->remote_cache_loaded = TRUE;
+	fn = gs_flatpak_remote_cache_get_filename (self, &error);
+	if (fn == NULL) {
+		g_warning ("failed to get remote metadata cache: %s", error->message);
+		return;
+	}
+	if (!g_file_test (fn, G_FILE_TEST_EXISTS))
+		return;
+	if (!g_key_file_load_from_file (self->remote_cache, fn,
+					G_KEY_FILE_NONE, &error))
+		g_warning ("failed to load %s: %s", fn, error->message);
+}
+
+gboolean
+gs_flatpak_remote_cache_save (GsFlatpak *self, GError **error)
+{
+	gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+	g_autofree gchar *fn = NULL;
+	g_auto(GStrv) groups = NULL;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->remote_cache_mutex);
+
+	if (!self->remote_cache_changed)
+		return TRUE;
+
+	/* drop commits nobody has asked about for a long time */
+	groups = g_key_file_get_groups (self->remote_cache, NULL);
+	for (guint i = 0; groups[i] != NULL; i++) {
+		gint64 used = g_key_file_get_int64 (self->remote_cache,
+						    groups[i], "Used", NULL);
+		if (now - used > GS_FLATPAK_REMOTE_CACHE_AGE_MAX)
+			g_key_file_remove_group (self->remote_cache, groups[i], NULL);
+	}
+
+	fn = gs_flatpak_remote_cache_get_filename (self, error);
+	if (fn == NULL)
+		return FALSE;
+	if (!g_key_file_save_to_file (self->remote_cache, fn, &error_local)) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_WRITE_FAILED,
+			     "failed to save %s: %s",
+			     fn, error_local->message);
+		return FALSE;
+	}
+	self->remote_cache_changed = FALSE;
+	return TRUE;
+}
+
+/* gets the commits of all the refs in a remote with one summary fetch */
+static gboolean
+gs_flatpak_list_remote_commits (GsFlatpak *self,
+				const gchar *remote_name,
+				GCancellable *cancellable,
+				GError **error)
+{
+	g_autoptr(GPtrArray) xrefs = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	locker = g_mutex_locker_new (&self->remote_cache_mutex);
+	if (g_hash_table_contains (self->remote_commits_listed, remote_name))
+		return TRUE;
+	g_clear_pointer (&locker, g_mutex_locker_free);
+
+	xrefs = flatpak_installation_list_remote_refs_sync (self->installation,
+							    remote_name,
+							    cancellable,
+							    error);
+	if (xrefs == NULL) {
+		gs_plugin_flatpak_error_convert (error);
+		return FALSE;
+	}
+	locker = g_mutex_locker_new (&self->remote_cache_mutex);
+	for (guint i = 0; i < xrefs->len; i++) {
+		FlatpakRef *xref = g_ptr_array_index (xrefs, i);
+		g_autofree gchar *ref = flatpak_ref_format_ref (xref);
+		if (flatpak_ref_get_commit (xref) == NULL)
+			continue;
+		g_hash_table_insert (self->remote_commits,
+				     g_strdup_printf ("%s:%s", remote_name, ref),
+				     g_strdup (flatpak_ref_get_commit (xref)));
+	}
+	g_hash_table_add (self->remote_commits_listed, g_strdup (remote_name));
+	return TRUE;
+}
+
+/* returns the cache key for the current commit of a ref, or %NULL if
+ * the commit cannot be found, in which case nothing is cached */
+static gchar *
+gs_flatpak_get_remote_cache_key (GsFlatpak *self,
+				 const gchar *remote_name,
+				 FlatpakRef *xref,
+				 GCancellable *cancellable)
+{
+	const gchar *commit;
+	g_autofree gchar *ref = flatpak_ref_format_ref (xref);
+	g_autofree gchar *key = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	if (!gs_flatpak_list_remote_commits (self, remote_name, cancellable, &error)) {
+		g_debug ("failed to list refs in %s: %s", remote_name, error->message);
+		return NULL;
+	}
+	key = g_strdup_printf ("%s:%s", remote_name, ref);
+	locker = g_mutex_locker_new (&self->remote_cache_mutex);
+	commit = g_hash_table_lookup (self->remote_commits, key);
+	if (commit == NULL)
+		return NULL;
+	return g_strdup_printf ("%s@%s", key, commit);
+}
+
+/* must be called with remote_cache_mutex held; a hit does not make the
+ * cache need saving unless the entry was last used on a different day */
+static void
+gs_flatpak_remote_cache_set_used (GsFlatpak *self, const gchar *key)
+{
+	gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+	gint64 used = g_key_file_get_int64 (self->remote_cache, key, "Used", NULL);
+	if (now - used < GS_FLATPAK_REMOTE_CACHE_USED_FUZZ)
+		return;
+	g_key_file_set_int64 (self->remote_cache, key, "Used", now);
+	self->remote_cache_changed = TRUE;
+}
+
+/* returns a cached item, marking the entry as used */
+static gboolean
+gs_flatpak_remote_cache_lookup (GsFlatpak *self,
+				const gchar *key,
+				gchar **metadata,
+				guint64 *download_size,
+				guint64 *installed_size)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->remote_cache_mutex);
+
+	gs_flatpak_remote_cache_ensure_loaded (self);
+	if (metadata != NULL) {
+		*metadata = g_key_file_get_string (self->remote_cache, key,
+						   "Metadata", NULL);
+		if (*metadata == NULL)
+			return FALSE;
+	}
+	if (download_size != NULL && installed_size != NULL) {
+		if (!g_key_file_has_key (self->remote_cache, key, "DownloadSize", NULL))
+			return FALSE;
+		*download_size = g_key_file_get_uint64 (self->remote_cache, key,
+							"DownloadSize", NULL);
+		*installed_size = g_key_file_get_uint64 (self->remote_cache, key,
+							 "InstalledSize", NULL);
+	}
+	gs_flatpak_remote_cache_set_used (self, key);
+	return TRUE;
+}
+
+static void
+gs_flatpak_remote_cache_add_metadata (GsFlatpak *self,
+				      const gchar *key,
+				      GBytes *data)
+{
+	gsize len = 0;
+	const gchar *str = g_bytes_get_data (data, &len);
+	g_autofree gchar *tmp = g_strndup (str, len);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->remote_cache_mutex);
+
+	gs_flatpak_remote_cache_ensure_loaded (self);
+	g_key_file_set_string (self->remote_cache, key, "Metadata", tmp);
+	g_key_file_set_int64 (self->remote_cache, key, "Used",
+			      g_get_real_time () / G_USEC_PER_SEC);
+	self->remote_cache_changed = TRUE;
+}
+
+static void
+gs_flatpak_remote_cache_add_size (GsFlatpak *self,
+				  const gchar *key,
+				  guint64 download_size,
+				  guint64 installed_size)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->remote_cache_mutex);
+
+	gs_flatpak_remote_cache_ensure_loaded (self);
+	g_key_file_set_uint64 (self->remote_cache, key, "DownloadSize", download_size);
+	g_key_file_set_uint64 (self->remote_cache, key, "InstalledSize", installed_size);
+	g_key_file_set_int64 (self->remote_cache, key, "Used",
+			      g_get_real_time () / G_USEC_PER_SEC);
+	self->remote_cache_changed = TRUE;
+}
+
 static GBytes *
 gs_flatpak_fetch_remote_metadata (GsFlatpak *self,
 				  GsApp *app,
 				  GCancellable *cancellable,
 				  GError **error)
 {
+	g_autofree gchar *key = NULL;
+	g_autofree gchar *metadata = NULL;
 	g_autoptr(GBytes) data = NULL;
 	g_autoptr(FlatpakRef) xref = NULL;
 
@@ -1796,11 +2852,20 @@ gs_flatpak_fetch_remote_metadata (GsFlatpak *self,
 			     gs_app_get_unique_id (app));
 		return NULL;
 	}
-
-	/* fetch from the server */
 	xref = gs_flatpak_create_fake_ref (app, error);
 	if (xref == NULL)
 		return NULL;
+
+	/* already fetched for this commit */
+	key = gs_flatpak_get_remote_cache_key (self, gs_app_get_origin (app),
+					       xref, cancellable);
+	if (key != NULL &&
+	    gs_flatpak_remote_cache_lookup (self, key, &metadata, NULL, NULL)) {
+		gsize len = strlen (metadata);
+		return g_bytes_new_take (g_steal_pointer (&metadata), len);
+	}
+
+	/* fetch from the server */
 	data = flatpak_installation_fetch_remote_metadata_sync (self->installation,
 								gs_app_get_origin (app),
 								xref,
@@ -1810,6 +2875,8 @@ gs_flatpak_fetch_remote_metadata (GsFlatpak *self,
 		gs_plugin_flatpak_error_convert (error);
 		return NULL;
 	}
+	if (key != NULL)
+		gs_flatpak_remote_cache_add_metadata (self, key, data);
 	return g_steal_pointer (&data);
 }
 
@@ -1880,7 +2947,20 @@ gs_flatpak_get_installed_ref (GsFlatpak *self,
 			      GCancellable *cancellable,
 			      GError **error)
 {
-	FlatpakInstalledRef *ref;
+	FlatpakInstalledRef *ref = NULL;
+
+	/* try the snapshot first */
+	if (!gs_flatpak_lookup_installed_ref (self,
+					      gs_app_get_flatpak_kind (app),
+					      gs_app_get_flatpak_name (app),
+					      gs_app_get_flatpak_arch (app),
+					      gs_app_get_flatpak_branch (app),
+					      &ref,
+					      cancellable,
+					      error))
+		return NULL;
+	if (ref != NULL)
+		return ref;
 	ref = flatpak_installation_get_installed_ref (self->installation,
 						      gs_app_get_flatpak_kind (app),
 						      gs_app_get_flatpak_name (app),
@@ -1969,6 +3049,7 @@ gs_plugin_refine_item_size (GsFlatpak *self,
 		if (installed_size == 0)
 			installed_size = GS_APP_SIZE_UNKNOWABLE;
 	} else {
+		g_autofree gchar *key = NULL;
 		g_autoptr(FlatpakRef) xref = NULL;
 		g_autoptr(GError) error_local = NULL;
 
@@ -1984,17 +3065,32 @@ gs_plugin_refine_item_size (GsFlatpak *self,
 		xref = gs_flatpak_create_fake_ref (app, error);
 		if (xref == NULL)
 			return FALSE;
-		ret = flatpak_installation_fetch_remote_size_sync (self->installation,
-								   gs_app_get_origin (app),
-								   xref,
-								   &download_size,
-								   &installed_size,
-								   cancellable,
-								   &error_local);
 
-		if (!ret) {
-			g_warning ("libflatpak failed to return application "
-				   "size: %s", error_local->message);
+		/* already fetched for this commit */
+		key = gs_flatpak_get_remote_cache_key (self,
+						       gs_app_get_origin (app),
+						       xref, cancellable);
+		if (key != NULL &&
+		    gs_flatpak_remote_cache_lookup (self, key, NULL,
+						    &download_size,
+						    &installed_size)) {
+			g_debug ("got size of %s from cache", key);
+		} else {
+			ret = flatpak_installation_fetch_remote_size_sync (self->installation,
+									   gs_app_get_origin (app),
+									   xref,
+									   &download_size,
+									   &installed_size,
+									   cancellable,
+									   &error_local);
+			if (!ret) {
+				g_warning ("libflatpak failed to return application "
+					   "size: %s", error_local->message);
+			} else if (key != NULL) {
+				gs_flatpak_remote_cache_add_size (self, key,
+								  download_size,
+								  installed_size);
+			}
 		}
 	}
 
@@ -2004,6 +3100,242 @@ gs_plugin_refine_item_size (GsFlatpak *self,
 	return TRUE;
 }
 
+typedef struct {
+	gchar			*remote_name;
+	gchar			*key;
+	FlatpakRef		*xref;
+	gboolean		 need_metadata;
+	gboolean		 need_size;
+} GsFlatpakPrefetchJob;
+
+static void
+gs_flatpak_prefetch_job_free (GsFlatpakPrefetchJob *job)
+{
+	g_free (job->remote_name);
+	g_free (job->key);
+	g_object_unref (job->xref);
+	g_free (job);
+}
+
+/* adds a job for anything about the ref that is not already cached */
+static void
+gs_flatpak_prefetch_add_job (GsFlatpak *self,
+			     GPtrArray *jobs,
+			     GHashTable *keys,
+			     const gchar *remote_name,
+			     FlatpakRef *xref,
+			     gboolean need_metadata,
+			     GCancellable *cancellable)
+{
+	GsFlatpakPrefetchJob *job;
+	g_autofree gchar *key = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	key = gs_flatpak_get_remote_cache_key (self, remote_name, xref, cancellable);
+	if (key == NULL || g_hash_table_contains (keys, key))
+		return;
+	job = g_new0 (GsFlatpakPrefetchJob, 1);
+	locker = g_mutex_locker_new (&self->remote_cache_mutex);
+	gs_flatpak_remote_cache_ensure_loaded (self);
+	job->need_metadata = need_metadata &&
+		!g_key_file_has_key (self->remote_cache, key, "Metadata", NULL);
+	job->need_size =
+		!g_key_file_has_key (self->remote_cache, key, "DownloadSize", NULL);
+	g_clear_pointer (&locker, g_mutex_locker_free);
+	job->remote_name = g_strdup (remote_name);
+	job->key = g_steal_pointer (&key);
+	job->xref = g_object_ref (xref);
+	g_hash_table_add (keys, g_strdup (job->key));
+	if (!job->need_metadata && !job->need_size) {
+		gs_flatpak_prefetch_job_free (job);
+		return;
+	}
+	g_ptr_array_add (jobs, job);
+}
+
+/* the per-app refine will try again and report errors */
+static void
+gs_flatpak_prefetch_job_cb (GsFlatpak *self,
+			    FlatpakInstallation *installation,
+			    gpointer user_data,
+			    GCancellable *cancellable)
+{
+	GsFlatpakPrefetchJob *job = (GsFlatpakPrefetchJob *) user_data;
+	g_autoptr(GError) error_local = NULL;
+
+	if (job->need_metadata) {
+		g_autoptr(GBytes) data = NULL;
+		data = flatpak_installation_fetch_remote_metadata_sync (installation,
+									job->remote_name,
+									job->xref,
+									cancellable,
+									&error_local);
+		if (data == NULL) {
+			g_debug ("failed to prefetch metadata for %s: %s",
+				 job->key, error_local->message);
+			return;
+		}
+		gs_flatpak_remote_cache_add_metadata (self, job->key, data);
+	}
+	if (job->need_size) {
+		guint64 download_size = 0;
+		guint64 installed_size = 0;
+		if (!flatpak_installation_fetch_remote_size_sync (installation,
+								  job->remote_name,
+								  job->xref,
+								  &download_size,
+								  &installed_size,
+								  cancellable,
+								  &error_local)) {
+			g_debug ("failed to prefetch size for %s: %s",
+				 job->key, error_local->message);
+			return;
+		}
+		gs_flatpak_remote_cache_add_size (self, job->key,
+						  download_size,
+						  installed_size);
+	}
+}
+
+/* gets the runtime ref from cached app metadata, e.g.
+ * runtime/org.gnome.Platform/x86_64/3.24 */
+static FlatpakRef *
+gs_flatpak_prefetch_get_runtime_ref (GsFlatpak *self, const gchar *key)
+{
+	g_autofree gchar *metadata = NULL;
+	g_autofree gchar *runtime = NULL;
+	g_autofree gchar *ref = NULL;
+	g_autoptr(GKeyFile) kf = g_key_file_new ();
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	locker = g_mutex_locker_new (&self->remote_cache_mutex);
+	metadata = g_key_file_get_string (self->remote_cache, key, "Metadata", NULL);
+	g_clear_pointer (&locker, g_mutex_locker_free);
+	if (metadata == NULL)
+		return NULL;
+	if (!g_key_file_load_from_data (kf, metadata, -1, G_KEY_FILE_NONE, NULL))
+		return NULL;
+	runtime = g_key_file_get_string (kf, "Application", "runtime", NULL);
+	if (runtime == NULL)
+		return NULL;
+	ref = g_strdup_printf ("runtime/%s", runtime);
+	return flatpak_ref_parse (ref, NULL);
+}
+
+/* fetches the remote metadata and sizes for the apps in @list and the
+ * runtimes they need, so that gs_flatpak_refine_app() finds everything in
+ * the cache -- failures are not fatal as the refine will try again */
+gboolean
+gs_flatpak_prefetch_remote_metadata (GsFlatpak *self,
+				     GsAppList *list,
+				     GCancellable *cancellable,
+				     GError **error)
+{
+	g_autoptr(AsProfileTask) ptask = NULL;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GError) error_save = NULL;
+	g_autoptr(GHashTable) keys = NULL;
+	g_autoptr(GPtrArray) jobs = NULL;
+	g_autoptr(GPtrArray) jobs_runtime = NULL;
+
+	/* profile */
+	ptask = as_profile_start (gs_plugin_get_profile (self->plugin),
+				  "%s::prefetch-remote-metadata",
+				  gs_flatpak_get_id (self));
+	g_assert (ptask != NULL);
+
+	/* the apps themselves */
+	keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	jobs = g_ptr_array_new_with_free_func ((GDestroyNotify) gs_flatpak_prefetch_job_free);
+	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+		g_autoptr(FlatpakRef) xref = NULL;
+		g_autoptr(GError) error_app = NULL;
+
+		if (gs_app_get_kind (app) == AS_APP_KIND_SOURCE)
+			continue;
+		if (gs_app_is_installed (app))
+			continue;
+		if (gs_app_get_state (app) == AS_APP_STATE_AVAILABLE_LOCAL)
+			continue;
+		if (gs_app_get_origin (app) == NULL)
+			continue;
+		if (!gs_refine_item_metadata (self, app, cancellable, &error_app)) {
+			g_debug ("not prefetching %s: %s",
+				 gs_app_get_unique_id (app), error_app->message);
+			continue;
+		}
+		if (gs_app_get_flatpak_name (app) == NULL)
+			continue;
+		xref = gs_flatpak_create_fake_ref (app, &error_app);
+		if (xref == NULL) {
+			g_debug ("not prefetching %s: %s",
+				 gs_app_get_unique_id (app), error_app->message);
+			continue;
+		}
+		gs_flatpak_prefetch_add_job (self, jobs, keys,
+					     gs_app_get_origin (app), xref,
+					     gs_app_get_flatpak_kind (app) == FLATPAK_REF_KIND_APP,
+					     cancellable);
+	}
+	gs_flatpak_run_parallel (self, jobs, FALSE,
+				 gs_flatpak_prefetch_job_cb, cancellable);
+
+	/* the runtimes the apps need, which is only known from the metadata */
+	jobs_runtime = g_ptr_array_new_with_free_func ((GDestroyNotify) gs_flatpak_prefetch_job_free);
+	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+		FlatpakInstalledRef *xref_installed = NULL;
+		g_autofree gchar *key = NULL;
+		g_autoptr(FlatpakRef) xref = NULL;
+		g_autoptr(FlatpakRef) xref_runtime = NULL;
+
+		if (gs_app_is_installed (app) ||
+		    gs_app_get_origin (app) == NULL ||
+		    gs_app_get_flatpak_kind (app) != FLATPAK_REF_KIND_APP ||
+		    gs_app_get_flatpak_name (app) == NULL)
+			continue;
+		xref = gs_flatpak_create_fake_ref (app, NULL);
+		if (xref == NULL)
+			continue;
+		key = gs_flatpak_get_remote_cache_key (self, gs_app_get_origin (app),
+						       xref, cancellable);
+		if (key == NULL)
+			continue;
+		xref_runtime = gs_flatpak_prefetch_get_runtime_ref (self, key);
+		if (xref_runtime == NULL)
+			continue;
+
+		/* no size is needed for installed runtimes */
+		if (!gs_flatpak_lookup_installed_ref (self,
+						      FLATPAK_REF_KIND_RUNTIME,
+						      flatpak_ref_get_name (xref_runtime),
+						      flatpak_ref_get_arch (xref_runtime),
+						      flatpak_ref_get_branch (xref_runtime),
+						      &xref_installed,
+						      cancellable,
+						      &error_local)) {
+			g_debug ("failed to get installed refs: %s",
+				 error_local->message);
+			break;
+		}
+		if (xref_installed != NULL) {
+			g_object_unref (xref_installed);
+			continue;
+		}
+		gs_flatpak_prefetch_add_job (self, jobs_runtime, keys,
+					     gs_app_get_origin (app), xref_runtime,
+					     FALSE, cancellable);
+	}
+	gs_flatpak_run_parallel (self, jobs_runtime, FALSE,
+				 gs_flatpak_prefetch_job_cb, cancellable);
+
+	/* write once for the whole list */
+	if (!gs_flatpak_remote_cache_save (self, &error_save))
+		g_warning ("%s", error_save->message);
+	return TRUE;
+}
+
 static void
 gs_flatpak_refine_appstream_release (AsApp *item, GsApp *app)
 {
@@ -2316,6 +3648,7 @@ gs_flatpak_app_remove (GsFlatpak *self,
 		gs_app_set_state_recover (app);
 		return FALSE;
 	}
+	gs_flatpak_invalidate_installed_refs (self);
 
 	/* did app also install a noenumerate=True remote */
 	remote_name = g_strdup_printf ("%s-origin", gs_app_get_flatpak_name (app));
@@ -2428,6 +3761,7 @@ install_runtime_for_app (GsFlatpak *self,
 			gs_app_set_state_recover (runtime);
 			return FALSE;
 		}
+		gs_flatpak_invalidate_installed_refs (self);
 		gs_app_set_state (runtime, AS_APP_STATE_INSTALLED);
 	} else {
 		g_debug ("%s is already installed, so skipping",
@@ -2695,7 +4029,7 @@ gs_flatpak_app_install (GsFlatpak *self,
 		}
 
 		/* update search tokens for new remote */
-		if (!gs_flatpak_refresh_appstream (self, G_MAXUINT, 0, cancellable, error))
+		if (!gs_flatpak_refresh_appstream (self, G_MAXUINT, 0, NULL, cancellable, error))
 			return FALSE;
 	}
 
@@ -2746,6 +4080,7 @@ gs_flatpak_app_install (GsFlatpak *self,
 		gs_app_set_state_recover (app);
 		return FALSE;
 	}
+	gs_flatpak_invalidate_installed_refs (self);
 
 	/* state is known */
 	gs_app_set_state (app, AS_APP_STATE_INSTALLED);
@@ -2757,13 +4092,155 @@ gs_flatpak_app_install (GsFlatpak *self,
 	return TRUE;
 }
 
+/* a remote and the jobs that pull from it */
+typedef struct {
+	gchar			*remote_name;
+	GPtrArray		*jobs;		/* of GsFlatpakUpdateJob, not owned */
+} GsFlatpakUpdateRemote;
+
+static void
+gs_flatpak_update_remote_free (GsFlatpakUpdateRemote *remote)
+{
+	g_free (remote->remote_name);
+	g_ptr_array_unref (remote->jobs);
+	g_free (remote);
+}
+
+static void
+gs_flatpak_update_progress_cb (const gchar *status,
+			       guint progress,
+			       gboolean estimating,
+			       gpointer user_data)
+{
+	GsFlatpakUpdateJob *job = (GsFlatpakUpdateJob *) user_data;
+	for (guint i = 0; i < job->apps->len; i++)
+		gs_app_set_progress (g_ptr_array_index (job->apps, i), progress);
+}
+
+static gboolean
+gs_flatpak_update_job_pull (FlatpakInstallation *installation,
+			    GsFlatpakUpdateJob *job,
+			    GCancellable *cancellable)
+{
+	g_autoptr(FlatpakInstalledRef) xref = NULL;
+
+	g_debug ("pulling update for %s from %s", job->name, job->remote_name);
+	xref = flatpak_installation_update (installation,
+					    FLATPAK_UPDATE_FLAGS_NO_DEPLOY,
+					    job->kind,
+					    job->name,
+					    job->arch,
+					    job->branch,
+					    gs_flatpak_update_progress_cb, job,
+					    cancellable, &job->error);
+	if (xref == NULL) {
+		gs_plugin_flatpak_error_convert (&job->error);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* each worker takes a whole remote, keeping the order of its refs */
+static void
+gs_flatpak_update_remote_cb (GsFlatpak *self,
+			     FlatpakInstallation *installation,
+			     gpointer user_data,
+			     GCancellable *cancellable)
+{
+	GsFlatpakUpdateRemote *remote = (GsFlatpakUpdateRemote *) user_data;
+	for (guint i = 0; i < remote->jobs->len; i++) {
+		GsFlatpakUpdateJob *job = g_ptr_array_index (remote->jobs, i);
+		gs_flatpak_update_job_pull (installation, job, cancellable);
+	}
+}
+
+/* pulls everything that is needed, with the remotes done concurrently */
+static void
+gs_flatpak_update_pull (GsFlatpak *self,
+			GPtrArray *jobs,
+			GCancellable *cancellable)
+{
+	g_autoptr(GHashTable) remotes_hash = NULL;
+	g_autoptr(GPtrArray) remotes = NULL;
+
+	/* group by remote, keeping the dependency order in each */
+	remotes = g_ptr_array_new_with_free_func ((GDestroyNotify) gs_flatpak_update_remote_free);
+	remotes_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	for (guint i = 0; i < jobs->len; i++) {
+		GsFlatpakUpdateJob *job = g_ptr_array_index (jobs, i);
+		GsFlatpakUpdateRemote *remote;
+		remote = g_hash_table_lookup (remotes_hash, job->remote_name);
+		if (remote == NULL) {
+			remote = g_new0 (GsFlatpakUpdateRemote, 1);
+			remote->remote_name = g_strdup (job->remote_name);
+			remote->jobs = g_ptr_array_new ();
+			g_hash_table_insert (remotes_hash, remote->remote_name, remote);
+			g_ptr_array_add (remotes, remote);
+		}
+		g_ptr_array_add (remote->jobs, job);
+	}
+	gs_flatpak_run_parallel (self, remotes, TRUE,
+				 gs_flatpak_update_remote_cb, cancellable);
+}
+
+gboolean
+gs_flatpak_prefetch_updates (GsFlatpak *self,
+			     GsAppList *list,
+			     GCancellable *cancellable,
+			     GError **error)
+{
+	g_autoptr(AsProfileTask) ptask = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
+	g_autoptr(GPtrArray) jobs = NULL;
+
+	/* profile */
+	ptask = as_profile_start (gs_plugin_get_profile (self->plugin),
+				  "%s::prefetch-updates",
+				  gs_flatpak_get_id (self));
+	g_assert (ptask != NULL);
+
+	/* download everything now, so each app only has to be deployed */
+	jobs = gs_flatpak_update_jobs_new (list);
+	if (jobs->len == 0)
+		return TRUE;
+	gs_flatpak_update_pull (self, jobs, cancellable);
+	if (g_cancellable_set_error_if_cancelled (cancellable, error)) {
+		gs_utils_error_convert_gio (error);
+		return FALSE;
+	}
+
+	/* failures are reported for each app when it is updated */
+	locker = g_mutex_locker_new (&self->updates_pulled_mutex);
+	for (guint i = 0; i < jobs->len; i++) {
+		GsFlatpakUpdateJob *job = g_ptr_array_index (jobs, i);
+		if (job->error != NULL) {
+			g_debug ("failed to pull %s, trying again when "
+				 "updating: %s", job->ref, job->error->message);
+			continue;
+		}
+		g_hash_table_add (self->updates_pulled, g_strdup (job->ref));
+	}
+	return TRUE;
+}
+
+/* returns TRUE if the ref was pulled by gs_flatpak_prefetch_updates() */
+static gboolean
+gs_flatpak_steal_update_pulled (GsFlatpak *self, const gchar *ref)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->updates_pulled_mutex);
+	return g_hash_table_remove (self->updates_pulled, ref);
+}
+
 gboolean
 gs_flatpak_update_app (GsFlatpak *self,
 		       GsApp *app,
 		       GCancellable *cancellable,
 		       GError **error)
 {
+	FlatpakUpdateFlags flags = FLATPAK_UPDATE_FLAGS_NONE;
+	g_autofree gchar *ref = NULL;
 	g_autoptr(FlatpakInstalledRef) xref = NULL;
+	g_autoptr(GError) error_local = NULL;
 
 	/* install */
 	gs_app_set_state (app, AS_APP_STATE_INSTALLING);
@@ -2775,19 +4252,44 @@ gs_flatpak_update_app (GsFlatpak *self,
 		return FALSE;
 	}
 
+	/* already downloaded */
+	ref = gs_flatpak_build_ref_key (gs_app_get_flatpak_kind (app),
+					gs_app_get_flatpak_name (app),
+					gs_app_get_flatpak_arch (app),
+					gs_app_get_flatpak_branch (app));
+	if (gs_flatpak_steal_update_pulled (self, ref))
+		flags = FLATPAK_UPDATE_FLAGS_NO_PULL;
 	xref = flatpak_installation_update (self->installation,
-					    FLATPAK_UPDATE_FLAGS_NONE,
+					    flags,
 					    gs_app_get_flatpak_kind (app),
 					    gs_app_get_flatpak_name (app),
 					    gs_app_get_flatpak_arch (app),
 					    gs_app_get_flatpak_branch (app),
 					    gs_flatpak_progress_cb, app,
-					    cancellable, error);
+					    cancellable, &error_local);
+
+	/* the pulled commit may have gone, so try again from the remote */
+	if (xref == NULL && flags == FLATPAK_UPDATE_FLAGS_NO_PULL &&
+	    !g_error_matches (error_local, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_debug ("failed to deploy %s, pulling again: %s",
+			 ref, error_local->message);
+		g_clear_error (&error_local);
+		xref = flatpak_installation_update (self->installation,
+						    FLATPAK_UPDATE_FLAGS_NONE,
+						    gs_app_get_flatpak_kind (app),
+						    gs_app_get_flatpak_name (app),
+						    gs_app_get_flatpak_arch (app),
+						    gs_app_get_flatpak_branch (app),
+						    gs_flatpak_progress_cb, app,
+						    cancellable, &error_local);
+	}
 	if (xref == NULL) {
+		g_propagate_error (error, g_steal_pointer (&error_local));
 		gs_plugin_flatpak_error_convert (error);
 		gs_app_set_state_recover (app);
 		return FALSE;
 	}
+	gs_flatpak_invalidate_installed_refs (self);
 
 	/* update UI */
 	gs_plugin_updates_changed (self->plugin);
@@ -3145,7 +4647,8 @@ gs_flatpak_file_to_app_ref (GsFlatpak *self,
 	gs_app_set_origin_ui (app, origin_title);
 
 	/* get the new appstream data (nonfatal for failure) */
-	if (!gs_flatpak_refresh_appstream_remote (self, remote_name,
+	if (!gs_flatpak_refresh_appstream_remote (self, self->installation,
+						  remote_name,
 						  cancellable, &error_local)) {
 		g_autoptr(GsPluginEvent) event = gs_plugin_event_new ();
 		gs_plugin_flatpak_error_convert (&error_local);
@@ -3335,6 +4838,21 @@ gs_flatpak_finalize (GObject *object)
 	g_object_unref (self->plugin);
 	g_object_unref (self->store);
 	g_hash_table_unref (self->broken_remotes);
+	if (self->installed_refs != NULL)
+		g_ptr_array_unref (self->installed_refs);
+	if (self->installed_refs_index != NULL)
+		g_hash_table_unref (self->installed_refs_index);
+	if (self->installed_refs_for_update != NULL)
+		g_ptr_array_unref (self->installed_refs_for_update);
+	g_mutex_clear (&self->installed_refs_mutex);
+	g_key_file_unref (self->remote_cache);
+	g_hash_table_unref (self->remote_commits);
+	g_hash_table_unref (self->remote_commits_listed);
+	g_mutex_clear (&self->remote_cache_mutex);
+	g_hash_table_unref (self->desktop_files);
+	g_mutex_clear (&self->desktop_files_mutex);
+	g_hash_table_unref (self->updates_pulled);
+	g_mutex_clear (&self->updates_pulled_mutex);
 
 	G_OBJECT_CLASS (gs_flatpak_parent_class)->finalize (object);
 }
@@ -3351,6 +4869,19 @@ gs_flatpak_init (GsFlatpak *self)
 {
 	self->broken_remotes = g_hash_table_new_full (g_str_hash, g_str_equal,
 						      g_free, NULL);
+	g_mutex_init (&self->installed_refs_mutex);
+	g_mutex_init (&self->remote_cache_mutex);
+	g_mutex_init (&self->desktop_files_mutex);
+	self->desktop_files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+						     (GDestroyNotify) gs_flatpak_desktop_file_free);
+	g_mutex_init (&self->updates_pulled_mutex);
+	self->updates_pulled = g_hash_table_new_full (g_str_hash, g_str_equal,
+						      g_free, NULL);
+	self->remote_cache = g_key_file_new ();
+	self->remote_commits = g_hash_table_new_full (g_str_hash, g_str_equal,
+						      g_free, g_free);
+	self->remote_commits_listed = g_hash_table_new_full (g_str_hash, g_str_equal,
+							     g_free, NULL);
 	self->store = as_store_new ();
 	g_signal_connect (self->store, "app-added",
 			  G_CALLBACK (gs_flatpak_store_app_added_cb),
@@ -3366,6 +4897,9 @@ gs_flatpak_init (GsFlatpak *self)
 				   AS_APP_SEARCH_MATCH_COMMENT |
 				   AS_APP_SEARCH_MATCH_NAME |
 				   AS_APP_SEARCH_MATCH_KEYWORD |
+#if AS_CHECK_VERSION(0,6,13)
+				   AS_APP_SEARCH_MATCH_ORIGIN |
+#endif
 				   AS_APP_SEARCH_MATCH_ID);
 }
 
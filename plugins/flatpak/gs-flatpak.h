@@ -46,6 +46,15 @@ G_DECLARE_FINAL_TYPE (GsFlatpak, gs_flatpak, GS, FLATPAK, GObject)
 #define	gs_app_set_flatpak_file_type(app,val)	gs_app_set_metadata(app,"flatpak::file-type",val)
 #define	gs_app_set_flatpak_object_id(app,val)	gs_app_set_metadata(app,"flatpak::object-id",val)
 
+/* remotes and installations are independent, so do a few at once */
+#define GS_FLATPAK_POOL_MAX_WORKERS		4
+
+typedef void	(*GsFlatpakPoolFunc)		(gpointer		 job,
+						 guint			 worker,
+						 gpointer		 user_data);
+typedef void	(*GsFlatpakProgressFunc)	(guint			 percentage,
+						 gpointer		 user_data);
+
 typedef enum {
 	GS_FLATPAK_FLAG_NONE			= 0,
 	GS_FLATPAK_FLAG_IS_TEMPORARY		= 1 << 0,
@@ -53,6 +62,9 @@ typedef enum {
 	GS_FLATPAK_FLAG_LAST
 } GsFlatpakFlags;
 
+void		gs_flatpak_run_pool		(GPtrArray		*jobs,
+						 GsFlatpakPoolFunc	 func,
+						 gpointer		 user_data);
 GsFlatpak	*gs_flatpak_new			(GsPlugin		*plugin,
 						 FlatpakInstallation	*installation);
 void		gs_flatpak_set_flags		(GsFlatpak		*self,
@@ -82,6 +94,14 @@ gboolean	gs_flatpak_add_updates_pending	(GsFlatpak		*self,
 gboolean	gs_flatpak_refresh		(GsFlatpak		*self,
 						 guint			cache_age,
 						 GsPluginRefreshFlags	flags,
+						 GsFlatpakProgressFunc	progress_func,
+						 gpointer		progress_data,
+						 GCancellable		*cancellable,
+						 GError			**error);
+gboolean	gs_flatpak_remote_cache_save	(GsFlatpak		*self,
+						 GError			**error);
+gboolean	gs_flatpak_prefetch_remote_metadata (GsFlatpak	*self,
+						 GsAppList		*list,
 						 GCancellable		*cancellable,
 						 GError			**error);
 gboolean	gs_flatpak_refine_app		(GsFlatpak		*self,
@@ -107,6 +127,10 @@ gboolean	gs_flatpak_app_install		(GsFlatpak		*self,
 						 GsApp			*app,
 						 GCancellable		*cancellable,
 						 GError			**error);
+gboolean	gs_flatpak_prefetch_updates	(GsFlatpak		*self,
+						 GsAppList		*list,
+						 GCancellable		*cancellable,
+						 GError			**error);
 gboolean	gs_flatpak_update_app		(GsFlatpak		*self,
 						 GsApp			*app,
 						 GCancellable		*cancellable,
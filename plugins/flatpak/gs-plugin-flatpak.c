@@ -29,6 +29,7 @@
 
 #include <config.h>
 
+#include <string.h>
 #include <flatpak.h>
 #include <gnome-software.h>
 
@@ -88,10 +89,24 @@ _as_app_scope_is_compatible (AsAppScope scope1, AsAppScope scope2)
 	return scope1 == scope2;
 }
 
+/* writes anything the per-app refine fetched since the last save */
+static void
+gs_plugin_flatpak_remote_cache_save (GsPlugin *plugin)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	for (guint i = 0; i < priv->flatpaks->len; i++) {
+		GsFlatpak *flatpak = g_ptr_array_index (priv->flatpaks, i);
+		g_autoptr(GError) error_local = NULL;
+		if (!gs_flatpak_remote_cache_save (flatpak, &error_local))
+			g_warning ("%s", error_local->message);
+	}
+}
+
 void
 gs_plugin_destroy (GsPlugin *plugin)
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
+	gs_plugin_flatpak_remote_cache_save (plugin);
 	g_ptr_array_unref (priv->flatpaks);
 }
 
@@ -222,38 +237,144 @@ gs_plugin_setup (GsPlugin *plugin, GCancellable *cancellable, GError **error)
 	return TRUE;
 }
 
-gboolean
-gs_plugin_add_installed (GsPlugin *plugin,
-			 GsAppList *list,
-			 GCancellable *cancellable,
-			 GError **error)
+typedef gboolean (*GsPluginFlatpakFunc)	(GsFlatpak		*flatpak,
+					 GsAppList		*list,
+					 gpointer		 user_data,
+					 GCancellable		*cancellable,
+					 GError			**error);
+
+typedef struct {
+	GsFlatpak		*flatpak;
+	GsAppList		*list;
+	GError			*error;
+} GsPluginFlatpakJob;
+
+static void
+gs_plugin_flatpak_job_free (GsPluginFlatpakJob *job)
+{
+	g_object_unref (job->flatpak);
+	g_object_unref (job->list);
+	g_clear_error (&job->error);
+	g_free (job);
+}
+
+typedef struct {
+	GsPluginFlatpakFunc	 func;
+	gpointer		 user_data;
+	GCancellable		*cancellable;
+} GsPluginFlatpakPool;
+
+static void
+gs_plugin_flatpak_pool_cb (gpointer user_data, guint worker, gpointer pool_data)
+{
+	GsPluginFlatpakJob *job = (GsPluginFlatpakJob *) user_data;
+	GsPluginFlatpakPool *pool = (GsPluginFlatpakPool *) pool_data;
+
+	if (g_cancellable_set_error_if_cancelled (pool->cancellable, &job->error)) {
+		gs_utils_error_convert_gio (&job->error);
+		return;
+	}
+	pool->func (job->flatpak, job->list, pool->user_data,
+		    pool->cancellable, &job->error);
+}
+
+/* runs @func for every installation at the same time; the results are added
+ * to @list in installation order whatever order the workers finished in */
+static gboolean
+gs_plugin_flatpak_run_parallel (GsPlugin *plugin,
+				GsAppList *list,
+				GsPluginFlatpakFunc func,
+				gpointer user_data,
+				GCancellable *cancellable,
+				GError **error)
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
+	GsPluginFlatpakPool pool;
+	g_autoptr(GPtrArray) jobs = NULL;
+
+	jobs = g_ptr_array_new_with_free_func ((GDestroyNotify) gs_plugin_flatpak_job_free);
 	for (guint i = 0; i < priv->flatpaks->len; i++) {
 		GsFlatpak *flatpak = g_ptr_array_index (priv->flatpaks, i);
+		GsPluginFlatpakJob *job;
 		if (gs_flatpak_get_flags (flatpak) & GS_FLATPAK_FLAG_IS_TEMPORARY)
 			continue;
-		if (!gs_flatpak_add_installed (flatpak, list, cancellable, error))
+		job = g_new0 (GsPluginFlatpakJob, 1);
+		job->flatpak = g_object_ref (flatpak);
+		job->list = gs_app_list_new ();
+		g_ptr_array_add (jobs, job);
+	}
+
+	pool.func = func;
+	pool.user_data = user_data;
+	pool.cancellable = cancellable;
+	gs_flatpak_run_pool (jobs, gs_plugin_flatpak_pool_cb, &pool);
+
+	/* merge everything that succeeded before reporting any failure */
+	for (guint i = 0; i < jobs->len; i++) {
+		GsPluginFlatpakJob *job = g_ptr_array_index (jobs, i);
+		if (list != NULL && job->error == NULL)
+			gs_app_list_add_list (list, job->list);
+	}
+	for (guint i = 0; i < jobs->len; i++) {
+		GsPluginFlatpakJob *job = g_ptr_array_index (jobs, i);
+		if (job->error != NULL) {
+			g_propagate_error (error, g_steal_pointer (&job->error));
 			return FALSE;
+		}
 	}
 	return TRUE;
 }
 
+static gboolean
+gs_plugin_flatpak_add_installed_cb (GsFlatpak *flatpak,
+				    GsAppList *list,
+				    gpointer user_data,
+				    GCancellable *cancellable,
+				    GError **error)
+{
+	return gs_flatpak_add_installed (flatpak, list, cancellable, error);
+}
+
+gboolean
+gs_plugin_add_installed (GsPlugin *plugin,
+			 GsAppList *list,
+			 GCancellable *cancellable,
+			 GError **error)
+{
+	return gs_plugin_flatpak_run_parallel (plugin, list,
+					       gs_plugin_flatpak_add_installed_cb,
+					       NULL, cancellable, error);
+}
+
+static gboolean
+gs_plugin_flatpak_add_sources_cb (GsFlatpak *flatpak,
+				  GsAppList *list,
+				  gpointer user_data,
+				  GCancellable *cancellable,
+				  GError **error)
+{
+	return gs_flatpak_add_sources (flatpak, list, cancellable, error);
+}
+
 gboolean
 gs_plugin_add_sources (GsPlugin *plugin,
 		       GsAppList *list,
 		       GCancellable *cancellable,
 		       GError **error)
 {
-	GsPluginData *priv = gs_plugin_get_data (plugin);
-	for (guint i = 0; i < priv->flatpaks->len; i++) {
-		GsFlatpak *flatpak = g_ptr_array_index (priv->flatpaks, i);
-		if (gs_flatpak_get_flags (flatpak) & GS_FLATPAK_FLAG_IS_TEMPORARY)
-			continue;
-		if (!gs_flatpak_add_sources (flatpak, list, cancellable, error))
-			return FALSE;
-	}
-	return TRUE;
+	return gs_plugin_flatpak_run_parallel (plugin, list,
+					       gs_plugin_flatpak_add_sources_cb,
+					       NULL, cancellable, error);
+}
+
+static gboolean
+gs_plugin_flatpak_add_updates_cb (GsFlatpak *flatpak,
+				  GsAppList *list,
+				  gpointer user_data,
+				  GCancellable *cancellable,
+				  GError **error)
+{
+	return gs_flatpak_add_updates (flatpak, list, cancellable, error);
 }
 
 gboolean
@@ -262,15 +383,19 @@ gs_plugin_add_updates (GsPlugin *plugin,
 		       GCancellable *cancellable,
 		       GError **error)
 {
-	GsPluginData *priv = gs_plugin_get_data (plugin);
-	for (guint i = 0; i < priv->flatpaks->len; i++) {
-		GsFlatpak *flatpak = g_ptr_array_index (priv->flatpaks, i);
-		if (gs_flatpak_get_flags (flatpak) & GS_FLATPAK_FLAG_IS_TEMPORARY)
-			continue;
-		if (!gs_flatpak_add_updates (flatpak, list, cancellable, error))
-			return FALSE;
-	}
-	return TRUE;
+	return gs_plugin_flatpak_run_parallel (plugin, list,
+					       gs_plugin_flatpak_add_updates_cb,
+					       NULL, cancellable, error);
+}
+
+static gboolean
+gs_plugin_flatpak_add_updates_pending_cb (GsFlatpak *flatpak,
+					  GsAppList *list,
+					  gpointer user_data,
+					  GCancellable *cancellable,
+					  GError **error)
+{
+	return gs_flatpak_add_updates_pending (flatpak, list, cancellable, error);
 }
 
 gboolean
@@ -279,16 +404,65 @@ gs_plugin_add_updates_pending (GsPlugin *plugin,
 			       GCancellable *cancellable,
 			       GError **error)
 {
-	GsPluginData *priv = gs_plugin_get_data (plugin);
-	for (guint i = 0; i < priv->flatpaks->len; i++) {
-		GsFlatpak *flatpak = g_ptr_array_index (priv->flatpaks, i);
-		if (gs_flatpak_get_flags (flatpak) & GS_FLATPAK_FLAG_IS_TEMPORARY)
-			continue;
-		if (!gs_flatpak_add_updates_pending (flatpak, list,
-						     cancellable, error)) {
-			return FALSE;
-		}
-	}
+	return gs_plugin_flatpak_run_parallel (plugin, list,
+					       gs_plugin_flatpak_add_updates_pending_cb,
+					       NULL, cancellable, error);
+}
+
+typedef struct {
+	GsPlugin		*plugin;
+	guint			 cache_age;
+	GsPluginRefreshFlags	 flags;
+	GMutex			 mutex;
+	GHashTable		*percentages;	/* GsFlatpak : percentage */
+	guint			 n_flatpaks;
+	guint			 percentage;
+} GsPluginFlatpakRefreshHelper;
+
+typedef struct {
+	GsPluginFlatpakRefreshHelper	*helper;
+	GsFlatpak			*flatpak;
+} GsPluginFlatpakRefreshProgress;
+
+/* the overall progress is the mean of all the installations */
+static void
+gs_plugin_flatpak_refresh_progress_cb (guint percentage, gpointer user_data)
+{
+	GsPluginFlatpakRefreshProgress *progress = (GsPluginFlatpakRefreshProgress *) user_data;
+	GsPluginFlatpakRefreshHelper *helper = progress->helper;
+	GHashTableIter iter;
+	gpointer value;
+	guint total = 0;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&helper->mutex);
+
+	g_hash_table_insert (helper->percentages, progress->flatpak,
+			     GUINT_TO_POINTER (percentage));
+	g_hash_table_iter_init (&iter, helper->percentages);
+	while (g_hash_table_iter_next (&iter, NULL, &value))
+		total += GPOINTER_TO_UINT (value);
+	percentage = total / MAX (helper->n_flatpaks, 1);
+	if (percentage == helper->percentage)
+		return;
+	helper->percentage = percentage;
+	gs_plugin_percentage_update (helper->plugin, percentage);
+}
+
+static gboolean
+gs_plugin_flatpak_refresh_cb (GsFlatpak *flatpak,
+			      GsAppList *list,
+			      gpointer user_data,
+			      GCancellable *cancellable,
+			      GError **error)
+{
+	GsPluginFlatpakRefreshHelper *helper = (GsPluginFlatpakRefreshHelper *) user_data;
+	GsPluginFlatpakRefreshProgress progress = { helper, flatpak };
+	g_autoptr(GError) error_local = NULL;
+	if (!gs_flatpak_refresh (flatpak, helper->cache_age, helper->flags,
+				 gs_plugin_flatpak_refresh_progress_cb, &progress,
+				 cancellable, error))
+		return FALSE;
+	if (!gs_flatpak_remote_cache_save (flatpak, &error_local))
+		g_warning ("%s", error_local->message);
 	return TRUE;
 }
 
@@ -300,16 +474,30 @@ gs_plugin_refresh (GsPlugin *plugin,
 		   GError **error)
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
+	GsPluginFlatpakRefreshHelper helper;
+	gboolean ret;
+
+	memset (&helper, 0, sizeof (helper));
+	helper.plugin = plugin;
+	helper.cache_age = cache_age;
+	helper.flags = flags;
+	helper.percentage = G_MAXUINT;
+	helper.percentages = g_hash_table_new (g_direct_hash, g_direct_equal);
+	g_mutex_init (&helper.mutex);
 	for (guint i = 0; i < priv->flatpaks->len; i++) {
 		GsFlatpak *flatpak = g_ptr_array_index (priv->flatpaks, i);
-		if (gs_flatpak_get_flags (flatpak) & GS_FLATPAK_FLAG_IS_TEMPORARY)
-			continue;
-		if (!gs_flatpak_refresh (flatpak, cache_age, flags,
-					 cancellable, error)) {
-			return FALSE;
-		}
+		if ((gs_flatpak_get_flags (flatpak) & GS_FLATPAK_FLAG_IS_TEMPORARY) == 0)
+			helper.n_flatpaks++;
 	}
-	return TRUE;
+
+	/* one status for all the installations and remotes */
+	gs_plugin_status_update (plugin, NULL, GS_PLUGIN_STATUS_DOWNLOADING);
+	ret = gs_plugin_flatpak_run_parallel (plugin, NULL,
+					      gs_plugin_flatpak_refresh_cb,
+					      &helper, cancellable, error);
+	g_hash_table_unref (helper.percentages);
+	g_mutex_clear (&helper.mutex);
+	return ret;
 }
 
 static GsFlatpak *
@@ -349,6 +537,68 @@ gs_plugin_flatpak_get_handler (GsPlugin *plugin, GsApp *app)
 	return NULL;
 }
 
+/* adds @app to the list for the installation that handles it */
+static void
+gs_plugin_flatpak_add_to_lists (GsPlugin *plugin, GHashTable *lists, GsApp *app)
+{
+	GsAppList *list_tmp;
+	GsFlatpak *flatpak = gs_plugin_flatpak_get_handler (plugin, app);
+	if (flatpak == NULL)
+		return;
+	list_tmp = g_hash_table_lookup (lists, flatpak);
+	if (list_tmp == NULL) {
+		list_tmp = gs_app_list_new ();
+		g_hash_table_insert (lists, flatpak, list_tmp);
+	}
+	gs_app_list_add (list_tmp, app);
+}
+
+static GHashTable *
+gs_plugin_flatpak_lists_new (void)
+{
+	return g_hash_table_new_full (g_direct_hash, g_direct_equal,
+				      NULL, (GDestroyNotify) g_object_unref);
+}
+
+gboolean
+gs_plugin_refine (GsPlugin *plugin,
+		  GsAppList *list,
+		  GsPluginRefineFlags flags,
+		  GCancellable *cancellable,
+		  GError **error)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	g_autoptr(GHashTable) lists = NULL;
+
+	/* the previous refine has finished with the cache */
+	gs_plugin_flatpak_remote_cache_save (plugin);
+
+	/* only these need network access */
+	if ((flags & (GS_PLUGIN_REFINE_FLAGS_REQUIRE_SIZE |
+		      GS_PLUGIN_REFINE_FLAGS_REQUIRE_RUNTIME |
+		      GS_PLUGIN_REFINE_FLAGS_REQUIRE_PERMISSIONS)) == 0)
+		return TRUE;
+
+	/* split the apps by installation */
+	lists = gs_plugin_flatpak_lists_new ();
+	for (guint i = 0; i < gs_app_list_length (list); i++)
+		gs_plugin_flatpak_add_to_lists (plugin, lists, gs_app_list_index (list, i));
+
+	/* fetch what the per-app refine needs in one pass */
+	for (guint i = 0; i < priv->flatpaks->len; i++) {
+		GsFlatpak *flatpak = g_ptr_array_index (priv->flatpaks, i);
+		GsAppList *list_tmp = g_hash_table_lookup (lists, flatpak);
+		if (list_tmp == NULL)
+			continue;
+		if (gs_flatpak_get_flags (flatpak) & GS_FLATPAK_FLAG_IS_TEMPORARY)
+			continue;
+		if (!gs_flatpak_prefetch_remote_metadata (flatpak, list_tmp,
+							  cancellable, error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
 gboolean
 gs_plugin_refine_app (GsPlugin *plugin,
 		      GsApp *app,
@@ -362,6 +612,23 @@ gs_plugin_refine_app (GsPlugin *plugin,
 	return gs_flatpak_refine_app (flatpak, app, flags, cancellable, error);
 }
 
+typedef struct {
+	GsApp			*app;
+	GsPluginRefineFlags	 flags;
+} GsPluginFlatpakWildcardHelper;
+
+static gboolean
+gs_plugin_flatpak_refine_wildcard_cb (GsFlatpak *flatpak,
+				      GsAppList *list,
+				      gpointer user_data,
+				      GCancellable *cancellable,
+				      GError **error)
+{
+	GsPluginFlatpakWildcardHelper *helper = (GsPluginFlatpakWildcardHelper *) user_data;
+	return gs_flatpak_refine_wildcard (flatpak, helper->app, list,
+					   helper->flags, cancellable, error);
+}
+
 gboolean
 gs_plugin_refine_wildcard (GsPlugin *plugin,
 			   GsApp *app,
@@ -370,17 +637,10 @@ gs_plugin_refine_wildcard (GsPlugin *plugin,
 			   GCancellable *cancellable,
 			   GError **error)
 {
-	GsPluginData *priv = gs_plugin_get_data (plugin);
-	for (guint i = 0; i < priv->flatpaks->len; i++) {
-		GsFlatpak *flatpak = g_ptr_array_index (priv->flatpaks, i);
-		if (gs_flatpak_get_flags (flatpak) & GS_FLATPAK_FLAG_IS_TEMPORARY)
-			continue;
-		if (!gs_flatpak_refine_wildcard (flatpak, app, list, flags,
-						 cancellable, error)) {
-			return FALSE;
-		}
-	}
-	return TRUE;
+	GsPluginFlatpakWildcardHelper helper = { app, flags };
+	return gs_plugin_flatpak_run_parallel (plugin, list,
+					       gs_plugin_flatpak_refine_wildcard_cb,
+					       &helper, cancellable, error);
 }
 
 gboolean
@@ -446,6 +706,42 @@ gs_plugin_app_install (GsPlugin *plugin,
 	return gs_flatpak_app_install (flatpak, app, cancellable, error);
 }
 
+gboolean
+gs_plugin_update (GsPlugin *plugin,
+		  GsAppList *list,
+		  GCancellable *cancellable,
+		  GError **error)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	g_autoptr(GHashTable) lists = gs_plugin_flatpak_lists_new ();
+
+	/* split the apps by installation, looking inside proxy apps */
+	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+		if (gs_app_has_quirk (app, AS_APP_QUIRK_IS_PROXY)) {
+			GPtrArray *related = gs_app_get_related (app);
+			for (guint j = 0; j < related->len; j++) {
+				GsApp *app_tmp = g_ptr_array_index (related, j);
+				if (gs_app_is_updatable (app_tmp))
+					gs_plugin_flatpak_add_to_lists (plugin, lists, app_tmp);
+			}
+			continue;
+		}
+		gs_plugin_flatpak_add_to_lists (plugin, lists, app);
+	}
+
+	/* only download here, gs_plugin_update_app() deploys each app */
+	for (guint i = 0; i < priv->flatpaks->len; i++) {
+		GsFlatpak *flatpak = g_ptr_array_index (priv->flatpaks, i);
+		GsAppList *list_tmp = g_hash_table_lookup (lists, flatpak);
+		if (list_tmp == NULL)
+			continue;
+		if (!gs_flatpak_prefetch_updates (flatpak, list_tmp, cancellable, error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
 gboolean
 gs_plugin_update_app (GsPlugin *plugin,
 		      GsApp *app,
@@ -505,6 +801,17 @@ gs_plugin_file_to_app (GsPlugin *plugin,
 	return TRUE;
 }
 
+static gboolean
+gs_plugin_flatpak_search_cb (GsFlatpak *flatpak,
+			     GsAppList *list,
+			     gpointer user_data,
+			     GCancellable *cancellable,
+			     GError **error)
+{
+	return gs_flatpak_search (flatpak, (gchar **) user_data, list,
+				  cancellable, error);
+}
+
 gboolean
 gs_plugin_add_search (GsPlugin *plugin,
 		      gchar **values,
@@ -512,17 +819,9 @@ gs_plugin_add_search (GsPlugin *plugin,
 		      GCancellable *cancellable,
 		      GError **error)
 {
-	GsPluginData *priv = gs_plugin_get_data (plugin);
-	for (guint i = 0; i < priv->flatpaks->len; i++) {
-		GsFlatpak *flatpak = g_ptr_array_index (priv->flatpaks, i);
-		if (gs_flatpak_get_flags (flatpak) & GS_FLATPAK_FLAG_IS_TEMPORARY)
-			continue;
-		if (!gs_flatpak_search (flatpak, values, list,
-					cancellable, error)) {
-			return FALSE;
-		}
-	}
-	return TRUE;
+	return gs_plugin_flatpak_run_parallel (plugin, list,
+					       gs_plugin_flatpak_search_cb,
+					       values, cancellable, error);
 }
 
 gboolean
@@ -21,8 +21,12 @@
 
 #include "config.h"
 
+#include <glib/gstdio.h>
+
 #include "gnome-software-private.h"
 
+#include "gs-flatpak.h"
+#include "gs-flatpak-update.h"
 #include "gs-test.h"
 
 static void
@@ -1152,6 +1156,352 @@ gs_plugins_flatpak_app_update_func (GsPluginLoader *plugin_loader)
 	g_assert_cmpint (gs_app_get_state (app_source), ==, AS_APP_STATE_AVAILABLE);
 }
 
+static FlatpakInstallation *
+gs_plugins_flatpak_installation_new (void)
+{
+	const gchar *root = g_getenv ("GS_SELF_TEST_FLATPACK_DATADIR");
+	g_autofree gchar *path = g_build_filename (root, "flatpak", NULL);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file = g_file_new_for_path (path);
+	FlatpakInstallation *installation;
+
+	installation = flatpak_installation_new_for_path (file, TRUE, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (installation != NULL);
+	return installation;
+}
+
+/* points the "test" remote at one of the test repos */
+static void
+gs_plugins_flatpak_remote_set (FlatpakInstallation *installation,
+			       const gchar *repo,
+			       const gchar *default_branch)
+{
+	gboolean ret;
+	g_autofree gchar *testdir = NULL;
+	g_autofree gchar *url = NULL;
+	g_autoptr(FlatpakRemote) xremote = NULL;
+	g_autoptr(GError) error = NULL;
+
+	testdir = gs_test_get_filename (TESTDATADIR, repo);
+	g_assert (testdir != NULL);
+	url = g_strdup_printf ("file://%s/repo", testdir);
+	xremote = flatpak_installation_get_remote_by_name (installation, "test",
+							   NULL, NULL);
+	if (xremote == NULL)
+		xremote = flatpak_remote_new ("test");
+	flatpak_remote_set_url (xremote, url);
+	flatpak_remote_set_gpg_verify (xremote, FALSE);
+	flatpak_remote_set_default_branch (xremote, default_branch);
+	ret = flatpak_installation_modify_remote (installation, xremote,
+						  NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+}
+
+/* an available app, as the appstream plugin would create it */
+static GsApp *
+gs_plugins_flatpak_chiron_new (void)
+{
+	GsApp *app = gs_app_new ("org.test.Chiron.desktop");
+	gs_app_set_kind (app, AS_APP_KIND_DESKTOP);
+	gs_app_set_management_plugin (app, "flatpak");
+	gs_app_set_metadata (app, "flatpak::kind", "app");
+	gs_app_set_metadata (app, "flatpak::name", "org.test.Chiron");
+	gs_app_set_metadata (app, "flatpak::arch", flatpak_get_default_arch ());
+	gs_app_set_metadata (app, "flatpak::branch", "master");
+	gs_app_set_origin (app, "test");
+	gs_app_set_state (app, AS_APP_STATE_AVAILABLE);
+	return app;
+}
+
+static guint
+gs_plugins_flatpak_search_count (GsFlatpak *flatpak, const gchar *value)
+{
+	gboolean ret;
+	gchar *values[] = { (gchar *) value, NULL };
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+
+	ret = gs_flatpak_search (flatpak, values, list, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	return gs_app_list_length (list);
+}
+
+static guint
+gs_plugins_flatpak_installed_count (GsFlatpak *flatpak)
+{
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+
+	ret = gs_flatpak_add_installed (flatpak, list, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	return gs_app_list_length (list);
+}
+
+static void
+gs_plugins_flatpak_caches_func (GsPluginLoader *plugin_loader)
+{
+	GsPlugin *plugin;
+	gboolean ret;
+	g_autofree gchar *basename = NULL;
+	g_autofree gchar *cache_fn = NULL;
+	g_autofree gchar *metadata = NULL;
+	g_autofree gchar *repodir_fn = NULL;
+	g_autoptr(FlatpakInstallation) installation = NULL;
+	g_autoptr(FlatpakInstallation) installation_other = NULL;
+	g_autoptr(FlatpakInstalledRef) xref_app = NULL;
+	g_autoptr(FlatpakInstalledRef) xref_runtime = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GKeyFile) kf = g_key_file_new ();
+	g_autoptr(GSettings) settings = NULL;
+	g_autoptr(GsApp) app = NULL;
+	g_autoptr(GsFlatpak) flatpak = NULL;
+	g_auto(GStrv) groups = NULL;
+
+	/* drop all caches */
+	gs_plugin_loader_setup_again (plugin_loader);
+
+	/* no flatpak, abort */
+	if (!gs_plugin_loader_get_enabled (plugin_loader, "flatpak"))
+		return;
+
+	/* no files to use */
+	repodir_fn = gs_test_get_filename (TESTDATADIR, "app-update/repo");
+	if (repodir_fn == NULL ||
+	    !g_file_test (repodir_fn, G_FILE_TEST_EXISTS)) {
+		g_test_skip ("no flatpak test repo");
+		return;
+	}
+
+	/* use the same installation as the plugin, but not its instance */
+	plugin = gs_plugin_loader_find_plugin (plugin_loader, "flatpak");
+	g_assert (plugin != NULL);
+	installation = gs_plugins_flatpak_installation_new ();
+	gs_plugins_flatpak_remote_set (installation, "app-with-runtime", "master");
+
+	/* the AppStream data is loaded from the remote */
+	flatpak = gs_flatpak_new (plugin, installation);
+	ret = gs_flatpak_refresh (flatpak, G_MAXUINT,
+				  GS_PLUGIN_REFRESH_FLAGS_METADATA,
+				  NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (gs_plugins_flatpak_search_count (flatpak, "Bingo"), ==, 1);
+	g_clear_object (&flatpak);
+
+	/* components not on the default branch are dropped as they are read */
+	settings = g_settings_new ("org.gnome.software");
+	if (g_settings_get_boolean (settings, "filter-default-branch")) {
+		gs_plugins_flatpak_remote_set (installation, "app-with-runtime", "stable");
+		flatpak = gs_flatpak_new (plugin, installation);
+		ret = gs_flatpak_refresh (flatpak, G_MAXUINT,
+					  GS_PLUGIN_REFRESH_FLAGS_METADATA,
+					  NULL, NULL, NULL, &error);
+		g_assert_no_error (error);
+		g_assert (ret);
+		g_assert_cmpint (gs_plugins_flatpak_search_count (flatpak, "Bingo"), ==, 0);
+		g_clear_object (&flatpak);
+		gs_plugins_flatpak_remote_set (installation, "app-with-runtime", "master");
+	}
+
+	/* install behind the back of a new instance, which it has not been
+	 * told about as nothing watches the installation */
+	flatpak = gs_flatpak_new (plugin, installation);
+	g_assert_cmpint (gs_plugins_flatpak_installed_count (flatpak), ==, 0);
+	installation_other = gs_plugins_flatpak_installation_new ();
+	xref_runtime = flatpak_installation_install (installation_other, "test",
+						     FLATPAK_REF_KIND_RUNTIME,
+						     "org.test.Runtime",
+						     NULL, "master",
+						     NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (xref_runtime != NULL);
+	xref_app = flatpak_installation_install (installation_other, "test",
+						 FLATPAK_REF_KIND_APP,
+						 "org.test.Chiron",
+						 NULL, "master",
+						 NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (xref_app != NULL);
+
+	/* the snapshot is reused until a refresh */
+	g_assert_cmpint (gs_plugins_flatpak_installed_count (flatpak), ==, 0);
+	ret = gs_flatpak_refresh (flatpak, G_MAXUINT, 0,
+				  NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (gs_plugins_flatpak_installed_count (flatpak), ==, 1);
+	g_clear_object (&flatpak);
+
+	/* remove them again, as installed apps never use the remote metadata */
+	ret = flatpak_installation_uninstall (installation_other,
+					      FLATPAK_REF_KIND_APP,
+					      "org.test.Chiron",
+					      NULL, "master",
+					      NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = flatpak_installation_uninstall (installation_other,
+					      FLATPAK_REF_KIND_RUNTIME,
+					      "org.test.Runtime",
+					      NULL, "master",
+					      NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* start without a remote metadata cache */
+	flatpak = gs_flatpak_new (plugin, installation);
+	basename = g_strdup_printf ("remote-metadata-%s.ini",
+				    gs_flatpak_get_id (flatpak));
+	cache_fn = gs_utils_get_cache_filename ("flatpak", basename,
+						GS_UTILS_CACHE_FLAG_WRITEABLE,
+						&error);
+	g_assert_no_error (error);
+	g_assert (cache_fn != NULL);
+	g_unlink (cache_fn);
+
+	/* a miss fetches from the remote and is saved for the commit */
+	app = gs_plugins_flatpak_chiron_new ();
+	ret = gs_flatpak_refine_app (flatpak, app,
+				     GS_PLUGIN_REFINE_FLAGS_REQUIRE_PERMISSIONS,
+				     NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (gs_app_has_kudo (app, GS_APP_KUDO_SANDBOXED_SECURE));
+	ret = gs_flatpak_remote_cache_save (flatpak, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_clear_object (&app);
+	g_clear_object (&flatpak);
+
+	/* make the cached copy distinguishable from the one on the remote */
+	ret = g_key_file_load_from_file (kf, cache_fn, G_KEY_FILE_NONE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	groups = g_key_file_get_groups (kf, NULL);
+	g_assert_cmpint (g_strv_length (groups), ==, 1);
+	metadata = g_key_file_get_string (kf, groups[0], "Metadata", &error);
+	g_assert_no_error (error);
+	g_assert (metadata != NULL);
+	g_key_file_set_string (kf, groups[0], "Metadata",
+			       "[Application]\n"
+			       "name=org.test.Chiron\n"
+			       "runtime=org.test.Runtime/x86_64/master\n"
+			       "[Context]\n"
+			       "sockets=x11;\n");
+	ret = g_key_file_save_to_file (kf, cache_fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_clear_pointer (&groups, g_strfreev);
+
+	/* a new instance hits the saved cache for the same commit */
+	flatpak = gs_flatpak_new (plugin, installation);
+	app = gs_plugins_flatpak_chiron_new ();
+	ret = gs_flatpak_refine_app (flatpak, app,
+				     GS_PLUGIN_REFINE_FLAGS_REQUIRE_PERMISSIONS,
+				     NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (!gs_app_has_kudo (app, GS_APP_KUDO_SANDBOXED_SECURE));
+	g_clear_object (&app);
+	g_clear_object (&flatpak);
+
+	/* a new commit on the remote misses and adds a second entry */
+	gs_plugins_flatpak_remote_set (installation, "app-update", "master");
+	flatpak = gs_flatpak_new (plugin, installation);
+	app = gs_plugins_flatpak_chiron_new ();
+	ret = gs_flatpak_refine_app (flatpak, app,
+				     GS_PLUGIN_REFINE_FLAGS_REQUIRE_PERMISSIONS,
+				     NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (gs_app_has_kudo (app, GS_APP_KUDO_SANDBOXED_SECURE));
+	ret = gs_flatpak_remote_cache_save (flatpak, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_clear_object (&flatpak);
+	ret = g_key_file_load_from_file (kf, cache_fn, G_KEY_FILE_NONE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	groups = g_key_file_get_groups (kf, NULL);
+	g_assert_cmpint (g_strv_length (groups), ==, 2);
+
+	/* remove the remote */
+	ret = flatpak_installation_remove_remote (installation, "test",
+						  NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+}
+
+static GsApp *
+gs_plugins_flatpak_update_app_new (const gchar *kind, const gchar *name)
+{
+	GsApp *app = gs_app_new (name);
+	if (g_strcmp0 (kind, "runtime") == 0)
+		gs_app_set_kind (app, AS_APP_KIND_RUNTIME);
+	else
+		gs_app_set_kind (app, AS_APP_KIND_DESKTOP);
+	gs_app_set_metadata (app, "flatpak::kind", kind);
+	gs_app_set_metadata (app, "flatpak::name", name);
+	gs_app_set_metadata (app, "flatpak::arch", "x86_64");
+	gs_app_set_metadata (app, "flatpak::branch", "master");
+	gs_app_set_origin (app, "test");
+	gs_app_set_state (app, AS_APP_STATE_UPDATABLE_LIVE);
+	return app;
+}
+
+static void
+gs_plugins_flatpak_update_jobs_func (void)
+{
+	GsFlatpakUpdateJob *job;
+	g_autoptr(GsApp) app1 = NULL;
+	g_autoptr(GsApp) app2 = NULL;
+	g_autoptr(GsApp) proxy = NULL;
+	g_autoptr(GsApp) runtime = NULL;
+	g_autoptr(GsApp) runtime_dup = NULL;
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+	g_autoptr(GPtrArray) jobs = NULL;
+
+	/* two apps sharing one runtime, which is also updatable */
+	runtime = gs_plugins_flatpak_update_app_new ("runtime", "org.test.Runtime");
+	app1 = gs_plugins_flatpak_update_app_new ("app", "org.test.Chiron");
+	gs_app_set_runtime (app1, runtime);
+	app2 = gs_plugins_flatpak_update_app_new ("app", "org.test.Bingo");
+	gs_app_set_runtime (app2, runtime);
+
+	/* the runtime is listed again as a different object inside a proxy */
+	runtime_dup = gs_plugins_flatpak_update_app_new ("runtime", "org.test.Runtime");
+	proxy = gs_app_new ("proxy");
+	gs_app_add_quirk (proxy, AS_APP_QUIRK_IS_PROXY);
+	gs_app_add_related (proxy, app2);
+	gs_app_add_related (proxy, runtime_dup);
+	gs_app_list_add (list, app1);
+	gs_app_list_add (list, proxy);
+	gs_app_list_add (list, runtime);
+
+	/* the runtime is pulled once, before both apps */
+	jobs = gs_flatpak_update_jobs_new (list);
+	g_assert_cmpint (jobs->len, ==, 3);
+	job = g_ptr_array_index (jobs, 0);
+	g_assert_cmpstr (job->ref, ==, "runtime/org.test.Runtime/x86_64/master");
+	g_assert_cmpint (job->kind, ==, FLATPAK_REF_KIND_RUNTIME);
+	g_assert_cmpint (job->apps->len, ==, 2);
+	g_assert (g_ptr_array_index (job->apps, 0) == runtime_dup);
+	g_assert (g_ptr_array_index (job->apps, 1) == runtime);
+
+	/* the apps keep the order of the list */
+	job = g_ptr_array_index (jobs, 1);
+	g_assert_cmpstr (job->ref, ==, "app/org.test.Chiron/x86_64/master");
+	g_assert_cmpint (job->apps->len, ==, 1);
+	job = g_ptr_array_index (jobs, 2);
+	g_assert_cmpstr (job->ref, ==, "app/org.test.Bingo/x86_64/master");
+	g_assert_cmpint (job->apps->len, ==, 1);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -1208,6 +1558,8 @@ main (int argc, char **argv)
 	g_assert (ret);
 
 	/* plugin tests go here */
+	g_test_add_func ("/gnome-software/plugins/flatpak/update-jobs",
+			 gs_plugins_flatpak_update_jobs_func);
 	g_test_add_data_func ("/gnome-software/plugins/flatpak/app-with-runtime",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_flatpak_app_with_runtime_func);
@@ -1223,6 +1575,9 @@ main (int argc, char **argv)
 	g_test_add_data_func ("/gnome-software/plugins/flatpak/app-update-runtime",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_flatpak_app_update_func);
+	g_test_add_data_func ("/gnome-software/plugins/flatpak/caches",
+			      plugin_loader,
+			      (GTestDataFunc) gs_plugins_flatpak_caches_func);
 	g_test_add_data_func ("/gnome-software/plugins/flatpak/repo",
 			      plugin_loader,
 			      (GTestDataFunc) gs_plugins_flatpak_repo_func);
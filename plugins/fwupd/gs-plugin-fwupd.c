@@ -443,6 +443,10 @@ gs_plugin_fwupd_new_app_from_results (GsPlugin *plugin, FwupdResult *res)
 		gs_app_set_metadata (app, "fwupd::UpdateURI",
 				     fwupd_result_get_update_uri (res));
 	}
+	if (fwupd_result_get_update_checksum (res) != NULL) {
+		gs_app_set_metadata (app, "fwupd::UpdateChecksum",
+				     fwupd_result_get_update_checksum (res));
+	}
 	if (fwupd_result_get_device_description (res) != NULL) {
 		g_autofree gchar *tmp = NULL;
 		tmp = as_markup_convert (fwupd_result_get_device_description (res),
@@ -875,10 +879,21 @@ gs_plugin_fwupd_install (GsPlugin *plugin,
 	filename = g_file_get_path (local_file);
 	if (!g_file_query_exists (local_file, cancellable)) {
 		const gchar *uri = gs_app_get_metadata_item (app, "fwupd::UpdateURI");
+		const gchar *checksum = gs_app_get_metadata_item (app, "fwupd::UpdateChecksum");
 		gs_app_set_state (app, AS_APP_STATE_INSTALLING);
-		if (!gs_plugin_download_file (plugin, app, uri, filename,
-					      cancellable, error))
-			return FALSE;
+		if (checksum != NULL) {
+			if (!gs_plugin_download_file_with_checksum (plugin, app,
+								    uri, filename,
+								    G_CHECKSUM_SHA1,
+								    checksum,
+								    cancellable,
+								    error))
+				return FALSE;
+		} else {
+			if (!gs_plugin_download_file (plugin, app, uri, filename,
+						      cancellable, error))
+				return FALSE;
+		}
 	}
 
 	/* limit to single device? */
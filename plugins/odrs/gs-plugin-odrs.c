@@ -23,6 +23,7 @@
 
 #include <gnome-software.h>
 #include <json-glib/json-glib.h>
+#include <glib/gstdio.h>
 #include <string.h>
 #include <math.h>
 
@@ -33,13 +34,32 @@
 
 #define ODRS_REVIEW_CACHE_AGE_MAX		237000 /* 1 week */
 #define ODRS_REVIEW_NUMBER_RESULTS_MAX		20
+#define ODRS_REVIEW_FETCH_MAX_INFLIGHT		4
+
+/* the downloaded odrs.json is compiled into a table that can be mapped
+ * directly; it is only ever read on the machine that wrote it, so
+ * everything is stored in host byte order */
+#define ODRS_RATINGS_MAGIC			"GSODRS01"
+
+typedef struct {
+	gchar			 magic[8];
+	guint32			 n_entries;
+	guint32			 strings_size;
+} GsOdrsRatingsHeader;
+
+typedef struct {
+	guint32			 id_offset;	/* into the string table */
+	guint32			 stars[6];
+	gint32			 wilson;
+} GsOdrsRatingsEntry;
 
 struct GsPluginData {
 	GSettings		*settings;
 	gchar			*distro;
 	gchar			*user_hash;
 	gchar			*review_server;
-	GHashTable		*ratings;
+	GMutex			 ratings_mutex;
+	GMappedFile		*ratings;
 	GsApp			*cached_origin;
 };
 
@@ -53,8 +73,11 @@ gs_plugin_initialize (GsPlugin *plugin)
 	priv->settings = g_settings_new ("org.gnome.software");
 	priv->review_server = g_settings_get_string (priv->settings,
 						     "review-server");
-	priv->ratings = g_hash_table_new_full (g_str_hash, g_str_equal,
-					       g_free, (GDestroyNotify) g_array_unref);
+	if (g_getenv ("GS_SELF_TEST_ODRS_SERVER") != NULL) {
+		g_free (priv->review_server);
+		priv->review_server = g_strdup (g_getenv ("GS_SELF_TEST_ODRS_SERVER"));
+	}
+	g_mutex_init (&priv->ratings_mutex);
 
 	/* get the machine+user ID hash value */
 	priv->user_hash = gs_utils_get_user_hash (&error);
@@ -96,42 +119,44 @@ gs_plugin_initialize (GsPlugin *plugin)
 	gs_plugin_set_appstream_id (plugin, "org.gnome.Software.Plugin.Odrs");
 }
 
-static GArray *
-gs_plugin_odrs_load_ratings_for_app (JsonObject *json_app)
+static gboolean
+gs_plugin_odrs_load_ratings_for_app (JsonObject *json_app, guint32 *stars)
 {
-	GArray *ratings;
-	guint64 tmp;
 	guint i;
 	const gchar *names[] = { "star0", "star1", "star2", "star3",
 				 "star4", "star5", NULL };
 
-	ratings = g_array_sized_new (FALSE, TRUE, sizeof(guint32), 6);
 	for (i = 0; names[i] != NULL; i++) {
+		gint64 tmp;
 		if (!json_object_has_member (json_app, names[i]))
-			continue;
-		tmp = (guint64) json_object_get_int_member (json_app, names[i]);
-		g_array_append_val (ratings, tmp);
+			return FALSE;
+		tmp = json_object_get_int_member (json_app, names[i]);
+		stars[i] = (guint32) CLAMP (tmp, 0, G_MAXUINT32);
 	}
-
-	return ratings;
+	return TRUE;
 }
 
+/* converts the downloaded JSON into a sorted table written to @fn_bin */
 static gboolean
-gs_plugin_odrs_load_ratings (GsPlugin *plugin, const gchar *fn, GError **error)
+gs_plugin_odrs_compile_ratings (const gchar *fn_json,
+				const gchar *fn_bin,
+				GError **error)
 {
-	GsPluginData *priv = gs_plugin_get_data (plugin);
+	GsOdrsRatingsHeader header;
 	GList *l;
 	JsonNode *json_root;
 	JsonObject *json_item;
+	guint i;
+	g_autoptr(GArray) entries = NULL;
+	g_autoptr(GByteArray) data = NULL;
+	g_autoptr(GByteArray) strings = NULL;
+	g_autoptr(GError) error_local = NULL;
 	g_autoptr(GList) apps = NULL;
 	g_autoptr(JsonParser) json_parser = NULL;
 
-	/* remove all existing */
-	g_hash_table_remove_all (priv->ratings);
-
 	/* parse the data and find the success */
 	json_parser = json_parser_new ();
-	if (!json_parser_load_from_file (json_parser, fn, error)) {
+	if (!json_parser_load_from_file (json_parser, fn_json, error)) {
 		gs_utils_error_convert_json_glib (error);
 		return FALSE;
 	}
@@ -151,23 +176,156 @@ gs_plugin_odrs_load_ratings (GsPlugin *plugin, const gchar *fn, GError **error)
 		return FALSE;
 	}
 
-	/* parse each app */
+	/* sort the app IDs so they can be found with a binary search */
 	json_item = json_node_get_object (json_root);
 	apps = json_object_get_members (json_item);
+	apps = g_list_sort (apps, (GCompareFunc) g_strcmp0);
+
+	/* parse each app */
+	entries = g_array_new (FALSE, TRUE, sizeof (GsOdrsRatingsEntry));
+	strings = g_byte_array_new ();
 	for (l = apps; l != NULL; l = l->next) {
 		const gchar *app_id = (const gchar *) l->data;
 		JsonObject *json_app = json_object_get_object_member (json_item, app_id);
-		g_autoptr(GArray) ratings = NULL;;
-		ratings = gs_plugin_odrs_load_ratings_for_app (json_app);
-		if (ratings->len == 6) {
-			g_hash_table_insert (priv->ratings,
-					     g_strdup (app_id),
-					     g_array_ref (ratings));
-		}
+		GsOdrsRatingsEntry entry;
+		if (json_app == NULL)
+			continue;
+		memset (&entry, 0, sizeof (entry));
+		if (!gs_plugin_odrs_load_ratings_for_app (json_app, entry.stars))
+			continue;
+		entry.id_offset = strings->len;
+		entry.wilson = gs_utils_get_wilson_rating (entry.stars[1],
+							   entry.stars[2],
+							   entry.stars[3],
+							   entry.stars[4],
+							   entry.stars[5]);
+		g_byte_array_append (strings, (const guint8 *) app_id,
+				     (guint) strlen (app_id) + 1);
+		g_array_append_val (entries, entry);
+	}
+
+	/* header, entries, then the string table */
+	memset (&header, 0, sizeof (header));
+	memcpy (header.magic, ODRS_RATINGS_MAGIC, sizeof (header.magic));
+	header.n_entries = entries->len;
+	header.strings_size = strings->len;
+	data = g_byte_array_sized_new (sizeof (header) +
+				       entries->len * sizeof (GsOdrsRatingsEntry) +
+				       strings->len);
+	g_byte_array_append (data, (const guint8 *) &header, sizeof (header));
+	for (i = 0; i < entries->len; i++) {
+		GsOdrsRatingsEntry *entry = &g_array_index (entries, GsOdrsRatingsEntry, i);
+		g_byte_array_append (data, (const guint8 *) entry, sizeof (*entry));
+	}
+	g_byte_array_append (data, strings->data, strings->len);
+	g_debug ("compiled %u ratings into %u bytes", entries->len, data->len);
+	if (!g_file_set_contents (fn_bin, (const gchar *) data->data,
+				  (gssize) data->len, &error_local)) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_WRITE_FAILED,
+			     "failed to save %s: %s",
+			     fn_bin, error_local->message);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean
+gs_plugin_odrs_ratings_is_valid (GMappedFile *mapped_file)
+{
+	const GsOdrsRatingsHeader *header;
+	const GsOdrsRatingsEntry *entries;
+	const gchar *strings;
+	gsize size = g_mapped_file_get_length (mapped_file);
+	guint i;
+
+	if (size < sizeof (GsOdrsRatingsHeader))
+		return FALSE;
+	header = (const GsOdrsRatingsHeader *) g_mapped_file_get_contents (mapped_file);
+	if (memcmp (header->magic, ODRS_RATINGS_MAGIC, sizeof (header->magic)) != 0)
+		return FALSE;
+	if (size != sizeof (GsOdrsRatingsHeader) +
+		    (gsize) header->n_entries * sizeof (GsOdrsRatingsEntry) +
+		    header->strings_size)
+		return FALSE;
+
+	/* every ID has to be inside the string table */
+	entries = (const GsOdrsRatingsEntry *) (header + 1);
+	strings = (const gchar *) (entries + header->n_entries);
+	if (header->strings_size > 0 && strings[header->strings_size - 1] != '\0')
+		return FALSE;
+	for (i = 0; i < header->n_entries; i++) {
+		if (entries[i].id_offset >= header->strings_size)
+			return FALSE;
 	}
 	return TRUE;
 }
 
+static gboolean
+gs_plugin_odrs_load_ratings (GsPlugin *plugin, const gchar *fn, GError **error)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	GStatBuf buf_json;
+	GStatBuf buf_bin;
+	g_autofree gchar *fn_bin = NULL;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GMappedFile) mapped_file = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
+
+	/* only parse the JSON if it has changed since it was compiled */
+	fn_bin = gs_utils_get_cache_filename ("ratings",
+					      "odrs.bin",
+					      GS_UTILS_CACHE_FLAG_WRITEABLE,
+					      error);
+	if (fn_bin == NULL)
+		return FALSE;
+	if (g_stat (fn, &buf_json) != 0) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_FAILED,
+			     "failed to get ratings from %s", fn);
+		return FALSE;
+	}
+	if (g_stat (fn_bin, &buf_bin) != 0 ||
+	    buf_bin.st_mtime < buf_json.st_mtime) {
+		if (!gs_plugin_odrs_compile_ratings (fn, fn_bin, error))
+			return FALSE;
+	}
+
+	/* map the table, and re-create it if it is corrupt */
+	mapped_file = g_mapped_file_new (fn_bin, FALSE, &error_local);
+	if (mapped_file != NULL && !gs_plugin_odrs_ratings_is_valid (mapped_file)) {
+		g_warning ("ratings table %s is invalid, recreating", fn_bin);
+		g_clear_pointer (&mapped_file, g_mapped_file_unref);
+		if (!gs_plugin_odrs_compile_ratings (fn, fn_bin, error))
+			return FALSE;
+		mapped_file = g_mapped_file_new (fn_bin, FALSE, &error_local);
+	}
+	if (mapped_file == NULL) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_FAILED,
+			     "failed to map %s: %s",
+			     fn_bin, error_local->message);
+		return FALSE;
+	}
+	if (!gs_plugin_odrs_ratings_is_valid (mapped_file)) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_INVALID_FORMAT,
+			     "ratings table %s is invalid", fn_bin);
+		return FALSE;
+	}
+
+	/* replace any existing */
+	locker = g_mutex_locker_new (&priv->ratings_mutex);
+	if (priv->ratings != NULL)
+		g_mapped_file_unref (priv->ratings);
+	priv->ratings = g_steal_pointer (&mapped_file);
+	return TRUE;
+}
+
 static gboolean
 gs_plugin_odrs_refresh_ratings (GsPlugin *plugin,
 				guint cache_age,
@@ -176,6 +334,7 @@ gs_plugin_odrs_refresh_ratings (GsPlugin *plugin,
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
 	g_autofree gchar *fn = NULL;
+	g_autofree gchar *fn_bin = NULL;
 	g_autofree gchar *uri = NULL;
 	g_autoptr(GsApp) app_dl = gs_app_new (gs_plugin_get_name (plugin));
 
@@ -204,12 +363,58 @@ gs_plugin_odrs_refresh_ratings (GsPlugin *plugin,
 		gs_utils_error_add_unique_id (error, priv->cached_origin);
 		return FALSE;
 	}
+
+	/* the old table may have the same timestamp as the new data */
+	fn_bin = gs_utils_get_cache_filename ("ratings",
+					      "odrs.bin",
+					      GS_UTILS_CACHE_FLAG_WRITEABLE,
+					      error);
+	if (fn_bin == NULL)
+		return FALSE;
+	g_unlink (fn_bin);
 	return gs_plugin_odrs_load_ratings (plugin, fn, error);
 }
 
+/* reviews used to be cached as one reply per app, but now live in the
+ * shared review store, so remove anything left from older versions */
+static void
+gs_plugin_odrs_remove_legacy_reviews (void)
+{
+	const gchar *basename;
+	g_autofree gchar *cachedir = NULL;
+	g_autofree gchar *fn = NULL;
+	g_autoptr(GDir) dir = NULL;
+	g_autoptr(GError) error = NULL;
+
+	fn = gs_utils_get_cache_filename ("reviews", "odrs.ini",
+					  GS_UTILS_CACHE_FLAG_WRITEABLE,
+					  &error);
+	if (fn == NULL) {
+		g_debug ("failed to get reviews cache: %s", error->message);
+		return;
+	}
+	cachedir = g_path_get_dirname (fn);
+	dir = g_dir_open (cachedir, 0, NULL);
+	if (dir == NULL)
+		return;
+	while ((basename = g_dir_read_name (dir)) != NULL) {
+		g_autofree gchar *fn_legacy = NULL;
+		if (!g_str_has_suffix (basename, ".json") &&
+		    g_strcmp0 (basename, "odrs.ini") != 0)
+			continue;
+		fn_legacy = g_build_filename (cachedir, basename, NULL);
+		g_debug ("removing legacy reviews cache %s", fn_legacy);
+		if (g_unlink (fn_legacy) != 0)
+			g_debug ("failed to remove %s", fn_legacy);
+	}
+}
+
 gboolean
 gs_plugin_setup (GsPlugin *plugin, GCancellable *cancellable, GError **error)
 {
+	/* one-off cleanup, the store is used from now on */
+	gs_plugin_odrs_remove_legacy_reviews ();
+
 	/* just ensure there is any data, no matter how old */
 	if (!gs_plugin_odrs_refresh_ratings (plugin, G_MAXUINT, cancellable, error))
 		return FALSE;
@@ -240,7 +445,9 @@ gs_plugin_destroy (GsPlugin *plugin)
 	GsPluginData *priv = gs_plugin_get_data (plugin);
 	g_free (priv->user_hash);
 	g_free (priv->distro);
-	g_hash_table_unref (priv->ratings);
+	if (priv->ratings != NULL)
+		g_mapped_file_unref (priv->ratings);
+	g_mutex_clear (&priv->ratings_mutex);
 	g_object_unref (priv->settings);
 	g_object_unref (priv->cached_origin);
 }
@@ -490,30 +697,58 @@ gs_plugin_odrs_refine_ratings (GsPlugin *plugin,
 			       GError **error)
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
-	GArray *review_ratings;
-	gint rating;
+	const GsOdrsRatingsHeader *header;
+	const GsOdrsRatingsEntry *entries;
+	const GsOdrsRatingsEntry *entry = NULL;
+	const gchar *app_id;
+	const gchar *strings;
+	guint lo, hi;
 	g_autoptr(AsProfileTask) ptask = NULL;
+	g_autoptr(GArray) review_ratings = NULL;
+	g_autoptr(GMutexLocker) locker = NULL;
 
 	/* profile */
 	ptask = as_profile_start_literal (gs_plugin_get_profile (plugin),
 					  "odrs::refine-ratings");
 	g_assert (ptask != NULL);
 
-	/* get ratings */
-	review_ratings = g_hash_table_lookup (priv->ratings,
-					      gs_app_get_id (app));
-	if (review_ratings == NULL)
+	/* no data */
+	app_id = gs_app_get_id (app);
+	if (app_id == NULL)
+		return TRUE;
+	locker = g_mutex_locker_new (&priv->ratings_mutex);
+	if (priv->ratings == NULL)
 		return TRUE;
+
+	/* binary search the sorted table */
+	header = (const GsOdrsRatingsHeader *) g_mapped_file_get_contents (priv->ratings);
+	entries = (const GsOdrsRatingsEntry *) (header + 1);
+	strings = (const gchar *) (entries + header->n_entries);
+	lo = 0;
+	hi = header->n_entries;
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+		gint rc = strcmp (app_id, strings + entries[mid].id_offset);
+		if (rc == 0) {
+			entry = &entries[mid];
+			break;
+		}
+		if (rc < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	if (entry == NULL)
+		return TRUE;
+
+	/* get ratings */
+	review_ratings = g_array_sized_new (FALSE, FALSE, sizeof(guint32), 6);
+	g_array_append_vals (review_ratings, entry->stars, 6);
 	gs_app_set_review_ratings (app, review_ratings);
 
-	/* find the wilson rating */
-	rating = gs_utils_get_wilson_rating (g_array_index (review_ratings, guint32, 1),
-					     g_array_index (review_ratings, guint32, 2),
-					     g_array_index (review_ratings, guint32, 3),
-					     g_array_index (review_ratings, guint32, 4),
-					     g_array_index (review_ratings, guint32, 5));
-	if (rating > 0)
-		gs_app_set_rating (app, rating);
+	/* the wilson rating was found when the table was built */
+	if (entry->wilson > 0)
+		gs_app_set_rating (app, entry->wilson);
 	return TRUE;
 }
 
@@ -523,37 +758,14 @@ gs_plugin_odrs_fetch_for_app (GsPlugin *plugin, GsApp *app, GError **error)
 	GsPluginData *priv = gs_plugin_get_data (plugin);
 	const gchar *version;
 	guint status_code;
-	g_autofree gchar *cachefn_basename = NULL;
-	g_autofree gchar *cachefn = NULL;
 	g_autofree gchar *data = NULL;
 	g_autofree gchar *uri = NULL;
-	g_autoptr(GFile) cachefn_file = NULL;
 	g_autoptr(GPtrArray) reviews = NULL;
 	g_autoptr(JsonBuilder) builder = NULL;
 	g_autoptr(JsonGenerator) json_generator = NULL;
 	g_autoptr(JsonNode) json_root = NULL;
 	g_autoptr(SoupMessage) msg = NULL;
 
-	/* look in the cache */
-	cachefn_basename = g_strdup_printf ("%s.json", gs_app_get_id (app));
-	cachefn = gs_utils_get_cache_filename ("reviews",
-					       cachefn_basename,
-					       GS_UTILS_CACHE_FLAG_WRITEABLE,
-					       error);
-	if (cachefn == NULL)
-		return NULL;
-	cachefn_file = g_file_new_for_path (cachefn);
-	if (gs_utils_get_file_age (cachefn_file) < ODRS_REVIEW_CACHE_AGE_MAX) {
-		g_autofree gchar *json_data = NULL;
-		if (!g_file_get_contents (cachefn, &json_data, NULL, error))
-			return NULL;
-		g_debug ("got review data for %s from %s",
-			 gs_app_get_id (app), cachefn);
-		return gs_plugin_odrs_parse_reviews (plugin,
-						     json_data, -1,
-						     error);
-	}
-
 	/* not always available */
 	version = gs_app_get_version (app);
 	if (version == NULL)
@@ -610,38 +822,17 @@ gs_plugin_odrs_fetch_for_app (GsPlugin *plugin, GsApp *app, GError **error)
 		return NULL;
 	g_debug ("odrs returned: %s", msg->response_body->data);
 
-	/* save to the cache */
-	if (!g_file_set_contents (cachefn,
-				  msg->response_body->data,
-				  msg->response_body->length,
-				  error))
-		return NULL;
-
 	/* success */
 	return g_steal_pointer (&reviews);
 }
 
-static gboolean
-gs_plugin_odrs_refine_reviews (GsPlugin *plugin,
-			       GsApp *app,
-			       GCancellable *cancellable,
-			       GError **error)
+static void
+gs_plugin_odrs_add_reviews (GsPlugin *plugin, GsApp *app, GPtrArray *reviews)
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
 	AsReview *review;
 	guint i;
-	g_autoptr(AsProfileTask) ptask = NULL;
-	g_autoptr(GPtrArray) reviews = NULL;
-
-	/* profile */
-	ptask = as_profile_start_literal (gs_plugin_get_profile (plugin),
-					  "odrs::refine-reviews");
-	g_assert (ptask != NULL);
 
-	/* get from server */
-	reviews = gs_plugin_odrs_fetch_for_app (plugin, app, error);
-	if (reviews == NULL)
-		return FALSE;
 	for (i = 0; i < reviews->len; i++) {
 		review = g_ptr_array_index (reviews, i);
 
@@ -663,6 +854,193 @@ gs_plugin_odrs_refine_reviews (GsPlugin *plugin,
 		}
 		gs_app_add_review (app, review);
 	}
+}
+
+typedef struct {
+	GPtrArray		*apps;		/* all with the same ID */
+	GPtrArray		*reviews;
+	GError			*error;
+} GsOdrsFetchItem;
+
+static void
+gs_odrs_fetch_item_free (GsOdrsFetchItem *item)
+{
+	g_ptr_array_unref (item->apps);
+	if (item->reviews != NULL)
+		g_ptr_array_unref (item->reviews);
+	g_clear_error (&item->error);
+	g_free (item);
+}
+
+typedef struct {
+	GsPlugin		*plugin;
+	GPtrArray		*items;
+	GCancellable		*cancellable;
+	GMutex			 mutex;
+	guint			 next;
+} GsOdrsFetchHelper;
+
+/* each worker takes the next item until there are none left */
+static gpointer
+gs_plugin_odrs_fetch_thread_cb (gpointer user_data)
+{
+	GsOdrsFetchHelper *helper = (GsOdrsFetchHelper *) user_data;
+
+	while (TRUE) {
+		GsOdrsFetchItem *item;
+		GsApp *app;
+
+		g_mutex_lock (&helper->mutex);
+		if (helper->next >= helper->items->len) {
+			g_mutex_unlock (&helper->mutex);
+			break;
+		}
+		item = g_ptr_array_index (helper->items, helper->next++);
+		g_mutex_unlock (&helper->mutex);
+
+		if (g_cancellable_set_error_if_cancelled (helper->cancellable,
+							  &item->error)) {
+			gs_utils_error_convert_gio (&item->error);
+			continue;
+		}
+		app = g_ptr_array_index (item->apps, 0);
+		item->reviews = gs_plugin_odrs_fetch_for_app (helper->plugin,
+							      app,
+							      &item->error);
+	}
+	return NULL;
+}
+
+static gboolean
+gs_plugin_odrs_refine_reviews (GsPlugin *plugin,
+			       GsAppList *list,
+			       GCancellable *cancellable,
+			       GError **error)
+{
+	GsOdrsFetchHelper helper;
+	GsReviewStore *store = gs_plugin_get_review_store (plugin);
+	guint i;
+	guint n_threads;
+	g_autoptr(AsProfileTask) ptask = NULL;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GHashTable) items_by_id = NULL;
+	g_autoptr(GPtrArray) items = NULL;
+	g_autoptr(GPtrArray) misses = NULL;
+	g_autoptr(GPtrArray) threads = NULL;
+
+	/* profile */
+	ptask = as_profile_start_literal (gs_plugin_get_profile (plugin),
+					  "odrs::refine-reviews");
+	g_assert (ptask != NULL);
+
+	/* only fetch once for each ID */
+	items = g_ptr_array_new_with_free_func ((GDestroyNotify) gs_odrs_fetch_item_free);
+	items_by_id = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+		GsOdrsFetchItem *item;
+
+		/* not valid */
+		if (gs_app_get_kind (app) == AS_APP_KIND_ADDON)
+			continue;
+		if (gs_app_get_id (app) == NULL)
+			continue;
+		if (gs_app_get_reviews (app)->len > 0)
+			continue;
+
+		item = g_hash_table_lookup (items_by_id, gs_app_get_id (app));
+		if (item == NULL) {
+			item = g_new0 (GsOdrsFetchItem, 1);
+			item->apps = g_ptr_array_new ();
+			g_ptr_array_add (items, item);
+			g_hash_table_insert (items_by_id,
+					     (gpointer) gs_app_get_id (app),
+					     item);
+		}
+		g_ptr_array_add (item->apps, app);
+	}
+
+	/* use the cache where possible */
+	misses = g_ptr_array_new ();
+	for (i = 0; i < items->len; i++) {
+		GsOdrsFetchItem *item = g_ptr_array_index (items, i);
+		GsApp *app = g_ptr_array_index (item->apps, 0);
+
+		item->reviews = gs_review_store_get_reviews (store,
+							     gs_app_get_id (app),
+							     ODRS_REVIEW_CACHE_AGE_MAX);
+		if (item->reviews != NULL) {
+			g_debug ("got review data for %s from cache",
+				 gs_app_get_id (app));
+			continue;
+		}
+		g_ptr_array_add (misses, item);
+	}
+
+	/* fetch the rest, with a few requests in flight at once */
+	memset (&helper, 0, sizeof (helper));
+	helper.plugin = plugin;
+	helper.items = misses;
+	helper.cancellable = cancellable;
+	g_mutex_init (&helper.mutex);
+	n_threads = MIN (misses->len, ODRS_REVIEW_FETCH_MAX_INFLIGHT);
+	threads = g_ptr_array_new ();
+	for (i = 1; i < n_threads; i++) {
+		g_ptr_array_add (threads, g_thread_new ("gs-odrs-fetch",
+							gs_plugin_odrs_fetch_thread_cb,
+							&helper));
+	}
+	gs_plugin_odrs_fetch_thread_cb (&helper);
+	for (i = 0; i < threads->len; i++)
+		g_thread_join (g_ptr_array_index (threads, i));
+	g_mutex_clear (&helper.mutex);
+
+	/* save what was downloaded */
+	for (i = 0; i < misses->len; i++) {
+		GsOdrsFetchItem *item = g_ptr_array_index (misses, i);
+		GsApp *app = g_ptr_array_index (item->apps, 0);
+		if (item->reviews == NULL)
+			continue;
+		gs_review_store_add_reviews (store, gs_app_get_id (app), item->reviews);
+	}
+	if (misses->len > 0 && !gs_review_store_save (store, &error_local))
+		g_warning ("%s", error_local->message);
+
+	/* add everything that succeeded before reporting any failure */
+	for (i = 0; i < items->len; i++) {
+		GsOdrsFetchItem *item = g_ptr_array_index (items, i);
+		guint j;
+		if (item->reviews == NULL)
+			continue;
+		for (j = 0; j < item->apps->len; j++) {
+			gs_plugin_odrs_add_reviews (plugin,
+						    g_ptr_array_index (item->apps, j),
+						    item->reviews);
+		}
+	}
+	for (i = 0; i < misses->len; i++) {
+		GsOdrsFetchItem *item = g_ptr_array_index (misses, i);
+		if (item->error != NULL) {
+			g_propagate_error (error, g_steal_pointer (&item->error));
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+gboolean
+gs_plugin_refine (GsPlugin *plugin,
+		  GsAppList *list,
+		  GsPluginRefineFlags flags,
+		  GCancellable *cancellable,
+		  GError **error)
+{
+	/* add reviews if possible */
+	if (flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEWS) {
+		if (!gs_plugin_odrs_refine_reviews (plugin, list,
+						    cancellable, error))
+			return FALSE;
+	}
 	return TRUE;
 }
 
@@ -679,15 +1057,6 @@ gs_plugin_refine_app (GsPlugin *plugin,
 	if (gs_app_get_id (app) == NULL)
 		return TRUE;
 
-	/* add reviews if possible */
-	if (flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEWS) {
-		if (gs_app_get_reviews(app)->len > 0)
-			return TRUE;
-		if (!gs_plugin_odrs_refine_reviews (plugin, app,
-						    cancellable, error))
-			return FALSE;
-	}
-
 	/* add ratings if possible */
 	if (flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEW_RATINGS ||
 	    flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_RATING) {
@@ -729,25 +1098,14 @@ gs_plugin_odrs_sanitize_version (const gchar *version)
 }
 
 static gboolean
-gs_plugin_odrs_invalidate_cache (AsReview *review, GError **error)
-{
-	g_autofree gchar *cachefn_basename = NULL;
-	g_autofree gchar *cachefn = NULL;
-	g_autoptr(GFile) cachefn_file = NULL;
-
-	/* look in the cache */
-	cachefn_basename = g_strdup_printf ("%s.json",
-					    as_review_get_metadata_item (review, "app_id"));
-	cachefn = gs_utils_get_cache_filename ("reviews",
-					       cachefn_basename,
-					       GS_UTILS_CACHE_FLAG_WRITEABLE,
-					       error);
-	if (cachefn == NULL)
-		return FALSE;
-	cachefn_file = g_file_new_for_path (cachefn);
-	if (!g_file_query_exists (cachefn_file, NULL))
-		return TRUE;
-	return g_file_delete (cachefn_file, NULL, error);
+gs_plugin_odrs_invalidate_cache (GsPlugin *plugin, AsReview *review, GError **error)
+{
+	GsReviewStore *store = gs_plugin_get_review_store (plugin);
+	const gchar *app_id = as_review_get_metadata_item (review, "app_id");
+
+	/* drop the stored reviews */
+	gs_review_store_invalidate (store, app_id);
+	return gs_review_store_save (store, error);
 }
 
 gboolean
@@ -807,7 +1165,7 @@ gs_plugin_review_submit (GsPlugin *plugin,
 	data = json_generator_to_data (json_generator, NULL);
 
 	/* clear cache */
-	if (!gs_plugin_odrs_invalidate_cache (review, error))
+	if (!gs_plugin_odrs_invalidate_cache (plugin, review, error))
 		return FALSE;
 
 	/* POST */
@@ -858,7 +1216,7 @@ gs_plugin_odrs_vote (GsPlugin *plugin, AsReview *review,
 		return FALSE;
 
 	/* clear cache */
-	if (!gs_plugin_odrs_invalidate_cache (review, error))
+	if (!gs_plugin_odrs_invalidate_cache (plugin, review, error))
 		return FALSE;
 
 	/* send to server */
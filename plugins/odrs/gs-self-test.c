@@ -0,0 +1,298 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <json-glib/json-glib.h>
+
+#include "gnome-software-private.h"
+
+#include "gs-test.h"
+
+/* a mock ODRS server running in its own thread */
+typedef struct {
+	GMutex		 mutex;
+	GCond		 cond;
+	GMainLoop	*loop;
+	SoupServer	*server;
+	gchar		*uri;
+	gint		 fetches;
+	GsPluginLoader	*plugin_loader;
+} GsOdrsTestServer;
+
+static void
+gs_odrs_test_server_cb (SoupServer *server,
+			SoupMessage *msg,
+			const char *path,
+			GHashTable *query,
+			SoupClientContext *client,
+			gpointer user_data)
+{
+	GsOdrsTestServer *helper = (GsOdrsTestServer *) user_data;
+	JsonObject *json_obj;
+	const gchar *app_id;
+	g_autofree gchar *reply = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(JsonParser) parser = NULL;
+
+	if (g_strcmp0 (path, "/ratings") == 0) {
+		const gchar *ratings = "{\"org.example.One\":{\"star0\":0,"
+				       "\"star1\":0,\"star2\":0,\"star3\":0,"
+				       "\"star4\":1,\"star5\":4}}";
+		soup_message_set_status (msg, SOUP_STATUS_OK);
+		soup_message_set_response (msg, "application/json",
+					   SOUP_MEMORY_STATIC,
+					   ratings, strlen (ratings));
+		return;
+	}
+	if (g_strcmp0 (path, "/fetch") != 0) {
+		soup_message_set_status (msg, SOUP_STATUS_NOT_FOUND);
+		return;
+	}
+
+	/* reply with one review for the requested ID */
+	parser = json_parser_new ();
+	if (!json_parser_load_from_data (parser,
+					 msg->request_body->data,
+					 msg->request_body->length,
+					 &error)) {
+		soup_message_set_status (msg, SOUP_STATUS_BAD_REQUEST);
+		return;
+	}
+	json_obj = json_node_get_object (json_parser_get_root (parser));
+	app_id = json_object_get_string_member (json_obj, "app_id");
+	g_atomic_int_inc (&helper->fetches);
+	reply = g_strdup_printf ("[{\"app_id\":\"%s\",\"rating\":80,"
+				 "\"review_id\":1,\"user_skey\":\"skey\","
+				 "\"user_hash\":\"hash\",\"version\":\"1.0\","
+				 "\"summary\":\"Review of %s\"}]",
+				 app_id, app_id);
+	soup_message_set_status (msg, SOUP_STATUS_OK);
+	soup_message_set_response (msg, "application/json",
+				   SOUP_MEMORY_COPY,
+				   reply, strlen (reply));
+}
+
+static gpointer
+gs_odrs_test_server_thread (gpointer user_data)
+{
+	GsOdrsTestServer *helper = (GsOdrsTestServer *) user_data;
+	GSList *uris;
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GMainContext) context = g_main_context_new ();
+
+	g_main_context_push_thread_default (context);
+	helper->server = soup_server_new (SOUP_SERVER_SERVER_HEADER, "gs-self-test", NULL);
+	soup_server_add_handler (helper->server, NULL,
+				 gs_odrs_test_server_cb,
+				 helper, NULL);
+	ret = soup_server_listen_local (helper->server, 0,
+					SOUP_SERVER_LISTEN_IPV4_ONLY,
+					&error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	uris = soup_server_get_uris (helper->server);
+	helper->loop = g_main_loop_new (context, FALSE);
+
+	/* server is ready */
+	g_mutex_lock (&helper->mutex);
+	helper->uri = soup_uri_to_string (uris->data, FALSE);
+	g_cond_signal (&helper->cond);
+	g_mutex_unlock (&helper->mutex);
+	g_slist_free_full (uris, (GDestroyNotify) soup_uri_free);
+
+	g_main_loop_run (helper->loop);
+	g_clear_object (&helper->server);
+	g_main_context_pop_thread_default (context);
+	return NULL;
+}
+
+static gboolean
+gs_odrs_test_server_quit_cb (gpointer user_data)
+{
+	g_main_loop_quit ((GMainLoop *) user_data);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+gs_plugins_odrs_refine_reviews_func (gconstpointer user_data)
+{
+	GsOdrsTestServer *helper = (GsOdrsTestServer *) user_data;
+	GsPluginLoader *plugin_loader = helper->plugin_loader;
+	GPtrArray *reviews;
+	guint i;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GsAppList) list = NULL;
+	g_autoptr(GsAppList) list_cached = NULL;
+	g_autoptr(GsReviewStore) store_loaded = gs_review_store_new ();
+
+	/* no odrs, abort */
+	if (!gs_plugin_loader_get_enabled (plugin_loader, "odrs")) {
+		g_test_skip ("not enabled");
+		return;
+	}
+
+	/* more apps than requests allowed in flight, all refined at once */
+	list = gs_plugin_loader_search (plugin_loader,
+					"example", 0,
+					NULL, NULL,
+					GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEWS,
+					GS_PLUGIN_FAILURE_FLAGS_FATAL_ANY,
+					NULL,
+					&error);
+	gs_test_flush_main_context ();
+	g_assert_no_error (error);
+	g_assert (list != NULL);
+	g_assert_cmpint (gs_app_list_length (list), ==, 5);
+	g_assert_cmpint (g_atomic_int_get (&helper->fetches), ==, 5);
+	for (i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+		g_autofree gchar *summary = NULL;
+		reviews = gs_app_get_reviews (app);
+		g_assert_cmpint (reviews->len, ==, 1);
+		summary = g_strdup_printf ("Review of %s", gs_app_get_id (app));
+		g_assert_cmpstr (as_review_get_summary (g_ptr_array_index (reviews, 0)), ==, summary);
+		g_assert_cmpstr (gs_app_get_metadata_item (app, "ODRS::user_skey"), ==, "skey");
+	}
+
+	/* nothing is fetched again */
+	list_cached = gs_plugin_loader_search (plugin_loader,
+					       "example", 0,
+					       NULL, NULL,
+					       GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEWS,
+					       GS_PLUGIN_FAILURE_FLAGS_FATAL_ANY,
+					       NULL,
+					       &error);
+	gs_test_flush_main_context ();
+	g_assert_no_error (error);
+	g_assert (list_cached != NULL);
+	g_assert_cmpint (gs_app_list_length (list_cached), ==, 5);
+	g_assert_cmpint (g_atomic_int_get (&helper->fetches), ==, 5);
+	for (i = 0; i < gs_app_list_length (list_cached); i++) {
+		GsApp *app = gs_app_list_index (list_cached, i);
+		g_assert_cmpint (gs_app_get_reviews (app)->len, ==, 1);
+	}
+
+	/* the reviews were saved in the shared store */
+	reviews = gs_review_store_get_reviews (store_loaded, "org.example.Three", G_MAXUINT);
+	g_assert (reviews != NULL);
+	g_assert_cmpint (reviews->len, ==, 1);
+	g_assert_cmpstr (as_review_get_summary (g_ptr_array_index (reviews, 0)), ==,
+			 "Review of org.example.Three");
+	g_ptr_array_unref (reviews);
+}
+
+int
+main (int argc, char **argv)
+{
+	GsOdrsTestServer helper;
+	GThread *thread;
+	gboolean ret;
+	gint rc;
+	g_autofree gchar *server = NULL;
+	g_autofree gchar *tmp_root = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GsPluginLoader) plugin_loader = NULL;
+	g_autoptr(GString) xml = g_string_new (NULL);
+	const gchar *whitelist[] = {
+		"appstream",
+		"odrs",
+		NULL
+	};
+	const gchar *ids[] = { "org.example.One", "org.example.Two",
+			       "org.example.Three", "org.example.Four",
+			       "org.example.Five", NULL };
+
+	g_test_init (&argc, &argv, NULL);
+	g_setenv ("G_MESSAGES_DEBUG", "all", TRUE);
+
+	/* keep the downloaded data away from the real cache */
+	tmp_root = g_dir_make_tmp ("gnome-software-odrs-test-XXXXXX", NULL);
+	g_assert (tmp_root != NULL);
+	g_setenv ("XDG_CACHE_HOME", tmp_root, TRUE);
+
+	/* the apps to get reviews for */
+	g_string_append (xml, "<?xml version=\"1.0\"?>\n"
+			      "<components version=\"0.9\">\n");
+	for (guint i = 0; ids[i] != NULL; i++) {
+		g_string_append_printf (xml,
+			"  <component type=\"desktop\">\n"
+			"    <id>%s</id>\n"
+			"    <name>Example %u</name>\n"
+			"    <summary>An example application</summary>\n"
+			"  </component>\n", ids[i], i);
+	}
+	g_string_append (xml, "</components>\n");
+	g_setenv ("GS_SELF_TEST_APPSTREAM_XML", xml->str, TRUE);
+
+	/* only critical and error are fatal */
+	g_log_set_fatal_mask (NULL, G_LOG_LEVEL_ERROR | G_LOG_LEVEL_CRITICAL);
+
+	/* start the mock server before the plugin reads the address */
+	memset (&helper, 0, sizeof (helper));
+	g_mutex_init (&helper.mutex);
+	g_cond_init (&helper.cond);
+	thread = g_thread_new ("gs-odrs-test-server",
+			       gs_odrs_test_server_thread,
+			       &helper);
+	g_mutex_lock (&helper.mutex);
+	while (helper.uri == NULL)
+		g_cond_wait (&helper.cond, &helper.mutex);
+	g_mutex_unlock (&helper.mutex);
+	server = g_strndup (helper.uri, strlen (helper.uri) - 1);
+	g_setenv ("GS_SELF_TEST_ODRS_SERVER", server, TRUE);
+
+	/* we can only load this once per process */
+	plugin_loader = gs_plugin_loader_new ();
+	gs_plugin_loader_add_location (plugin_loader, LOCALPLUGINDIR);
+	gs_plugin_loader_add_location (plugin_loader, LOCALPLUGINDIR_CORE);
+	ret = gs_plugin_loader_setup (plugin_loader,
+				      (gchar**) whitelist,
+				      NULL,
+				      GS_PLUGIN_FAILURE_FLAGS_NONE,
+				      NULL,
+				      &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	helper.plugin_loader = plugin_loader;
+
+	/* plugin tests go here */
+	g_test_add_data_func ("/gnome-software/plugins/odrs/refine-reviews",
+			      &helper,
+			      gs_plugins_odrs_refine_reviews_func);
+	rc = g_test_run ();
+	g_clear_object (&plugin_loader);
+
+	/* stop the mock server */
+	g_main_context_invoke (g_main_loop_get_context (helper.loop),
+			       gs_odrs_test_server_quit_cb,
+			       helper.loop);
+	g_thread_join (thread);
+	g_main_loop_unref (helper.loop);
+	g_free (helper.uri);
+	g_mutex_clear (&helper.mutex);
+	g_cond_clear (&helper.cond);
+	return rc;
+}
+
+/* vim: set noexpandtab: */
@@ -87,6 +87,9 @@ struct _GsMarkdown {
 	gboolean		 autolinkify;
 	GString			*pending;
 	GString			*processed;
+	GString			*scratch1;	/* reused for each paragraph */
+	GString			*scratch2;
+	GString			*scratch3;
 };
 
 G_DEFINE_TYPE (GsMarkdown, gs_markdown, G_TYPE_OBJECT)
@@ -99,25 +102,16 @@ G_DEFINE_TYPE (GsMarkdown, gs_markdown, G_TYPE_OBJECT)
  * You may use spaces between the hyphens or asterisks.
  **/
 static gboolean
-gs_markdown_to_text_line_is_rule (const gchar *line)
+gs_markdown_to_text_line_is_rule (const gchar *line, gsize len)
 {
-	guint i;
-	guint len;
 	guint count = 0;
-	g_autofree gchar *copy = NULL;
 
-	len = (guint) strlen (line);
-	if (len == 0)
-		return FALSE;
-
-	/* replace non-rule chars with ~ */
-	copy = g_strdup (line);
-	g_strcanon (copy, "-*_ ", '~');
-	for (i = 0; i < len; i++) {
-		if (copy[i] == '~')
+	for (gsize i = 0; i < len; i++) {
+		if (line[i] == ' ')
+			continue;
+		if (line[i] != '-' && line[i] != '*' && line[i] != '_')
 			return FALSE;
-		if (copy[i] != ' ')
-			count++;
+		count++;
 	}
 
 	/* if we matched, return true */
@@ -127,439 +121,464 @@ gs_markdown_to_text_line_is_rule (const gchar *line)
 }
 
 static gboolean
-gs_markdown_to_text_line_is_bullet (const gchar *line)
-{
-	return (g_str_has_prefix (line, "- ") ||
-		g_str_has_prefix (line, "* ") ||
-		g_str_has_prefix (line, "+ ") ||
-		g_str_has_prefix (line, " - ") ||
-		g_str_has_prefix (line, " * ") ||
-		g_str_has_prefix (line, " + "));
-}
-
-static gboolean
-gs_markdown_to_text_line_is_header1 (const gchar *line)
+gs_markdown_has_prefix (const gchar *line, gsize len, const gchar *prefix)
 {
-	return g_str_has_prefix (line, "# ");
+	gsize prefix_len = strlen (prefix);
+	if (len < prefix_len)
+		return FALSE;
+	return memcmp (line, prefix, prefix_len) == 0;
 }
 
 static gboolean
-gs_markdown_to_text_line_is_header2 (const gchar *line)
+gs_markdown_to_text_line_is_bullet (const gchar *line, gsize len)
 {
-	return g_str_has_prefix (line, "## ");
+	return (gs_markdown_has_prefix (line, len, "- ") ||
+		gs_markdown_has_prefix (line, len, "* ") ||
+		gs_markdown_has_prefix (line, len, "+ ") ||
+		gs_markdown_has_prefix (line, len, " - ") ||
+		gs_markdown_has_prefix (line, len, " * ") ||
+		gs_markdown_has_prefix (line, len, " + "));
 }
 
 static gboolean
-gs_markdown_to_text_line_is_header1_type2 (const gchar *line)
+gs_markdown_to_text_line_is_header1 (const gchar *line, gsize len)
 {
-	return g_str_has_prefix (line, "===");
+	return gs_markdown_has_prefix (line, len, "# ");
 }
 
 static gboolean
-gs_markdown_to_text_line_is_header2_type2 (const gchar *line)
+gs_markdown_to_text_line_is_header2 (const gchar *line, gsize len)
 {
-	return g_str_has_prefix (line, "---");
+	return gs_markdown_has_prefix (line, len, "## ");
 }
 
-#if 0
 static gboolean
-gs_markdown_to_text_line_is_code (const gchar *line)
+gs_markdown_to_text_line_is_header1_type2 (const gchar *line, gsize len)
 {
-	return (g_str_has_prefix (line, "    ") ||
-		g_str_has_prefix (line, "\t"));
+	return gs_markdown_has_prefix (line, len, "===");
 }
 
 static gboolean
-gs_markdown_to_text_line_is_blockquote (const gchar *line)
+gs_markdown_to_text_line_is_header2_type2 (const gchar *line, gsize len)
 {
-	return (g_str_has_prefix (line, "> "));
+	return gs_markdown_has_prefix (line, len, "---");
 }
-#endif
 
 static gboolean
-gs_markdown_to_text_line_is_blank (const gchar *line)
+gs_markdown_to_text_line_is_blank (const gchar *line, gsize len)
 {
-	guint i;
-	guint len;
-
-	/* a line with no characters is blank by definition */
-	len = (guint) strlen (line);
-	if (len == 0)
-		return TRUE;
-
 	/* find if there are only space chars */
-	for (i = 0; i < len; i++) {
+	for (gsize i = 0; i < len; i++) {
 		if (line[i] != ' ' && line[i] != '\t')
 			return FALSE;
 	}
 
-	/* if we matched, return true */
+	/* a line with no characters is blank by definition */
 	return TRUE;
 }
 
-static gchar *
-gs_markdown_replace (const gchar *haystack,
-		     const gchar *needle,
-		     const gchar *replace)
-{
-	g_auto(GStrv) split = NULL;
-	split = g_strsplit (haystack, needle, -1);
-	return g_strjoinv (replace, split);
-}
-
-static gchar *
-gs_markdown_strstr_spaces (const gchar *haystack, const gchar *needle)
-{
-	gchar *found;
-	const gchar *haystack_new = haystack;
-
-retry:
-	/* don't find if surrounded by spaces */
-	found = strstr (haystack_new, needle);
-	if (found == NULL)
-		return NULL;
-
-	/* start of the string, always valid */
-	if (found == haystack)
-		return found;
-
-	/* end of the string, always valid */
-	if (*(found-1) == ' ' && *(found+1) == ' ') {
-		haystack_new = found+1;
-		goto retry;
+/*
+ * gs_markdown_find_formatter:
+ *
+ * Finds the next @formatter in @text starting at @from, ignoring any that are
+ * surrounded by spaces. @prev is the character before @from, and a formatter
+ * right at @from is always accepted if @from_valid is set.
+ *
+ * Returns: the offset, or -1 if not found
+ **/
+static gssize
+gs_markdown_find_formatter (const gchar *text,
+			    gsize len,
+			    gsize from,
+			    const gchar *formatter,
+			    gsize formatter_len,
+			    gchar prev,
+			    gboolean from_valid)
+{
+	gsize i = from;
+
+	while (i + formatter_len <= len) {
+		const gchar *found;
+		gchar before;
+		gchar after;
+
+		found = memchr (text + i, formatter[0], len - i - formatter_len + 1);
+		if (found == NULL)
+			return -1;
+		i = (gsize) (found - text);
+		if (memcmp (found, formatter, formatter_len) != 0) {
+			i++;
+			continue;
+		}
+		if (i == from && from_valid)
+			return (gssize) i;
+		before = i == from ? prev : text[i - 1];
+		after = i + 1 < len ? text[i + 1] : '\0';
+		if (before == ' ' && after == ' ') {
+			i++;
+			continue;
+		}
+		return (gssize) i;
 	}
-	return found;
+	return -1;
 }
 
-static gchar *
-gs_markdown_to_text_line_formatter (const gchar *line,
-				    const gchar *formatter,
-				    const gchar *left,
-				    const gchar *right)
-{
-	guint len;
-	gchar *str1;
-	gchar *str2;
-	gchar *start = NULL;
-	gchar *middle = NULL;
-	gchar *end = NULL;
-	g_autofree gchar *copy = NULL;
-
-	/* needed to know for shifts */
-	len = (guint) strlen (formatter);
-	if (len == 0)
-		return NULL;
-
-	/* find sections */
-	copy = g_strdup (line);
-	str1 = gs_markdown_strstr_spaces (copy, formatter);
-	if (str1 != NULL) {
-		*str1 = '\0';
-		str2 = gs_markdown_strstr_spaces (str1+len, formatter);
-		if (str2 != NULL) {
-			*str2 = '\0';
-			middle = str1 + len;
-			start = copy;
-			end = str2 + len;
-		}
+/*
+ * gs_markdown_format_pairs:
+ *
+ * Replaces each pair of @formatter in @text with @left and @right, in the
+ * same order as matching the first pair, substituting and starting again.
+ * Nothing is replaced after a formatter that has no partner.
+ **/
+static void
+gs_markdown_format_pairs (const gchar *text,
+			  gsize len,
+			  const gchar *formatter,
+			  const gchar *left,
+			  const gchar *right,
+			  GString *out)
+{
+	gsize formatter_len = strlen (formatter);
+	gsize pos = 0;
+
+	g_string_truncate (out, 0);
+	while (pos < len) {
+		gssize start;
+		gssize end;
+
+		/* the text already written counts as what comes before */
+		start = gs_markdown_find_formatter (text, len, pos,
+						    formatter, formatter_len,
+						    out->len > 0 ? out->str[out->len - 1] : '\0',
+						    out->len == 0);
+		if (start < 0)
+			break;
+		end = gs_markdown_find_formatter (text, len,
+						  (gsize) start + formatter_len,
+						  formatter, formatter_len,
+						  '\0', TRUE);
+		if (end < 0)
+			break;
+		g_string_append_len (out, text + pos, start - (gssize) pos);
+		g_string_append (out, left);
+		g_string_append_len (out,
+				     text + start + formatter_len,
+				     end - start - (gssize) formatter_len);
+		g_string_append (out, right);
+		pos = (gsize) end + formatter_len;
 	}
+	g_string_append_len (out, text + pos, (gssize) (len - pos));
+}
 
-	/* if we found, replace and keep looking for the same string */
-	if (start != NULL && middle != NULL && end != NULL) {
-		g_autofree gchar *temp = NULL;
-		temp = g_strdup_printf ("%s%s%s%s%s", start, left, middle, right, end);
-		/* recursive */
-		return gs_markdown_to_text_line_formatter (temp, formatter, left, right);
+static void
+gs_markdown_replace (const gchar *text,
+		     gsize len,
+		     const gchar *needle,
+		     const gchar *replace,
+		     GString *out)
+{
+	gsize needle_len = strlen (needle);
+	gsize pos = 0;
+
+	g_string_truncate (out, 0);
+	for (gsize i = 0; i + needle_len <= len; i++) {
+		if (memcmp (text + i, needle, needle_len) != 0)
+			continue;
+		g_string_append_len (out, text + pos, (gssize) (i - pos));
+		g_string_append (out, replace);
+		i += needle_len - 1;
+		pos = i + 1;
 	}
-
-	/* not found, keep return as-is */
-	return g_strdup (line);
+	g_string_append_len (out, text + pos, (gssize) (len - pos));
 }
 
-static gchar *
-gs_markdown_to_text_line_format_sections (GsMarkdown *self, const gchar *line)
+/* runs one formatting pass from @in to @out and swaps them */
+#define GS_MARKDOWN_SWAP(in, out) { GString *tmp_ = in; in = out; out = tmp_; }
+
+static void
+gs_markdown_to_text_line_format_sections (GsMarkdown *self,
+					  const gchar *line,
+					  gsize len,
+					  GString *out)
 {
-	gchar *data = g_strdup (line);
-	gchar *temp;
+	GString *in = self->scratch2;
+	GString *next = self->scratch3;
 
 	/* bold1 */
-	temp = data;
-	data = gs_markdown_to_text_line_formatter (temp, "**",
-						   self->tags.strong_start,
-						   self->tags.strong_end);
-	g_free (temp);
+	gs_markdown_format_pairs (line, len, "**",
+				  self->tags.strong_start,
+				  self->tags.strong_end, next);
+	GS_MARKDOWN_SWAP (in, next);
 
 	/* bold2 */
-	temp = data;
-	data = gs_markdown_to_text_line_formatter (temp, "__",
-						   self->tags.strong_start,
-						   self->tags.strong_end);
-	g_free (temp);
+	gs_markdown_format_pairs (in->str, in->len, "__",
+				  self->tags.strong_start,
+				  self->tags.strong_end, next);
+	GS_MARKDOWN_SWAP (in, next);
 
 	/* italic1 */
-	temp = data;
-	data = gs_markdown_to_text_line_formatter (temp, "*",
-						   self->tags.em_start,
-						   self->tags.em_end);
-	g_free (temp);
+	gs_markdown_format_pairs (in->str, in->len, "*",
+				  self->tags.em_start,
+				  self->tags.em_end, next);
+	GS_MARKDOWN_SWAP (in, next);
 
 	/* italic2 */
-	temp = data;
-	data = gs_markdown_to_text_line_formatter (temp, "_",
-						   self->tags.em_start,
-						   self->tags.em_end);
-	g_free (temp);
+	gs_markdown_format_pairs (in->str, in->len, "_",
+				  self->tags.em_start,
+				  self->tags.em_end, next);
+	GS_MARKDOWN_SWAP (in, next);
 
 	/* em-dash */
-	temp = data;
-	data = gs_markdown_replace (temp, " -- ", " — ");
-	g_free (temp);
+	gs_markdown_replace (in->str, in->len, " -- ", " — ", next);
+	GS_MARKDOWN_SWAP (in, next);
 
 	/* smart quoting */
 	if (self->smart_quoting) {
-		temp = data;
-		data = gs_markdown_to_text_line_formatter (temp, "\"", "“", "”");
-		g_free (temp);
+		gs_markdown_format_pairs (in->str, in->len, "\"", "“", "”", next);
+		GS_MARKDOWN_SWAP (in, next);
 
-		temp = data;
-		data = gs_markdown_to_text_line_formatter (temp, "'", "‘", "’");
-		g_free (temp);
+		gs_markdown_format_pairs (in->str, in->len, "'", "‘", "’", next);
+		GS_MARKDOWN_SWAP (in, next);
 	}
 
-	return data;
+	g_string_append_len (out, in->str, (gssize) in->len);
 }
 
-static gchar *
-gs_markdown_to_text_line_format (GsMarkdown *self, const gchar *line)
+static void
+gs_markdown_to_text_line_format (GsMarkdown *self,
+				 const gchar *line,
+				 gsize len,
+				 GString *out)
 {
-	GString *string;
 	gboolean mode = FALSE;
-	gchar *text;
-	guint i;
-	g_auto(GStrv) codes = NULL;
-
-	/* optimise the trivial case where we don't have any code tags */
-	text = strstr (line, "`");
-	if (text == NULL)
-		return gs_markdown_to_text_line_format_sections (self, line);
+	gsize pos = 0;
 
 	/* we want to parse the code sections without formatting */
-	codes = g_strsplit (line, "`", -1);
-	string = g_string_new ("");
-	for (i = 0; codes[i] != NULL; i++) {
+	while (TRUE) {
+		const gchar *tick = memchr (line + pos, '`', len - pos);
+		gsize section_len = tick != NULL ? (gsize) (tick - line) - pos : len - pos;
 		if (!mode) {
-			text = gs_markdown_to_text_line_format_sections (self, codes[i]);
-			g_string_append (string, text);
-			g_free (text);
+			gs_markdown_to_text_line_format_sections (self,
+								  line + pos,
+								  section_len,
+								  out);
 			mode = TRUE;
 		} else {
 			/* just append without formatting */
-			g_string_append (string, self->tags.code_start);
-			g_string_append (string, codes[i]);
-			g_string_append (string, self->tags.code_end);
+			g_string_append (out, self->tags.code_start);
+			g_string_append_len (out, line + pos, (gssize) section_len);
+			g_string_append (out, self->tags.code_end);
 			mode = FALSE;
 		}
+		if (tick == NULL)
+			break;
+		pos += section_len + 1;
 	}
-	return g_string_free (string, FALSE);
 }
 
 static gboolean
-gs_markdown_add_pending (GsMarkdown *self, const gchar *line)
+gs_markdown_add_pending_full (GsMarkdown *self,
+			      const gchar *line,
+			      gsize len,
+			      gboolean header)
 {
-	g_autofree gchar *copy = NULL;
+	gsize start = 0;
+	gsize end = len;
 
 	/* would put us over the limit */
 	if (self->max_lines > 0 && self->line_count >= self->max_lines)
 		return FALSE;
 
-	copy = g_strdup (line);
-
-	/* strip leading and trailing spaces */
-	g_strstrip (copy);
+	/* strip leading and trailing spaces, and for headers any # */
+	while (start < end &&
+	       (g_ascii_isspace (line[start]) || (header && line[start] == '#')))
+		start++;
+	while (end > start &&
+	       (g_ascii_isspace (line[end - 1]) || (header && line[end - 1] == '#')))
+		end--;
 
 	/* append */
-	g_string_append_printf (self->pending, "%s ", copy);
+	if (!header) {
+		g_string_append_len (self->pending, line + start, (gssize) (end - start));
+	} else {
+		for (gsize i = start; i < end; i++)
+			g_string_append_c (self->pending, line[i] == '#' ? ' ' : line[i]);
+	}
+	g_string_append_c (self->pending, ' ');
 	return TRUE;
 }
 
 static gboolean
-gs_markdown_add_pending_header (GsMarkdown *self, const gchar *line)
+gs_markdown_add_pending (GsMarkdown *self, const gchar *line, gsize len)
 {
-	g_autofree gchar *copy = NULL;
+	return gs_markdown_add_pending_full (self, line, len, FALSE);
+}
 
+static gboolean
+gs_markdown_add_pending_header (GsMarkdown *self, const gchar *line, gsize len)
+{
 	/* strip trailing # */
-	copy = g_strdup (line);
-	g_strdelimit (copy, "#", ' ');
-	return gs_markdown_add_pending (self, copy);
+	return gs_markdown_add_pending_full (self, line, len, TRUE);
 }
 
-static guint
-gs_markdown_count_chars_in_word (const gchar *text, gchar find)
+static gboolean
+gs_markdown_word_is_code (const gchar *text, gsize len)
 {
-	guint i;
-	guint len;
 	guint count = 0;
 
-	/* get length */
-	len = (guint) strlen (text);
+	/* nothing special */
 	if (len == 0)
-		return 0;
-
-	/* find matching chars */
-	for (i = 0; i < len; i++) {
-		if (text[i] == find)
-			count++;
-	}
-	return count;
-}
+		return FALSE;
 
-static gboolean
-gs_markdown_word_is_code (const gchar *text)
-{
 	/* already code */
-	if (g_str_has_prefix (text, "`"))
+	if (text[0] == '`')
 		return FALSE;
-	if (g_str_has_suffix (text, "`"))
+	if (text[len - 1] == '`')
 		return FALSE;
 
 	/* paths */
-	if (g_str_has_prefix (text, "/"))
+	if (text[0] == '/')
 		return TRUE;
 
 	/* bugzillas */
-	if (g_str_has_prefix (text, "#"))
+	if (text[0] == '#')
 		return TRUE;
 
 	/* patch files */
-	if (g_strrstr (text, ".patch") != NULL)
+	if (g_strstr_len (text, (gssize) len, ".patch") != NULL)
 		return TRUE;
-	if (g_strrstr (text, ".diff") != NULL)
+	if (g_strstr_len (text, (gssize) len, ".diff") != NULL)
 		return TRUE;
 
 	/* function names */
-	if (g_strrstr (text, "()") != NULL)
+	if (g_strstr_len (text, (gssize) len, "()") != NULL)
 		return TRUE;
 
 	/* email addresses */
-	if (g_strrstr (text, "@") != NULL)
+	if (memchr (text, '@', len) != NULL)
 		return TRUE;
 
 	/* compiler defines */
-	if (text[0] != '_' &&
-	    gs_markdown_count_chars_in_word (text, '_') > 1)
-		return TRUE;
-
-	/* nothing special */
-	return FALSE;
-}
-
-static gchar *
-gs_markdown_word_auto_format_code (const gchar *text)
-{
-	guint i;
-	gchar *temp;
-	gboolean ret = FALSE;
-	g_auto(GStrv) words = NULL;
-
-	/* split sentence up with space */
-	words = g_strsplit (text, " ", -1);
-
-	/* search each word */
-	for (i = 0; words[i] != NULL; i++) {
-		if (gs_markdown_word_is_code (words[i])) {
-			temp = g_strdup_printf ("`%s`", words[i]);
-			g_free (words[i]);
-			words[i] = temp;
-			ret = TRUE;
+	if (text[0] != '_') {
+		for (gsize i = 0; i < len; i++) {
+			if (text[i] == '_')
+				count++;
 		}
+		if (count > 1)
+			return TRUE;
 	}
 
-	/* no replacements, so just return a copy */
-	if (!ret)
-		return g_strdup (text);
-
-	/* join the array back into a string */
-	return g_strjoinv (" ", words);
+	/* nothing special */
+	return FALSE;
 }
 
 static gboolean
-gs_markdown_word_is_url (const gchar *text)
+gs_markdown_word_is_url (const gchar *text, gsize len)
 {
-	if (g_str_has_prefix (text, "http://"))
+	if (gs_markdown_has_prefix (text, len, "http://"))
 		return TRUE;
-	if (g_str_has_prefix (text, "https://"))
+	if (gs_markdown_has_prefix (text, len, "https://"))
 		return TRUE;
-	if (g_str_has_prefix (text, "ftp://"))
+	if (gs_markdown_has_prefix (text, len, "ftp://"))
 		return TRUE;
 	return FALSE;
 }
 
-static gchar *
-gs_markdown_word_auto_format_urls (const gchar *text)
+static void
+gs_markdown_word_auto_format_code (const gchar *text, gsize len, GString *out)
 {
-	guint i;
-	gchar *temp;
-	gboolean ret = FALSE;
-	g_auto(GStrv) words = NULL;
-
-	/* split sentence up with space */
-	words = g_strsplit (text, " ", -1);
+	gsize pos = 0;
 
 	/* search each word */
-	for (i = 0; words[i] != NULL; i++) {
-		if (gs_markdown_word_is_url (words[i])) {
-			temp = g_strdup_printf ("<a href=\"%s\">%s</a>",
-						words[i], words[i]);
-			g_free (words[i]);
-			words[i] = temp;
-			ret = TRUE;
+	g_string_truncate (out, 0);
+	while (TRUE) {
+		const gchar *space = memchr (text + pos, ' ', len - pos);
+		gsize word_len = space != NULL ? (gsize) (space - text) - pos : len - pos;
+		if (gs_markdown_word_is_code (text + pos, word_len)) {
+			g_string_append_c (out, '`');
+			g_string_append_len (out, text + pos, (gssize) word_len);
+			g_string_append_c (out, '`');
+		} else {
+			g_string_append_len (out, text + pos, (gssize) word_len);
 		}
+		if (space == NULL)
+			break;
+		g_string_append_c (out, ' ');
+		pos += word_len + 1;
 	}
+}
 
-	/* no replacements, so just return a copy */
-	if (!ret)
-		return g_strdup (text);
+static void
+gs_markdown_word_auto_format_urls (const gchar *text, gsize len, GString *out)
+{
+	gsize pos = 0;
 
-	/* join the array back into a string */
-	return g_strjoinv (" ", words);
+	/* search each word */
+	g_string_truncate (out, 0);
+	while (TRUE) {
+		const gchar *space = memchr (text + pos, ' ', len - pos);
+		gsize word_len = space != NULL ? (gsize) (space - text) - pos : len - pos;
+		if (gs_markdown_word_is_url (text + pos, word_len)) {
+			g_string_append (out, "<a href=\"");
+			g_string_append_len (out, text + pos, (gssize) word_len);
+			g_string_append (out, "\">");
+			g_string_append_len (out, text + pos, (gssize) word_len);
+			g_string_append (out, "</a>");
+		} else {
+			g_string_append_len (out, text + pos, (gssize) word_len);
+		}
+		if (space == NULL)
+			break;
+		g_string_append_c (out, ' ');
+		pos += word_len + 1;
+	}
 }
 
 static void
 gs_markdown_flush_pending (GsMarkdown *self)
 {
-	g_autofree gchar *copy = NULL;
-	g_autofree gchar *temp = NULL;
+	GString *copy = self->pending;
+	GString *temp = self->scratch1;
 
 	/* no data yet */
 	if (self->mode == GS_MARKDOWN_MODE_UNKNOWN)
 		return;
 
+	/* nothing gets written for a gap */
+	if (self->mode == GS_MARKDOWN_MODE_BLANK) {
+		g_string_truncate (self->pending, 0);
+		return;
+	}
+
 	/* remove trailing spaces */
-	while (g_str_has_suffix (self->pending->str, " "))
-		g_string_set_size (self->pending, self->pending->len - 1);
+	while (copy->len > 0 && copy->str[copy->len - 1] == ' ')
+		g_string_truncate (copy, copy->len - 1);
 
 	/* pango requires escaping */
-	copy = g_strdup (self->pending->str);
 	if (!self->escape && self->output == GS_MARKDOWN_OUTPUT_PANGO) {
-		g_strdelimit (copy, "<", '(');
-		g_strdelimit (copy, ">", ')');
-		g_strdelimit (copy, "&", '+');
+		for (gsize i = 0; i < copy->len; i++) {
+			if (copy->str[i] == '<')
+				copy->str[i] = '(';
+			else if (copy->str[i] == '>')
+				copy->str[i] = ')';
+			else if (copy->str[i] == '&')
+				copy->str[i] = '+';
+		}
 	}
 
 	/* check words for code */
 	if (self->autocode &&
 	    (self->mode == GS_MARKDOWN_MODE_PARA ||
 	     self->mode == GS_MARKDOWN_MODE_BULLETT)) {
-		temp = gs_markdown_word_auto_format_code (copy);
-		g_free (copy);
-		copy = temp;
+		gs_markdown_word_auto_format_code (copy->str, copy->len, temp);
+		GS_MARKDOWN_SWAP (copy, temp);
 	}
 
 	/* escape */
 	if (self->escape) {
-		temp = g_markup_escape_text (copy, -1);
-		g_free (copy);
-		copy = temp;
+		g_autofree gchar *escaped = g_markup_escape_text (copy->str, (gssize) copy->len);
+		g_string_assign (temp, escaped);
+		GS_MARKDOWN_SWAP (copy, temp);
 	}
 
 	/* check words for URLS */
@@ -567,32 +586,31 @@ gs_markdown_flush_pending (GsMarkdown *self)
 	    self->output == GS_MARKDOWN_OUTPUT_PANGO &&
 	    (self->mode == GS_MARKDOWN_MODE_PARA ||
 	     self->mode == GS_MARKDOWN_MODE_BULLETT)) {
-		temp = gs_markdown_word_auto_format_urls (copy);
-		g_free (copy);
-		copy = temp;
+		gs_markdown_word_auto_format_urls (copy->str, copy->len, temp);
+		GS_MARKDOWN_SWAP (copy, temp);
 	}
 
 	/* do formatting */
-	temp = gs_markdown_to_text_line_format (self, copy);
 	if (self->mode == GS_MARKDOWN_MODE_BULLETT) {
-		g_string_append_printf (self->processed, "%s%s%s\n",
-					self->tags.bullet_start,
-					temp,
-					self->tags.bullet_end);
+		g_string_append (self->processed, self->tags.bullet_start);
+		gs_markdown_to_text_line_format (self, copy->str, copy->len, self->processed);
+		g_string_append (self->processed, self->tags.bullet_end);
+		g_string_append_c (self->processed, '\n');
 		self->line_count++;
 	} else if (self->mode == GS_MARKDOWN_MODE_H1) {
-		g_string_append_printf (self->processed, "%s%s%s\n",
-					self->tags.h1_start,
-					temp,
-					self->tags.h1_end);
+		g_string_append (self->processed, self->tags.h1_start);
+		gs_markdown_to_text_line_format (self, copy->str, copy->len, self->processed);
+		g_string_append (self->processed, self->tags.h1_end);
+		g_string_append_c (self->processed, '\n');
 	} else if (self->mode == GS_MARKDOWN_MODE_H2) {
-		g_string_append_printf (self->processed, "%s%s%s\n",
-					self->tags.h2_start,
-					temp,
-					self->tags.h2_end);
+		g_string_append (self->processed, self->tags.h2_start);
+		gs_markdown_to_text_line_format (self, copy->str, copy->len, self->processed);
+		g_string_append (self->processed, self->tags.h2_end);
+		g_string_append_c (self->processed, '\n');
 	} else if (self->mode == GS_MARKDOWN_MODE_PARA ||
 		   self->mode == GS_MARKDOWN_MODE_RULE) {
-		g_string_append_printf (self->processed, "%s\n", temp);
+		gs_markdown_to_text_line_format (self, copy->str, copy->len, self->processed);
+		g_string_append_c (self->processed, '\n');
 		self->line_count++;
 	}
 
@@ -601,23 +619,23 @@ gs_markdown_flush_pending (GsMarkdown *self)
 }
 
 static gboolean
-gs_markdown_to_text_line_process (GsMarkdown *self, const gchar *line)
+gs_markdown_to_text_line_process (GsMarkdown *self, const gchar *line, gsize len)
 {
 	gboolean ret;
 
 	/* blank */
-	ret = gs_markdown_to_text_line_is_blank (line);
+	ret = gs_markdown_to_text_line_is_blank (line, len);
 	if (ret) {
 		gs_markdown_flush_pending (self);
 		/* a new line after a list is the end of list, not a gap */
 		if (self->mode != GS_MARKDOWN_MODE_BULLETT)
-			ret = gs_markdown_add_pending (self, "\n");
+			ret = gs_markdown_add_pending (self, "\n", 1);
 		self->mode = GS_MARKDOWN_MODE_BLANK;
 		goto out;
 	}
 
 	/* header1_type2 */
-	ret = gs_markdown_to_text_line_is_header1_type2 (line);
+	ret = gs_markdown_to_text_line_is_header1_type2 (line, len);
 	if (ret) {
 		if (self->mode == GS_MARKDOWN_MODE_PARA)
 			self->mode = GS_MARKDOWN_MODE_H1;
@@ -625,7 +643,7 @@ gs_markdown_to_text_line_process (GsMarkdown *self, const gchar *line)
 	}
 
 	/* header2_type2 */
-	ret = gs_markdown_to_text_line_is_header2_type2 (line);
+	ret = gs_markdown_to_text_line_is_header2_type2 (line, len);
 	if (ret) {
 		if (self->mode == GS_MARKDOWN_MODE_PARA)
 			self->mode = GS_MARKDOWN_MODE_H2;
@@ -633,38 +651,39 @@ gs_markdown_to_text_line_process (GsMarkdown *self, const gchar *line)
 	}
 
 	/* rule */
-	ret = gs_markdown_to_text_line_is_rule (line);
+	ret = gs_markdown_to_text_line_is_rule (line, len);
 	if (ret) {
 		gs_markdown_flush_pending (self);
 		self->mode = GS_MARKDOWN_MODE_RULE;
-		ret = gs_markdown_add_pending (self, self->tags.rule);
+		ret = gs_markdown_add_pending (self, self->tags.rule,
+					       strlen (self->tags.rule));
 		goto out;
 	}
 
 	/* bullet */
-	ret = gs_markdown_to_text_line_is_bullet (line);
+	ret = gs_markdown_to_text_line_is_bullet (line, len);
 	if (ret) {
 		gs_markdown_flush_pending (self);
 		self->mode = GS_MARKDOWN_MODE_BULLETT;
-		ret = gs_markdown_add_pending (self, &line[2]);
+		ret = gs_markdown_add_pending (self, line + 2, len - 2);
 		goto out;
 	}
 
 	/* header1 */
-	ret = gs_markdown_to_text_line_is_header1 (line);
+	ret = gs_markdown_to_text_line_is_header1 (line, len);
 	if (ret) {
 		gs_markdown_flush_pending (self);
 		self->mode = GS_MARKDOWN_MODE_H1;
-		ret = gs_markdown_add_pending_header (self, &line[2]);
+		ret = gs_markdown_add_pending_header (self, line + 2, len - 2);
 		goto out;
 	}
 
 	/* header2 */
-	ret = gs_markdown_to_text_line_is_header2 (line);
+	ret = gs_markdown_to_text_line_is_header2 (line, len);
 	if (ret) {
 		gs_markdown_flush_pending (self);
 		self->mode = GS_MARKDOWN_MODE_H2;
-		ret = gs_markdown_add_pending_header (self, &line[3]);
+		ret = gs_markdown_add_pending_header (self, line + 3, len - 3);
 		goto out;
 	}
 
@@ -676,7 +695,7 @@ gs_markdown_to_text_line_process (GsMarkdown *self, const gchar *line)
 	}
 
 	/* add to pending */
-	ret = gs_markdown_add_pending (self, line);
+	ret = gs_markdown_add_pending (self, line, len);
 out:
 	/* if we failed to add, we don't know the mode */
 	if (!ret)
@@ -789,11 +808,8 @@ gs_markdown_set_autolinkify (GsMarkdown *self, gboolean autolinkify)
 gchar *
 gs_markdown_parse (GsMarkdown *self, const gchar *markdown)
 {
-	gboolean ret;
+	const gchar *line = markdown;
 	gchar *temp;
-	guint i;
-	guint len;
-	g_auto(GStrv) lines = NULL;
 
 	g_return_val_if_fail (GS_IS_MARKDOWN (self), NULL);
 
@@ -802,23 +818,32 @@ gs_markdown_parse (GsMarkdown *self, const gchar *markdown)
 	self->line_count = 0;
 	g_string_truncate (self->pending, 0);
 	g_string_truncate (self->processed, 0);
-	lines = g_strsplit (markdown, "\n", -1);
-	len = g_strv_length (lines);
 
-	/* process each line */
-	for (i = 0; i < len; i++) {
-		ret = gs_markdown_to_text_line_process (self, lines[i]);
-		if (!ret)
+	/* process each line, without copying it */
+	while (*line != '\0') {
+		const gchar *eol = strchr (line, '\n');
+		gsize len = eol != NULL ? (gsize) (eol - line) : strlen (line);
+		if (!gs_markdown_to_text_line_process (self, line, len))
+			break;
+		if (eol == NULL)
+			break;
+		line = eol + 1;
+
+		/* the text ends with a newline, so there is one more line */
+		if (*line == '\0') {
+			gs_markdown_to_text_line_process (self, line, 0);
 			break;
+		}
 	}
 	gs_markdown_flush_pending (self);
 
 	/* remove trailing \n */
-	while (g_str_has_suffix (self->processed->str, "\n"))
-		g_string_set_size (self->processed, self->processed->len - 1);
+	while (self->processed->len > 0 &&
+	       self->processed->str[self->processed->len - 1] == '\n')
+		g_string_truncate (self->processed, self->processed->len - 1);
 
 	/* get a copy */
-	temp = g_strdup (self->processed->str);
+	temp = g_strndup (self->processed->str, self->processed->len);
 	g_string_truncate (self->pending, 0);
 	g_string_truncate (self->processed, 0);
 	return temp;
@@ -835,6 +860,9 @@ gs_markdown_finalize (GObject *object)
 
 	g_string_free (self->pending, TRUE);
 	g_string_free (self->processed, TRUE);
+	g_string_free (self->scratch1, TRUE);
+	g_string_free (self->scratch2, TRUE);
+	g_string_free (self->scratch3, TRUE);
 
 	G_OBJECT_CLASS (gs_markdown_parent_class)->finalize (object);
 }
@@ -852,6 +880,9 @@ gs_markdown_init (GsMarkdown *self)
 	self->mode = GS_MARKDOWN_MODE_UNKNOWN;
 	self->pending = g_string_new ("");
 	self->processed = g_string_new ("");
+	self->scratch1 = g_string_new ("");
+	self->scratch2 = g_string_new ("");
+	self->scratch3 = g_string_new ("");
 	self->max_lines = -1;
 	self->smart_quoting = FALSE;
 	self->escape = FALSE;
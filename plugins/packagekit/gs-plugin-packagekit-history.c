@@ -25,21 +25,59 @@
 
 #include <gnome-software.h>
 
+#include "packagekit-history.h"
+
 #define GS_PLUGIN_PACKAGEKIT_HISTORY_TIMEOUT	5000 /* ms */
 
+/* if all of these are new then some may have been missed */
+#define GS_PLUGIN_PACKAGEKIT_HISTORY_TRANSACTIONS	50
+
 /*
  * SECTION:
  * This returns update history using the system PackageKit instance.
+ *
+ * The history of each package is only asked for once and then kept in
+ * the cache directory. It is brought up to date by looking at the
+ * transactions PackageKit has done since it was last looked at.
+ *
+ * PackageKit is only asked with a private copy of the history, which
+ * then replaces the shared one; the mutex just protects the swap.
  */
 
 struct GsPluginData {
 	GDBusConnection		*connection;
+	PkControl		*control;
+	PkClient		*client;
+	GMutex			 mutex;
+	GsPackagekitHistory	*history;
+	guint			 history_serial;	/* bumped on updates-changed */
+	guint			 history_serial_done;
 };
 
+static void
+gs_plugin_packagekit_history_updates_changed_cb (PkControl *control,
+						 GsPlugin *plugin)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	g_mutex_lock (&priv->mutex);
+	priv->history_serial++;
+	g_mutex_unlock (&priv->mutex);
+}
+
 void
 gs_plugin_initialize (GsPlugin *plugin)
 {
-	gs_plugin_alloc_data (plugin, sizeof(GsPluginData));
+	GsPluginData *priv = gs_plugin_alloc_data (plugin, sizeof(GsPluginData));
+
+	g_mutex_init (&priv->mutex);
+	priv->history_serial = 1;
+	priv->client = pk_client_new ();
+	pk_client_set_background (priv->client, TRUE);
+	pk_client_set_interactive (priv->client, FALSE);
+	priv->control = pk_control_new ();
+	g_signal_connect (priv->control, "updates-changed",
+			  G_CALLBACK (gs_plugin_packagekit_history_updates_changed_cb),
+			  plugin);
 
 	/* need pkgname */
 	gs_plugin_add_rule (plugin, GS_PLUGIN_RULE_RUN_AFTER, "appstream");
@@ -52,6 +90,54 @@ gs_plugin_destroy (GsPlugin *plugin)
 	GsPluginData *priv = gs_plugin_get_data (plugin);
 	if (priv->connection != NULL)
 		g_object_unref (priv->connection);
+	g_object_unref (priv->client);
+	g_object_unref (priv->control);
+	if (priv->history != NULL)
+		gs_packagekit_history_free (priv->history);
+	g_mutex_clear (&priv->mutex);
+}
+
+static gchar *
+gs_plugin_packagekit_history_get_filename (GError **error)
+{
+	return gs_utils_get_cache_filename ("packagekit",
+					    "history.gvariant",
+					    GS_UTILS_CACHE_FLAG_WRITEABLE,
+					    error);
+}
+
+/* returns FALSE if PackageKit could not be asked */
+static gboolean
+gs_plugin_packagekit_history_update (GsPlugin *plugin,
+				     GsPackagekitHistory *history,
+				     GCancellable *cancellable)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	guint64 timestamp = gs_packagekit_history_get_timestamp (history);
+	guint n_new;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	/* get the most recent transactions */
+	results = pk_client_get_old_transactions (priv->client,
+						  GS_PLUGIN_PACKAGEKIT_HISTORY_TRANSACTIONS,
+						  cancellable,
+						  NULL, NULL,
+						  &error);
+	if (results == NULL) {
+		g_debug ("failed to get old transactions: %s", error->message);
+		return FALSE;
+	}
+	array = pk_results_get_transaction_array (results);
+	n_new = gs_packagekit_history_add_transactions (history, array);
+
+	/* too much has happened, so start again */
+	if (timestamp > 0 && n_new >= GS_PLUGIN_PACKAGEKIT_HISTORY_TRANSACTIONS) {
+		g_debug ("%u new transactions, discarding history", n_new);
+		gs_packagekit_history_remove_all (history);
+	}
+	return TRUE;
 }
 
 static void
@@ -115,37 +201,41 @@ gs_plugin_setup (GsPlugin *plugin, GCancellable *cancellable, GError **error)
 }
 
 static gboolean
-gs_plugin_packagekit_refine (GsPlugin *plugin,
-			     GsAppList *list,
-			     GCancellable *cancellable,
-			     GError **error)
+gs_plugin_packagekit_history_fetch (GsPlugin *plugin,
+				    GsPackagekitHistory *history,
+				    GsAppList *list,
+				    GCancellable *cancellable,
+				    GError **error)
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
-	gboolean ret;
 	GError *error_local = NULL;
-	guint j;
 	GsApp *app;
-	guint i = 0;
-	GVariantIter iter;
-	GVariant *value;
-	g_autofree const gchar **package_names = NULL;
+	guint i;
+	g_autoptr(GPtrArray) package_names = NULL;
 	g_autoptr(GVariant) result = NULL;
 	g_autoptr(GVariant) tuple = NULL;
 
-	/* get an array of package names */
-	package_names = g_new0 (const gchar *, gs_app_list_length (list) + 1);
-	for (j = 0; j < gs_app_list_length (list); j++) {
-		app = gs_app_list_index (list, j);
-		package_names[i++] = gs_app_get_source_default (app);
+	/* only ask about packages not seen before */
+	package_names = g_ptr_array_new ();
+	for (i = 0; i < gs_app_list_length (list); i++) {
+		const gchar *source;
+		app = gs_app_list_index (list, i);
+		source = gs_app_get_source_default (app);
+		if (gs_packagekit_history_lookup (history, source) != NULL)
+			continue;
+		g_ptr_array_add (package_names, (gpointer) source);
 	}
+	if (package_names->len == 0)
+		return TRUE;
+	g_ptr_array_add (package_names, NULL);
 
-	g_debug ("getting history for %u packages", gs_app_list_length (list));
+	g_debug ("getting history for %u packages", package_names->len - 1);
 	result = g_dbus_connection_call_sync (priv->connection,
 					      "org.freedesktop.PackageKit",
 					      "/org/freedesktop/PackageKit",
 					      "org.freedesktop.PackageKit",
 					      "GetPackageHistory",
-					      g_variant_new ("(^asu)", package_names, 0),
+					      g_variant_new ("(^asu)", package_names->pdata, 0),
 					      NULL,
 					      G_DBUS_CALL_FLAGS_NONE,
 					      GS_PLUGIN_PACKAGEKIT_HISTORY_TIMEOUT,
@@ -179,19 +269,77 @@ gs_plugin_packagekit_refine (GsPlugin *plugin,
 			     GS_PLUGIN_ERROR_NOT_SUPPORTED,
 			     "Failed to get history: %s",
 			     error_local->message);
+		g_error_free (error_local);
 		return FALSE;
 	}
 
-	/* get any results */
+	/* packages with no history are remembered too */
 	tuple = g_variant_get_child_value (result, 0);
+	for (i = 0; i < package_names->len - 1; i++) {
+		const gchar *name = g_ptr_array_index (package_names, i);
+		GVariant *entries = NULL;
+		if (!g_variant_lookup (tuple, name, "@aa{sv}", &entries))
+			entries = g_variant_ref_sink (g_variant_new_array (G_VARIANT_TYPE ("a{sv}"), NULL, 0));
+		gs_packagekit_history_add_package (history, name, entries);
+		g_variant_unref (entries);
+	}
+	return TRUE;
+}
+
+static gboolean
+gs_plugin_packagekit_refine (GsPlugin *plugin,
+			     GsAppList *list,
+			     GCancellable *cancellable,
+			     GError **error)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	GsApp *app;
+	guint i = 0;
+	guint serial;
+	gboolean updated = TRUE;
+	GVariantIter iter;
+	GVariant *value;
+	g_autofree gchar *fn = NULL;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GsPackagekitHistory) history = NULL;
+
+	/* take a copy so PackageKit is not asked with the lock held */
+	g_mutex_lock (&priv->mutex);
+	if (priv->history != NULL)
+		history = gs_packagekit_history_copy (priv->history);
+	serial = priv->history_serial;
+	if (priv->history_serial_done != serial)
+		updated = FALSE;
+	g_mutex_unlock (&priv->mutex);
+
+	fn = gs_plugin_packagekit_history_get_filename (&error_local);
+	if (fn == NULL) {
+		g_warning ("failed to get history cache: %s", error_local->message);
+		g_clear_error (&error_local);
+	}
+	if (history == NULL) {
+		history = gs_packagekit_history_new ();
+		if (fn != NULL && !gs_packagekit_history_load (history, fn, &error_local)) {
+			g_warning ("failed to load %s: %s", fn, error_local->message);
+			g_clear_error (&error_local);
+		}
+	}
+
+	/* bring the cache up to date and add anything missing */
+	if (!updated)
+		updated = gs_plugin_packagekit_history_update (plugin, history, cancellable);
+	if (!gs_plugin_packagekit_history_fetch (plugin, history, list, cancellable, error))
+		return FALSE;
+	if (fn != NULL && !gs_packagekit_history_save (history, fn, &error_local))
+		g_warning ("failed to save %s: %s", fn, error_local->message);
+
+	/* get any results */
 	for (i = 0; i < gs_app_list_length (list); i++) {
-		g_autoptr(GVariant) entries = NULL;
+		GVariant *entries;
 		app = gs_app_list_index (list, i);
-		ret = g_variant_lookup (tuple,
-					gs_app_get_source_default (app),
-					"@aa{sv}",
-					&entries);
-		if (!ret) {
+		entries = gs_packagekit_history_lookup (history,
+							gs_app_get_source_default (app));
+		if (entries == NULL || g_variant_n_children (entries) == 0) {
 			/* make up a fake entry as we know this package was at
 			 * least installed at some point in time */
 			if (gs_app_get_state (app) == AS_APP_STATE_INSTALLED) {
@@ -216,6 +364,16 @@ gs_plugin_packagekit_refine (GsPlugin *plugin,
 			g_variant_unref (value);
 		}
 	}
+
+	/* a refine running at the same time may swap in its copy after
+	 * this one, which only means asking PackageKit again later */
+	g_mutex_lock (&priv->mutex);
+	if (priv->history != NULL)
+		gs_packagekit_history_free (priv->history);
+	priv->history = g_steal_pointer (&history);
+	if (updated)
+		priv->history_serial_done = serial;
+	g_mutex_unlock (&priv->mutex);
 	return TRUE;
 }
 
@@ -21,10 +21,13 @@
 
 #include <config.h>
 
+#include <string.h>
 #include <packagekit-glib2/packagekit.h>
+#include <glib/gstdio.h>
 #include <gnome-software.h>
 
 #include "gs-markdown.h"
+#include "packagekit-cache.h"
 #include "packagekit-common.h"
 
 /*
@@ -41,11 +44,51 @@ struct GsPluginData {
 	PkClient		*client;
 	GHashTable		*sources;
 	AsProfileTask		*ptask;
+	GMutex			 files_mutex;
+	GKeyFile		*files_cache;	/* filename : package */
+	gboolean		 files_cache_loaded;
+	gboolean		 files_cache_changed;
+	GMutex			 cache_mutex;
+	GsPackagekitCache	*cache;		/* package-id : metadata */
+	guint64			 cache_generation;
+	gboolean		 cache_generation_certain;
+	gboolean		 cache_generation_valid;
 };
 
+static gchar *
+gs_plugin_packagekit_files_cache_get_filename (GError **error)
+{
+	return gs_utils_get_cache_filename ("packagekit",
+					    "installed-files.ini",
+					    GS_UTILS_CACHE_FLAG_WRITEABLE,
+					    error);
+}
+
+/* the installed packages have changed, so forget which owns each file */
+static void
+gs_plugin_packagekit_files_cache_invalidate (GsPlugin *plugin)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	g_autofree gchar *fn = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->files_mutex);
+
+	g_key_file_unref (priv->files_cache);
+	priv->files_cache = g_key_file_new ();
+	priv->files_cache_loaded = TRUE;
+	priv->files_cache_changed = FALSE;
+	fn = gs_plugin_packagekit_files_cache_get_filename (NULL);
+	if (fn != NULL && g_file_test (fn, G_FILE_TEST_EXISTS))
+		g_unlink (fn);
+}
+
 static void
 gs_plugin_packagekit_cache_invalid_cb (PkControl *control, GsPlugin *plugin)
 {
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	g_mutex_lock (&priv->cache_mutex);
+	priv->cache_generation_valid = FALSE;
+	g_mutex_unlock (&priv->cache_mutex);
+	gs_plugin_packagekit_files_cache_invalidate (plugin);
 	gs_plugin_updates_changed (plugin);
 }
 
@@ -53,6 +96,9 @@ void
 gs_plugin_initialize (GsPlugin *plugin)
 {
 	GsPluginData *priv = gs_plugin_alloc_data (plugin, sizeof(GsPluginData));
+	g_autofree gchar *cache_fn = NULL;
+	g_autoptr(GError) error = NULL;
+
 	priv->client = pk_client_new ();
 	priv->control = pk_control_new ();
 	g_signal_connect (priv->control, "updates-changed",
@@ -62,6 +108,17 @@ gs_plugin_initialize (GsPlugin *plugin)
 	pk_client_set_background (priv->client, FALSE);
 	pk_client_set_interactive (priv->client, FALSE);
 	pk_client_set_cache_age (priv->client, G_MAXUINT);
+	g_mutex_init (&priv->files_mutex);
+	priv->files_cache = g_key_file_new ();
+	g_mutex_init (&priv->cache_mutex);
+	cache_fn = gs_utils_get_cache_filename ("packagekit",
+						"package-metadata.ini",
+						GS_UTILS_CACHE_FLAG_WRITEABLE,
+						&error);
+	if (cache_fn != NULL)
+		priv->cache = gs_packagekit_cache_new (cache_fn);
+	else
+		g_warning ("not caching package metadata: %s", error->message);
 
 	/* we can get better results than the RPM plugin */
 	gs_plugin_add_rule (plugin, GS_PLUGIN_RULE_CONFLICTS, "rpm");
@@ -77,6 +134,11 @@ gs_plugin_destroy (GsPlugin *plugin)
 	GsPluginData *priv = gs_plugin_get_data (plugin);
 	g_object_unref (priv->client);
 	g_object_unref (priv->control);
+	g_key_file_unref (priv->files_cache);
+	g_mutex_clear (&priv->files_mutex);
+	if (priv->cache != NULL)
+		gs_packagekit_cache_free (priv->cache);
+	g_mutex_clear (&priv->cache_mutex);
 }
 
 void
@@ -167,9 +229,10 @@ gs_plugin_packagekit_set_metadata_from_package (GsPlugin *plugin,
 
 static void
 gs_plugin_packagekit_resolve_packages_app (GsPlugin *plugin,
-					   GPtrArray *packages,
+					   GHashTable *packages_by_name,
 					   GsApp *app)
 {
+	GPtrArray *packages;
 	GPtrArray *sources;
 	PkPackage *package;
 	const gchar *pkgname;
@@ -183,24 +246,25 @@ gs_plugin_packagekit_resolve_packages_app (GsPlugin *plugin,
 	sources = gs_app_get_sources (app);
 	for (j = 0; j < sources->len; j++) {
 		pkgname = g_ptr_array_index (sources, j);
+		packages = g_hash_table_lookup (packages_by_name, pkgname);
+		if (packages == NULL)
+			continue;
 		for (i = 0; i < packages->len; i++) {
 			package = g_ptr_array_index (packages, i);
-			if (g_strcmp0 (pk_package_get_name (package), pkgname) == 0) {
-				gs_plugin_packagekit_set_metadata_from_package (plugin, app, package);
-				switch (pk_package_get_info (package)) {
-				case PK_INFO_ENUM_INSTALLED:
-					number_installed++;
-					break;
-				case PK_INFO_ENUM_AVAILABLE:
-					number_available++;
-					break;
-				case PK_INFO_ENUM_UNAVAILABLE:
-					number_available++;
-					break;
-				default:
-					/* should we expect anything else? */
-					break;
-				}
+			gs_plugin_packagekit_set_metadata_from_package (plugin, app, package);
+			switch (pk_package_get_info (package)) {
+			case PK_INFO_ENUM_INSTALLED:
+				number_installed++;
+				break;
+			case PK_INFO_ENUM_AVAILABLE:
+				number_available++;
+				break;
+			case PK_INFO_ENUM_UNAVAILABLE:
+				number_available++;
+				break;
+			default:
+				/* should we expect anything else? */
+				break;
 			}
 		}
 	}
@@ -242,6 +306,7 @@ gs_plugin_packagekit_resolve_packages (GsPlugin *plugin,
 	guint j;
 	ProgressData data;
 	g_autoptr(PkResults) results = NULL;
+	g_autoptr(GHashTable) packages_by_name = NULL;
 	g_autoptr(GPtrArray) package_ids = NULL;
 	g_autoptr(GPtrArray) packages = NULL;
 
@@ -279,58 +344,295 @@ gs_plugin_packagekit_resolve_packages (GsPlugin *plugin,
 	if (!gs_plugin_packagekit_results_valid (results, error))
 		return FALSE;
 
-	/* get results */
+	/* get results, indexed once rather than searched for each app */
 	packages = pk_results_get_package_array (results);
+	packages_by_name = gs_plugin_packagekit_build_package_index (packages);
 	for (i = 0; i < gs_app_list_length (list); i++) {
 		app = gs_app_list_index (list, i);
 		if (gs_app_get_local_file (app) != NULL)
 			continue;
-		gs_plugin_packagekit_resolve_packages_app (plugin, packages, app);
+		gs_plugin_packagekit_resolve_packages_app (plugin, packages_by_name, app);
 	}
 	return TRUE;
 }
 
+/* must be called with files_mutex held */
+static void
+gs_plugin_packagekit_files_cache_ensure_loaded (GsPlugin *plugin)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	g_autofree gchar *fn = NULL;
+	g_autoptr(GError) error = NULL;
+
+	if (priv->files_cache_loaded)
+		return;
+	priv->files_cache_loaded = TRUE;
+	fn = gs_plugin_packagekit_files_cache_get_filename (&error);
+	if (fn == NULL) {
+		g_warning ("failed to get installed files cache: %s", error->message);
+		return;
+	}
+	if (!g_file_test (fn, G_FILE_TEST_EXISTS))
+		return;
+	if (!g_key_file_load_from_file (priv->files_cache, fn,
+					G_KEY_FILE_NONE, &error))
+		g_warning ("failed to load %s: %s", fn, error->message);
+}
+
+/* returns the installed package that owns @filename if it is known */
+static PkPackage *
+gs_plugin_packagekit_files_cache_lookup (GsPlugin *plugin,
+					 const gchar *filename,
+					 gint64 mtime)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	g_autofree gchar *package_id = NULL;
+	g_autofree gchar *summary = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->files_mutex);
+	g_autoptr(PkPackage) package = NULL;
+
+	gs_plugin_packagekit_files_cache_ensure_loaded (plugin);
+	if (g_key_file_get_int64 (priv->files_cache, filename, "Mtime", NULL) != mtime)
+		return NULL;
+	package_id = g_key_file_get_string (priv->files_cache, filename,
+					    "PackageId", NULL);
+	if (package_id == NULL)
+		return NULL;
+	package = pk_package_new ();
+	if (!pk_package_set_id (package, package_id, NULL))
+		return NULL;
+	pk_package_set_info (package, PK_INFO_ENUM_INSTALLED);
+	summary = g_key_file_get_string (priv->files_cache, filename,
+					 "Summary", NULL);
+	if (summary != NULL)
+		pk_package_set_summary (package, summary);
+	return g_steal_pointer (&package);
+}
+
+static void
+gs_plugin_packagekit_files_cache_add (GsPlugin *plugin,
+				      const gchar *filename,
+				      gint64 mtime,
+				      PkPackage *package)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->files_mutex);
+
+	gs_plugin_packagekit_files_cache_ensure_loaded (plugin);
+	g_key_file_set_string (priv->files_cache, filename, "PackageId",
+			       pk_package_get_id (package));
+	if (pk_package_get_summary (package) != NULL) {
+		g_key_file_set_string (priv->files_cache, filename, "Summary",
+				       pk_package_get_summary (package));
+	}
+	g_key_file_set_int64 (priv->files_cache, filename, "Mtime", mtime);
+	priv->files_cache_changed = TRUE;
+}
+
+static gboolean
+gs_plugin_packagekit_files_cache_save (GsPlugin *plugin, GError **error)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	g_autofree gchar *fn = NULL;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->files_mutex);
+
+	if (!priv->files_cache_changed)
+		return TRUE;
+	fn = gs_plugin_packagekit_files_cache_get_filename (error);
+	if (fn == NULL)
+		return FALSE;
+	if (!g_key_file_save_to_file (priv->files_cache, fn, &error_local)) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_WRITE_FAILED,
+			     "failed to save %s: %s",
+			     fn, error_local->message);
+		return FALSE;
+	}
+	priv->files_cache_changed = FALSE;
+	return TRUE;
+}
+
+static gint64
+gs_plugin_packagekit_get_file_mtime (const gchar *filename)
+{
+	GStatBuf buf;
+	if (g_stat (filename, &buf) != 0)
+		return 0;
+	return (gint64) buf.st_mtime;
+}
+
+/* finds the package that owns each file, where @filenames matches @apps */
 static gboolean
 gs_plugin_packagekit_refine_from_desktop (GsPlugin *plugin,
-					  GsApp *app,
-					  const gchar *filename,
+					  GPtrArray *apps,
+					  GPtrArray *filenames,
 					  GCancellable *cancellable,
 					  GError **error)
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
-	const gchar *to_array[] = { NULL, NULL };
 	ProgressData data;
-	g_autoptr(PkResults) results = NULL;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GHashTable) owners = NULL;
+	g_autoptr(GHashTable) packages_by_id = NULL;
+	g_autoptr(GPtrArray) files = NULL;
+	g_autoptr(GPtrArray) misses = NULL;
+	g_autoptr(GPtrArray) package_ids = NULL;
 	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(PkResults) results = NULL;
+	g_autoptr(PkResults) results_files = NULL;
+
+	/* most files have been looked up before */
+	misses = g_ptr_array_new ();
+	for (guint i = 0; i < filenames->len; i++) {
+		GsApp *app = g_ptr_array_index (apps, i);
+		const gchar *fn = g_ptr_array_index (filenames, i);
+		g_autoptr(PkPackage) package = NULL;
+		package = gs_plugin_packagekit_files_cache_lookup (plugin, fn,
+								   gs_plugin_packagekit_get_file_mtime (fn));
+		if (package != NULL) {
+			gs_plugin_packagekit_set_metadata_from_package (plugin, app, package);
+			continue;
+		}
+		g_ptr_array_add (misses, GUINT_TO_POINTER (i));
+	}
+	if (misses->len == 0)
+		return TRUE;
 
-	data.app = app;
+	data.app = NULL;
 	data.plugin = plugin;
 	data.ptask = NULL;
-	data.profile_id = g_path_get_basename (filename);
+	data.profile_id = g_strdup ("search-files");
 
-	to_array[0] = filename;
+	/* find the packages owning any of the files in one transaction */
+	files = g_ptr_array_new ();
+	for (guint i = 0; i < misses->len; i++) {
+		guint idx = GPOINTER_TO_UINT (g_ptr_array_index (misses, i));
+		g_ptr_array_add (files, g_ptr_array_index (filenames, idx));
+	}
+	g_ptr_array_add (files, NULL);
 	results = pk_client_search_files (priv->client,
 					  pk_bitfield_from_enums (PK_FILTER_ENUM_INSTALLED, -1),
-					  (gchar **) to_array,
+					  (gchar **) files->pdata,
 					  cancellable,
 					  gs_plugin_packagekit_progress_cb, &data,
 					  error);
+	g_clear_pointer (&data.profile_id, g_free);
 	if (!gs_plugin_packagekit_results_valid (results, error))
 		return FALSE;
-
-	/* get results */
 	packages = pk_results_get_package_array (results);
-	if (packages->len == 1) {
-		PkPackage *package;
-		package = g_ptr_array_index (packages, 0);
+	packages_by_id = g_hash_table_new (g_str_hash, g_str_equal);
+	for (guint i = 0; i < packages->len; i++) {
+		PkPackage *package = g_ptr_array_index (packages, i);
+		g_hash_table_insert (packages_by_id,
+				     (gpointer) pk_package_get_id (package),
+				     package);
+	}
+
+	/* work out which package owns which file */
+	owners = g_hash_table_new (g_str_hash, g_str_equal);
+	if (misses->len == 1 && packages->len == 1) {
+		PkPackage *package = g_ptr_array_index (packages, 0);
+		g_hash_table_insert (owners, g_ptr_array_index (files, 0),
+				     (gpointer) pk_package_get_id (package));
+	} else if (packages->len > 0) {
+		g_autoptr(GPtrArray) array = NULL;
+		package_ids = g_ptr_array_new ();
+		for (guint i = 0; i < packages->len; i++) {
+			PkPackage *package = g_ptr_array_index (packages, i);
+			g_ptr_array_add (package_ids, (gpointer) pk_package_get_id (package));
+		}
+		g_ptr_array_add (package_ids, NULL);
+		data.profile_id = g_strdup ("get-files");
+		results_files = pk_client_get_files (priv->client,
+						     (gchar **) package_ids->pdata,
+						     cancellable,
+						     gs_plugin_packagekit_progress_cb, &data,
+						     error);
+		g_clear_pointer (&data.profile_id, g_free);
+		if (!gs_plugin_packagekit_results_valid (results_files, error))
+			return FALSE;
+		array = pk_results_get_files_array (results_files);
+		for (guint i = 0; i < array->len; i++) {
+			PkFiles *item = g_ptr_array_index (array, i);
+			gchar **item_files = pk_files_get_files (item);
+			for (guint j = 0; item_files != NULL && item_files[j] != NULL; j++) {
+				const gchar *package_id;
+				package_id = g_hash_table_lookup (owners, item_files[j]);
+				if (package_id == NULL) {
+					g_hash_table_insert (owners, item_files[j],
+							     (gpointer) pk_files_get_package_id (item));
+				} else if (g_strcmp0 (package_id, pk_files_get_package_id (item)) != 0) {
+					/* owned by more than one package */
+					g_hash_table_insert (owners, item_files[j], (gpointer) "");
+				}
+			}
+		}
+	}
+
+	/* set the metadata and remember it for next time */
+	for (guint i = 0; i < misses->len; i++) {
+		guint idx = GPOINTER_TO_UINT (g_ptr_array_index (misses, i));
+		GsApp *app = g_ptr_array_index (apps, idx);
+		PkPackage *package = NULL;
+		const gchar *fn = g_ptr_array_index (filenames, idx);
+		const gchar *package_id = g_hash_table_lookup (owners, fn);
+		if (package_id != NULL)
+			package = g_hash_table_lookup (packages_by_id, package_id);
+		if (package == NULL) {
+			g_warning ("Failed to find one package for %s, %s",
+				   gs_app_get_id (app), fn);
+			continue;
+		}
 		gs_plugin_packagekit_set_metadata_from_package (plugin, app, package);
-	} else {
-		g_warning ("Failed to find one package for %s, %s, [%u]",
-			   gs_app_get_id (app), filename, packages->len);
+		gs_plugin_packagekit_files_cache_add (plugin, fn,
+						      gs_plugin_packagekit_get_file_mtime (fn),
+						      package);
 	}
+	if (!gs_plugin_packagekit_files_cache_save (plugin, &error_local))
+		g_warning ("%s", error_local->message);
 	return TRUE;
 }
 
+/* returns the package metadata cache if it can be used for this generation */
+static GsPackagekitCache *
+gs_plugin_packagekit_get_cache (GsPlugin *plugin, GCancellable *cancellable)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->cache_mutex);
+
+	if (priv->cache == NULL)
+		return NULL;
+	if (!priv->cache_generation_valid) {
+		g_autoptr(GError) error = NULL;
+		priv->cache_generation = gs_packagekit_cache_get_generation (priv->control,
+									     &priv->cache_generation_certain,
+									     cancellable,
+									     &error);
+		if (error != NULL) {
+			g_debug ("not using package metadata cache: %s",
+				 error->message);
+			return NULL;
+		}
+
+		/* ask again next time in case it has settled */
+		priv->cache_generation_valid = priv->cache_generation_certain;
+	}
+	gs_packagekit_cache_load (priv->cache,
+				  priv->cache_generation,
+				  priv->cache_generation_certain);
+	return priv->cache;
+}
+
+static void
+gs_plugin_packagekit_save_cache (GsPackagekitCache *cache)
+{
+	g_autoptr(GError) error = NULL;
+	if (!gs_packagekit_cache_save (cache, &error))
+		g_warning ("%s", error->message);
+}
+
 /*
  * gs_plugin_packagekit_fixup_update_description:
  *
@@ -358,46 +660,154 @@ gs_plugin_packagekit_fixup_update_description (const gchar *text)
 	return g_strdup (text);
 }
 
-static gboolean
-gs_plugin_packagekit_refine_updatedetails (GsPlugin *plugin,
-					   GsAppList *list,
-					   GCancellable *cancellable,
-					   GError **error)
+/* several refines can run at once, so only have a few transactions each */
+#define GS_PLUGIN_PACKAGEKIT_REFINE_MAX_TRANSACTIONS	2
+
+typedef struct _RefineJob RefineJob;
+typedef void (*RefineJobStartFunc) (RefineJob *job);
+
+/* the phases that only need package-ids, run on a private main context */
+typedef struct {
+	GsPlugin	*plugin;
+	GMainContext	*context;
+	GMainLoop	*loop;
+	GCancellable	*cancellable;
+	GQueue		 pending;	/* of RefineJob */
+	guint		 n_running;
+	GError		*error;
+} RefineHelper;
+
+struct _RefineJob {
+	RefineHelper		*helper;
+	RefineJobStartFunc	 start;
+	const gchar		*profile_id;
+	AsProfileTask		*ptask;
+	ProgressData		 data;
+	GsAppList		*list;
+	GsPackagekitCache	*cache;
+	GPtrArray		*array;		/* results, some from the cache */
+	GPtrArray		*package_ids;	/* to ask for, NULL terminated */
+};
+
+static RefineJob *
+gs_plugin_packagekit_refine_job_new (RefineHelper *helper,
+				     GsAppList *list,
+				     const gchar *profile_id,
+				     RefineJobStartFunc start)
 {
-	GsPluginData *priv = gs_plugin_get_data (plugin);
-	const gchar *package_id;
-	guint j;
-	GsApp *app;
-	guint i = 0;
-	PkUpdateDetail *update_detail;
-	ProgressData data;
-	g_autofree const gchar **package_ids = NULL;
-	g_autoptr(PkResults) results = NULL;
-	g_autoptr(GPtrArray) array = NULL;
+	RefineJob *job = g_new0 (RefineJob, 1);
+	job->helper = helper;
+	job->start = start;
+	job->profile_id = profile_id;
+	job->data.plugin = helper->plugin;
+	job->data.profile_id = g_strdup (profile_id);
+	job->list = g_object_ref (list);
+	job->array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	job->package_ids = g_ptr_array_new_with_free_func (g_free);
+	return job;
+}
 
-	package_ids = g_new0 (const gchar *, gs_app_list_length (list) + 1);
-	for (i = 0; i < gs_app_list_length (list); i++) {
-		app = gs_app_list_index (list, i);
-		package_id = gs_app_get_source_id_default (app);
-		package_ids[i] = package_id;
+static void
+gs_plugin_packagekit_refine_job_free (RefineJob *job)
+{
+	g_clear_pointer (&job->ptask, as_profile_task_free);
+	g_clear_pointer (&job->data.ptask, as_profile_task_free);
+	g_free (job->data.profile_id);
+	g_object_unref (job->list);
+	g_ptr_array_unref (job->array);
+	g_ptr_array_unref (job->package_ids);
+	g_free (job);
+}
+
+static void
+gs_plugin_packagekit_refine_helper_init (RefineHelper *helper,
+					 GsPlugin *plugin,
+					 GCancellable *cancellable)
+{
+	memset (helper, 0, sizeof (RefineHelper));
+	helper->plugin = plugin;
+	helper->cancellable = cancellable;
+	helper->context = g_main_context_new ();
+	helper->loop = g_main_loop_new (helper->context, FALSE);
+	g_queue_init (&helper->pending);
+
+	/* the async transactions complete in this thread */
+	g_main_context_push_thread_default (helper->context);
+}
+
+static void
+gs_plugin_packagekit_refine_helper_clear (RefineHelper *helper)
+{
+	g_main_context_pop_thread_default (helper->context);
+	g_main_loop_unref (helper->loop);
+	g_main_context_unref (helper->context);
+	g_clear_error (&helper->error);
+}
+
+/* starts as many of the queued transactions as are allowed */
+static void
+gs_plugin_packagekit_refine_helper_run_pending (RefineHelper *helper)
+{
+	while (helper->n_running < GS_PLUGIN_PACKAGEKIT_REFINE_MAX_TRANSACTIONS) {
+		RefineJob *job = g_queue_pop_head (&helper->pending);
+		if (job == NULL)
+			break;
+
+		/* no point asking if something else already failed */
+		if (helper->error != NULL) {
+			gs_plugin_packagekit_refine_job_free (job);
+			continue;
+		}
+		helper->n_running++;
+		job->ptask = as_profile_start (gs_plugin_get_profile (helper->plugin),
+					       "packagekit-refine[%s]",
+					       job->profile_id);
+		job->start (job);
 	}
+}
 
-	data.app = NULL;
-	data.plugin = plugin;
-	data.ptask = NULL;
-	data.profile_id = NULL;
+/* takes ownership of @error */
+static void
+gs_plugin_packagekit_refine_job_done (RefineJob *job, GError *error)
+{
+	RefineHelper *helper = job->helper;
 
-	/* get any update details */
-	results = pk_client_get_update_detail (priv->client,
-					       (gchar **) package_ids,
-					       cancellable,
-					       gs_plugin_packagekit_progress_cb, &data,
-					       error);
-	if (!gs_plugin_packagekit_results_valid (results, error))
+	if (error != NULL) {
+		if (helper->error == NULL)
+			helper->error = error;
+		else
+			g_error_free (error);
+	}
+	gs_plugin_packagekit_refine_job_free (job);
+	helper->n_running--;
+	gs_plugin_packagekit_refine_helper_run_pending (helper);
+	if (helper->n_running == 0)
+		g_main_loop_quit (helper->loop);
+}
+
+/* returns the first error from any of the transactions */
+static gboolean
+gs_plugin_packagekit_refine_helper_wait (RefineHelper *helper, GError **error)
+{
+	gs_plugin_packagekit_refine_helper_run_pending (helper);
+	if (helper->n_running > 0)
+		g_main_loop_run (helper->loop);
+	if (helper->error != NULL) {
+		g_propagate_error (error, g_steal_pointer (&helper->error));
 		return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+gs_plugin_packagekit_refine_updatedetails_apply (GsAppList *list, GPtrArray *array)
+{
+	const gchar *package_id;
+	guint i, j;
+	GsApp *app;
+	PkUpdateDetail *update_detail;
 
 	/* set the update details for the update */
-	array = pk_results_get_update_detail_array (results);
 	for (j = 0; j < gs_app_list_length (list); j++) {
 		app = gs_app_list_index (list, j);
 		package_id = gs_app_get_source_id_default (app);
@@ -415,7 +825,85 @@ gs_plugin_packagekit_refine_updatedetails (GsPlugin *plugin,
 			break;
 		}
 	}
-	return TRUE;
+}
+
+static void
+gs_plugin_packagekit_refine_updatedetails_cb (GObject *source_object,
+					      GAsyncResult *res,
+					      gpointer user_data)
+{
+	RefineJob *job = (RefineJob *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array_tmp = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	results = pk_client_generic_finish (PK_CLIENT (source_object), res, &error);
+	if (!gs_plugin_packagekit_results_valid (results, &error)) {
+		gs_plugin_packagekit_refine_job_done (job, g_steal_pointer (&error));
+		return;
+	}
+	array_tmp = pk_results_get_update_detail_array (results);
+	for (guint i = 0; i < array_tmp->len; i++) {
+		PkUpdateDetail *update_detail = g_ptr_array_index (array_tmp, i);
+		if (job->cache != NULL)
+			gs_packagekit_cache_add_update_detail (job->cache, update_detail);
+		g_ptr_array_add (job->array, g_object_ref (update_detail));
+	}
+	if (job->cache != NULL)
+		gs_plugin_packagekit_save_cache (job->cache);
+	gs_plugin_packagekit_refine_updatedetails_apply (job->list, job->array);
+	gs_plugin_packagekit_refine_job_done (job, NULL);
+}
+
+static void
+gs_plugin_packagekit_refine_updatedetails_start (RefineJob *job)
+{
+	GsPluginData *priv = gs_plugin_get_data (job->helper->plugin);
+	pk_client_get_update_detail_async (priv->client,
+					   (gchar **) job->package_ids->pdata,
+					   job->helper->cancellable,
+					   gs_plugin_packagekit_progress_cb, &job->data,
+					   gs_plugin_packagekit_refine_updatedetails_cb,
+					   job);
+}
+
+static void
+gs_plugin_packagekit_refine_updatedetails (RefineHelper *helper, GsAppList *list)
+{
+	const gchar *package_id;
+	GsApp *app;
+	PkUpdateDetail *update_detail;
+	RefineJob *job;
+
+	job = gs_plugin_packagekit_refine_job_new (helper, list,
+						   "id->update-details",
+						   gs_plugin_packagekit_refine_updatedetails_start);
+
+	/* use what we already know */
+	job->cache = gs_plugin_packagekit_get_cache (helper->plugin, helper->cancellable);
+	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		app = gs_app_list_index (list, i);
+		package_id = gs_app_get_source_id_default (app);
+		if (package_id == NULL)
+			continue;
+		if (job->cache != NULL) {
+			update_detail = gs_packagekit_cache_lookup_update_detail (job->cache, package_id);
+			if (update_detail != NULL) {
+				g_ptr_array_add (job->array, update_detail);
+				continue;
+			}
+		}
+		g_ptr_array_add (job->package_ids, g_strdup (package_id));
+	}
+
+	/* nothing to ask PackageKit */
+	if (job->package_ids->len == 0) {
+		gs_plugin_packagekit_refine_updatedetails_apply (list, job->array);
+		gs_plugin_packagekit_refine_job_free (job);
+		return;
+	}
+	g_ptr_array_add (job->package_ids, NULL);
+	g_queue_push_tail (&helper->pending, job);
 }
 
 /*
@@ -452,6 +940,7 @@ gs_plugin_packagekit_refine_details_app (GsPlugin *plugin,
 	guint i;
 	guint j;
 	guint64 size = 0;
+	guint64 size_download = 0;
 
 	source_ids = gs_app_get_source_ids (app);
 	for (j = 0; j < source_ids->len; j++) {
@@ -479,116 +968,164 @@ gs_plugin_packagekit_refine_details_app (GsPlugin *plugin,
 						pk_details_get_url (details));
 			}
 			size += pk_details_get_size (details);
+			size_download += gs_plugin_packagekit_details_get_download_size (details);
 			break;
 		}
 	}
 
 	/* the size is the size of all sources */
-	if (gs_app_is_installed (app)) {
+	if (gs_app_get_state (app) == AS_APP_STATE_UPDATABLE ||
+	    gs_app_get_state (app) == AS_APP_STATE_UPDATABLE_LIVE) {
+		/* the sources are the new packages */
+		if (size_download > 0 && gs_app_get_size_download (app) == 0)
+			gs_app_set_size_download (app, size_download);
+		if (size > 0 && gs_app_get_size_installed (app) == 0)
+			gs_app_set_size_installed (app, size);
+	} else if (gs_app_is_installed (app)) {
 		gs_app_set_size_download (app, GS_APP_SIZE_UNKNOWABLE);
 		if (size > 0 && gs_app_get_size_installed (app) == 0)
 			gs_app_set_size_installed (app, size);
 	} else {
 		gs_app_set_size_installed (app, GS_APP_SIZE_UNKNOWABLE);
-		if (size > 0 && gs_app_get_size_download (app) == 0)
-			gs_app_set_size_download (app, size);
+		if (size_download > 0 && gs_app_get_size_download (app) == 0)
+			gs_app_set_size_download (app, size_download);
 	}
 }
 
-static gboolean
-gs_plugin_packagekit_refine_details (GsPlugin *plugin,
-				     GsAppList *list,
-				     GCancellable *cancellable,
-				     GError **error)
+static void
+gs_plugin_packagekit_refine_details_cb (GObject *source_object,
+					GAsyncResult *res,
+					gpointer user_data)
+{
+	RefineJob *job = (RefineJob *) user_data;
+	const gchar *package_id;
+	guint i, j;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array_tmp = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	results = pk_client_generic_finish (PK_CLIENT (source_object), res, &error);
+	if (!gs_plugin_packagekit_results_valid (results, &error)) {
+		gs_plugin_packagekit_refine_job_done (job, g_steal_pointer (&error));
+		return;
+	}
+	array_tmp = pk_results_get_details_array (results);
+	for (i = 0; i < array_tmp->len; i++) {
+		PkDetails *details = g_ptr_array_index (array_tmp, i);
+		g_ptr_array_add (job->array, g_object_ref (details));
+	}
+
+	/* some backends do not return the repo, so use the ID we asked for */
+	for (i = 0; job->cache != NULL && i < job->package_ids->len - 1; i++) {
+		package_id = g_ptr_array_index (job->package_ids, i);
+		for (j = 0; j < array_tmp->len; j++) {
+			PkDetails *details = g_ptr_array_index (array_tmp, j);
+			if (!gs_pk_compare_ids (package_id,
+						pk_details_get_package_id (details)))
+				continue;
+			gs_packagekit_cache_add_details (job->cache, package_id, details);
+			break;
+		}
+	}
+	if (job->cache != NULL)
+		gs_plugin_packagekit_save_cache (job->cache);
+
+	/* set the details for each app */
+	for (i = 0; i < gs_app_list_length (job->list); i++) {
+		GsApp *app = gs_app_list_index (job->list, i);
+		gs_plugin_packagekit_refine_details_app (job->helper->plugin, job->array, app);
+	}
+	gs_plugin_packagekit_refine_job_done (job, NULL);
+}
+
+static void
+gs_plugin_packagekit_refine_details_start (RefineJob *job)
+{
+	GsPluginData *priv = gs_plugin_get_data (job->helper->plugin);
+	pk_client_get_details_async (priv->client,
+				     (gchar **) job->package_ids->pdata,
+				     job->helper->cancellable,
+				     gs_plugin_packagekit_progress_cb, &job->data,
+				     gs_plugin_packagekit_refine_details_cb,
+				     job);
+}
+
+static void
+gs_plugin_packagekit_refine_details (RefineHelper *helper, GsAppList *list)
 {
-	GsPluginData *priv = gs_plugin_get_data (plugin);
 	GPtrArray *source_ids;
 	GsApp *app;
 	const gchar *package_id;
 	guint i, j;
-	ProgressData data;
-	g_autoptr(GPtrArray) array = NULL;
-	g_autoptr(GPtrArray) package_ids = NULL;
-	g_autoptr(PkResults) results = NULL;
+	RefineJob *job;
 
-	package_ids = g_ptr_array_new_with_free_func (g_free);
+	job = gs_plugin_packagekit_refine_job_new (helper, list,
+						   "source->license",
+						   gs_plugin_packagekit_refine_details_start);
+
+	/* use what we already know */
+	job->cache = gs_plugin_packagekit_get_cache (helper->plugin, helper->cancellable);
 	for (i = 0; i < gs_app_list_length (list); i++) {
 		app = gs_app_list_index (list, i);
 		source_ids = gs_app_get_source_ids (app);
 		for (j = 0; j < source_ids->len; j++) {
 			package_id = g_ptr_array_index (source_ids, j);
-			g_ptr_array_add (package_ids, g_strdup (package_id));
+			if (job->cache != NULL) {
+				PkDetails *details;
+				details = gs_packagekit_cache_lookup_details (job->cache, package_id);
+				if (details != NULL) {
+					g_ptr_array_add (job->array, details);
+					continue;
+				}
+			}
+			g_ptr_array_add (job->package_ids, g_strdup (package_id));
 		}
 	}
-	g_ptr_array_add (package_ids, NULL);
 
-	data.app = NULL;
-	data.plugin = plugin;
-	data.ptask = NULL;
-	data.profile_id = g_strjoinv (",", (gchar **) package_ids->pdata);
-
-	/* get any details */
-	results = pk_client_get_details (priv->client,
-					 (gchar **) package_ids->pdata,
-					 cancellable,
-					 gs_plugin_packagekit_progress_cb, &data,
-					 error);
-	if (!gs_plugin_packagekit_results_valid (results, error))
-		return FALSE;
-
-	/* set the update details for the update */
-	array = pk_results_get_details_array (results);
-	for (i = 0; i < gs_app_list_length (list); i++) {
-		app = gs_app_list_index (list, i);
-		gs_plugin_packagekit_refine_details_app (plugin, array, app);
+	/* nothing to ask PackageKit */
+	if (job->package_ids->len == 0) {
+		for (i = 0; i < gs_app_list_length (list); i++) {
+			app = gs_app_list_index (list, i);
+			gs_plugin_packagekit_refine_details_app (helper->plugin, job->array, app);
+		}
+		gs_plugin_packagekit_refine_job_free (job);
+		return;
 	}
-	return TRUE;
+	g_ptr_array_add (job->package_ids, NULL);
+	g_queue_push_tail (&helper->pending, job);
 }
 
-static gboolean
-gs_plugin_packagekit_refine_update_urgency (GsPlugin *plugin,
-					    GsAppList *list,
-					    GCancellable *cancellable,
-					    GError **error)
+/* @sack is the result of GetUpdates, or %NULL to use @cache */
+static void
+gs_plugin_packagekit_refine_update_urgency_apply (GsAppList *list,
+						  PkPackageSack *sack,
+						  GsPackagekitCache *cache)
 {
-	GsPluginData *priv = gs_plugin_get_data (plugin);
 	guint i;
 	GsApp *app;
 	const gchar *package_id;
-	PkBitfield filter;
-	ProgressData data;
-	g_autoptr(PkPackageSack) sack = NULL;
-	g_autoptr(PkResults) results = NULL;
-
-	data.app = NULL;
-	data.plugin = plugin;
-	data.ptask = NULL;
-	data.profile_id = NULL;
-
-	/* get the list of updates */
-	filter = pk_bitfield_value (PK_FILTER_ENUM_NONE);
-	results = pk_client_get_updates (priv->client,
-					 filter,
-					 cancellable,
-					 gs_plugin_packagekit_progress_cb, &data,
-					 error);
-	if (!gs_plugin_packagekit_results_valid (results, error))
-		return FALSE;
+	PkInfoEnum info;
 
 	/* set the update severity for the app */
-	sack = pk_results_get_package_sack (results);
 	for (i = 0; i < gs_app_list_length (list); i++) {
-		g_autoptr (PkPackage) pkg = NULL;
 		app = gs_app_list_index (list, i);
 		if (gs_app_has_quirk (app, AS_APP_QUIRK_MATCH_ANY_PREFIX))
 			continue;
 		package_id = gs_app_get_source_id_default (app);
 		if (package_id == NULL)
 			continue;
-		pkg = pk_package_sack_find_by_id (sack, package_id);
-		if (pkg == NULL)
-			continue;
-		switch (pk_package_get_info (pkg)) {
+		if (sack != NULL) {
+			g_autoptr (PkPackage) pkg = NULL;
+			pkg = pk_package_sack_find_by_id (sack, package_id);
+			if (pkg == NULL)
+				continue;
+			info = pk_package_get_info (pkg);
+		} else {
+			info = gs_packagekit_cache_lookup_update_info (cache, package_id);
+			if (info == PK_INFO_ENUM_UNKNOWN)
+				continue;
+		}
+		switch (info) {
 		case PK_INFO_ENUM_AVAILABLE:
 		case PK_INFO_ENUM_NORMAL:
 		case PK_INFO_ENUM_LOW:
@@ -607,11 +1144,66 @@ gs_plugin_packagekit_refine_update_urgency (GsPlugin *plugin,
 		default:
 			gs_app_set_update_urgency (app, AS_URGENCY_KIND_UNKNOWN);
 			g_warning ("unhandled info state %s",
-				   pk_info_enum_to_string (pk_package_get_info (pkg)));
+				   pk_info_enum_to_string (info));
 			break;
 		}
 	}
-	return TRUE;
+}
+
+static void
+gs_plugin_packagekit_refine_update_urgency_cb (GObject *source_object,
+					       GAsyncResult *res,
+					       gpointer user_data)
+{
+	RefineJob *job = (RefineJob *) user_data;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkPackageSack) sack = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	results = pk_client_generic_finish (PK_CLIENT (source_object), res, &error);
+	if (!gs_plugin_packagekit_results_valid (results, &error)) {
+		gs_plugin_packagekit_refine_job_done (job, g_steal_pointer (&error));
+		return;
+	}
+	sack = pk_results_get_package_sack (results);
+	if (job->cache != NULL) {
+		g_autoptr(GPtrArray) packages = pk_results_get_package_array (results);
+		gs_packagekit_cache_set_updates (job->cache, packages);
+		gs_plugin_packagekit_save_cache (job->cache);
+	}
+	gs_plugin_packagekit_refine_update_urgency_apply (job->list, sack, NULL);
+	gs_plugin_packagekit_refine_job_done (job, NULL);
+}
+
+static void
+gs_plugin_packagekit_refine_update_urgency_start (RefineJob *job)
+{
+	GsPluginData *priv = gs_plugin_get_data (job->helper->plugin);
+	pk_client_get_updates_async (priv->client,
+				     pk_bitfield_value (PK_FILTER_ENUM_NONE),
+				     job->helper->cancellable,
+				     gs_plugin_packagekit_progress_cb, &job->data,
+				     gs_plugin_packagekit_refine_update_urgency_cb,
+				     job);
+}
+
+static void
+gs_plugin_packagekit_refine_update_urgency (RefineHelper *helper, GsAppList *list)
+{
+	RefineJob *job;
+
+	job = gs_plugin_packagekit_refine_job_new (helper, list,
+						   "id->update-severity",
+						   gs_plugin_packagekit_refine_update_urgency_start);
+
+	/* get the list of updates, unless it is already known */
+	job->cache = gs_plugin_packagekit_get_cache (helper->plugin, helper->cancellable);
+	if (job->cache != NULL && gs_packagekit_cache_has_updates (job->cache)) {
+		gs_plugin_packagekit_refine_update_urgency_apply (list, NULL, job->cache);
+		gs_plugin_packagekit_refine_job_free (job);
+		return;
+	}
+	g_queue_push_tail (&helper->pending, job);
 }
 
 static gboolean
@@ -632,22 +1224,15 @@ gs_plugin_refine_app_needs_details (GsPlugin *plugin, GsPluginRefineFlags flags,
 	return FALSE;
 }
 
-static gboolean
-gs_plugin_refine_require_details (GsPlugin *plugin,
+static void
+gs_plugin_refine_require_details (RefineHelper *helper,
 				  GsAppList *list,
-				  GsPluginRefineFlags flags,
-				  GCancellable *cancellable,
-				  GError **error)
+				  GsPluginRefineFlags flags)
 {
 	guint i;
 	GsApp *app;
-	gboolean ret = TRUE;
 	g_autoptr(GsAppList) list_tmp = NULL;
-	g_autoptr(AsProfileTask) ptask = NULL;
 
-	ptask = as_profile_start_literal (gs_plugin_get_profile (plugin),
-					  "packagekit-refine[source->license]");
-	g_assert (ptask != NULL);
 	list_tmp = gs_app_list_new ();
 	for (i = 0; i < gs_app_list_length (list); i++) {
 		app = gs_app_list_index (list, i);
@@ -659,19 +1244,13 @@ gs_plugin_refine_require_details (GsPlugin *plugin,
 			continue;
 		if (gs_app_get_source_id_default (app) == NULL)
 			continue;
-		if (!gs_plugin_refine_app_needs_details (plugin, flags, app))
+		if (!gs_plugin_refine_app_needs_details (helper->plugin, flags, app))
 			continue;
 		gs_app_list_add (list_tmp, app);
 	}
 	if (gs_app_list_length (list_tmp) == 0)
-		return TRUE;
-	ret = gs_plugin_packagekit_refine_details (plugin,
-						   list_tmp,
-						   cancellable,
-						   error);
-	if (!ret)
-		return FALSE;
-	return TRUE;
+		return;
+	gs_plugin_packagekit_refine_details (helper, list_tmp);
 }
 
 static gboolean
@@ -801,7 +1380,10 @@ gs_plugin_refine (GsPlugin *plugin,
 	gboolean ret = TRUE;
 	g_autoptr(GsAppList) resolve_all = NULL;
 	g_autoptr(GsAppList) updatedetails_all = NULL;
+	g_autoptr(GPtrArray) desktop_apps = NULL;
+	g_autoptr(GPtrArray) desktop_filenames = NULL;
 	AsProfileTask *ptask = NULL;
+	RefineHelper helper;
 
 	/* when we need the cannot-be-upgraded applications, we implement this
 	 * by doing a UpgradeSystem(SIMULATE) which adds the removed packages
@@ -858,6 +1440,8 @@ gs_plugin_refine (GsPlugin *plugin,
 	/* set the package-id for an installed desktop file */
 	ptask = as_profile_start_literal (gs_plugin_get_profile (plugin),
 					  "packagekit-refine[installed-filename->id]");
+	desktop_apps = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	desktop_filenames = g_ptr_array_new_with_free_func (g_free);
 	for (i = 0; i < gs_app_list_length (list); i++) {
 		g_autofree gchar *fn = NULL;
 		if ((flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_SETUP_ACTION) == 0)
@@ -889,9 +1473,13 @@ gs_plugin_refine (GsPlugin *plugin,
 			g_debug ("ignoring %s as does not exist", fn);
 			continue;
 		}
+		g_ptr_array_add (desktop_apps, g_object_ref (app));
+		g_ptr_array_add (desktop_filenames, g_steal_pointer (&fn));
+	}
+	if (desktop_filenames->len > 0) {
 		ret = gs_plugin_packagekit_refine_from_desktop (plugin,
-								app,
-								fn,
+								desktop_apps,
+								desktop_filenames,
 								cancellable,
 								error);
 		if (!ret)
@@ -899,9 +1487,10 @@ gs_plugin_refine (GsPlugin *plugin,
 	}
 	as_profile_task_free (ptask);
 
+	/* the rest only needs package-ids, so the transactions can overlap */
+	gs_plugin_packagekit_refine_helper_init (&helper, plugin, cancellable);
+
 	/* any update details missing? */
-	ptask = as_profile_start_literal (gs_plugin_get_profile (plugin),
-					  "packagekit-refine[id->update-details]");
 	updatedetails_all = gs_app_list_new ();
 	for (i = 0; i < gs_app_list_length (list); i++) {
 		app = gs_app_list_index (list, i);
@@ -915,34 +1504,18 @@ gs_plugin_refine (GsPlugin *plugin,
 		if (gs_plugin_refine_requires_update_details (app, flags))
 			gs_app_list_add (updatedetails_all, app);
 	}
-	if (gs_app_list_length (updatedetails_all) > 0) {
-		ret = gs_plugin_packagekit_refine_updatedetails (plugin,
-								 updatedetails_all,
-								 cancellable,
-								 error);
-		if (!ret)
-			goto out;
-	}
-	as_profile_task_free (ptask);
+	if (gs_app_list_length (updatedetails_all) > 0)
+		gs_plugin_packagekit_refine_updatedetails (&helper, updatedetails_all);
 
 	/* any important details missing? */
-	ret = gs_plugin_refine_require_details (plugin,
-						list,
-						flags,
-						cancellable,
-						error);
-	if (!ret)
-		goto out;
+	gs_plugin_refine_require_details (&helper, list, flags);
 
 	/* get the update severity */
-	if ((flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_UPDATE_SEVERITY) > 0) {
-		ret = gs_plugin_packagekit_refine_update_urgency (plugin,
-								  list,
-								  cancellable,
-								  error);
-		if (!ret)
-			goto out;
-	}
+	if ((flags & GS_PLUGIN_REFINE_FLAGS_REQUIRE_UPDATE_SEVERITY) > 0)
+		gs_plugin_packagekit_refine_update_urgency (&helper, list);
+
+	ret = gs_plugin_packagekit_refine_helper_wait (&helper, error);
+	gs_plugin_packagekit_refine_helper_clear (&helper);
 out:
 	return ret;
 }
@@ -24,12 +24,17 @@
 #include <packagekit-glib2/packagekit.h>
 #include <gnome-software.h>
 
+#include "packagekit-cache.h"
 #include "packagekit-common.h"
+#include "packagekit-download.h"
 
 /*
  * SECTION:
  * Do a PackageKit UpdatePackages(ONLY_DOWNLOAD) method on refresh and
  * also convert any package files to applications the best we can.
+ *
+ * The progress of the download is worked out from the bytes remaining
+ * rather than from the coarse percentage PackageKit reports.
  */
 
 struct GsPluginData {
@@ -57,8 +62,11 @@ gs_plugin_destroy (GsPlugin *plugin)
 }
 
 typedef struct {
-	GsPlugin	*plugin;
-	AsProfileTask	*ptask;
+	GsApp			*app;
+	GsPlugin		*plugin;
+	AsProfileTask		*ptask;
+	GsPackagekitDownload	*download;
+	guint			 percentage;
 } ProgressData;
 
 static void
@@ -71,6 +79,23 @@ gs_plugin_packagekit_progress_cb (PkProgress *progress,
 	GsPluginStatus plugin_status;
 	PkStatusEnum status;
 
+	/* only the bytes are accurate, so only show those */
+	if (type == PK_PROGRESS_TYPE_DOWNLOAD_SIZE_REMAINING && data->download != NULL) {
+		guint64 remaining = 0;
+		guint percentage;
+
+		g_object_get (progress,
+			      "download-size-remaining", &remaining,
+			      NULL);
+		gs_packagekit_download_set_remaining (data->download, remaining,
+						      g_get_monotonic_time ());
+		percentage = gs_packagekit_download_get_percentage (data->download);
+		if (percentage != data->percentage) {
+			gs_plugin_percentage_update (plugin, percentage);
+			data->percentage = percentage;
+		}
+		return;
+	}
 	if (type != PK_PROGRESS_TYPE_STATUS)
 		return;
 	g_object_get (progress,
@@ -87,7 +112,141 @@ gs_plugin_packagekit_progress_cb (PkProgress *progress,
 
 	plugin_status = packagekit_status_enum_to_plugin_status (status);
 	if (plugin_status != GS_PLUGIN_STATUS_UNKNOWN)
-		gs_plugin_status_update (plugin, NULL, plugin_status);
+		gs_plugin_status_update (plugin, data->app, plugin_status);
+}
+
+/* fill the package metadata cache for the refine plugin while we know
+ * that the answers have just changed */
+static void
+gs_plugin_packagekit_refresh_populate_cache (GsPlugin *plugin,
+					     PkResults *results,
+					     GHashTable *details_by_id,
+					     ProgressData *data,
+					     GCancellable *cancellable)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	gboolean certain = FALSE;
+	guint64 generation;
+	g_autofree gchar *fn = NULL;
+	g_auto(GStrv) package_ids = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(GsPackagekitCache) cache = NULL;
+	g_autoptr(PkControl) control = pk_control_new ();
+	g_autoptr(PkPackageSack) sack = NULL;
+	g_autoptr(PkResults) results_details = NULL;
+	g_autoptr(PkResults) results_update_detail = NULL;
+
+	fn = gs_utils_get_cache_filename ("packagekit",
+					  "package-metadata.ini",
+					  GS_UTILS_CACHE_FLAG_WRITEABLE,
+					  &error);
+	if (fn == NULL) {
+		g_warning ("not caching package metadata: %s", error->message);
+		return;
+	}
+	generation = gs_packagekit_cache_get_generation (control, &certain,
+							 cancellable, &error);
+	if (error != NULL) {
+		g_warning ("not caching package metadata: %s", error->message);
+		return;
+	}
+	cache = gs_packagekit_cache_new (fn);
+	gs_packagekit_cache_load (cache, generation, certain);
+	packages = pk_results_get_package_array (results);
+	gs_packagekit_cache_set_updates (cache, packages);
+
+	/* the details of every update are going to be shown */
+	sack = pk_results_get_package_sack (results);
+	package_ids = pk_package_sack_get_ids (sack);
+	if (g_strv_length (package_ids) > 0) {
+		results_details = pk_client_get_details (PK_CLIENT (priv->task),
+							 package_ids,
+							 cancellable,
+							 gs_plugin_packagekit_progress_cb, data,
+							 &error);
+		if (!gs_plugin_packagekit_results_valid (results_details, &error)) {
+			g_warning ("failed to get details: %s", error->message);
+			g_clear_error (&error);
+		} else {
+			array = pk_results_get_details_array (results_details);
+			for (guint i = 0; i < array->len; i++) {
+				PkDetails *details = g_ptr_array_index (array, i);
+				gs_packagekit_cache_add_details (cache,
+								 pk_details_get_package_id (details),
+								 details);
+				g_hash_table_insert (details_by_id,
+						     g_strdup (pk_details_get_package_id (details)),
+						     g_object_ref (details));
+			}
+			g_clear_pointer (&array, g_ptr_array_unref);
+		}
+		results_update_detail = pk_client_get_update_detail (PK_CLIENT (priv->task),
+								     package_ids,
+								     cancellable,
+								     gs_plugin_packagekit_progress_cb, data,
+								     &error);
+		if (!gs_plugin_packagekit_results_valid (results_update_detail, &error)) {
+			g_warning ("failed to get update details: %s", error->message);
+			g_clear_error (&error);
+		} else {
+			array = pk_results_get_update_detail_array (results_update_detail);
+			for (guint i = 0; i < array->len; i++)
+				gs_packagekit_cache_add_update_detail (cache, g_ptr_array_index (array, i));
+		}
+	}
+	if (!gs_packagekit_cache_save (cache, &error))
+		g_warning ("%s", error->message);
+}
+
+static gboolean
+gs_plugin_packagekit_refresh_download (GsPlugin *plugin,
+				       gchar **package_ids,
+				       GHashTable *details_by_id,
+				       ProgressData *data,
+				       GCancellable *cancellable,
+				       GError **error)
+{
+	GsPluginData *priv = gs_plugin_get_data (plugin);
+	guint64 size = 0;
+	g_autoptr(GsApp) app = NULL;
+	g_autoptr(GsPackagekitDownload) download = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	/* the size before anything has been downloaded */
+	for (guint i = 0; package_ids[i] != NULL; i++) {
+		PkDetails *details = g_hash_table_lookup (details_by_id, package_ids[i]);
+		if (details != NULL)
+			size += gs_plugin_packagekit_details_get_download_size (details);
+	}
+
+	/* the UI shows the progress of the whole download on this */
+	app = gs_app_new (NULL);
+	gs_app_set_kind (app, AS_APP_KIND_OS_UPDATE);
+	gs_app_set_management_plugin (app, "packagekit");
+	gs_app_set_size_download (app, size);
+	download = gs_packagekit_download_new (app, size);
+
+	/* PackageKit only runs one download at a time, so the packages
+	 * are all fetched in one transaction */
+	data->app = app;
+	data->download = download;
+	data->percentage = G_MAXUINT;
+	gs_plugin_status_update (plugin, app, GS_PLUGIN_STATUS_WAITING);
+	results = pk_task_update_packages_sync (priv->task,
+						package_ids,
+						cancellable,
+						gs_plugin_packagekit_progress_cb, data,
+						error);
+	data->app = NULL;
+	data->download = NULL;
+	if (results == NULL) {
+		gs_plugin_packagekit_error_convert (error);
+		return FALSE;
+	}
+	gs_packagekit_download_set_finished (download, g_get_monotonic_time ());
+	return TRUE;
 }
 
 gboolean
@@ -99,6 +258,7 @@ gs_plugin_refresh (GsPlugin *plugin,
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
 	ProgressData data;
+	g_autoptr(GHashTable) details_by_id = NULL;
 	g_autoptr(PkResults) results = NULL;
 
 	/* nothing to re-generate */
@@ -108,8 +268,13 @@ gs_plugin_refresh (GsPlugin *plugin,
 	/* cache age of 0 is user-initiated */
 	pk_client_set_background (PK_CLIENT (priv->task), cache_age > 0);
 
+	data.app = NULL;
 	data.plugin = plugin;
 	data.ptask = NULL;
+	data.download = NULL;
+	data.percentage = G_MAXUINT;
+	details_by_id = g_hash_table_new_full (g_str_hash, g_str_equal,
+					       g_free, (GDestroyNotify) g_object_unref);
 
 	/* refresh the metadata */
 	if (flags & GS_PLUGIN_REFRESH_FLAGS_METADATA ||
@@ -126,28 +291,24 @@ gs_plugin_refresh (GsPlugin *plugin,
 						 error);
 		if (!gs_plugin_packagekit_results_valid (results, error))
 			return FALSE;
+		gs_plugin_packagekit_refresh_populate_cache (plugin, results,
+							     details_by_id,
+							     &data, cancellable);
 	}
 
 	/* download all the packages themselves */
 	if (flags & GS_PLUGIN_REFRESH_FLAGS_PAYLOAD) {
 		g_auto(GStrv) package_ids = NULL;
 		g_autoptr(PkPackageSack) sack = NULL;
-		g_autoptr(PkResults) results2 = NULL;
 
 		sack = pk_results_get_package_sack (results);
 		if (pk_package_sack_get_size (sack) == 0)
 			return TRUE;
 		package_ids = pk_package_sack_get_ids (sack);
-		gs_plugin_status_update (plugin, NULL, GS_PLUGIN_STATUS_WAITING);
-		results2 = pk_task_update_packages_sync (priv->task,
-							 package_ids,
-							 cancellable,
-							 gs_plugin_packagekit_progress_cb, &data,
-							 error);
-		if (results2 == NULL) {
-			gs_plugin_packagekit_error_convert (error);
+		if (!gs_plugin_packagekit_refresh_download (plugin, package_ids,
+							    details_by_id, &data,
+							    cancellable, error))
 			return FALSE;
-		}
 	}
 
 	return TRUE;
@@ -26,6 +26,7 @@
 #include <gnome-software.h>
 
 #include "packagekit-common.h"
+#include "packagekit-download.h"
 
 struct GsPluginData {
 	PkTask			*task;
@@ -50,8 +51,9 @@ gs_plugin_destroy (GsPlugin *plugin)
 }
 
 typedef struct {
-	GsApp		*app;
-	GsPlugin	*plugin;
+	GsApp			*app;
+	GsPlugin		*plugin;
+	GsPackagekitDownload	*download;
 } ProgressData;
 
 static void
@@ -69,8 +71,19 @@ gs_plugin_packagekit_progress_cb (PkProgress *progress,
 			gs_plugin_status_update (plugin, NULL, plugin_status);
 	} else if (type == PK_PROGRESS_TYPE_PERCENTAGE) {
 		gint percentage = pk_progress_get_percentage (progress);
+
+		/* the bytes downloaded are more accurate when known */
+		if (gs_packagekit_download_get_size (data->download) > 0)
+			return;
 		if (percentage >= 0 && percentage <= 100)
 			gs_app_set_progress (data->app, (guint) percentage);
+	} else if (type == PK_PROGRESS_TYPE_DOWNLOAD_SIZE_REMAINING) {
+		guint64 remaining = 0;
+		g_object_get (progress,
+			      "download-size-remaining", &remaining,
+			      NULL);
+		gs_packagekit_download_set_remaining (data->download, remaining,
+						      g_get_monotonic_time ());
 	}
 }
 
@@ -82,6 +95,7 @@ gs_plugin_app_upgrade_download (GsPlugin *plugin,
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
 	ProgressData data;
+	g_autoptr(GsPackagekitDownload) download = NULL;
 	g_autoptr(PkResults) results = NULL;
 
 	/* only process this app if was created by this plugin */
@@ -92,8 +106,10 @@ gs_plugin_app_upgrade_download (GsPlugin *plugin,
 	if (gs_app_get_kind (app) != AS_APP_KIND_OS_UPGRADE)
 		return TRUE;
 
+	download = gs_packagekit_download_new (app, 0);
 	data.app = app;
 	data.plugin = plugin;
+	data.download = download;
 
 	/* ask PK to download enough packages to upgrade the system */
 	gs_app_set_state (app, AS_APP_STATE_INSTALLING);
@@ -97,6 +97,92 @@ gs_plugin_packagekit_progress_cb (PkProgress *progress,
 	}
 }
 
+/* how often to pass packages found so far back to the loader */
+#define GS_PLUGIN_PACKAGEKIT_PARTIAL_RESULTS_INTERVAL	200 /* ms */
+
+typedef struct {
+	ProgressData	 data;
+	GsAppList	*list;
+	GsAppList	*partial;
+	GHashTable	*installed;
+	gint64		 last_report;
+} SearchData;
+
+static void
+gs_plugin_packagekit_search_flush (SearchData *search)
+{
+	g_autoptr(GsAppList) partial = NULL;
+
+	if (gs_app_list_length (search->partial) == 0)
+		return;
+	partial = search->partial;
+	search->partial = gs_app_list_new ();
+	search->last_report = g_get_monotonic_time ();
+	gs_plugin_report_partial_results (search->data.plugin,
+					  search->list,
+					  partial);
+}
+
+static void
+gs_plugin_packagekit_search_progress_cb (PkProgress *progress,
+					 PkProgressType type,
+					 gpointer user_data)
+{
+	SearchData *search = (SearchData *) user_data;
+	g_autoptr(GsApp) app = NULL;
+	g_autoptr(PkPackage) package = NULL;
+
+	if (type != PK_PROGRESS_TYPE_PACKAGE) {
+		gs_plugin_packagekit_progress_cb (progress, type, &search->data);
+		return;
+	}
+
+	/* the final list hides available packages that are also installed,
+	 * so do the same for the ones that arrive in the right order */
+	g_object_get (progress, "package", &package, NULL);
+	if (package == NULL)
+		return;
+	if (pk_package_get_info (package) == PK_INFO_ENUM_INSTALLED) {
+		g_hash_table_add (search->installed,
+				  g_strdup (pk_package_get_name (package)));
+	} else if (pk_package_get_info (package) == PK_INFO_ENUM_AVAILABLE &&
+		   g_hash_table_contains (search->installed,
+					  pk_package_get_name (package))) {
+		return;
+	}
+	app = gs_plugin_packagekit_app_new_from_package (search->data.plugin, package);
+	gs_app_list_add (search->partial, app);
+
+	/* do not wake the UI for every single package; anything still
+	 * pending when the transaction finishes is in the final list */
+	if (g_get_monotonic_time () - search->last_report <
+	    GS_PLUGIN_PACKAGEKIT_PARTIAL_RESULTS_INTERVAL * 1000)
+		return;
+	gs_plugin_packagekit_search_flush (search);
+}
+
+static void
+gs_plugin_packagekit_search_init (SearchData *search,
+				  GsPlugin *plugin,
+				  GsAppList *list)
+{
+	search->data.app = NULL;
+	search->data.plugin = plugin;
+	search->data.ptask = NULL;
+	search->list = list;
+	search->partial = gs_app_list_new ();
+	search->installed = g_hash_table_new_full (g_str_hash, g_str_equal,
+						   g_free, NULL);
+	search->last_report = 0;
+}
+
+static void
+gs_plugin_packagekit_search_clear (SearchData *search)
+{
+	g_object_unref (search->partial);
+	g_hash_table_unref (search->installed);
+}
+
 static gboolean
 gs_plugin_add_sources_related (GsPlugin *plugin,
 			       GHashTable *hash,
@@ -573,15 +659,12 @@ gs_plugin_add_search_files (GsPlugin *plugin,
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
 	PkBitfield filter;
-	ProgressData data;
+	SearchData search_data;
 	g_autoptr(PkResults) results = NULL;
 
-	data.app = NULL;
-	data.plugin = plugin;
-	data.ptask = NULL;
-
-	/* do sync call */
+	/* do sync call, reporting packages as they are found */
 	gs_plugin_status_update (plugin, NULL, GS_PLUGIN_STATUS_WAITING);
+	gs_plugin_packagekit_search_init (&search_data, plugin, list);
 	filter = pk_bitfield_from_enums (PK_FILTER_ENUM_NEWEST,
 					 PK_FILTER_ENUM_ARCH,
 					 -1);
@@ -589,8 +672,9 @@ gs_plugin_add_search_files (GsPlugin *plugin,
 	                                  filter,
 	                                  search,
 	                                  cancellable,
-	                                  gs_plugin_packagekit_progress_cb, &data,
+	                                  gs_plugin_packagekit_search_progress_cb, &search_data,
 	                                  error);
+	gs_plugin_packagekit_search_clear (&search_data);
 	if (!gs_plugin_packagekit_results_valid (results, error))
 		return FALSE;
 
@@ -607,15 +691,12 @@ gs_plugin_add_search_what_provides (GsPlugin *plugin,
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
 	PkBitfield filter;
-	ProgressData data;
+	SearchData search_data;
 	g_autoptr(PkResults) results = NULL;
 
-	data.app = NULL;
-	data.plugin = plugin;
-	data.ptask = NULL;
-
-	/* do sync call */
+	/* do sync call, reporting packages as they are found */
 	gs_plugin_status_update (plugin, NULL, GS_PLUGIN_STATUS_WAITING);
+	gs_plugin_packagekit_search_init (&search_data, plugin, list);
 	filter = pk_bitfield_from_enums (PK_FILTER_ENUM_NEWEST,
 					 PK_FILTER_ENUM_ARCH,
 					 -1);
@@ -623,8 +704,9 @@ gs_plugin_add_search_what_provides (GsPlugin *plugin,
 	                                   filter,
 	                                   search,
 	                                   cancellable,
-	                                   gs_plugin_packagekit_progress_cb, &data,
+	                                   gs_plugin_packagekit_search_progress_cb, &search_data,
 	                                   error);
+	gs_plugin_packagekit_search_clear (&search_data);
 	if (!gs_plugin_packagekit_results_valid (results, error))
 		return FALSE;
 
@@ -21,10 +21,17 @@
 
 #include "config.h"
 
+#include <glib/gstdio.h>
+
 #include "gnome-software-private.h"
 
 #include "gs-markdown.h"
+#include "gs-markdown-legacy.h"
 #include "gs-test.h"
+#include "packagekit-cache.h"
+#include "packagekit-common.h"
+#include "packagekit-download.h"
+#include "packagekit-history.h"
 
 static void
 gs_markdown_func (void)
@@ -206,6 +213,497 @@ gs_markdown_func (void)
 	g_free (text);
 }
 
+static gchar *
+gs_markdown_test_changelog (gsize size, gboolean code)
+{
+	GString *str = g_string_new (NULL);
+	for (guint i = 0; str->len < size; i++) {
+		g_string_append_printf (str,
+					"* Fix *crash* in **parser** when %s was _empty_, "
+					"see #%u and http://bugzilla.example.com/%u\n",
+					code ? "`foo()`" : "foo()", i, i);
+		if (i % 20 == 0)
+			g_string_append (str, "\n## Release notes ##\n\n");
+	}
+	return g_string_free (str, FALSE);
+}
+
+/* words that exercise each of the formatting rules */
+static const gchar *gs_markdown_test_tokens[] = {
+	"*", "**", "_", "__", "`", " ", "  ", "\t", "\n", "\n\n",
+	"# ", "## ", "#", "- ", "* ", " - ", "+ ", "===", "---", "***", "-_ *",
+	"\"", "'", " -- ", "--", "<", ">", "&", "é",
+	"http://www.example.com/", "ftp://ftp.example.com", "foo()",
+	"dev@example.com", "/usr/bin", "#123", "fix.patch", "CONFIG_FOO_BAR",
+	"_private_name", "word", "Update", NULL };
+
+static gchar *
+gs_markdown_test_random_document (GRand *rand, guint n_tokens)
+{
+	GString *str = g_string_new (NULL);
+	guint n_choices = g_strv_length ((gchar **) gs_markdown_test_tokens);
+	for (guint i = 0; i < n_tokens; i++) {
+		guint idx = (guint) g_rand_int_range (rand, 0, (gint32) n_choices);
+		g_string_append (str, gs_markdown_test_tokens[idx]);
+	}
+	return g_string_free (str, FALSE);
+}
+
+static void
+gs_markdown_test_compare (const gchar *markdown,
+			  GsMarkdownOutputKind output,
+			  guint options,
+			  gint max_lines)
+{
+	g_autofree gchar *text = NULL;
+	g_autofree gchar *text_legacy = NULL;
+	g_autoptr(GsMarkdown) md = gs_markdown_new (output);
+	g_autoptr(GsMarkdownLegacy) md_legacy = gs_markdown_legacy_new (output);
+
+	gs_markdown_set_smart_quoting (md, (options & 1) > 0);
+	gs_markdown_set_autocode (md, (options & 2) > 0);
+	gs_markdown_set_escape (md, (options & 4) > 0);
+	gs_markdown_set_autolinkify (md, (options & 8) > 0);
+	gs_markdown_set_max_lines (md, max_lines);
+	gs_markdown_legacy_set_smart_quoting (md_legacy, (options & 1) > 0);
+	gs_markdown_legacy_set_autocode (md_legacy, (options & 2) > 0);
+	gs_markdown_legacy_set_escape (md_legacy, (options & 4) > 0);
+	gs_markdown_legacy_set_autolinkify (md_legacy, (options & 8) > 0);
+	gs_markdown_legacy_set_max_lines (md_legacy, max_lines);
+
+	/* parse twice to check nothing is left over from the last run */
+	for (guint i = 0; i < 2; i++) {
+		g_free (text);
+		g_free (text_legacy);
+		text = gs_markdown_parse (md, markdown);
+		text_legacy = gs_markdown_legacy_parse (md_legacy, markdown);
+		if (g_strcmp0 (text, text_legacy) != 0) {
+			g_test_message ("output %u, options 0x%x, max lines %i: %s",
+					output, options, max_lines, markdown);
+		}
+		g_assert_cmpstr (text, ==, text_legacy);
+	}
+}
+
+static void
+gs_markdown_differential_func (void)
+{
+	const gchar *samples[] = {
+		"",
+		"\n",
+		"OEMs\n====\n - Bullett\n",
+		"*** This software is currently in alpha state ***\n",
+		" - This is a *very*\n - short paragraph\n\n## Header ##\n",
+		"*Thu Mar 12 12:00:00 2009* Dan Walsh <dwalsh@redhat.com> - 2.0.79-1\n"
+		"- Update to upstream\n * Fix *bold* and __strong__ text\n",
+		"this is the http://www.hughsie.com/ coolest site with `code` in it",
+		"This isn't CONFIG_UEVENT_HELPER_PATH present -- or \"is\" it?",
+		"a * b * c _d_ e __f __ g **h** i",
+		NULL };
+	g_autoptr(GRand) rand = g_rand_new_with_seed (0x6d64);
+
+	/* every combination of options for some known documents */
+	for (guint i = 0; samples[i] != NULL; i++) {
+		for (guint output = 0; output < GS_MARKDOWN_OUTPUT_LAST; output++) {
+			for (guint options = 0; options < 16; options++) {
+				gs_markdown_test_compare (samples[i], output, options, -1);
+				gs_markdown_test_compare (samples[i], output, options, 1);
+			}
+		}
+	}
+
+	/* the changelogs used for the benchmark, at a size the old parser
+	 * can handle quickly */
+	for (guint i = 0; i < 2; i++) {
+		g_autofree gchar *markdown = gs_markdown_test_changelog (16 * 1024, i == 0);
+		for (guint output = 0; output < GS_MARKDOWN_OUTPUT_LAST; output++) {
+			for (guint options = 0; options < 16; options++) {
+				gs_markdown_test_compare (markdown, output, options, -1);
+				gs_markdown_test_compare (markdown, output, options, 5);
+			}
+		}
+	}
+
+	/* lots of nonsense */
+	for (guint i = 0; i < 20000; i++) {
+		g_autofree gchar *markdown = NULL;
+		markdown = gs_markdown_test_random_document (rand, (guint) g_rand_int_range (rand, 0, 40));
+		gs_markdown_test_compare (markdown,
+					  (GsMarkdownOutputKind) g_rand_int_range (rand, 0, GS_MARKDOWN_OUTPUT_LAST),
+					  (guint) g_rand_int_range (rand, 0, 16),
+					  g_rand_int_range (rand, -1, 3));
+	}
+}
+
+static void
+gs_markdown_benchmark_func (void)
+{
+	gsize size = g_test_perf () ? 4 * 1024 * 1024 : 256 * 1024;
+	g_autoptr(GTimer) timer = g_timer_new ();
+
+	/* with and without code sections, which split up the paragraphs */
+	for (guint i = 0; i < 2; i++) {
+		g_autofree gchar *markdown = gs_markdown_test_changelog (size, i == 0);
+		g_autofree gchar *text = NULL;
+		g_autofree gchar *text_legacy = NULL;
+		g_autoptr(GsMarkdown) md = gs_markdown_new (GS_MARKDOWN_OUTPUT_PANGO);
+		g_autoptr(GsMarkdownLegacy) md_legacy = NULL;
+
+		gs_markdown_set_autocode (md, TRUE);
+		g_timer_reset (timer);
+		text = gs_markdown_parse (md, markdown);
+		g_test_message ("parsed %" G_GSIZE_FORMAT " bytes in %.1fms",
+				size, g_timer_elapsed (timer, NULL) * 1000);
+
+		/* the same as the old parser, and what it used to cost */
+		md_legacy = gs_markdown_legacy_new (GS_MARKDOWN_OUTPUT_PANGO);
+		gs_markdown_legacy_set_autocode (md_legacy, TRUE);
+		g_timer_reset (timer);
+		text_legacy = gs_markdown_legacy_parse (md_legacy, markdown);
+		g_test_minimized_result (g_timer_elapsed (timer, NULL),
+					 "legacy parser took %.1fms",
+					 g_timer_elapsed (timer, NULL) * 1000);
+		g_assert_cmpstr (text, ==, text_legacy);
+	}
+}
+
+static void
+gs_packagekit_package_index_func (void)
+{
+	GPtrArray *array;
+	gdouble elapsed;
+	guint matched = 0;
+	const guint n_packages = 50000;
+	const guint n_lookups = 3000;
+	g_autoptr(GHashTable) index = NULL;
+	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(GTimer) timer = g_timer_new ();
+	g_autoptr(PkResults) results = pk_results_new ();
+
+	/* a synthetic resolve of 50k packages, with one name twice */
+	for (guint i = 0; i < n_packages; i++) {
+		g_autofree gchar *package_id = NULL;
+		g_autoptr(GError) error = NULL;
+		g_autoptr(PkPackage) package = pk_package_new ();
+		package_id = g_strdup_printf ("pkg%u;1.%u-1;x86_64;fedora",
+					      i % (n_packages - 1), i);
+		pk_package_set_id (package, package_id, &error);
+		g_assert_no_error (error);
+		pk_package_set_info (package, i % 2 == 0 ? PK_INFO_ENUM_INSTALLED :
+							   PK_INFO_ENUM_AVAILABLE);
+		pk_results_add_package (results, package);
+	}
+	packages = pk_results_get_package_array (results);
+	g_assert_cmpint (packages->len, ==, n_packages);
+
+	/* all the packages with a name are kept, in order */
+	g_timer_reset (timer);
+	index = gs_plugin_packagekit_build_package_index (packages);
+	g_test_message ("indexed %u packages in %.1fms", n_packages,
+			g_timer_elapsed (timer, NULL) * 1000);
+	g_assert_cmpint (g_hash_table_size (index), ==, n_packages - 1);
+	array = g_hash_table_lookup (index, "pkg0");
+	g_assert (array != NULL);
+	g_assert_cmpint (array->len, ==, 2);
+	g_assert_cmpstr (pk_package_get_version (g_ptr_array_index (array, 0)), ==, "1.0-1");
+	g_assert_cmpstr (pk_package_get_version (g_ptr_array_index (array, 1)), ==, "1.49999-1");
+	g_assert (g_hash_table_lookup (index, "pkg") == NULL);
+
+	/* look up the sources of 3,000 apps */
+	g_timer_reset (timer);
+	for (guint i = 0; i < n_lookups; i++) {
+		g_autofree gchar *name = g_strdup_printf ("pkg%u", i * 16);
+		array = g_hash_table_lookup (index, name);
+		if (array != NULL)
+			matched += array->len;
+	}
+	elapsed = g_timer_elapsed (timer, NULL);
+	g_test_message ("resolved %u names against %u packages in %.1fms",
+			n_lookups, n_packages, elapsed * 1000);
+	g_assert_cmpint (matched, ==, n_lookups + 1);
+}
+
+static void
+gs_packagekit_cache_func (void)
+{
+	gboolean ret;
+	const gchar *package_id = "chiron;1.1-1.fc24;x86_64;fedora";
+	g_autofree gchar *fn = NULL;
+	g_autofree gchar *tmpdir = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) packages = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_autoptr(GsPackagekitCache) cache = NULL;
+	g_autoptr(GsPackagekitCache) cache2 = NULL;
+	g_autoptr(GsPackagekitCache) cache3 = NULL;
+	g_autoptr(PkDetails) details = NULL;
+	g_autoptr(PkDetails) details2 = NULL;
+	g_autoptr(PkPackage) package = pk_package_new ();
+	g_autoptr(PkUpdateDetail) update_detail = NULL;
+	g_autoptr(PkUpdateDetail) update_detail2 = NULL;
+
+	tmpdir = g_dir_make_tmp ("gs-self-test-packagekit-XXXXXX", &error);
+	g_assert_no_error (error);
+	fn = g_build_filename (tmpdir, "package-metadata.ini", NULL);
+
+	/* nothing known yet */
+	cache = gs_packagekit_cache_new (fn);
+	gs_packagekit_cache_load (cache, 1000, TRUE);
+	g_assert (gs_packagekit_cache_lookup_details (cache, package_id) == NULL);
+	g_assert (!gs_packagekit_cache_has_updates (cache));
+
+	/* add what a refresh would */
+	details = g_object_new (PK_TYPE_DETAILS,
+				"package-id", package_id,
+				"summary", "Single line synopsis",
+				"license", "GPLv2+",
+				"url", "http://127.0.0.1/",
+				"size", (guint64) 12345,
+				NULL);
+	gs_packagekit_cache_add_details (cache, package_id, details);
+	update_detail = g_object_new (PK_TYPE_UPDATE_DETAIL,
+				      "package-id", package_id,
+				      "update-text", "Fixes\nsome bugs",
+				      NULL);
+	gs_packagekit_cache_add_update_detail (cache, update_detail);
+	ret = pk_package_set_id (package, package_id, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	pk_package_set_info (package, PK_INFO_ENUM_SECURITY);
+	g_ptr_array_add (packages, g_object_ref (package));
+	gs_packagekit_cache_set_updates (cache, packages);
+	ret = gs_packagekit_cache_save (cache, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* another plugin loads it in the same generation */
+	cache2 = gs_packagekit_cache_new (fn);
+	gs_packagekit_cache_load (cache2, 1001, TRUE);
+	details2 = gs_packagekit_cache_lookup_details (cache2, package_id);
+	g_assert (details2 != NULL);
+	g_assert_cmpstr (pk_details_get_package_id (details2), ==, package_id);
+	g_assert_cmpstr (pk_details_get_summary (details2), ==, "Single line synopsis");
+	g_assert_cmpstr (pk_details_get_license (details2), ==, "GPLv2+");
+	g_assert_cmpstr (pk_details_get_url (details2), ==, "http://127.0.0.1/");
+	g_assert_cmpint (pk_details_get_size (details2), ==, 12345);
+	update_detail2 = gs_packagekit_cache_lookup_update_detail (cache2, package_id);
+	g_assert (update_detail2 != NULL);
+	g_assert_cmpstr (pk_update_detail_get_update_text (update_detail2), ==, "Fixes\nsome bugs");
+	g_assert (gs_packagekit_cache_has_updates (cache2));
+	g_assert_cmpint (gs_packagekit_cache_lookup_update_info (cache2, package_id), ==,
+			 PK_INFO_ENUM_SECURITY);
+	g_assert_cmpint (gs_packagekit_cache_lookup_update_info (cache2, "colour;1;noarch;fedora"), ==,
+			 PK_INFO_ENUM_UNKNOWN);
+
+	/* something may have happened that the generation does not show */
+	gs_packagekit_cache_load (cache2, 1001, FALSE);
+	g_assert (!gs_packagekit_cache_has_updates (cache2));
+	g_assert_cmpint (gs_packagekit_cache_lookup_update_info (cache2, package_id), ==,
+			 PK_INFO_ENUM_UNKNOWN);
+	g_clear_object (&details2);
+	details2 = gs_packagekit_cache_lookup_details (cache2, package_id);
+	g_assert (details2 != NULL);
+	gs_packagekit_cache_load (cache2, 1001, TRUE);
+	g_assert (gs_packagekit_cache_has_updates (cache2));
+
+	/* PackageKit has done something since */
+	cache3 = gs_packagekit_cache_new (fn);
+	gs_packagekit_cache_load (cache3, 2000, TRUE);
+	g_assert (gs_packagekit_cache_lookup_details (cache3, package_id) == NULL);
+	g_assert (gs_packagekit_cache_lookup_update_detail (cache3, package_id) == NULL);
+	g_assert (!gs_packagekit_cache_has_updates (cache3));
+	ret = gs_packagekit_cache_save (cache3, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* which the first plugin notices when it next loads */
+	gs_packagekit_cache_load (cache2, 2000, TRUE);
+	g_assert (!gs_packagekit_cache_has_updates (cache2));
+
+	/* an update list from an uncertain generation is never recorded */
+	gs_packagekit_cache_load (cache2, 2000, FALSE);
+	gs_packagekit_cache_set_updates (cache2, packages);
+	gs_packagekit_cache_load (cache2, 2000, TRUE);
+	g_assert (!gs_packagekit_cache_has_updates (cache2));
+
+	g_unlink (fn);
+	g_rmdir (tmpdir);
+}
+
+static PkTransactionPast *
+gs_packagekit_history_test_transaction (const gchar *tid,
+					const gchar *timestamp,
+					const gchar *data)
+{
+	return g_object_new (PK_TYPE_TRANSACTION_PAST,
+			     "tid", tid,
+			     "timestamp", timestamp,
+			     "succeeded", TRUE,
+			     "data", data,
+			     "uid", (guint) 1000,
+			     NULL);
+}
+
+static void
+gs_packagekit_history_func (void)
+{
+	gboolean ret;
+	GVariant *entries;
+	const gchar *version = NULL;
+	g_autofree gchar *fn = NULL;
+	g_autofree gchar *tmpdir = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) transactions = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_autoptr(GsPackagekitHistory) history = NULL;
+	g_autoptr(GsPackagekitHistory) history2 = NULL;
+	g_autoptr(GsPackagekitHistory) history3 = NULL;
+	g_autoptr(GVariant) entry = NULL;
+	GVariantBuilder builder;
+
+	tmpdir = g_dir_make_tmp ("gs-self-test-packagekit-XXXXXX", &error);
+	g_assert_no_error (error);
+	fn = g_build_filename (tmpdir, "history.gvariant", NULL);
+
+	/* nothing on disk yet */
+	history = gs_packagekit_history_new ();
+	ret = gs_packagekit_history_load (history, fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (gs_packagekit_history_lookup (history, "chiron") == NULL);
+
+	/* what GetPackageHistory returns */
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+	g_variant_builder_open (&builder, G_VARIANT_TYPE ("a{sv}"));
+	g_variant_builder_add (&builder, "{sv}", "info",
+			       g_variant_new_uint32 (PK_INFO_ENUM_INSTALLING));
+	g_variant_builder_add (&builder, "{sv}", "version",
+			       g_variant_new_string ("1.1-1.fc24"));
+	g_variant_builder_add (&builder, "{sv}", "timestamp",
+			       g_variant_new_uint64 (1483264800));
+	g_variant_builder_close (&builder);
+	gs_packagekit_history_add_package (history, "chiron",
+					   g_variant_builder_end (&builder));
+	gs_packagekit_history_add_package (history, "colour",
+					   g_variant_new_array (G_VARIANT_TYPE ("a{sv}"), NULL, 0));
+
+	/* two transactions finish in the same second */
+	g_ptr_array_add (transactions,
+			 gs_packagekit_history_test_transaction ("/1_abc",
+								 "2017-01-02T10:00:00Z",
+								 "updating\tchiron;1.2-1.fc24;x86_64;fedora\n"
+								 "installing\tunknown;1;noarch;fedora"));
+	g_assert_cmpint (gs_packagekit_history_add_transactions (history, transactions), ==, 1);
+	g_assert_cmpint (gs_packagekit_history_get_timestamp (history), ==, 1483351200);
+	g_assert (gs_packagekit_history_lookup (history, "unknown") == NULL);
+	entries = gs_packagekit_history_lookup (history, "chiron");
+	g_assert (entries != NULL);
+	g_assert_cmpint (g_variant_n_children (entries), ==, 2);
+
+	/* the cache format keeps both the history and the transactions seen */
+	ret = gs_packagekit_history_save (history, fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	history2 = gs_packagekit_history_new ();
+	ret = gs_packagekit_history_load (history2, fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (gs_packagekit_history_get_timestamp (history2), ==, 1483351200);
+	entries = gs_packagekit_history_lookup (history2, "colour");
+	g_assert (entries != NULL);
+	g_assert_cmpint (g_variant_n_children (entries), ==, 0);
+	entries = gs_packagekit_history_lookup (history2, "chiron");
+	g_assert (entries != NULL);
+	g_assert_cmpint (g_variant_n_children (entries), ==, 2);
+	entry = g_variant_get_child_value (entries, 1);
+	g_assert (g_variant_lookup (entry, "version", "&s", &version));
+	g_assert_cmpstr (version, ==, "1.2-1.fc24");
+
+	/* the second one in the same second is still new */
+	g_ptr_array_add (transactions,
+			 gs_packagekit_history_test_transaction ("/2_def",
+								 "2017-01-02T10:00:00Z",
+								 "updating\tcolour;2-1;noarch;fedora"));
+	g_assert_cmpint (gs_packagekit_history_add_transactions (history2, transactions), ==, 1);
+	entries = gs_packagekit_history_lookup (history2, "colour");
+	g_assert_cmpint (g_variant_n_children (entries), ==, 1);
+	entries = gs_packagekit_history_lookup (history2, "chiron");
+	g_assert_cmpint (g_variant_n_children (entries), ==, 2);
+
+	/* and a later one */
+	g_ptr_array_add (transactions,
+			 gs_packagekit_history_test_transaction ("/3_ghi",
+								 "2017-01-03T10:00:00Z",
+								 "removing\tchiron;1.2-1.fc24;x86_64;fedora"));
+	g_assert_cmpint (gs_packagekit_history_add_transactions (history2, transactions), ==, 1);
+	g_assert_cmpint (gs_packagekit_history_get_timestamp (history2), ==, 1483437600);
+	entries = gs_packagekit_history_lookup (history2, "chiron");
+	g_assert_cmpint (g_variant_n_children (entries), ==, 3);
+
+	/* nothing has happened since */
+	g_assert_cmpint (gs_packagekit_history_add_transactions (history2, transactions), ==, 0);
+	ret = gs_packagekit_history_save (history2, fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	history3 = gs_packagekit_history_new ();
+	ret = gs_packagekit_history_load (history3, fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (gs_packagekit_history_add_transactions (history3, transactions), ==, 0);
+	entries = gs_packagekit_history_lookup (history3, "chiron");
+	g_assert_cmpint (g_variant_n_children (entries), ==, 3);
+
+	g_unlink (fn);
+	g_rmdir (tmpdir);
+}
+
+static void
+gs_packagekit_download_func (void)
+{
+	g_autoptr(GsApp) app = gs_app_new (NULL);
+	g_autoptr(GsPackagekitDownload) download = NULL;
+
+	/* nothing downloaded yet */
+	download = gs_packagekit_download_new (app, 4000);
+	g_assert_cmpint (gs_packagekit_download_get_size (download), ==, 4000);
+	g_assert_cmpint (gs_packagekit_download_get_done (download), ==, 0);
+	g_assert_cmpint (gs_packagekit_download_get_eta (download), ==, 0);
+
+	/* the transaction starts */
+	gs_packagekit_download_set_remaining (download, 3500, 1 * G_USEC_PER_SEC);
+	g_assert_cmpint (gs_packagekit_download_get_done (download), ==, 500);
+	g_assert_cmpint (gs_packagekit_download_get_percentage (download), ==, 12);
+	g_assert_cmpint (gs_app_get_progress (app), ==, 12);
+	g_assert_cmpint (gs_packagekit_download_get_rate (download), ==, 0);
+	g_assert_cmpstr (gs_app_get_metadata_item (app, "GnomeSoftware::DownloadRate"), ==, NULL);
+
+	/* a second later the rate is known */
+	gs_packagekit_download_set_remaining (download, 2500, 2 * G_USEC_PER_SEC);
+	g_assert_cmpint (gs_packagekit_download_get_done (download), ==, 1500);
+	g_assert_cmpint (gs_app_get_progress (app), ==, 37);
+	g_assert_cmpint (gs_packagekit_download_get_rate (download), ==, 1000);
+	g_assert_cmpint (gs_packagekit_download_get_eta (download), ==, 2);
+	g_assert_cmpstr (gs_app_get_metadata_item (app, "GnomeSoftware::DownloadRate"), ==, "1000");
+	g_assert_cmpstr (gs_app_get_metadata_item (app, "GnomeSoftware::DownloadEta"), ==, "2");
+
+	/* PackageKit finds more to download than the details said */
+	gs_packagekit_download_set_remaining (download, 5500, 3 * G_USEC_PER_SEC);
+	g_assert_cmpint (gs_packagekit_download_get_size (download), ==, 5500);
+	g_assert_cmpint (gs_packagekit_download_get_done (download), ==, 0);
+	g_assert_cmpint (gs_app_get_progress (app), ==, 0);
+	g_assert_cmpint (gs_packagekit_download_get_rate (download), ==, 700);
+	g_assert_cmpstr (gs_app_get_metadata_item (app, "GnomeSoftware::DownloadEta"), ==, "7");
+
+	/* finished */
+	gs_packagekit_download_set_finished (download, 4 * G_USEC_PER_SEC);
+	g_assert_cmpint (gs_packagekit_download_get_done (download), ==, 5500);
+	g_assert_cmpint (gs_app_get_progress (app), ==, 100);
+	g_assert_cmpint (gs_packagekit_download_get_eta (download), ==, 0);
+
+	/* the estimate goes away with the download */
+	g_clear_pointer (&download, gs_packagekit_download_free);
+	g_assert_cmpstr (gs_app_get_metadata_item (app, "GnomeSoftware::DownloadRate"), ==, NULL);
+	g_assert_cmpstr (gs_app_get_metadata_item (app, "GnomeSoftware::DownloadEta"), ==, NULL);
+}
+
 static void
 gs_plugins_packagekit_local_func (GsPluginLoader *plugin_loader)
 {
@@ -266,6 +764,18 @@ main (int argc, char **argv)
 
 	/* generic tests go here */
 	g_test_add_func ("/gnome-software/markdown", gs_markdown_func);
+	g_test_add_func ("/gnome-software/markdown/differential",
+			 gs_markdown_differential_func);
+	g_test_add_func ("/gnome-software/markdown/benchmark",
+			 gs_markdown_benchmark_func);
+	g_test_add_func ("/gnome-software/packagekit/package-index",
+			 gs_packagekit_package_index_func);
+	g_test_add_func ("/gnome-software/packagekit/cache",
+			 gs_packagekit_cache_func);
+	g_test_add_func ("/gnome-software/packagekit/history",
+			 gs_packagekit_history_func);
+	g_test_add_func ("/gnome-software/packagekit/download",
+			 gs_packagekit_download_func);
 
 	/* we can only load this once per process */
 	plugin_loader = gs_plugin_loader_new ();
@@ -0,0 +1,367 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <glib/gstdio.h>
+
+#include "packagekit-cache.h"
+#include "packagekit-common.h"
+
+/*
+ * The answers PackageKit gives for details, update details and update
+ * severity only change when the package cache or the installed packages
+ * change, so they are kept on disk between sessions.
+ *
+ * The generation is the time of the last transaction that could have
+ * changed them, or of the last change to the package database, and the
+ * whole file is discarded when it moves on.
+ *
+ * Two changes close together cannot be told apart, so a generation that
+ * is still settling is uncertain and the list of updates is then always
+ * asked for again.
+ */
+
+/* the generation is worked out from relative times, so allow some jitter */
+#define GS_PACKAGEKIT_CACHE_GENERATION_FUZZ	2 /* seconds */
+
+/* any change after this is outside the fuzz of the one before */
+#define GS_PACKAGEKIT_CACHE_GENERATION_SETTLE	(2 * GS_PACKAGEKIT_CACHE_GENERATION_FUZZ)
+
+/* written by the package manager whichever backend PackageKit uses */
+static const gchar *gs_packagekit_cache_databases[] = {
+	"/var/lib/rpm/Packages",
+	"/var/lib/rpm/rpmdb.sqlite",
+	"/usr/lib/sysimage/rpm/rpmdb.sqlite",
+	"/var/lib/dpkg/status",
+	NULL };
+
+struct _GsPackagekitCache {
+	GMutex		 mutex;
+	gchar		*filename;
+	GKeyFile	*kf;
+	gboolean	 changed;
+	gboolean	 certain;
+	gint64		 file_mtime;
+	gint64		 file_size;
+};
+
+GsPackagekitCache *
+gs_packagekit_cache_new (const gchar *filename)
+{
+	GsPackagekitCache *cache = g_new0 (GsPackagekitCache, 1);
+	g_mutex_init (&cache->mutex);
+	cache->filename = g_strdup (filename);
+	cache->kf = g_key_file_new ();
+	cache->file_mtime = -1;
+	return cache;
+}
+
+void
+gs_packagekit_cache_free (GsPackagekitCache *cache)
+{
+	g_free (cache->filename);
+	g_key_file_unref (cache->kf);
+	g_mutex_clear (&cache->mutex);
+	g_free (cache);
+}
+
+/* @certain is set to %FALSE if a change may be hidden by the last one */
+guint64
+gs_packagekit_cache_get_generation (PkControl *control,
+				    gboolean *certain,
+				    GCancellable *cancellable,
+				    GError **error)
+{
+	guint64 generation = 0;
+	guint64 now = (guint64) (g_get_real_time () / G_USEC_PER_SEC);
+	const PkRoleEnum roles[] = {
+		PK_ROLE_ENUM_REFRESH_CACHE,
+		PK_ROLE_ENUM_UPDATE_PACKAGES,
+		PK_ROLE_ENUM_UPGRADE_SYSTEM,
+		PK_ROLE_ENUM_INSTALL_PACKAGES,
+		PK_ROLE_ENUM_INSTALL_FILES,
+		PK_ROLE_ENUM_INSTALL_SIGNATURE,
+		PK_ROLE_ENUM_REMOVE_PACKAGES,
+		PK_ROLE_ENUM_REPO_ENABLE,	/* also used to disable */
+		PK_ROLE_ENUM_REPO_SET_DATA,
+		PK_ROLE_ENUM_REPO_REMOVE,
+		PK_ROLE_ENUM_UNKNOWN };
+
+	for (guint i = 0; roles[i] != PK_ROLE_ENUM_UNKNOWN; i++) {
+		guint since;
+		g_autoptr(GError) error_local = NULL;
+		since = pk_control_get_time_since_action_sync (control,
+							       roles[i],
+							       cancellable,
+							       &error_local);
+		if (error_local != NULL) {
+			g_propagate_error (error, g_steal_pointer (&error_local));
+			gs_plugin_packagekit_error_convert (error);
+			return 0;
+		}
+
+		/* never done */
+		if (since >= now)
+			continue;
+		generation = MAX (generation, now - since);
+	}
+
+	/* the backend may have been bypassed */
+	for (guint i = 0; gs_packagekit_cache_databases[i] != NULL; i++) {
+		GStatBuf buf;
+		if (g_stat (gs_packagekit_cache_databases[i], &buf) != 0)
+			continue;
+		generation = MAX (generation, (guint64) buf.st_mtime);
+	}
+	if (certain != NULL)
+		*certain = generation + GS_PACKAGEKIT_CACHE_GENERATION_SETTLE < now;
+	return generation;
+}
+
+static gboolean
+gs_packagekit_cache_generation_equal (guint64 generation1, guint64 generation2)
+{
+	if (generation1 > generation2)
+		return generation1 - generation2 <= GS_PACKAGEKIT_CACHE_GENERATION_FUZZ;
+	return generation2 - generation1 <= GS_PACKAGEKIT_CACHE_GENERATION_FUZZ;
+}
+
+/* must be called with the mutex held */
+static void
+gs_packagekit_cache_update_file_stat (GsPackagekitCache *cache)
+{
+	GStatBuf buf;
+	if (g_stat (cache->filename, &buf) != 0) {
+		cache->file_mtime = -1;
+		cache->file_size = 0;
+		return;
+	}
+	cache->file_mtime = (gint64) buf.st_mtime;
+	cache->file_size = (gint64) buf.st_size;
+}
+
+/* another plugin may have written the file since it was last read */
+void
+gs_packagekit_cache_load (GsPackagekitCache *cache,
+			  guint64 generation,
+			  gboolean certain)
+{
+	GStatBuf buf;
+	gint64 file_mtime = -1;
+	gint64 file_size = 0;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache->mutex);
+
+	if (g_stat (cache->filename, &buf) == 0) {
+		file_mtime = (gint64) buf.st_mtime;
+		file_size = (gint64) buf.st_size;
+	}
+	if (!cache->changed &&
+	    (file_mtime != cache->file_mtime || file_size != cache->file_size)) {
+		g_key_file_unref (cache->kf);
+		cache->kf = g_key_file_new ();
+		if (file_mtime != -1) {
+			g_autoptr(GError) error = NULL;
+			if (!g_key_file_load_from_file (cache->kf, cache->filename,
+							G_KEY_FILE_NONE, &error)) {
+				g_warning ("failed to load %s: %s",
+					   cache->filename, error->message);
+			}
+		}
+		cache->file_mtime = file_mtime;
+		cache->file_size = file_size;
+	}
+
+	/* something has changed in PackageKit */
+	if (!gs_packagekit_cache_generation_equal (generation,
+						   g_key_file_get_uint64 (cache->kf, "cache",
+									  "Generation", NULL))) {
+		g_debug ("discarding package metadata from an old generation");
+		g_key_file_unref (cache->kf);
+		cache->kf = g_key_file_new ();
+		g_key_file_set_uint64 (cache->kf, "cache", "Generation", generation);
+	}
+	cache->certain = certain;
+}
+
+gboolean
+gs_packagekit_cache_save (GsPackagekitCache *cache, GError **error)
+{
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache->mutex);
+
+	if (!cache->changed)
+		return TRUE;
+	if (!g_key_file_save_to_file (cache->kf, cache->filename, &error_local)) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_WRITE_FAILED,
+			     "failed to save %s: %s",
+			     cache->filename, error_local->message);
+		return FALSE;
+	}
+	gs_packagekit_cache_update_file_stat (cache);
+	cache->changed = FALSE;
+	return TRUE;
+}
+
+/* must be called with the mutex held */
+static void
+gs_packagekit_cache_set_string (GsPackagekitCache *cache,
+				const gchar *package_id,
+				const gchar *key,
+				const gchar *value)
+{
+	if (value == NULL)
+		return;
+	g_key_file_set_string (cache->kf, package_id, key, value);
+}
+
+void
+gs_packagekit_cache_add_details (GsPackagekitCache *cache,
+				 const gchar *package_id,
+				 PkDetails *details)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache->mutex);
+
+	gs_packagekit_cache_set_string (cache, package_id, "Summary",
+					pk_details_get_summary (details));
+	gs_packagekit_cache_set_string (cache, package_id, "License",
+					pk_details_get_license (details));
+	gs_packagekit_cache_set_string (cache, package_id, "Url",
+					pk_details_get_url (details));
+	g_key_file_set_uint64 (cache->kf, package_id, "Size",
+			       pk_details_get_size (details));
+	g_key_file_set_uint64 (cache->kf, package_id, "DownloadSize",
+			       gs_plugin_packagekit_details_get_download_size (details));
+	g_key_file_set_boolean (cache->kf, package_id, "HasDetails", TRUE);
+	cache->changed = TRUE;
+}
+
+void
+gs_packagekit_cache_add_update_detail (GsPackagekitCache *cache,
+				       PkUpdateDetail *update_detail)
+{
+	const gchar *package_id = pk_update_detail_get_package_id (update_detail);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache->mutex);
+
+	gs_packagekit_cache_set_string (cache, package_id, "UpdateText",
+					pk_update_detail_get_update_text (update_detail));
+	g_key_file_set_boolean (cache->kf, package_id, "HasUpdateDetail", TRUE);
+	cache->changed = TRUE;
+}
+
+/* @packages is the complete result of GetUpdates */
+void
+gs_packagekit_cache_set_updates (GsPackagekitCache *cache, GPtrArray *packages)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache->mutex);
+
+	/* it would not be known which generation these belong to */
+	if (!cache->certain)
+		return;
+
+	for (guint i = 0; i < packages->len; i++) {
+		PkPackage *package = g_ptr_array_index (packages, i);
+		g_key_file_set_string (cache->kf,
+				       pk_package_get_id (package),
+				       "UpdateInfo",
+				       pk_info_enum_to_string (pk_package_get_info (package)));
+	}
+	g_key_file_set_boolean (cache->kf, "cache", "HasUpdates", TRUE);
+	cache->changed = TRUE;
+}
+
+PkDetails *
+gs_packagekit_cache_lookup_details (GsPackagekitCache *cache,
+				    const gchar *package_id)
+{
+	g_autofree gchar *license = NULL;
+	g_autofree gchar *summary = NULL;
+	g_autofree gchar *url = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache->mutex);
+	PkDetails *details;
+
+	if (!g_key_file_get_boolean (cache->kf, package_id, "HasDetails", NULL))
+		return NULL;
+	summary = g_key_file_get_string (cache->kf, package_id, "Summary", NULL);
+	license = g_key_file_get_string (cache->kf, package_id, "License", NULL);
+	url = g_key_file_get_string (cache->kf, package_id, "Url", NULL);
+	details = g_object_new (PK_TYPE_DETAILS,
+				"package-id", package_id,
+				"summary", summary,
+				"license", license,
+				"url", url,
+				"size", g_key_file_get_uint64 (cache->kf, package_id,
+							       "Size", NULL),
+				NULL);
+	if (g_key_file_has_key (cache->kf, package_id, "DownloadSize", NULL) &&
+	    g_object_class_find_property (G_OBJECT_GET_CLASS (details),
+					  "download-size") != NULL) {
+		g_object_set (details,
+			      "download-size", g_key_file_get_uint64 (cache->kf, package_id,
+								       "DownloadSize", NULL),
+			      NULL);
+	}
+	return details;
+}
+
+PkUpdateDetail *
+gs_packagekit_cache_lookup_update_detail (GsPackagekitCache *cache,
+					  const gchar *package_id)
+{
+	g_autofree gchar *update_text = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache->mutex);
+
+	if (!g_key_file_get_boolean (cache->kf, package_id, "HasUpdateDetail", NULL))
+		return NULL;
+	update_text = g_key_file_get_string (cache->kf, package_id, "UpdateText", NULL);
+	return g_object_new (PK_TYPE_UPDATE_DETAIL,
+			     "package-id", package_id,
+			     "update-text", update_text,
+			     NULL);
+}
+
+/* if %FALSE then GetUpdates has to be used */
+gboolean
+gs_packagekit_cache_has_updates (GsPackagekitCache *cache)
+{
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache->mutex);
+	if (!cache->certain)
+		return FALSE;
+	return g_key_file_get_boolean (cache->kf, "cache", "HasUpdates", NULL);
+}
+
+/* returns %PK_INFO_ENUM_UNKNOWN if @package_id is not an update */
+PkInfoEnum
+gs_packagekit_cache_lookup_update_info (GsPackagekitCache *cache,
+					const gchar *package_id)
+{
+	g_autofree gchar *tmp = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&cache->mutex);
+
+	if (!cache->certain)
+		return PK_INFO_ENUM_UNKNOWN;
+	tmp = g_key_file_get_string (cache->kf, package_id, "UpdateInfo", NULL);
+	if (tmp == NULL)
+		return PK_INFO_ENUM_UNKNOWN;
+	return pk_info_enum_from_string (tmp);
+}
@@ -0,0 +1,64 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PACKAGEKIT_CACHE_H
+#define __PACKAGEKIT_CACHE_H
+
+#include <glib.h>
+#include <gnome-software.h>
+
+#include <packagekit-glib2/packagekit.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GsPackagekitCache GsPackagekitCache;
+
+GsPackagekitCache *gs_packagekit_cache_new		(const gchar	*filename);
+void		 gs_packagekit_cache_free		(GsPackagekitCache *cache);
+guint64		 gs_packagekit_cache_get_generation	(PkControl	*control,
+							 gboolean	*certain,
+							 GCancellable	*cancellable,
+							 GError		**error);
+void		 gs_packagekit_cache_load		(GsPackagekitCache *cache,
+							 guint64	 generation,
+							 gboolean	 certain);
+gboolean	 gs_packagekit_cache_save		(GsPackagekitCache *cache,
+							 GError		**error);
+void		 gs_packagekit_cache_add_details	(GsPackagekitCache *cache,
+							 const gchar	*package_id,
+							 PkDetails	*details);
+void		 gs_packagekit_cache_add_update_detail	(GsPackagekitCache *cache,
+							 PkUpdateDetail	*update_detail);
+void		 gs_packagekit_cache_set_updates	(GsPackagekitCache *cache,
+							 GPtrArray	*packages);
+PkDetails	*gs_packagekit_cache_lookup_details	(GsPackagekitCache *cache,
+							 const gchar	*package_id);
+PkUpdateDetail	*gs_packagekit_cache_lookup_update_detail (GsPackagekitCache *cache,
+							 const gchar	*package_id);
+gboolean	 gs_packagekit_cache_has_updates	(GsPackagekitCache *cache);
+PkInfoEnum	 gs_packagekit_cache_lookup_update_info	(GsPackagekitCache *cache,
+							 const gchar	*package_id);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(GsPackagekitCache, gs_packagekit_cache_free)
+
+G_END_DECLS
+
+#endif /* __PACKAGEKIT_CACHE_H */
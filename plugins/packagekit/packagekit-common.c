@@ -187,6 +187,68 @@ gs_plugin_packagekit_results_valid (PkResults *results, GError **error)
 	return TRUE;
 }
 
+/* what PackageKit has to fetch for the package, which is less than the
+ * package size if it is already downloaded or a delta can be used */
+guint64
+gs_plugin_packagekit_details_get_download_size (PkDetails *details)
+{
+	guint64 download_size = G_MAXUINT64;
+
+	/* only newer versions of PackageKit know this */
+	if (g_object_class_find_property (G_OBJECT_GET_CLASS (details),
+					  "download-size") != NULL) {
+		g_object_get (details, "download-size", &download_size, NULL);
+	}
+	if (download_size == G_MAXUINT64)
+		return pk_details_get_size (details);
+	return download_size;
+}
+
+/* a generic app for a package returned by a search */
+GsApp *
+gs_plugin_packagekit_app_new_from_package (GsPlugin *plugin, PkPackage *package)
+{
+	GsApp *app;
+
+	app = gs_app_new (NULL);
+	gs_app_add_source (app, pk_package_get_name (package));
+	gs_app_add_source_id (app, pk_package_get_id (package));
+	gs_app_set_name (app,
+			 GS_APP_QUALITY_LOWEST,
+			 pk_package_get_name (package));
+	gs_app_set_summary (app,
+			    GS_APP_QUALITY_LOWEST,
+			    pk_package_get_summary (package));
+	gs_app_set_metadata (app, "GnomeSoftware::Creator",
+			     gs_plugin_get_name (plugin));
+	gs_app_set_management_plugin (app, "packagekit");
+	gs_app_set_version (app, pk_package_get_version (package));
+	switch (pk_package_get_info (package)) {
+	case PK_INFO_ENUM_INSTALLED:
+		gs_app_set_state (app, AS_APP_STATE_INSTALLED);
+		break;
+	case PK_INFO_ENUM_AVAILABLE:
+		gs_app_set_state (app, AS_APP_STATE_AVAILABLE);
+		break;
+	case PK_INFO_ENUM_INSTALLING:
+	case PK_INFO_ENUM_UPDATING:
+	case PK_INFO_ENUM_DOWNGRADING:
+	case PK_INFO_ENUM_OBSOLETING:
+	case PK_INFO_ENUM_UNTRUSTED:
+		break;
+	case PK_INFO_ENUM_UNAVAILABLE:
+	case PK_INFO_ENUM_REMOVING:
+		gs_app_set_state (app, AS_APP_STATE_UNAVAILABLE);
+		break;
+	default:
+		gs_app_set_state (app, AS_APP_STATE_UNKNOWN);
+		g_warning ("unknown info state of %s",
+			   pk_info_enum_to_string (pk_package_get_info (package)));
+	}
+	gs_app_set_kind (app, AS_APP_KIND_GENERIC);
+	return app;
+}
+
 gboolean
 gs_plugin_packagekit_add_results (GsPlugin *plugin,
 				  GsAppList *list,
@@ -246,44 +308,34 @@ gs_plugin_packagekit_add_results (GsPlugin *plugin,
 	for (i = 0; i < array_filtered->len; i++) {
 		g_autoptr(GsApp) app = NULL;
 		package = g_ptr_array_index (array_filtered, i);
-
-		app = gs_app_new (NULL);
-		gs_app_add_source (app, pk_package_get_name (package));
-		gs_app_add_source_id (app, pk_package_get_id (package));
-		gs_app_set_name (app,
-				 GS_APP_QUALITY_LOWEST,
-				 pk_package_get_name (package));
-		gs_app_set_summary (app,
-				    GS_APP_QUALITY_LOWEST,
-				    pk_package_get_summary (package));
-		gs_app_set_metadata (app, "GnomeSoftware::Creator",
-				     gs_plugin_get_name (plugin));
-		gs_app_set_management_plugin (app, "packagekit");
-		gs_app_set_version (app, pk_package_get_version (package));
-		switch (pk_package_get_info (package)) {
-		case PK_INFO_ENUM_INSTALLED:
-			gs_app_set_state (app, AS_APP_STATE_INSTALLED);
-			break;
-		case PK_INFO_ENUM_AVAILABLE:
-			gs_app_set_state (app, AS_APP_STATE_AVAILABLE);
-			break;
-		case PK_INFO_ENUM_INSTALLING:
-		case PK_INFO_ENUM_UPDATING:
-		case PK_INFO_ENUM_DOWNGRADING:
-		case PK_INFO_ENUM_OBSOLETING:
-		case PK_INFO_ENUM_UNTRUSTED:
-			break;
-		case PK_INFO_ENUM_UNAVAILABLE:
-		case PK_INFO_ENUM_REMOVING:
-			gs_app_set_state (app, AS_APP_STATE_UNAVAILABLE);
-			break;
-		default:
-			gs_app_set_state (app, AS_APP_STATE_UNKNOWN);
-			g_warning ("unknown info state of %s",
-				   pk_info_enum_to_string (pk_package_get_info (package)));
-		}
-		gs_app_set_kind (app, AS_APP_KIND_GENERIC);
+		app = gs_plugin_packagekit_app_new_from_package (plugin, package);
 		gs_app_list_add (list, app);
 	}
 	return TRUE;
 }
+
+/* returns a hash of package name to an array of PkPackage, in the same
+ * order as @packages, so matching app sources does not need to compare
+ * every source with every package */
+GHashTable *
+gs_plugin_packagekit_build_package_index (GPtrArray *packages)
+{
+	GHashTable *index;
+
+	index = g_hash_table_new_full (g_str_hash, g_str_equal,
+				       g_free, (GDestroyNotify) g_ptr_array_unref);
+	for (guint i = 0; i < packages->len; i++) {
+		PkPackage *package = g_ptr_array_index (packages, i);
+		GPtrArray *array;
+		const gchar *name = pk_package_get_name (package);
+		if (name == NULL)
+			continue;
+		array = g_hash_table_lookup (index, name);
+		if (array == NULL) {
+			array = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+			g_hash_table_insert (index, g_strdup (name), array);
+		}
+		g_ptr_array_add (array, g_object_ref (package));
+	}
+	return index;
+}
@@ -31,6 +31,9 @@ G_BEGIN_DECLS
 
 GsPluginStatus 	packagekit_status_enum_to_plugin_status	(PkStatusEnum	 status);
 
+guint64		gs_plugin_packagekit_details_get_download_size (PkDetails *details);
+GsApp		*gs_plugin_packagekit_app_new_from_package (GsPlugin	*plugin,
+							 PkPackage	*package);
 gboolean	gs_plugin_packagekit_add_results	(GsPlugin	*plugin,
 							 GsAppList	*list,
 							 PkResults	*results,
@@ -38,6 +41,7 @@ gboolean	gs_plugin_packagekit_add_results	(GsPlugin	*plugin,
 gboolean	gs_plugin_packagekit_error_convert	(GError		**error);
 gboolean	gs_plugin_packagekit_results_valid	(PkResults	*results,
 							 GError		**error);
+GHashTable	*gs_plugin_packagekit_build_package_index (GPtrArray	*packages);
 
 G_END_DECLS
 
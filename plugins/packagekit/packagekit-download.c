@@ -0,0 +1,167 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include "packagekit-download.h"
+
+/*
+ * Works out how much of a PackageKit download has been done from the
+ * download size remaining the transaction reports, and shows it on the
+ * app as a percentage, a rate and the time left.
+ *
+ * The size is what the package details say it should be, and grows if
+ * PackageKit reports more than that to download.
+ */
+
+/* how often to work out the download rate */
+#define GS_PACKAGEKIT_DOWNLOAD_RATE_INTERVAL	1 /* s */
+
+struct _GsPackagekitDownload {
+	GsApp		*app;
+	guint64		 size;
+	guint64		 remaining;
+	guint64		 rate;
+	guint64		 rate_done;
+	gint64		 rate_time;
+};
+
+GsPackagekitDownload *
+gs_packagekit_download_new (GsApp *app, guint64 size)
+{
+	GsPackagekitDownload *download = g_new0 (GsPackagekitDownload, 1);
+	download->app = g_object_ref (app);
+	download->size = size;
+	download->remaining = size;
+	return download;
+}
+
+void
+gs_packagekit_download_free (GsPackagekitDownload *download)
+{
+	/* the estimate means nothing once the download has stopped */
+	gs_app_set_metadata (download->app, "GnomeSoftware::DownloadRate", NULL);
+	gs_app_set_metadata (download->app, "GnomeSoftware::DownloadEta", NULL);
+	g_object_unref (download->app);
+	g_free (download);
+}
+
+guint64
+gs_packagekit_download_get_size (GsPackagekitDownload *download)
+{
+	return download->size;
+}
+
+guint64
+gs_packagekit_download_get_done (GsPackagekitDownload *download)
+{
+	return download->size - download->remaining;
+}
+
+guint
+gs_packagekit_download_get_percentage (GsPackagekitDownload *download)
+{
+	if (download->size == 0)
+		return 0;
+	return (guint) (gs_packagekit_download_get_done (download) * 100 / download->size);
+}
+
+/* in bytes per second, or 0 if not yet known */
+guint64
+gs_packagekit_download_get_rate (GsPackagekitDownload *download)
+{
+	return download->rate;
+}
+
+/* in seconds, or 0 if not yet known */
+guint
+gs_packagekit_download_get_eta (GsPackagekitDownload *download)
+{
+	if (download->rate == 0)
+		return 0;
+	return (guint) MIN (download->remaining / download->rate, G_MAXUINT);
+}
+
+static void
+gs_packagekit_download_set_metadata (GsPackagekitDownload *download,
+				     const gchar *key,
+				     guint64 value)
+{
+	g_autofree gchar *str = g_strdup_printf ("%" G_GUINT64_FORMAT, value);
+	gs_app_set_metadata (download->app, key, NULL);
+	gs_app_set_metadata (download->app, key, str);
+}
+
+static void
+gs_packagekit_download_update (GsPackagekitDownload *download, gint64 now)
+{
+	guint64 done = gs_packagekit_download_get_done (download);
+
+	/* smooth the rate so the estimate does not jump about */
+	if (download->rate_time == 0) {
+		download->rate_time = now;
+		download->rate_done = done;
+	} else if (now - download->rate_time >= GS_PACKAGEKIT_DOWNLOAD_RATE_INTERVAL * G_USEC_PER_SEC) {
+		guint64 rate = 0;
+
+		if (done > download->rate_done) {
+			rate = (done - download->rate_done) * G_USEC_PER_SEC /
+				(guint64) (now - download->rate_time);
+		}
+		if (download->rate == 0)
+			download->rate = rate;
+		else
+			download->rate = (download->rate * 7 + rate * 3) / 10;
+		download->rate_time = now;
+		download->rate_done = done;
+
+		/* set before the progress so the UI sees both together */
+		gs_packagekit_download_set_metadata (download,
+						     "GnomeSoftware::DownloadRate",
+						     download->rate);
+		gs_packagekit_download_set_metadata (download,
+						     "GnomeSoftware::DownloadEta",
+						     gs_packagekit_download_get_eta (download));
+	}
+
+	/* only the bytes are accurate, so only show those */
+	gs_app_set_progress (download->app,
+			     gs_packagekit_download_get_percentage (download));
+}
+
+void
+gs_packagekit_download_set_remaining (GsPackagekitDownload *download,
+				      guint64 remaining,
+				      gint64 now)
+{
+	if (remaining > download->size)
+		download->size = remaining;
+	download->remaining = remaining;
+	gs_packagekit_download_update (download, now);
+}
+
+void
+gs_packagekit_download_set_finished (GsPackagekitDownload *download,
+				     gint64 now)
+{
+	download->remaining = 0;
+	gs_packagekit_download_update (download, now);
+}
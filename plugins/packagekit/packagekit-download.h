@@ -0,0 +1,50 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __PACKAGEKIT_DOWNLOAD_H
+#define __PACKAGEKIT_DOWNLOAD_H
+
+#include <glib.h>
+#include <gnome-software.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GsPackagekitDownload GsPackagekitDownload;
+
+GsPackagekitDownload *gs_packagekit_download_new	(GsApp		*app,
+							 guint64	 size);
+void		 gs_packagekit_download_free		(GsPackagekitDownload *download);
+void		 gs_packagekit_download_set_remaining	(GsPackagekitDownload *download,
+							 guint64	 remaining,
+							 gint64		 now);
+void		 gs_packagekit_download_set_finished	(GsPackagekitDownload *download,
+							 gint64		 now);
+guint64		 gs_packagekit_download_get_size	(GsPackagekitDownload *download);
+guint64		 gs_packagekit_download_get_done	(GsPackagekitDownload *download);
+guint		 gs_packagekit_download_get_percentage	(GsPackagekitDownload *download);
+guint64		 gs_packagekit_download_get_rate	(GsPackagekitDownload *download);
+guint		 gs_packagekit_download_get_eta		(GsPackagekitDownload *download);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(GsPackagekitDownload, gs_packagekit_download_free)
+
+G_END_DECLS
+
+#endif /* __PACKAGEKIT_DOWNLOAD_H */
@@ -0,0 +1,344 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+
+#include "packagekit-history.h"
+
+/*
+ * The history of each package is only asked for once and then kept on
+ * disk. It is brought up to date by looking at the transactions
+ * PackageKit has done since the newest one that was looked at.
+ *
+ * Several transactions can finish in the same second, so the IDs of the
+ * ones at the newest timestamp are kept to know which have been seen.
+ */
+
+#define GS_PACKAGEKIT_HISTORY_VERSION	2
+#define GS_PACKAGEKIT_HISTORY_TYPE	"(utasa{saa{sv}})"
+
+struct _GsPackagekitHistory {
+	GHashTable	*packages;	/* name : aa{sv} */
+	GHashTable	*transactions;	/* tid, at @timestamp */
+	guint64		 timestamp;
+	gboolean	 changed;
+};
+
+GsPackagekitHistory *
+gs_packagekit_history_new (void)
+{
+	GsPackagekitHistory *history = g_new0 (GsPackagekitHistory, 1);
+	history->packages = g_hash_table_new_full (g_str_hash, g_str_equal,
+						   g_free, (GDestroyNotify) g_variant_unref);
+	history->transactions = g_hash_table_new_full (g_str_hash, g_str_equal,
+						       g_free, NULL);
+	return history;
+}
+
+/* the entries are immutable, so this is cheap */
+GsPackagekitHistory *
+gs_packagekit_history_copy (GsPackagekitHistory *history)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	GsPackagekitHistory *copy = gs_packagekit_history_new ();
+
+	g_hash_table_iter_init (&iter, history->packages);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		g_hash_table_insert (copy->packages,
+				     g_strdup (key),
+				     g_variant_ref (value));
+	}
+	g_hash_table_iter_init (&iter, history->transactions);
+	while (g_hash_table_iter_next (&iter, &key, NULL))
+		g_hash_table_add (copy->transactions, g_strdup (key));
+	copy->timestamp = history->timestamp;
+	copy->changed = history->changed;
+	return copy;
+}
+
+void
+gs_packagekit_history_free (GsPackagekitHistory *history)
+{
+	g_hash_table_unref (history->packages);
+	g_hash_table_unref (history->transactions);
+	g_free (history);
+}
+
+gboolean
+gs_packagekit_history_load (GsPackagekitHistory *history,
+			    const gchar *filename,
+			    GError **error)
+{
+	GVariantIter iter;
+	GVariant *entries_pkg;
+	const gchar *name;
+	guint32 version;
+	guint64 timestamp;
+	g_autoptr(GBytes) bytes = NULL;
+	g_autoptr(GMappedFile) mapped_file = NULL;
+	g_autoptr(GVariant) entries = NULL;
+	g_autoptr(GVariant) root = NULL;
+	g_autoptr(GVariant) tids = NULL;
+
+	if (!g_file_test (filename, G_FILE_TEST_EXISTS))
+		return TRUE;
+	mapped_file = g_mapped_file_new (filename, FALSE, error);
+	if (mapped_file == NULL)
+		return FALSE;
+	bytes = g_mapped_file_get_bytes (mapped_file);
+	root = g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (GS_PACKAGEKIT_HISTORY_TYPE),
+							     bytes, FALSE));
+	g_variant_get (root, "(ut@as@a{saa{sv}})",
+		       &version, &timestamp, &tids, &entries);
+	if (version != GS_PACKAGEKIT_HISTORY_VERSION) {
+		g_debug ("ignoring %s with version %u", filename, version);
+		return TRUE;
+	}
+	history->timestamp = timestamp;
+	g_hash_table_remove_all (history->transactions);
+	g_variant_iter_init (&iter, tids);
+	while (g_variant_iter_next (&iter, "&s", &name))
+		g_hash_table_add (history->transactions, g_strdup (name));
+	g_variant_iter_init (&iter, entries);
+	while (g_variant_iter_next (&iter, "{&s@aa{sv}}", &name, &entries_pkg))
+		g_hash_table_insert (history->packages, g_strdup (name), entries_pkg);
+	g_debug ("loaded history for %u packages from %s",
+		 g_hash_table_size (history->packages), filename);
+	return TRUE;
+}
+
+gboolean
+gs_packagekit_history_save (GsPackagekitHistory *history,
+			    const gchar *filename,
+			    GError **error)
+{
+	GHashTableIter iter;
+	GVariantBuilder builder;
+	GVariantBuilder builder_tids;
+	gpointer key, value;
+	g_autoptr(GVariant) root = NULL;
+
+	if (!history->changed)
+		return TRUE;
+	g_variant_builder_init (&builder_tids, G_VARIANT_TYPE ("as"));
+	g_hash_table_iter_init (&iter, history->transactions);
+	while (g_hash_table_iter_next (&iter, &key, NULL))
+		g_variant_builder_add (&builder_tids, "s", (const gchar *) key);
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{saa{sv}}"));
+	g_hash_table_iter_init (&iter, history->packages);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		g_variant_builder_add (&builder, "{s@aa{sv}}",
+				       (const gchar *) key, (GVariant *) value);
+	}
+	root = g_variant_ref_sink (g_variant_new ("(ut@as@a{saa{sv}})",
+						  (guint32) GS_PACKAGEKIT_HISTORY_VERSION,
+						  history->timestamp,
+						  g_variant_builder_end (&builder_tids),
+						  g_variant_builder_end (&builder)));
+
+	/* the old file may still be mapped, so replace it atomically */
+	if (!g_file_set_contents (filename,
+				  g_variant_get_data (root),
+				  (gssize) g_variant_get_size (root),
+				  error))
+		return FALSE;
+	history->changed = FALSE;
+	return TRUE;
+}
+
+/* returns %NULL if the history of @name has never been fetched */
+GVariant *
+gs_packagekit_history_lookup (GsPackagekitHistory *history, const gchar *name)
+{
+	return g_hash_table_lookup (history->packages, name);
+}
+
+/* @entries is the whole history of @name from GetPackageHistory */
+void
+gs_packagekit_history_add_package (GsPackagekitHistory *history,
+				   const gchar *name,
+				   GVariant *entries)
+{
+	g_hash_table_insert (history->packages,
+			     g_strdup (name),
+			     g_variant_ref_sink (entries));
+	history->changed = TRUE;
+}
+
+/* only packages seen from now on are followed */
+void
+gs_packagekit_history_remove_all (GsPackagekitHistory *history)
+{
+	g_hash_table_remove_all (history->packages);
+	history->changed = TRUE;
+}
+
+guint64
+gs_packagekit_history_get_timestamp (GsPackagekitHistory *history)
+{
+	return history->timestamp;
+}
+
+static gboolean
+gs_packagekit_history_entry_equal (GVariant *entry1, GVariant *entry2)
+{
+	const gchar *version1 = NULL;
+	const gchar *version2 = NULL;
+	guint32 info1 = 0;
+	guint32 info2 = 0;
+	guint64 timestamp1 = 0;
+	guint64 timestamp2 = 0;
+
+	g_variant_lookup (entry1, "info", "u", &info1);
+	g_variant_lookup (entry2, "info", "u", &info2);
+	g_variant_lookup (entry1, "timestamp", "t", &timestamp1);
+	g_variant_lookup (entry2, "timestamp", "t", &timestamp2);
+	g_variant_lookup (entry1, "version", "&s", &version1);
+	g_variant_lookup (entry2, "version", "&s", &version2);
+	return info1 == info2 && timestamp1 == timestamp2 &&
+		g_strcmp0 (version1, version2) == 0;
+}
+
+static void
+gs_packagekit_history_append (GsPackagekitHistory *history,
+			      const gchar *name,
+			      GVariant *entry)
+{
+	GVariant *entries;
+	GVariantBuilder builder;
+	GVariantIter iter;
+	GVariant *child;
+	g_autoptr(GVariant) entry_sunk = g_variant_ref_sink (entry);
+
+	entries = g_hash_table_lookup (history->packages, name);
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa{sv}"));
+	g_variant_iter_init (&iter, entries);
+	while ((child = g_variant_iter_next_value (&iter)) != NULL) {
+		gboolean same = gs_packagekit_history_entry_equal (child, entry_sunk);
+		g_variant_builder_add_value (&builder, child);
+		g_variant_unref (child);
+
+		/* already fetched with GetPackageHistory */
+		if (same) {
+			g_variant_builder_clear (&builder);
+			return;
+		}
+	}
+	g_variant_builder_add_value (&builder, entry_sunk);
+	g_hash_table_insert (history->packages, g_strdup (name),
+			     g_variant_ref_sink (g_variant_builder_end (&builder)));
+	history->changed = TRUE;
+}
+
+static void
+gs_packagekit_history_add_transaction (GsPackagekitHistory *history,
+				       PkTransactionPast *past,
+				       guint64 timestamp)
+{
+	const gchar *data;
+	g_auto(GStrv) lines = NULL;
+
+	if (!pk_transaction_past_get_succeeded (past))
+		return;
+	data = pk_transaction_past_get_data (past);
+	if (data == NULL)
+		return;
+
+	/* each line is "info\tpackage-id" */
+	lines = g_strsplit (data, "\n", -1);
+	for (guint i = 0; lines[i] != NULL; i++) {
+		GVariantBuilder builder;
+		PkInfoEnum info_enum;
+		g_auto(GStrv) sections = NULL;
+		g_auto(GStrv) split = NULL;
+
+		sections = g_strsplit (lines[i], "\t", 2);
+		if (g_strv_length (sections) != 2)
+			continue;
+		split = pk_package_id_split (sections[1]);
+		if (split == NULL)
+			continue;
+
+		/* we only know the whole history of packages we have seen */
+		if (!g_hash_table_contains (history->packages, split[PK_PACKAGE_ID_NAME]))
+			continue;
+		info_enum = pk_info_enum_from_string (sections[0]);
+		g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
+		g_variant_builder_add (&builder, "{sv}", "info",
+				       g_variant_new_uint32 (info_enum));
+		g_variant_builder_add (&builder, "{sv}", "source",
+				       g_variant_new_string (split[PK_PACKAGE_ID_DATA]));
+		g_variant_builder_add (&builder, "{sv}", "version",
+				       g_variant_new_string (split[PK_PACKAGE_ID_VERSION]));
+		g_variant_builder_add (&builder, "{sv}", "timestamp",
+				       g_variant_new_uint64 (timestamp));
+		g_variant_builder_add (&builder, "{sv}", "user-id",
+				       g_variant_new_uint32 (pk_transaction_past_get_uid (past)));
+		gs_packagekit_history_append (history,
+					      split[PK_PACKAGE_ID_NAME],
+					      g_variant_builder_end (&builder));
+	}
+}
+
+static gint
+gs_packagekit_history_sort_cb (gconstpointer a, gconstpointer b)
+{
+	PkTransactionPast *past1 = *((PkTransactionPast **) a);
+	PkTransactionPast *past2 = *((PkTransactionPast **) b);
+	return g_strcmp0 (pk_transaction_past_get_timestamp (past1),
+			  pk_transaction_past_get_timestamp (past2));
+}
+
+/* returns the number of @transactions not seen before */
+guint
+gs_packagekit_history_add_transactions (GsPackagekitHistory *history,
+					GPtrArray *transactions)
+{
+	guint n_new = 0;
+
+	g_ptr_array_sort (transactions, gs_packagekit_history_sort_cb);
+	for (guint i = 0; i < transactions->len; i++) {
+		PkTransactionPast *past = g_ptr_array_index (transactions, i);
+		const gchar *tid = pk_transaction_past_get_id (past);
+		GTimeVal tv;
+		guint64 timestamp;
+
+		if (!g_time_val_from_iso8601 (pk_transaction_past_get_timestamp (past), &tv))
+			continue;
+		timestamp = (guint64) tv.tv_sec;
+		if (timestamp < history->timestamp)
+			continue;
+		if (timestamp == history->timestamp &&
+		    g_hash_table_contains (history->transactions, tid))
+			continue;
+		if (timestamp > history->timestamp) {
+			g_hash_table_remove_all (history->transactions);
+			history->timestamp = timestamp;
+		}
+		g_hash_table_add (history->transactions, g_strdup (tid));
+		history->changed = TRUE;
+		gs_packagekit_history_add_transaction (history, past, timestamp);
+		n_new++;
+	}
+	return n_new;
+}
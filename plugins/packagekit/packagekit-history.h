@@ -0,0 +1,58 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Richard Hughes <richard@hughsie.com>
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef __PACKAGEKIT_HISTORY_H
+#define __PACKAGEKIT_HISTORY_H
+
+#include <glib.h>
+#include <gnome-software.h>
+
+#include <packagekit-glib2/packagekit.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GsPackagekitHistory GsPackagekitHistory;
+
+GsPackagekitHistory *gs_packagekit_history_new		(void);
+GsPackagekitHistory *gs_packagekit_history_copy		(GsPackagekitHistory *history);
+void		 gs_packagekit_history_free		(GsPackagekitHistory *history);
+gboolean	 gs_packagekit_history_load		(GsPackagekitHistory *history,
+							 const gchar	*filename,
+							 GError		**error);
+gboolean	 gs_packagekit_history_save		(GsPackagekitHistory *history,
+							 const gchar	*filename,
+							 GError		**error);
+GVariant	*gs_packagekit_history_lookup		(GsPackagekitHistory *history,
+							 const gchar	*name);
+void		 gs_packagekit_history_add_package	(GsPackagekitHistory *history,
+							 const gchar	*name,
+							 GVariant	*entries);
+void		 gs_packagekit_history_remove_all	(GsPackagekitHistory *history);
+guint		 gs_packagekit_history_add_transactions	(GsPackagekitHistory *history,
+							 GPtrArray	*transactions);
+guint64		 gs_packagekit_history_get_timestamp	(GsPackagekitHistory *history);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(GsPackagekitHistory, gs_packagekit_history_free)
+
+G_END_DECLS
+
+#endif /* __PACKAGEKIT_HISTORY_H */
@@ -184,7 +184,10 @@ gs_plugin_snap_refine_app (GsPlugin *plugin,
 	/* icon is optional, either loaded from snapd or from a URL */
 	icon_url = json_object_get_string_member (package, "icon");
 	if (icon_url != NULL && g_strcmp0 (icon_url, "") != 0) {
-		if (g_str_has_prefix (icon_url, "/")) {
+		if (g_str_has_prefix (icon_url, "/") &&
+		    gs_app_get_pixbuf (app) != NULL) {
+			/* already fetched as part of a batched refine */
+		} else if (g_str_has_prefix (icon_url, "/")) {
 			g_autofree gchar *icon_data = NULL;
 			gsize icon_data_length;
 			g_autoptr(GError) error_local = NULL;
@@ -413,32 +416,133 @@ gs_plugin_add_search (GsPlugin *plugin,
 	return TRUE;
 }
 
+static void
+gs_plugin_snap_json_object_free (JsonObject *object)
+{
+	if (object != NULL)
+		json_object_unref (object);
+}
+
 gboolean
-gs_plugin_refine_app (GsPlugin *plugin,
-		      GsApp *app,
-		      GsPluginRefineFlags flags,
-		      GCancellable *cancellable,
-		      GError **error)
+gs_plugin_refine (GsPlugin *plugin,
+		  GsAppList *list,
+		  GsPluginRefineFlags flags,
+		  GCancellable *cancellable,
+		  GError **error)
 {
 	g_autofree gchar *macaroon = NULL;
 	g_auto(GStrv) discharges = NULL;
-	g_autoptr(JsonObject) result = NULL;
-	const gchar *id;
+	g_autoptr(GError) error_icons = NULL;
+	g_autoptr(GHashTable) installed = NULL;
+	g_autoptr(GPtrArray) apps = g_ptr_array_new ();
+	g_autoptr(GPtrArray) packages = NULL;
+	g_autoptr(GPtrArray) icon_apps = g_ptr_array_new ();
+	g_autoptr(GPtrArray) icon_paths = g_ptr_array_new ();
+	g_autoptr(GPtrArray) icons = NULL;
+	g_autoptr(JsonArray) snaps = NULL;
+	guint i;
 
 	/* not us */
-	if (g_strcmp0 (gs_app_get_management_plugin (app), "snap") != 0)
+	for (i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+		if (g_strcmp0 (gs_app_get_management_plugin (app), "snap") != 0)
+			continue;
+		g_ptr_array_add (apps, app);
+	}
+	if (apps->len == 0)
 		return TRUE;
 
 	get_macaroon (plugin, &macaroon, &discharges);
 
-	id = gs_app_get_id (app);
-	if (id == NULL)
-		id = gs_app_get_source_default (app);
-	result = gs_snapd_list_one (macaroon, discharges, id, cancellable, error);
-	if (result == NULL)
-		return FALSE;
-	if (!gs_plugin_snap_refine_app (plugin, app, result, FALSE, cancellable, error))
+	/* get all the installed snaps in one request */
+	snaps = gs_snapd_list (macaroon, discharges, cancellable, error);
+	if (snaps == NULL)
 		return FALSE;
+	installed = g_hash_table_new (g_str_hash, g_str_equal);
+	for (i = 0; i < json_array_get_length (snaps); i++) {
+		JsonObject *package = json_array_get_object_element (snaps, i);
+		g_hash_table_insert (installed,
+				     (gpointer) json_object_get_string_member (package, "name"),
+				     package);
+	}
+
+	packages = g_ptr_array_new_with_free_func ((GDestroyNotify) gs_plugin_snap_json_object_free);
+	for (i = 0; i < apps->len; i++) {
+		GsApp *app = g_ptr_array_index (apps, i);
+		JsonObject *package;
+		const gchar *id;
+		const gchar *icon_url = NULL;
+
+		id = gs_app_get_id (app);
+		if (id == NULL)
+			id = gs_app_get_source_default (app);
+		package = g_hash_table_lookup (installed, id);
+		if (package != NULL) {
+			json_object_ref (package);
+		} else {
+			g_autoptr(GError) error_local = NULL;
+			package = gs_snapd_list_one (macaroon, discharges, id,
+						     cancellable, &error_local);
+			if (package == NULL) {
+				if (g_cancellable_set_error_if_cancelled (cancellable, error))
+					return FALSE;
+
+				/* leave this one unrefined rather than fail the rest */
+				g_warning ("failed to get snap %s: %s",
+					   id, error_local->message);
+				g_ptr_array_add (packages, NULL);
+				continue;
+			}
+		}
+		g_ptr_array_add (packages, package);
+
+		/* queue icons that snapd has to serve */
+		if (gs_app_get_pixbuf (app) != NULL)
+			continue;
+		if (json_object_has_member (package, "icon"))
+			icon_url = json_object_get_string_member (package, "icon");
+		if (icon_url != NULL && g_str_has_prefix (icon_url, "/")) {
+			g_ptr_array_add (icon_apps, app);
+			g_ptr_array_add (icon_paths, (gpointer) icon_url);
+		}
+	}
+
+	/* fetch all the local icons in one round trip; a missing icon is
+	 * not worth failing the refine for */
+	icons = gs_snapd_get_resources (macaroon, discharges, icon_paths,
+					cancellable, &error_icons);
+	if (icons == NULL) {
+		if (g_cancellable_set_error_if_cancelled (cancellable, error))
+			return FALSE;
+		g_warning ("failed to get snap icons: %s", error_icons->message);
+	}
+	for (i = 0; icons != NULL && i < icons->len; i++) {
+		GBytes *icon_data = g_ptr_array_index (icons, i);
+		GsApp *app = g_ptr_array_index (icon_apps, i);
+		const gchar *icon_url = g_ptr_array_index (icon_paths, i);
+		g_autoptr(GError) error_local = NULL;
+		if (icon_data == NULL) {
+			g_warning ("failed to get icon %s for %s",
+				   icon_url, gs_app_get_id (app));
+			continue;
+		}
+		if (!gs_plugin_snap_set_app_pixbuf_from_data (app,
+					g_bytes_get_data (icon_data, NULL),
+					g_bytes_get_size (icon_data),
+					&error_local)) {
+			g_warning ("failed to load %s: %s",
+				   icon_url, error_local->message);
+		}
+	}
+
+	for (i = 0; i < apps->len; i++) {
+		GsApp *app = g_ptr_array_index (apps, i);
+		JsonObject *package = g_ptr_array_index (packages, i);
+		if (package == NULL)
+			continue;
+		if (!gs_plugin_snap_refine_app (plugin, app, package, FALSE, cancellable, error))
+			return FALSE;
+	}
 
 	return TRUE;
 }
@@ -0,0 +1,294 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Canonical Ltd
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <gio/gunixsocketaddress.h>
+
+#include "gnome-software-private.h"
+
+#include "gs-snapd.h"
+
+/* a tiny snapd that answers pipelined requests on a unix socket */
+typedef struct {
+	GSocket		*listener;
+	GCancellable	*cancellable;
+	gint		 connections;
+	gint		 requests;
+} GsSnapdTestServer;
+
+static gboolean
+gs_snapd_test_server_send (GSocket *socket, GString *response)
+{
+	gsize n_total = 0;
+	while (n_total < response->len) {
+		gssize n_written;
+		n_written = g_socket_send (socket,
+					   response->str + n_total,
+					   response->len - n_total,
+					   NULL, NULL);
+		if (n_written < 0)
+			return FALSE;
+		n_total += (gsize) n_written;
+	}
+	return TRUE;
+}
+
+/* returns FALSE if the connection should be closed */
+static gboolean
+gs_snapd_test_server_respond (GSocket *socket, const gchar *path)
+{
+	g_autoptr(GString) response = g_string_new (NULL);
+
+	if (g_strcmp0 (path, "/v2/snaps") == 0) {
+		const gchar *chunk1 = "{\"type\":\"sync\",\"status-code\":200,"
+				      "\"result\":[{\"name\":\"one\"},";
+		const gchar *chunk2 = "{\"name\":\"two\"}]}";
+		g_string_append (response,
+				 "HTTP/1.1 200 OK\r\n"
+				 "Content-Type: application/json\r\n"
+				 "Transfer-Encoding: chunked\r\n"
+				 "\r\n");
+		g_string_append_printf (response, "%zx\r\n%s\r\n",
+					strlen (chunk1), chunk1);
+		g_string_append_printf (response, "%zx\r\n%s\r\n",
+					strlen (chunk2), chunk2);
+		g_string_append (response, "0\r\n\r\n");
+	} else if (g_strcmp0 (path, "/v2/snaps/three") == 0) {
+		const gchar *body = "{\"type\":\"sync\",\"status-code\":200,"
+				    "\"result\":{\"name\":\"three\"}}";
+		g_string_append_printf (response,
+					"HTTP/1.1 200 OK\r\n"
+					"Content-Type: application/json\r\n"
+					"Content-Length: %zu\r\n"
+					"\r\n%s",
+					strlen (body), body);
+	} else if (g_str_has_prefix (path, "/icons/")) {
+		g_autofree gchar *body = g_strdup_printf ("icon-%s", path + 7);
+		g_string_append_printf (response,
+					"HTTP/1.1 200 OK\r\n"
+					"Content-Type: image/png\r\n"
+					"Content-Length: %zu\r\n"
+					"\r\n%s",
+					strlen (body), body);
+	} else if (g_str_has_suffix (path, "/drop")) {
+		/* go away without answering */
+		return FALSE;
+	} else if (g_strcmp0 (path, "/close") == 0) {
+		g_string_append (response,
+				 "HTTP/1.1 200 OK\r\n"
+				 "Content-Type: text/plain\r\n"
+				 "Content-Length: 6\r\n"
+				 "Connection: close\r\n"
+				 "\r\nclosed");
+		gs_snapd_test_server_send (socket, response);
+		return FALSE;
+	} else {
+		g_string_append (response,
+				 "HTTP/1.1 404 Not Found\r\n"
+				 "Content-Length: 0\r\n"
+				 "\r\n");
+	}
+	return gs_snapd_test_server_send (socket, response);
+}
+
+static void
+gs_snapd_test_server_handle (GsSnapdTestServer *server, GSocket *socket)
+{
+	g_autoptr(GString) buffer = g_string_new (NULL);
+
+	while (TRUE) {
+		gchar tmp[1024];
+		gssize n_read;
+		const gchar *end;
+
+		n_read = g_socket_receive (socket, tmp, sizeof (tmp),
+					   server->cancellable, NULL);
+		if (n_read <= 0)
+			return;
+		g_string_append_len (buffer, tmp, n_read);
+
+		/* several requests may have arrived in one read */
+		while ((end = strstr (buffer->str, "\r\n\r\n")) != NULL) {
+			g_autofree gchar *line = NULL;
+			g_auto(GStrv) split = NULL;
+
+			line = g_strndup (buffer->str, (gsize) (strstr (buffer->str, "\r\n") - buffer->str));
+			g_string_erase (buffer, 0, end + 4 - buffer->str);
+			split = g_strsplit (line, " ", -1);
+			g_assert_cmpint (g_strv_length (split), ==, 3);
+			g_atomic_int_inc (&server->requests);
+			if (!gs_snapd_test_server_respond (socket, split[1]))
+				return;
+		}
+	}
+}
+
+static gpointer
+gs_snapd_test_server_thread (gpointer user_data)
+{
+	GsSnapdTestServer *server = user_data;
+
+	while (TRUE) {
+		g_autoptr(GSocket) socket = NULL;
+		socket = g_socket_accept (server->listener, server->cancellable, NULL);
+		if (socket == NULL)
+			return NULL;
+		g_atomic_int_inc (&server->connections);
+		gs_snapd_test_server_handle (server, socket);
+		g_socket_close (socket, NULL);
+	}
+}
+
+static void
+gs_snapd_pipeline_func (void)
+{
+	GsSnapdTestServer server = { NULL, NULL, 0, 0 };
+	GThread *thread;
+	JsonObject *snap;
+	gboolean ret;
+	gint requests;
+	gsize data_length = 0;
+	g_autofree gchar *data = NULL;
+	g_autofree gchar *socket_dir = NULL;
+	g_autofree gchar *socket_path = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) paths = g_ptr_array_new ();
+	g_autoptr(GPtrArray) resources = NULL;
+	g_autoptr(GSocketAddress) address = NULL;
+	g_autoptr(JsonArray) snaps = NULL;
+	g_autoptr(JsonObject) result = NULL;
+
+	/* start the fake snapd */
+	socket_dir = g_dir_make_tmp ("gs-self-test-snapd-XXXXXX", &error);
+	g_assert_no_error (error);
+	socket_path = g_build_filename (socket_dir, "snapd.socket", NULL);
+	g_setenv ("GS_SELF_TEST_SNAPD_SOCKET", socket_path, TRUE);
+	server.listener = g_socket_new (G_SOCKET_FAMILY_UNIX,
+					G_SOCKET_TYPE_STREAM,
+					G_SOCKET_PROTOCOL_DEFAULT,
+					&error);
+	g_assert_no_error (error);
+	address = g_unix_socket_address_new (socket_path);
+	ret = g_socket_bind (server.listener, address, TRUE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = g_socket_listen (server.listener, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	server.cancellable = g_cancellable_new ();
+	thread = g_thread_new ("fake-snapd", gs_snapd_test_server_thread, &server);
+	g_assert (gs_snapd_exists ());
+
+	/* chunked response with more than one chunk */
+	snaps = gs_snapd_list (NULL, NULL, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (snaps != NULL);
+	g_assert_cmpint (json_array_get_length (snaps), ==, 2);
+	snap = json_array_get_object_element (snaps, 1);
+	g_assert_cmpstr (json_object_get_string_member (snap, "name"), ==, "two");
+
+	/* the connection is reused */
+	result = gs_snapd_list_one (NULL, NULL, "three", NULL, &error);
+	g_assert_no_error (error);
+	g_assert (result != NULL);
+	g_assert_cmpstr (json_object_get_string_member (result, "name"), ==, "three");
+	g_assert_cmpint (g_atomic_int_get (&server.connections), ==, 1);
+
+	/* pipelined requests come back in order */
+	g_ptr_array_add (paths, (gpointer) "/icons/1");
+	g_ptr_array_add (paths, (gpointer) "/icons/2");
+	g_ptr_array_add (paths, (gpointer) "/icons/3");
+	g_ptr_array_add (paths, (gpointer) "/missing");
+	resources = gs_snapd_get_resources (NULL, NULL, paths, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (resources != NULL);
+	g_assert_cmpint (resources->len, ==, 4);
+	g_assert_cmpint (g_bytes_get_size (g_ptr_array_index (resources, 0)), ==, 6);
+	g_assert (memcmp (g_bytes_get_data (g_ptr_array_index (resources, 0), NULL), "icon-1", 6) == 0);
+	g_assert (memcmp (g_bytes_get_data (g_ptr_array_index (resources, 2), NULL), "icon-3", 6) == 0);
+	g_assert (g_ptr_array_index (resources, 3) == NULL);
+	g_assert_cmpint (g_atomic_int_get (&server.connections), ==, 1);
+	g_assert_cmpint (g_atomic_int_get (&server.requests), ==, 6);
+
+	/* a 'Connection: close' response means connecting again */
+	data = gs_snapd_get_resource (NULL, NULL, "/close", &data_length, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_cmpstr (data, ==, "closed");
+	g_assert_cmpint (data_length, ==, 6);
+	g_clear_pointer (&result, json_object_unref);
+	result = gs_snapd_list_one (NULL, NULL, "three", NULL, &error);
+	g_assert_no_error (error);
+	g_assert (result != NULL);
+	g_assert_cmpint (g_atomic_int_get (&server.connections), ==, 2);
+
+	/* a GET on a connection that has gone is sent again */
+	requests = g_atomic_int_get (&server.requests);
+	g_clear_pointer (&data, g_free);
+	data = gs_snapd_get_resource (NULL, NULL, "/drop", &data_length, NULL, &error);
+	g_assert (error != NULL);
+	g_assert (data == NULL);
+	g_clear_error (&error);
+	g_assert_cmpint (g_atomic_int_get (&server.requests), ==, requests + 2);
+	g_assert_cmpint (g_atomic_int_get (&server.connections), ==, 3);
+
+	/* anything else is not, as snapd may have acted on it */
+	g_clear_pointer (&result, json_object_unref);
+	result = gs_snapd_list_one (NULL, NULL, "three", NULL, &error);
+	g_assert_no_error (error);
+	g_assert (result != NULL);
+	g_assert_cmpint (g_atomic_int_get (&server.connections), ==, 4);
+	requests = g_atomic_int_get (&server.requests);
+	ret = gs_snapd_install (NULL, NULL, "drop", NULL, NULL, NULL, &error);
+	g_assert (error != NULL);
+	g_assert (!ret);
+	g_clear_error (&error);
+	g_assert_cmpint (g_atomic_int_get (&server.requests), ==, requests + 1);
+	g_assert_cmpint (g_atomic_int_get (&server.connections), ==, 4);
+
+	/* stop the fake snapd */
+	g_cancellable_cancel (server.cancellable);
+	g_thread_join (thread);
+	g_object_unref (server.cancellable);
+	g_object_unref (server.listener);
+	g_unlink (socket_path);
+	g_rmdir (socket_dir);
+}
+
+int
+main (int argc, char **argv)
+{
+	g_test_init (&argc, &argv, NULL);
+	g_setenv ("G_MESSAGES_DEBUG", "all", TRUE);
+
+	/* only critical and error are fatal */
+	g_log_set_fatal_mask (NULL, G_LOG_LEVEL_ERROR | G_LOG_LEVEL_CRITICAL);
+
+	/* snapd tests go here */
+	g_test_add_func ("/gnome-software/plugins/snap/pipeline",
+			 gs_snapd_pipeline_func);
+
+	return g_test_run ();
+}
+
+/* vim: set noexpandtab: */
@@ -35,10 +35,60 @@
 
 #define SNAPD_SOCKET "/run/snapd.socket"
 
+/* one connection to snapd kept open between requests */
+typedef struct {
+	GMutex		 mutex;
+	GSocket		*socket;
+	GByteArray	*buffer;	/* received but not yet consumed */
+} GsSnapdConnection;
+
+static GsSnapdConnection connection;
+
+typedef struct {
+	guint		 status_code;
+	gchar		*reason_phrase;
+	gchar		*response_type;
+	gchar		*response;
+	gsize		 response_length;
+} GsSnapdResponse;
+
+static void
+gs_snapd_response_free (GsSnapdResponse *response)
+{
+	g_free (response->reason_phrase);
+	g_free (response->response_type);
+	g_free (response->response);
+	g_free (response);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(GsSnapdResponse, gs_snapd_response_free)
+
+static void
+gs_snapd_bytes_free (GBytes *bytes)
+{
+	if (bytes != NULL)
+		g_bytes_unref (bytes);
+}
+
+static void
+gs_snapd_string_free (GString *str)
+{
+	g_string_free (str, TRUE);
+}
+
+static const gchar *
+gs_snapd_get_socket_path (void)
+{
+	const gchar *tmp = g_getenv ("GS_SELF_TEST_SNAPD_SOCKET");
+	if (tmp != NULL)
+		return tmp;
+	return SNAPD_SOCKET;
+}
+
 gboolean
 gs_snapd_exists (void)
 {
-	return g_file_test (SNAPD_SOCKET, G_FILE_TEST_EXISTS);
+	return g_file_test (gs_snapd_get_socket_path (), G_FILE_TEST_EXISTS);
 }
 
 static GSocket *
@@ -60,7 +110,7 @@ gs_snapd_socket_open (GCancellable *cancellable, GError **error)
 			     error_local->message);
 		return NULL;
 	}
-	address = g_unix_socket_address_new (SNAPD_SOCKET);
+	address = g_unix_socket_address_new (gs_snapd_get_socket_path ());
 	if (!g_socket_connect (socket, address, cancellable, &error_local)) {
 		g_set_error (error,
 			     GS_PLUGIN_ERROR,
@@ -74,205 +124,220 @@ gs_snapd_socket_open (GCancellable *cancellable, GError **error)
 	return socket;
 }
 
+static void
+gs_snapd_connection_close (GsSnapdConnection *conn)
+{
+	if (conn->socket != NULL) {
+		g_socket_close (conn->socket, NULL);
+		g_clear_object (&conn->socket);
+	}
+	if (conn->buffer != NULL)
+		g_byte_array_set_size (conn->buffer, 0);
+}
+
+static gboolean
+gs_snapd_connection_write (GsSnapdConnection *conn,
+			   GString *data,
+			   GCancellable *cancellable,
+			   GError **error)
+{
+	gsize n_total = 0;
+
+	while (n_total < data->len) {
+		gssize n_written;
+		n_written = g_socket_send (conn->socket,
+					   data->str + n_total,
+					   data->len - n_total,
+					   cancellable,
+					   error);
+		if (n_written < 0)
+			return FALSE;
+		n_total += (gsize) n_written;
+	}
+	return TRUE;
+}
+
 static gboolean
-gs_snapd_socket_read (GSocket *socket,
-		      GByteArray *buffer,
-		      gsize *read_offset,
-		      gsize size,
-		      GCancellable *cancellable,
-		      GError **error)
+gs_snapd_connection_read (GsSnapdConnection *conn,
+			  gboolean *eof,
+			  GCancellable *cancellable,
+			  GError **error)
 {
 	gssize n_read;
+	guint offset = conn->buffer->len;
 
-	if (*read_offset + size > buffer->len)
-		g_byte_array_set_size (buffer, *read_offset + size + 1);
-	n_read = g_socket_receive (socket,
-				   buffer->data + *read_offset,
-				   size,
+	g_byte_array_set_size (conn->buffer, offset + 4096);
+	n_read = g_socket_receive (conn->socket,
+				   (gchar *) conn->buffer->data + offset,
+				   4096,
 				   cancellable,
 				   error);
 	if (n_read < 0) {
+		g_byte_array_set_size (conn->buffer, offset);
 		gs_utils_error_convert_gio (error);
 		return FALSE;
 	}
-	*read_offset += (gsize) n_read;
-	buffer->data[*read_offset] = '\0';
-
+	g_byte_array_set_size (conn->buffer, offset + (guint) n_read);
+	*eof = n_read == 0;
 	return TRUE;
 }
 
+/* makes sure at least @size bytes have been received */
 static gboolean
-gs_snapd_send_request (const gchar  *method,
-		       const gchar  *path,
-		       const gchar  *content,
-		       const gchar  *macaroon,
-		       gchar       **discharges,
-		       guint        *status_code,
-		       gchar       **reason_phrase,
-		       gchar       **response_type,
-		       gchar       **response,
-		       gsize        *response_length,
-		       GCancellable *cancellable,
-		       GError      **error)
+gs_snapd_connection_fill (GsSnapdConnection *conn,
+			  gsize size,
+			  GCancellable *cancellable,
+			  GError **error)
 {
-	g_autoptr (GSocket) socket = NULL;
-	g_autoptr (GString) request = NULL;
-	gssize n_written;
-	g_autoptr (GByteArray) buffer = NULL;
-	gsize data_length = 0, header_length, body_offset = 0;
-	g_autoptr (SoupMessageHeaders) headers = NULL;
-	gsize chunk_length = 0, n_required, chunk_offset;
-	guint code;
-
-	// NOTE: Would love to use libsoup but it doesn't support unix sockets
-	// https://bugzilla.gnome.org/show_bug.cgi?id=727563
-
-	socket = gs_snapd_socket_open (cancellable, error);
-	if (socket == NULL)
-		return FALSE;
-
-	request = g_string_new ("");
-	g_string_append_printf (request, "%s %s HTTP/1.1\r\n", method, path);
-	g_string_append (request, "Host:\r\n");
-	if (macaroon != NULL) {
-		gint i;
-
-		g_string_append_printf (request, "Authorization: Macaroon root=\"%s\"", macaroon);
-		for (i = 0; discharges[i] != NULL; i++)
-			g_string_append_printf (request, ",discharge=\"%s\"", discharges[i]);
-		g_string_append (request, "\r\n");
-	}
-	if (content)
-		g_string_append_printf (request, "Content-Length: %zu\r\n", strlen (content));
-	g_string_append (request, "\r\n");
-	if (content)
-		g_string_append (request, content);
-
-	g_debug ("begin snapd request: %s", request->str);
-
-	/* send HTTP request */
-	n_written = g_socket_send (socket, request->str, request->len, cancellable, error);
-	if (n_written < 0) {
-		gs_utils_error_convert_gio (error);
-		return FALSE;
-	}
-
-	/* read HTTP headers */
-	buffer = g_byte_array_new ();
-	while (TRUE) {
-		const gchar *divider;
-
-		gsize n_read = data_length;
-		if (!gs_snapd_socket_read (socket,
-				      buffer,
-				      &data_length,
-				      1024,
-				      cancellable,
-				      error))
+	while (conn->buffer->len < size) {
+		gboolean eof = FALSE;
+		if (!gs_snapd_connection_read (conn, &eof, cancellable, error))
 			return FALSE;
-
-		if (n_read == data_length) {
+		if (eof) {
 			g_set_error_literal (error,
 					     GS_PLUGIN_ERROR,
 					     GS_PLUGIN_ERROR_INVALID_FORMAT,
-					     "Unable to find header separator in snapd response");
+					     "snapd closed the connection");
 			return FALSE;
 		}
+	}
+	return TRUE;
+}
+
+/* returns the offset just after the next "\r\n" at or after @offset,
+ * reading more data as required */
+static gboolean
+gs_snapd_connection_find_line (GsSnapdConnection *conn,
+			       gsize offset,
+			       gsize *end,
+			       GCancellable *cancellable,
+			       GError **error)
+{
+	gsize i = offset;
+
+	while (TRUE) {
+		for (; i + 1 < conn->buffer->len; i++) {
+			if (conn->buffer->data[i] == '\r' &&
+			    conn->buffer->data[i + 1] == '\n') {
+				*end = i + 2;
+				return TRUE;
+			}
+		}
+		if (!gs_snapd_connection_fill (conn, conn->buffer->len + 1,
+					       cancellable, error))
+			return FALSE;
+	}
+}
 
-		divider = strstr (buffer->data, "\r\n\r\n");
-		if (divider != NULL) {
-			body_offset = ((guint8*) divider - buffer->data) + 4;
+static GsSnapdResponse *
+gs_snapd_connection_read_response (GsSnapdConnection *conn,
+				   gboolean *keep_alive,
+				   GCancellable *cancellable,
+				   GError **error)
+{
+	gsize body_offset = 0;
+	gsize consumed = 0;
+	gsize line_start;
+	SoupHTTPVersion version;
+	g_autoptr(GByteArray) body = g_byte_array_new ();
+	g_autoptr(GsSnapdResponse) response = g_new0 (GsSnapdResponse, 1);
+	g_autoptr(SoupMessageHeaders) headers = NULL;
+
+	/* read HTTP headers, which end with an empty line */
+	line_start = 0;
+	while (TRUE) {
+		gsize line_end;
+		if (!gs_snapd_connection_find_line (conn, line_start, &line_end,
+						    cancellable, error))
+			return NULL;
+		if (line_end - line_start == 2 && line_start > 0) {
+			body_offset = line_end;
 			break;
 		}
+		line_start = line_end;
 	}
 
 	/* parse headers */
 	headers = soup_message_headers_new (SOUP_MESSAGE_HEADERS_RESPONSE);
-	if (!soup_headers_parse_response (buffer->data, (gint) body_offset, headers,
-					  NULL, &code, reason_phrase)) {
+	if (!soup_headers_parse_response ((const gchar *) conn->buffer->data,
+					  (gint) body_offset, headers,
+					  &version, &response->status_code,
+					  &response->reason_phrase)) {
 		g_set_error_literal (error,
 				     GS_PLUGIN_ERROR,
 				     GS_PLUGIN_ERROR_INVALID_FORMAT,
 				     "snapd response HTTP headers not parseable");
-		return FALSE;
+		return NULL;
 	}
-
-	if (status_code != NULL)
-		*status_code = code;
+	*keep_alive = version == SOUP_HTTP_1_1 &&
+		      !soup_message_headers_header_contains (headers, "Connection", "close");
 
 	/* read content */
 	switch (soup_message_headers_get_encoding (headers)) {
+	case SOUP_ENCODING_NONE:
+		consumed = body_offset;
+		break;
 	case SOUP_ENCODING_EOF:
-		chunk_offset = body_offset;
 		while (TRUE) {
-			gsize n_read = data_length;
-			if (!gs_snapd_socket_read (socket,
-					      buffer,
-					      &data_length,
-					      1024,
-					      cancellable,
-					      error))
-				return FALSE;
-			if (n_read == data_length)
+			gboolean eof = FALSE;
+			if (!gs_snapd_connection_read (conn, &eof, cancellable, error))
+				return NULL;
+			if (eof)
 				break;
-			chunk_length += data_length - n_read;
 		}
+		g_byte_array_append (body,
+				     conn->buffer->data + body_offset,
+				     conn->buffer->len - (guint) body_offset);
+		consumed = conn->buffer->len;
+		*keep_alive = FALSE;
 		break;
 	case SOUP_ENCODING_CHUNKED:
-		// FIXME: support multiple chunks
+		consumed = body_offset;
 		while (TRUE) {
-			const gchar *divider;
-			gsize n_read;
-
-			divider = strstr (buffer->data + body_offset, "\r\n");
-			if (divider) {
-				chunk_length = strtoul (buffer->data + body_offset, NULL, 16);
-				chunk_offset = ((guint8*) divider - buffer->data) + 2;
+			gsize chunk_length;
+			gsize line_end;
+
+			/* chunk size */
+			if (!gs_snapd_connection_find_line (conn, consumed, &line_end,
+							    cancellable, error))
+				return NULL;
+			chunk_length = strtoul ((const gchar *) conn->buffer->data + consumed, NULL, 16);
+			consumed = line_end;
+
+			/* last chunk, skip any trailers */
+			if (chunk_length == 0) {
+				while (TRUE) {
+					gsize trailer_start = consumed;
+					if (!gs_snapd_connection_find_line (conn, consumed, &consumed,
+									    cancellable, error))
+						return NULL;
+					if (consumed - trailer_start == 2)
+						break;
+				}
 				break;
 			}
 
-			n_read = data_length;
-			if (!gs_snapd_socket_read (socket,
-					      buffer,
-					      &data_length,
-					      1024,
-					      cancellable,
-					      error))
-				return FALSE;
-
-			if (n_read == data_length) {
-				g_set_error_literal (error,
-						     GS_PLUGIN_ERROR,
-						     GS_PLUGIN_ERROR_INVALID_FORMAT,
-						     "Unable to find chunk header in "
-						     "snapd response");
-				return FALSE;
-			}
+			/* chunk data and its trailing "\r\n" */
+			if (!gs_snapd_connection_fill (conn, consumed + chunk_length + 2,
+						       cancellable, error))
+				return NULL;
+			g_byte_array_append (body,
+					     conn->buffer->data + consumed,
+					     (guint) chunk_length);
+			consumed += chunk_length + 2;
 		}
-
-		/* check if enough space to read chunk */
-		n_required = chunk_offset + chunk_length;
-		while (data_length < n_required)
-			if (!gs_snapd_socket_read (socket,
-					      buffer,
-					      &data_length,
-					      n_required - data_length,
-					      cancellable,
-					      error))
-				return FALSE;
 		break;
 	case SOUP_ENCODING_CONTENT_LENGTH:
-		chunk_offset = body_offset;
-		chunk_length = soup_message_headers_get_content_length (headers);
-		n_required = chunk_offset + chunk_length;
-		while (data_length < n_required) {
-			if (!gs_snapd_socket_read (socket,
-						   buffer,
-						   &data_length,
-						   n_required - data_length,
-						   cancellable,
-						   error))
-				return FALSE;
+		{
+			gsize content_length;
+			content_length = (gsize) soup_message_headers_get_content_length (headers);
+			if (!gs_snapd_connection_fill (conn, body_offset + content_length,
+						       cancellable, error))
+				return NULL;
+			g_byte_array_append (body,
+					     conn->buffer->data + body_offset,
+					     (guint) content_length);
+			consumed = body_offset + content_length;
 		}
 		break;
 	default:
@@ -281,18 +346,166 @@ gs_snapd_send_request (const gchar  *method,
 				     GS_PLUGIN_ERROR_INVALID_FORMAT,
 				     "Unable to determine content "
 				     "length of snapd response");
-		return FALSE;
+		return NULL;
 	}
 
-	if (response_type)
-		*response_type = g_strdup (soup_message_headers_get_content_type (headers, NULL));
-	if (response != NULL) {
-		*response = g_malloc (chunk_length + 1);
-		memcpy (*response, buffer->data + chunk_offset, chunk_length + 1);
-		g_debug ("snapd status %u: %s", code, *response);
+	/* anything left over belongs to the next pipelined response */
+	g_byte_array_remove_range (conn->buffer, 0, (guint) consumed);
+
+	response->response_type = g_strdup (soup_message_headers_get_content_type (headers, NULL));
+	response->response_length = body->len;
+	g_byte_array_append (body, (const guint8 *) "", 1);
+	response->response = (gchar *) g_byte_array_free (g_steal_pointer (&body), FALSE);
+	g_debug ("snapd status %u: %s", response->status_code, response->response);
+	return g_steal_pointer (&response);
+}
+
+static GString *
+gs_snapd_build_request (const gchar  *method,
+			const gchar  *path,
+			const gchar  *content,
+			const gchar  *macaroon,
+			gchar       **discharges)
+{
+	GString *request = g_string_new ("");
+
+	g_string_append_printf (request, "%s %s HTTP/1.1\r\n", method, path);
+	g_string_append (request, "Host:\r\n");
+	if (macaroon != NULL) {
+		gint i;
+
+		g_string_append_printf (request, "Authorization: Macaroon root=\"%s\"", macaroon);
+		for (i = 0; discharges[i] != NULL; i++)
+			g_string_append_printf (request, ",discharge=\"%s\"", discharges[i]);
+		g_string_append (request, "\r\n");
 	}
-	if (response_length)
-		*response_length = chunk_length;
+	if (content)
+		g_string_append_printf (request, "Content-Length: %zu\r\n", strlen (content));
+	g_string_append (request, "\r\n");
+	if (content)
+		g_string_append (request, content);
+	return request;
+}
+
+/* writes all the requests in one go and then reads the responses in
+ * order, reusing the existing connection where possible; only requests
+ * that are safe to repeat are sent again if the connection has gone */
+static GPtrArray *
+gs_snapd_send_requests (GPtrArray *requests,
+			gboolean retry,
+			GCancellable *cancellable,
+			GError **error)
+{
+	GsSnapdConnection *conn = &connection;
+	guint attempt;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&conn->mutex);
+
+	// NOTE: Would love to use libsoup but it doesn't support unix sockets
+	// https://bugzilla.gnome.org/show_bug.cgi?id=727563
+
+	if (conn->buffer == NULL)
+		conn->buffer = g_byte_array_new ();
+
+	/* snapd may have closed an idle connection, so try again once */
+	for (attempt = 0; ; attempt++) {
+		gboolean reused = conn->socket != NULL;
+		guint i;
+		g_autoptr(GError) error_local = NULL;
+		g_autoptr(GPtrArray) responses = NULL;
+		g_autoptr(GString) data = g_string_new (NULL);
+
+		if (conn->socket == NULL) {
+			conn->socket = gs_snapd_socket_open (cancellable, error);
+			if (conn->socket == NULL)
+				return NULL;
+		}
+
+		/* send HTTP requests */
+		for (i = 0; i < requests->len; i++) {
+			GString *request = g_ptr_array_index (requests, i);
+			g_debug ("begin snapd request: %s", request->str);
+			g_string_append_len (data, request->str, (gssize) request->len);
+		}
+		responses = g_ptr_array_new_with_free_func ((GDestroyNotify) gs_snapd_response_free);
+		if (gs_snapd_connection_write (conn, data, cancellable, &error_local)) {
+			/* read HTTP responses */
+			for (i = 0; i < requests->len; i++) {
+				GsSnapdResponse *response;
+				gboolean keep_alive = TRUE;
+				response = gs_snapd_connection_read_response (conn,
+									      &keep_alive,
+									      cancellable,
+									      &error_local);
+				if (response == NULL)
+					break;
+				g_ptr_array_add (responses, response);
+				if (!keep_alive) {
+					gs_snapd_connection_close (conn);
+					if (i + 1 < requests->len) {
+						g_set_error_literal (&error_local,
+								     GS_PLUGIN_ERROR,
+								     GS_PLUGIN_ERROR_INVALID_FORMAT,
+								     "snapd closed the connection");
+						break;
+					}
+				}
+			}
+			if (error_local == NULL)
+				return g_steal_pointer (&responses);
+		}
+
+		/* the connection is in an unknown state now */
+		gs_snapd_connection_close (conn);
+		if (!retry || !reused || attempt > 0 || responses->len > 0 ||
+		    g_cancellable_is_cancelled (cancellable)) {
+			gs_utils_error_convert_gio (&error_local);
+			g_propagate_error (error, g_steal_pointer (&error_local));
+			return NULL;
+		}
+		g_debug ("failed to use existing snapd connection, reconnecting: %s",
+			 error_local->message);
+	}
+}
+
+static gboolean
+gs_snapd_send_request (const gchar  *method,
+		       const gchar  *path,
+		       const gchar  *content,
+		       const gchar  *macaroon,
+		       gchar       **discharges,
+		       guint        *status_code,
+		       gchar       **reason_phrase,
+		       gchar       **response_type,
+		       gchar       **response,
+		       gsize        *response_length,
+		       GCancellable *cancellable,
+		       GError      **error)
+{
+	GsSnapdResponse *resp;
+	g_autoptr(GPtrArray) requests = NULL;
+	g_autoptr(GPtrArray) responses = NULL;
+
+	requests = g_ptr_array_new_with_free_func ((GDestroyNotify) gs_snapd_string_free);
+	g_ptr_array_add (requests, gs_snapd_build_request (method, path, content,
+							   macaroon, discharges));
+	/* snapd may have acted on anything other than a GET */
+	responses = gs_snapd_send_requests (requests,
+					    g_strcmp0 (method, "GET") == 0,
+					    cancellable, error);
+	if (responses == NULL)
+		return FALSE;
+
+	resp = g_ptr_array_index (responses, 0);
+	if (status_code != NULL)
+		*status_code = resp->status_code;
+	if (reason_phrase != NULL)
+		*reason_phrase = g_steal_pointer (&resp->reason_phrase);
+	if (response_type != NULL)
+		*response_type = g_steal_pointer (&resp->response_type);
+	if (response != NULL)
+		*response = g_steal_pointer (&resp->response);
+	if (response_length != NULL)
+		*response_length = resp->response_length;
 
 	return TRUE;
 }
@@ -752,3 +965,53 @@ gs_snapd_get_resource (const gchar *macaroon, gchar **discharges,
 
 	return g_steal_pointer (&data);
 }
+
+/**
+ * gs_snapd_get_resources:
+ *
+ * Gets several resources using one pipelined round trip to snapd.
+ * A resource snapd does not return does not fail the others.
+ *
+ * Returns: an array of #GBytes in the same order as @paths, with %NULL
+ * for each resource that could not be got, or %NULL on error
+ */
+GPtrArray *
+gs_snapd_get_resources (const gchar *macaroon, gchar **discharges,
+			GPtrArray *paths,
+			GCancellable *cancellable, GError **error)
+{
+	guint i;
+	g_autoptr(GPtrArray) requests = NULL;
+	g_autoptr(GPtrArray) responses = NULL;
+	g_autoptr(GPtrArray) resources = NULL;
+
+	resources = g_ptr_array_new_with_free_func ((GDestroyNotify) gs_snapd_bytes_free);
+	if (paths->len == 0)
+		return g_steal_pointer (&resources);
+
+	requests = g_ptr_array_new_with_free_func ((GDestroyNotify) gs_snapd_string_free);
+	for (i = 0; i < paths->len; i++) {
+		const gchar *path = g_ptr_array_index (paths, i);
+		g_ptr_array_add (requests, gs_snapd_build_request ("GET", path, NULL,
+								   macaroon, discharges));
+	}
+	responses = gs_snapd_send_requests (requests, TRUE, cancellable, error);
+	if (responses == NULL)
+		return NULL;
+
+	for (i = 0; i < responses->len; i++) {
+		GsSnapdResponse *resp = g_ptr_array_index (responses, i);
+		if (resp->status_code != SOUP_STATUS_OK) {
+			g_debug ("snapd returned status code %u for %s: %s",
+				 resp->status_code,
+				 (const gchar *) g_ptr_array_index (paths, i),
+				 resp->reason_phrase);
+			g_ptr_array_add (resources, NULL);
+			continue;
+		}
+		g_ptr_array_add (resources,
+				 g_bytes_new_take (g_steal_pointer (&resp->response),
+						   resp->response_length));
+	}
+	return g_steal_pointer (&resources);
+}
@@ -80,4 +80,10 @@ gchar *gs_snapd_get_resource		(const gchar	*macaroon,
 					 GCancellable	*cancellable,
 					 GError		**error);
 
+GPtrArray *gs_snapd_get_resources	(const gchar	*macaroon,
+					 gchar		**discharges,
+					 GPtrArray	*paths,
+					 GCancellable	*cancellable,
+					 GError		**error);
+
 #endif /* __GS_SNAPD_H__ */
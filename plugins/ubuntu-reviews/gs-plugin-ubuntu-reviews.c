@@ -29,8 +29,11 @@
 #include <gnome-software.h>
 
 struct GsPluginData {
+	gchar		*review_server;
 	gchar		*db_path;
 	sqlite3		*db;
+	sqlite3_stmt	*stats_stmt;	/* lookup, guarded by stats_mutex */
+	GMutex		 stats_mutex;
 	gsize		 db_loaded;
 	gchar		*origin;
 	gchar		*distroseries;
@@ -53,6 +56,9 @@ typedef struct {
 /* Number of pages of reviews to download */
 #define N_PAGES				3
 
+/* Download reviews again after a week */
+#define REVIEWS_AGE_MAX			(60 * 60 * 24 * 7)
+
 void
 gs_plugin_initialize (GsPlugin *plugin)
 {
@@ -60,6 +66,8 @@ gs_plugin_initialize (GsPlugin *plugin)
 	g_autoptr(GsOsRelease) os_release = NULL;
 	g_autoptr(GError) error = NULL;
 
+	g_mutex_init (&priv->stats_mutex);
+
 	/* check that we are running on Ubuntu */
 	if (!gs_plugin_check_distro_id (plugin, "ubuntu")) {
 		gs_plugin_set_enabled (plugin, FALSE);
@@ -67,6 +75,11 @@ gs_plugin_initialize (GsPlugin *plugin)
 		return;
 	}
 
+	priv->review_server = g_strdup (UBUNTU_REVIEWS_SERVER);
+	if (g_getenv ("GS_SELF_TEST_UBUNTU_REVIEWS_SERVER") != NULL) {
+		g_free (priv->review_server);
+		priv->review_server = g_strdup (g_getenv ("GS_SELF_TEST_UBUNTU_REVIEWS_SERVER"));
+	}
 	priv->db_path = g_build_filename (g_get_user_data_dir (),
 					  "gnome-software",
 					  "ubuntu-reviews.db",
@@ -98,7 +111,10 @@ void
 gs_plugin_destroy (GsPlugin *plugin)
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
+	g_clear_pointer (&priv->stats_stmt, sqlite3_finalize);
 	g_clear_pointer (&priv->db, sqlite3_close);
+	g_mutex_clear (&priv->stats_mutex);
+	g_free (priv->review_server);
 	g_free (priv->db_path);
 	g_free (priv->origin);
 	g_free (priv->distroseries);
@@ -115,28 +131,27 @@ get_timestamp_sqlite_cb (void *data, gint argc,
 
 static gboolean
 set_package_stats (GsPlugin *plugin,
+		   sqlite3_stmt *stmt,
 		   const gchar *package_name,
 		   Histogram *histogram,
 		   GError **error)
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
-	char *error_msg = NULL;
 	gint result;
-	g_autofree gchar *statement = NULL;
-
-	statement = g_strdup_printf ("INSERT OR REPLACE INTO review_stats (package_name, "
-				     "one_star_count, two_star_count, three_star_count, "
-				     "four_star_count, five_star_count) "
-				     "VALUES ('%s', '%" G_GUINT64_FORMAT "', '%" G_GUINT64_FORMAT"', '%" G_GUINT64_FORMAT "', '%" G_GUINT64_FORMAT "', '%" G_GUINT64_FORMAT "');",
-				     package_name, histogram->one_star_count, histogram->two_star_count,
-				     histogram->three_star_count, histogram->four_star_count, histogram->five_star_count);
-	result = sqlite3_exec (priv->db, statement, NULL, NULL, &error_msg);
-	if (result != SQLITE_OK) {
+
+	sqlite3_reset (stmt);
+	sqlite3_bind_text (stmt, 1, package_name, -1, SQLITE_STATIC);
+	sqlite3_bind_int64 (stmt, 2, (sqlite3_int64) histogram->one_star_count);
+	sqlite3_bind_int64 (stmt, 3, (sqlite3_int64) histogram->two_star_count);
+	sqlite3_bind_int64 (stmt, 4, (sqlite3_int64) histogram->three_star_count);
+	sqlite3_bind_int64 (stmt, 5, (sqlite3_int64) histogram->four_star_count);
+	sqlite3_bind_int64 (stmt, 6, (sqlite3_int64) histogram->five_star_count);
+	result = sqlite3_step (stmt);
+	if (result != SQLITE_DONE) {
 		g_set_error (error,
 			     GS_PLUGIN_ERROR,
 			     GS_PLUGIN_ERROR_FAILED,
-			     "SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
+			     "SQL error: %s", sqlite3_errmsg (priv->db));
 		return FALSE;
 	}
 
@@ -149,41 +164,29 @@ set_timestamp (GsPlugin *plugin,
 	       GError **error)
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
-	char *error_msg = NULL;
 	gint result;
-	g_autofree gchar *statement = NULL;
-
-	statement = g_strdup_printf ("INSERT OR REPLACE INTO timestamps (key, value) "
-				     "VALUES ('%s', '%" G_GINT64_FORMAT "');",
-				     type,
-				     g_get_real_time () / G_USEC_PER_SEC);
-	result = sqlite3_exec (priv->db, statement, NULL, NULL, &error_msg);
-	if (result != SQLITE_OK) {
+	sqlite3_stmt *stmt = NULL;
+
+	result = sqlite3_prepare_v2 (priv->db,
+				     "INSERT OR REPLACE INTO timestamps (key, value) "
+				     "VALUES (?1, ?2);",
+				     -1, &stmt, NULL);
+	if (result == SQLITE_OK) {
+		sqlite3_bind_text (stmt, 1, type, -1, SQLITE_STATIC);
+		sqlite3_bind_int64 (stmt, 2, g_get_real_time () / G_USEC_PER_SEC);
+		result = sqlite3_step (stmt);
+	}
+	sqlite3_finalize (stmt);
+	if (result != SQLITE_DONE) {
 		g_set_error (error,
 			     GS_PLUGIN_ERROR,
 			     GS_PLUGIN_ERROR_FAILED,
-			     "SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
+			     "SQL error: %s", sqlite3_errmsg (priv->db));
 		return FALSE;
 	}
 	return TRUE;
 }
 
-static gint
-get_review_stats_sqlite_cb (void *data,
-			    gint argc,
-			    gchar **argv,
-			    gchar **col_name)
-{
-	Histogram *histogram = (Histogram *) data;
-	histogram->one_star_count = g_ascii_strtoull (argv[0], NULL, 10);
-	histogram->two_star_count = g_ascii_strtoull (argv[1], NULL, 10);
-	histogram->three_star_count = g_ascii_strtoull (argv[2], NULL, 10);
-	histogram->four_star_count = g_ascii_strtoull (argv[3], NULL, 10);
-	histogram->five_star_count = g_ascii_strtoull (argv[4], NULL, 10);
-	return 0;
-}
-
 static gboolean
 get_review_stats (GsPlugin *plugin,
 		  const gchar *package_name,
@@ -193,26 +196,28 @@ get_review_stats (GsPlugin *plugin,
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
 	Histogram histogram = { 0, 0, 0, 0, 0 };
-	gchar *error_msg = NULL;
 	gint result;
-	g_autofree gchar *statement = NULL;
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&priv->stats_mutex);
 
 	/* Get histogram from the database */
-	statement = g_strdup_printf ("SELECT one_star_count, two_star_count, three_star_count, four_star_count, five_star_count FROM review_stats "
-				     "WHERE package_name = '%s'", package_name);
-	result = sqlite3_exec (priv->db,
-			       statement,
-			       get_review_stats_sqlite_cb,
-			       &histogram,
-			       &error_msg);
-	if (result != SQLITE_OK) {
+	sqlite3_reset (priv->stats_stmt);
+	sqlite3_bind_text (priv->stats_stmt, 1, package_name, -1, SQLITE_STATIC);
+	result = sqlite3_step (priv->stats_stmt);
+	if (result == SQLITE_ROW) {
+		histogram.one_star_count = (guint64) sqlite3_column_int64 (priv->stats_stmt, 0);
+		histogram.two_star_count = (guint64) sqlite3_column_int64 (priv->stats_stmt, 1);
+		histogram.three_star_count = (guint64) sqlite3_column_int64 (priv->stats_stmt, 2);
+		histogram.four_star_count = (guint64) sqlite3_column_int64 (priv->stats_stmt, 3);
+		histogram.five_star_count = (guint64) sqlite3_column_int64 (priv->stats_stmt, 4);
+	} else if (result != SQLITE_DONE) {
 		g_set_error (error,
 			     GS_PLUGIN_ERROR,
 			     GS_PLUGIN_ERROR_FAILED,
-			     "SQL error: %s", error_msg);
-		sqlite3_free (error_msg);
+			     "SQL error: %s", sqlite3_errmsg (priv->db));
+		sqlite3_reset (priv->stats_stmt);
 		return FALSE;
 	}
+	sqlite3_reset (priv->stats_stmt);
 
 	*rating = gs_utils_get_wilson_rating (histogram.one_star_count,
 					      histogram.two_star_count,
@@ -279,12 +284,34 @@ parse_review_entry (JsonNode *node, const gchar **package_name, Histogram *histo
 static gboolean
 parse_review_entries (GsPlugin *plugin, JsonParser *parser, GError **error)
 {
+	GsPluginData *priv = gs_plugin_get_data (plugin);
 	JsonArray *array;
+	gint result;
 	guint i;
+	sqlite3_stmt *stmt = NULL;
 
 	if (!JSON_NODE_HOLDS_ARRAY (json_parser_get_root (parser)))
 		return FALSE;
 	array = json_node_get_array (json_parser_get_root (parser));
+
+	/* write everything in one transaction */
+	result = sqlite3_exec (priv->db, "BEGIN TRANSACTION;", NULL, NULL, NULL);
+	if (result == SQLITE_OK) {
+		result = sqlite3_prepare_v2 (priv->db,
+					     "INSERT OR REPLACE INTO review_stats (package_name, "
+					     "one_star_count, two_star_count, three_star_count, "
+					     "four_star_count, five_star_count) "
+					     "VALUES (?1, ?2, ?3, ?4, ?5, ?6);",
+					     -1, &stmt, NULL);
+	}
+	if (result != SQLITE_OK) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_FAILED,
+			     "SQL error: %s", sqlite3_errmsg (priv->db));
+		sqlite3_exec (priv->db, "ROLLBACK;", NULL, NULL, NULL);
+		return FALSE;
+	}
 	for (i = 0; i < json_array_get_length (array); i++) {
 		const gchar *package_name;
 		Histogram histogram;
@@ -294,8 +321,22 @@ parse_review_entries (GsPlugin *plugin, JsonParser *parser, GError **error)
 			continue;
 
 		/* ...write into the database (abort everything if can't write) */
-		if (!set_package_stats (plugin, package_name, &histogram, error))
+		if (!set_package_stats (plugin, stmt, package_name, &histogram, error)) {
+			sqlite3_finalize (stmt);
+			sqlite3_exec (priv->db, "ROLLBACK;", NULL, NULL, NULL);
 			return FALSE;
+		}
+	}
+	sqlite3_finalize (stmt);
+
+	result = sqlite3_exec (priv->db, "COMMIT;", NULL, NULL, NULL);
+	if (result != SQLITE_OK) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_FAILED,
+			     "SQL error: %s", sqlite3_errmsg (priv->db));
+		sqlite3_exec (priv->db, "ROLLBACK;", NULL, NULL, NULL);
+		return FALSE;
 	}
 
 	return TRUE;
@@ -348,11 +389,12 @@ send_review_request (GsPlugin *plugin,
 		     JsonParser **result,
 		     GCancellable *cancellable, GError **error)
 {
+	GsPluginData *priv = gs_plugin_get_data (plugin);
 	g_autofree gchar *uri = NULL;
 	g_autoptr(SoupMessage) msg = NULL;
 
 	uri = g_strdup_printf ("%s%s",
-			       UBUNTU_REVIEWS_SERVER, path);
+			       priv->review_server, path);
 	msg = soup_message_new (method, uri);
 
 	if (request != NULL) {
@@ -436,16 +478,15 @@ download_review_stats (GsPlugin *plugin, GCancellable *cancellable, GError **err
 }
 
 static gboolean
-load_database (GsPlugin *plugin, GCancellable *cancellable, GError **error)
+open_database (GsPlugin *plugin,
+	       gboolean *rebuild_ratings,
+	       gint64 *stats_mtime,
+	       GError **error)
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
 	const gchar *statement;
-	gboolean rebuild_ratings = FALSE;
 	char *error_msg = NULL;
 	gint result;
-	gint64 stats_mtime = 0;
-	gint64 now;
-	g_autoptr(GError) error_local = NULL;
 
 	g_debug ("trying to open database '%s'", priv->db_path);
 	if (!gs_mkdir_parent (priv->db_path, error))
@@ -477,7 +518,7 @@ load_database (GsPlugin *plugin, GCancellable *cancellable, GError **error)
 			    "four_star_count INTEGER DEFAULT 0,"
 			    "five_star_count INTEGER DEFAULT 0);";
 		sqlite3_exec (priv->db, statement, NULL, NULL, NULL);
-		rebuild_ratings = TRUE;
+		*rebuild_ratings = TRUE;
 	}
 
 	/* Create a table to store local reviews */
@@ -494,13 +535,13 @@ load_database (GsPlugin *plugin, GCancellable *cancellable, GError **error)
 			    "summary TEXT,"
 			    "text TEXT);";
 		sqlite3_exec (priv->db, statement, NULL, NULL, NULL);
-		rebuild_ratings = TRUE;
+		*rebuild_ratings = TRUE;
 	}
 
 	/* Create a table to store timestamps */
 	result = sqlite3_exec (priv->db,
 			       "SELECT value FROM timestamps WHERE key = 'stats_mtime' LIMIT 1",
-			       get_timestamp_sqlite_cb, &stats_mtime,
+			       get_timestamp_sqlite_cb, stats_mtime,
 			       &error_msg);
 	if (result != SQLITE_OK) {
 		g_debug ("creating table to repair: %s", error_msg);
@@ -515,6 +556,33 @@ load_database (GsPlugin *plugin, GCancellable *cancellable, GError **error)
 			return FALSE;
 	}
 
+	/* Lookups use the primary key index on package_name */
+	result = sqlite3_prepare_v2 (priv->db,
+				     "SELECT one_star_count, two_star_count, three_star_count, "
+				     "four_star_count, five_star_count FROM review_stats "
+				     "WHERE package_name = ?1;",
+				     -1, &priv->stats_stmt, NULL);
+	if (result != SQLITE_OK) {
+		g_set_error (error,
+			     GS_PLUGIN_ERROR,
+			     GS_PLUGIN_ERROR_FAILED,
+			     "SQL error: %s", sqlite3_errmsg (priv->db));
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean
+load_database (GsPlugin *plugin, GCancellable *cancellable, GError **error)
+{
+	gboolean rebuild_ratings = FALSE;
+	gint64 stats_mtime = 0;
+	gint64 now;
+	g_autoptr(GError) error_local = NULL;
+
+	if (!open_database (plugin, &rebuild_ratings, &stats_mtime, error))
+		return FALSE;
+
 	/* Download data if we have none or it is out of date */
 	now = g_get_real_time () / G_USEC_PER_SEC;
 	if (stats_mtime == 0 || rebuild_ratings) {
@@ -600,7 +668,7 @@ parse_review (AsReview *review, const gchar *our_username, JsonNode *node)
 }
 
 static gboolean
-parse_reviews (GsPlugin *plugin, JsonParser *parser, GsApp *app, GCancellable *cancellable, GError **error)
+parse_reviews (GsPlugin *plugin, JsonParser *parser, GPtrArray *reviews, GCancellable *cancellable, GError **error)
 {
 	GsAuth *auth;
 	JsonArray *array;
@@ -620,14 +688,14 @@ parse_reviews (GsPlugin *plugin, JsonParser *parser, GsApp *app, GCancellable *c
 		/* Read in from JSON... (skip bad entries) */
 		review = as_review_new ();
 		if (parse_review (review, consumer_key, json_array_get_element (array, i)))
-			gs_app_add_review (app, review);
+			g_ptr_array_add (reviews, g_object_ref (review));
 	}
 
 	return TRUE;
 }
 
 static gboolean
-download_reviews (GsPlugin *plugin, GsApp *app,
+download_reviews (GsPlugin *plugin, GPtrArray *reviews,
 		  const gchar *package_name, guint page_number,
 		  GCancellable *cancellable, GError **error)
 {
@@ -655,7 +723,7 @@ download_reviews (GsPlugin *plugin, GsApp *app,
 	}
 
 	/* Extract the stats from the data */
-	return parse_reviews (plugin, result, app, cancellable, error);
+	return parse_reviews (plugin, result, reviews, cancellable, error);
 }
 
 static gboolean
@@ -709,8 +777,11 @@ refine_rating (GsPlugin *plugin, GsApp *app, GCancellable *cancellable, GError *
 static gboolean
 refine_reviews (GsPlugin *plugin, GsApp *app, GCancellable *cancellable, GError **error)
 {
+	GsReviewStore *store = gs_plugin_get_review_store (plugin);
 	GPtrArray *sources;
+	gboolean downloaded = FALSE;
 	guint i, j;
+	g_autoptr(GError) error_local = NULL;
 
 	/* Skip if already has reviews */
 	if (gs_app_get_reviews (app)->len > 0)
@@ -719,17 +790,33 @@ refine_reviews (GsPlugin *plugin, GsApp *app, GCancellable *cancellable, GError
 	sources = gs_app_get_sources (app);
 	for (i = 0; i < sources->len; i++) {
 		const gchar *package_name;
+		g_autofree gchar *key = NULL;
+		g_autoptr(GPtrArray) reviews = NULL;
 
+		/* Use the stored reviews if they are recent enough; keyed
+		 * by package as the same ID may have reviews from ODRS */
 		package_name = g_ptr_array_index (sources, i);
-		for (j = 0; j < N_PAGES; j++) {
-			gboolean ret;
-
-			ret = download_reviews (plugin, app, package_name, j, cancellable, error);
-			if (!ret)
-				return FALSE;
+		key = g_strdup_printf ("ubuntu-reviews::%s", package_name);
+		reviews = gs_review_store_get_reviews (store, key, REVIEWS_AGE_MAX);
+		if (reviews == NULL) {
+			reviews = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+			for (j = 0; j < N_PAGES; j++) {
+				gboolean ret;
+
+				ret = download_reviews (plugin, reviews, package_name, j, cancellable, error);
+				if (!ret)
+					return FALSE;
+			}
+			gs_review_store_add_reviews (store, key, reviews);
+			downloaded = TRUE;
 		}
+		for (j = 0; j < reviews->len; j++)
+			gs_app_add_review (app, g_ptr_array_index (reviews, j));
 	}
 
+	if (downloaded && !gs_review_store_save (store, &error_local))
+		g_warning ("%s", error_local->message);
+
 	return TRUE;
 }
 
@@ -775,11 +862,13 @@ gs_plugin_review_submit (GsPlugin *plugin,
 {
 	GsPluginData *priv = gs_plugin_get_data (plugin);
 	GsAuth *auth;
+	GsReviewStore *store = gs_plugin_get_review_store (plugin);
 	const gchar *consumer_key = NULL;
 	const gchar *language;
 	gint rating;
 	gint n_stars;
 	g_autofree gchar *architecture = NULL;
+	g_autofree gchar *key = NULL;
 	g_autoptr(JsonBuilder) request = NULL;
 	guint status_code;
 	g_autoptr(JsonParser) result = NULL;
@@ -836,7 +925,10 @@ gs_plugin_review_submit (GsPlugin *plugin,
 		consumer_key = gs_auth_get_metadata_item (auth, "consumer-key");
 	parse_review (review, consumer_key, json_parser_get_root (result));
 
-	return TRUE;
+	/* Download the reviews again next time */
+	key = g_strdup_printf ("ubuntu-reviews::%s", gs_app_get_source_default (app));
+	gs_review_store_invalidate (store, key);
+	return gs_review_store_save (store, error);
 }
 
 gboolean
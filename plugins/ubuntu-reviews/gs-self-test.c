@@ -0,0 +1,321 @@
+/* -*- Mode: C; tab-width: 8; indent-tabs-mode: t; c-basic-offset: 8 -*-
+ *
+ * Copyright (C) 2017 Canonical Ltd.
+ *
+ * Licensed under the GNU General Public License Version 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+#include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
+
+#include "gnome-software-private.h"
+
+#include "gs-test.h"
+
+#define GS_SELF_TEST_N_PACKAGES		20000
+
+/* a mock reviews server running in its own thread */
+typedef struct {
+	GMutex		 mutex;
+	GCond		 cond;
+	GMainLoop	*loop;
+	SoupServer	*server;
+	gchar		*uri;
+	gchar		*stats;
+	gint		 stats_requests;
+	GsPluginLoader	*plugin_loader;
+} GsUbuntuReviewsTestServer;
+
+static void
+gs_ubuntu_reviews_test_server_cb (SoupServer *server,
+				  SoupMessage *msg,
+				  const char *path,
+				  GHashTable *query,
+				  SoupClientContext *client,
+				  gpointer user_data)
+{
+	GsUbuntuReviewsTestServer *helper = (GsUbuntuReviewsTestServer *) user_data;
+
+	if (g_strcmp0 (path, "/api/1.0/review-stats/any/any/") != 0) {
+		soup_message_set_status (msg, SOUP_STATUS_NOT_FOUND);
+		return;
+	}
+	g_atomic_int_inc (&helper->stats_requests);
+	soup_message_set_status (msg, SOUP_STATUS_OK);
+	soup_message_set_response (msg, "application/json",
+				   SOUP_MEMORY_STATIC,
+				   helper->stats, strlen (helper->stats));
+}
+
+static gpointer
+gs_ubuntu_reviews_test_server_thread (gpointer user_data)
+{
+	GsUbuntuReviewsTestServer *helper = (GsUbuntuReviewsTestServer *) user_data;
+	GSList *uris;
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GMainContext) context = g_main_context_new ();
+
+	g_main_context_push_thread_default (context);
+	helper->server = soup_server_new (SOUP_SERVER_SERVER_HEADER, "gs-self-test", NULL);
+	soup_server_add_handler (helper->server, NULL,
+				 gs_ubuntu_reviews_test_server_cb,
+				 helper, NULL);
+	ret = soup_server_listen_local (helper->server, 0,
+					SOUP_SERVER_LISTEN_IPV4_ONLY,
+					&error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	uris = soup_server_get_uris (helper->server);
+	helper->loop = g_main_loop_new (context, FALSE);
+
+	/* server is ready */
+	g_mutex_lock (&helper->mutex);
+	helper->uri = soup_uri_to_string (uris->data, FALSE);
+	g_cond_signal (&helper->cond);
+	g_mutex_unlock (&helper->mutex);
+	g_slist_free_full (uris, (GDestroyNotify) soup_uri_free);
+
+	g_main_loop_run (helper->loop);
+	g_clear_object (&helper->server);
+	g_main_context_pop_thread_default (context);
+	return NULL;
+}
+
+static gboolean
+gs_ubuntu_reviews_test_server_quit_cb (gpointer user_data)
+{
+	g_main_loop_quit ((GMainLoop *) user_data);
+	return G_SOURCE_REMOVE;
+}
+
+/* a dump the size of the real one, with a name that needs quoting */
+static gchar *
+gs_ubuntu_reviews_test_build_stats (void)
+{
+	g_autoptr(JsonBuilder) builder = json_builder_new ();
+	g_autoptr(JsonGenerator) generator = json_generator_new ();
+	g_autoptr(JsonNode) root = NULL;
+
+	json_builder_begin_array (builder);
+	for (guint i = 0; i < GS_SELF_TEST_N_PACKAGES; i++) {
+		g_autofree gchar *name = g_strdup_printf ("package%u", i);
+		json_builder_begin_object (builder);
+		json_builder_set_member_name (builder, "package_name");
+		json_builder_add_string_value (builder, name);
+		json_builder_set_member_name (builder, "histogram");
+		json_builder_add_string_value (builder, "[1, 2, 3, 4, 5]");
+		json_builder_end_object (builder);
+	}
+	json_builder_begin_object (builder);
+	json_builder_set_member_name (builder, "package_name");
+	json_builder_add_string_value (builder, "it's-quoted");
+	json_builder_set_member_name (builder, "histogram");
+	json_builder_add_string_value (builder, "[0, 0, 0, 10, 400]");
+	json_builder_end_object (builder);
+	json_builder_end_array (builder);
+	root = json_builder_get_root (builder);
+	json_generator_set_root (generator, root);
+	return json_generator_to_data (generator, NULL);
+}
+
+static GsApp *
+gs_ubuntu_reviews_test_find_app (GsAppList *list, const gchar *id)
+{
+	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+		if (g_strcmp0 (gs_app_get_id (app), id) == 0)
+			return app;
+	}
+	return NULL;
+}
+
+static void
+gs_plugins_ubuntu_reviews_import_func (gconstpointer user_data)
+{
+	GsUbuntuReviewsTestServer *helper = (GsUbuntuReviewsTestServer *) user_data;
+	GsPluginLoader *plugin_loader = helper->plugin_loader;
+	GArray *review_ratings;
+	GsApp *app;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GsAppList) list = NULL;
+	g_autoptr(GTimer) timer = NULL;
+
+	/* not running on Ubuntu, abort */
+	if (!gs_plugin_loader_get_enabled (plugin_loader, "ubuntu-reviews")) {
+		g_test_skip ("not enabled");
+		return;
+	}
+
+	/* the first lookup downloads and imports all the stats */
+	timer = g_timer_new ();
+	list = gs_plugin_loader_search (plugin_loader,
+					"example", 0,
+					NULL, NULL,
+					GS_PLUGIN_REFINE_FLAGS_REQUIRE_RATING |
+					GS_PLUGIN_REFINE_FLAGS_REQUIRE_REVIEW_RATINGS,
+					GS_PLUGIN_FAILURE_FLAGS_FATAL_ANY,
+					NULL,
+					&error);
+	gs_test_flush_main_context ();
+	g_assert_no_error (error);
+	g_assert (list != NULL);
+	g_test_message ("imported %u packages in %.0fms",
+			GS_SELF_TEST_N_PACKAGES + 1,
+			g_timer_elapsed (timer, NULL) * 1000);
+	g_assert_cmpint (g_atomic_int_get (&helper->stats_requests), ==, 1);
+	g_assert_cmpint (gs_app_list_length (list), ==, 3);
+
+	/* an ordinary package */
+	app = gs_ubuntu_reviews_test_find_app (list, "org.example.Plain");
+	g_assert (app != NULL);
+	review_ratings = gs_app_get_review_ratings (app);
+	g_assert (review_ratings != NULL);
+	g_assert_cmpint (g_array_index (review_ratings, gint, 5), ==, 5);
+
+	/* the name was bound, not quoted into the SQL */
+	app = gs_ubuntu_reviews_test_find_app (list, "org.example.Quoted");
+	g_assert (app != NULL);
+	review_ratings = gs_app_get_review_ratings (app);
+	g_assert (review_ratings != NULL);
+	g_assert_cmpint (g_array_index (review_ratings, gint, 4), ==, 10);
+	g_assert_cmpint (g_array_index (review_ratings, gint, 5), ==, 400);
+	g_assert_cmpint (gs_app_get_rating (app), >, 90);
+
+	/* not in the stats */
+	app = gs_ubuntu_reviews_test_find_app (list, "org.example.Missing");
+	g_assert (app != NULL);
+	g_assert_cmpint (gs_app_get_rating (app), ==, -1);
+}
+
+int
+main (int argc, char **argv)
+{
+	GsUbuntuReviewsTestServer helper;
+	GThread *thread;
+	gboolean ret;
+	gint rc;
+	g_autofree gchar *os_release = NULL;
+	g_autofree gchar *server = NULL;
+	g_autofree gchar *tmp_root = NULL;
+	g_autofree gchar *xml = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GsPluginLoader) plugin_loader = NULL;
+	const gchar *whitelist[] = {
+		"appstream",
+		"ubuntu-reviews",
+		NULL
+	};
+
+	g_test_init (&argc, &argv, NULL);
+	g_setenv ("G_MESSAGES_DEBUG", "all", TRUE);
+
+	/* keep the database away from the real one, and pretend to be Ubuntu */
+	tmp_root = g_dir_make_tmp ("gnome-software-ubuntu-reviews-test-XXXXXX", NULL);
+	g_assert (tmp_root != NULL);
+	g_setenv ("XDG_DATA_HOME", tmp_root, TRUE);
+	g_setenv ("XDG_CACHE_HOME", tmp_root, TRUE);
+	os_release = g_build_filename (tmp_root, "os-release", NULL);
+	ret = g_file_set_contents (os_release,
+				   "NAME=\"Ubuntu\"\n"
+				   "ID=ubuntu\n"
+				   "UBUNTU_CODENAME=test\n",
+				   -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_setenv ("GS_SELF_TEST_OS_RELEASE_FILENAME", os_release, TRUE);
+
+	/* the apps to get ratings for, by package name */
+	xml = g_strdup ("<?xml version=\"1.0\"?>\n"
+		"<components version=\"0.9\">\n"
+		"  <component type=\"desktop\">\n"
+		"    <id>org.example.Plain</id>\n"
+		"    <name>Plain</name>\n"
+		"    <summary>An example application</summary>\n"
+		"    <pkgname>package100</pkgname>\n"
+		"  </component>\n"
+		"  <component type=\"desktop\">\n"
+		"    <id>org.example.Quoted</id>\n"
+		"    <name>Quoted</name>\n"
+		"    <summary>An example application</summary>\n"
+		"    <pkgname>it's-quoted</pkgname>\n"
+		"  </component>\n"
+		"  <component type=\"desktop\">\n"
+		"    <id>org.example.Missing</id>\n"
+		"    <name>Missing</name>\n"
+		"    <summary>An example application</summary>\n"
+		"    <pkgname>missing</pkgname>\n"
+		"  </component>\n"
+		"</components>\n");
+	g_setenv ("GS_SELF_TEST_APPSTREAM_XML", xml, TRUE);
+
+	/* only critical and error are fatal */
+	g_log_set_fatal_mask (NULL, G_LOG_LEVEL_ERROR | G_LOG_LEVEL_CRITICAL);
+
+	/* start the mock server before the plugin reads the address */
+	memset (&helper, 0, sizeof (helper));
+	g_mutex_init (&helper.mutex);
+	g_cond_init (&helper.cond);
+	helper.stats = gs_ubuntu_reviews_test_build_stats ();
+	thread = g_thread_new ("gs-ubuntu-reviews-test-server",
+			       gs_ubuntu_reviews_test_server_thread,
+			       &helper);
+	g_mutex_lock (&helper.mutex);
+	while (helper.uri == NULL)
+		g_cond_wait (&helper.cond, &helper.mutex);
+	g_mutex_unlock (&helper.mutex);
+	server = g_strndup (helper.uri, strlen (helper.uri) - 1);
+	g_setenv ("GS_SELF_TEST_UBUNTU_REVIEWS_SERVER", server, TRUE);
+
+	/* we can only load this once per process */
+	plugin_loader = gs_plugin_loader_new ();
+	gs_plugin_loader_add_location (plugin_loader, LOCALPLUGINDIR);
+	gs_plugin_loader_add_location (plugin_loader, LOCALPLUGINDIR_CORE);
+	ret = gs_plugin_loader_setup (plugin_loader,
+				      (gchar**) whitelist,
+				      NULL,
+				      GS_PLUGIN_FAILURE_FLAGS_NONE,
+				      NULL,
+				      &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	helper.plugin_loader = plugin_loader;
+
+	/* plugin tests go here */
+	g_test_add_data_func ("/gnome-software/plugins/ubuntu-reviews/import",
+			      &helper,
+			      gs_plugins_ubuntu_reviews_import_func);
+	rc = g_test_run ();
+	g_clear_object (&plugin_loader);
+
+	/* stop the mock server */
+	g_main_context_invoke (g_main_loop_get_context (helper.loop),
+			       gs_ubuntu_reviews_test_server_quit_cb,
+			       helper.loop);
+	g_thread_join (thread);
+	g_main_loop_unref (helper.loop);
+	g_free (helper.uri);
+	g_free (helper.stats);
+	g_mutex_clear (&helper.mutex);
+	g_cond_clear (&helper.cond);
+	return rc;
+}
+
+/* vim: set noexpandtab: */
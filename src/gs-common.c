@@ -646,4 +646,56 @@ gs_utils_list_has_app_fuzzy (GsAppList *list, GsApp *app)
 	return FALSE;
 }
 
+/**
+ * gs_utils_get_download_estimate:
+ * @app: A #GsApp
+ *
+ * Describes how fast the app is being downloaded and how long is left,
+ * using the estimate the plugin doing the download sets on the app.
+ *
+ * Returns: a string like "1.2 MB/s, 3 minutes remaining", or %NULL if
+ * there is no estimate
+ */
+gchar *
+gs_utils_get_download_estimate (GsApp *app)
+{
+	const gchar *tmp;
+	guint64 rate;
+	guint eta = 0;
+	g_autofree gchar *rate_str = NULL;
+	g_autofree gchar *eta_str = NULL;
+
+	tmp = gs_app_get_metadata_item (app, "GnomeSoftware::DownloadRate");
+	if (tmp == NULL)
+		return NULL;
+	rate = g_ascii_strtoull (tmp, NULL, 10);
+	if (rate == 0)
+		return NULL;
+	rate_str = g_format_size (rate);
+	tmp = gs_app_get_metadata_item (app, "GnomeSoftware::DownloadEta");
+	if (tmp != NULL)
+		eta = (guint) g_ascii_strtoull (tmp, NULL, 10);
+
+	if (eta == 0) {
+		/* TRANSLATORS: the download rate, where %s is e.g. "1.2 MB" */
+		return g_strdup_printf (_("%s/s"), rate_str);
+	}
+	if (eta < 60) {
+		/* TRANSLATORS: the time left for the download */
+		eta_str = g_strdup_printf (ngettext ("%u second remaining",
+						     "%u seconds remaining", eta), eta);
+	} else if (eta < 60 * 60) {
+		/* TRANSLATORS: the time left for the download */
+		eta_str = g_strdup_printf (ngettext ("%u minute remaining",
+						     "%u minutes remaining", eta / 60), eta / 60);
+	} else {
+		/* TRANSLATORS: the time left for the download */
+		eta_str = g_strdup_printf (ngettext ("%u hour remaining",
+						     "%u hours remaining", eta / 3600), eta / 3600);
+	}
+	/* TRANSLATORS: the first %s is the download rate, e.g. "1.2 MB",
+	 * and the second is the time left, e.g. "3 minutes remaining" */
+	return g_strdup_printf (_("%s/s, %s"), rate_str, eta_str);
+}
+
 /* vim: set noexpandtab: */
@@ -60,6 +60,7 @@ gchar		*gs_utils_build_unique_id_kind	(AsAppKind	 kind,
 						 const gchar	*id);
 gboolean	 gs_utils_list_has_app_fuzzy	(GsAppList	*list,
 						 GsApp		*app);
+gchar		*gs_utils_get_download_estimate	(GsApp		*app);
 
 G_END_DECLS
 
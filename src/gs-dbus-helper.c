@@ -21,6 +21,8 @@
 
 #include "config.h"
 
+#include <stdlib.h>
+#include <string.h>
 #include <gio/gdesktopappinfo.h>
 #include <gio/gio.h>
 #include <glib/gi18n.h>
@@ -43,6 +45,13 @@ struct _GsDbusHelper {
 	GDBusInterfaceSkeleton	*modify2_interface;
 	PkTask			*task;
 	guint			 dbus_own_name_id;
+	PkControl		*control;
+	PkClient		*index_client;
+	GCancellable		*index_cancellable;
+	gboolean		 index_wanted;
+	GHashTable		*installed_names;	/* name */
+	GArray			*installed_files;	/* GsDbusHelperFile, sorted */
+	GStringChunk		*installed_chunk;
 };
 
 G_DEFINE_TYPE (GsDbusHelper, gs_dbus_helper, G_TYPE_OBJECT)
@@ -56,6 +65,7 @@ typedef struct {
 	gboolean		 show_finished;
 	gboolean		 show_progress;
 	gboolean		 show_warning;
+	gchar			**package_names;
 } GsDbusHelperTask;
 
 static void
@@ -64,6 +74,7 @@ gs_dbus_helper_task_free (GsDbusHelperTask *dtask)
 	if (dtask->dbus_helper != NULL)
 		g_object_unref (dtask->dbus_helper);
 
+	g_strfreev (dtask->package_names);
 	g_free (dtask);
 }
 
@@ -107,6 +118,277 @@ gs_dbus_helper_progress_cb (PkProgress *progress, PkProgressType type, gpointer
 {
 }
 
+/*
+ * The installed packages and the files they own are kept in memory so that
+ * the Query methods can be answered without a PackageKit transaction.
+ *
+ * The index is only built once something asks a question, and is thrown
+ * away and rebuilt when PackageKit says the installed packages changed.
+ * Until it is ready, queries are forwarded to PackageKit as before.
+ *
+ * There can be hundreds of thousands of installed files, so each path is
+ * stored once in a string chunk and looked up in a sorted array rather
+ * than in a hash table.
+ */
+
+typedef struct {
+	const gchar		*filename;
+	const gchar		*name;
+} GsDbusHelperFile;
+
+typedef struct {
+	GsDbusHelper		*dbus_helper;
+	GCancellable		*cancellable;
+	GArray			*files;
+	GStringChunk		*chunk;
+} GsDbusHelperIndexLoad;
+
+static void
+gs_dbus_helper_index_load_free (GsDbusHelperIndexLoad *load)
+{
+	g_object_unref (load->cancellable);
+	if (load->files != NULL)
+		g_array_unref (load->files);
+	if (load->chunk != NULL)
+		g_string_chunk_free (load->chunk);
+	g_free (load);
+}
+
+static void
+gs_dbus_helper_index_clear (GsDbusHelper *dbus_helper)
+{
+	g_clear_pointer (&dbus_helper->installed_names, g_hash_table_unref);
+	g_clear_pointer (&dbus_helper->installed_files, g_array_unref);
+	g_clear_pointer (&dbus_helper->installed_chunk, g_string_chunk_free);
+}
+
+static gint
+gs_dbus_helper_file_cmp (gconstpointer a, gconstpointer b)
+{
+	const GsDbusHelperFile *file_a = a;
+	const GsDbusHelperFile *file_b = b;
+	return strcmp (file_a->filename, file_b->filename);
+}
+
+/* returns the name of the installed package owning @filename, or NULL */
+static const gchar *
+gs_dbus_helper_index_lookup_file (GsDbusHelper *dbus_helper, const gchar *filename)
+{
+	GsDbusHelperFile key = { filename, NULL };
+	GsDbusHelperFile *file;
+
+	if (dbus_helper->installed_files == NULL)
+		return NULL;
+	file = bsearch (&key,
+			dbus_helper->installed_files->data,
+			dbus_helper->installed_files->len,
+			sizeof (GsDbusHelperFile),
+			gs_dbus_helper_file_cmp);
+	return file != NULL ? file->name : NULL;
+}
+
+static void
+gs_dbus_helper_index_get_files_cb (GObject *source, GAsyncResult *res, gpointer data)
+{
+	GsDbusHelperIndexLoad *load = (GsDbusHelperIndexLoad *) data;
+	GsDbusHelper *dbus_helper;
+	PkClient *client = PK_CLIENT (source);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkError) error_code = NULL;
+	g_autoptr(PkResults) results = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+
+	/* the helper has gone away, or a newer load replaced this one */
+	results = pk_client_generic_finish (client, res, &error);
+	if (g_cancellable_is_cancelled (load->cancellable)) {
+		gs_dbus_helper_index_load_free (load);
+		return;
+	}
+
+	/* the package names are still worth having on their own */
+	if (results == NULL) {
+		g_warning ("failed to index installed files: %s", error->message);
+		gs_dbus_helper_index_load_free (load);
+		return;
+	}
+	error_code = pk_results_get_error_code (results);
+	if (error_code != NULL) {
+		g_warning ("failed to index installed files: %s",
+			   pk_error_get_details (error_code));
+		gs_dbus_helper_index_load_free (load);
+		return;
+	}
+
+	array = pk_results_get_files_array (results);
+	for (guint i = 0; i < array->len; i++) {
+		PkFiles *item = g_ptr_array_index (array, i);
+		gchar **files = pk_files_get_files (item);
+		GsDbusHelperFile file;
+		g_auto(GStrv) split = NULL;
+
+		split = pk_package_id_split (pk_files_get_package_id (item));
+		if (split == NULL || files == NULL)
+			continue;
+		file.name = g_string_chunk_insert_const (load->chunk, split[PK_PACKAGE_ID_NAME]);
+		for (guint j = 0; files[j] != NULL; j++) {
+			file.filename = g_string_chunk_insert (load->chunk, files[j]);
+			g_array_append_val (load->files, file);
+		}
+	}
+	g_array_sort (load->files, gs_dbus_helper_file_cmp);
+
+	dbus_helper = load->dbus_helper;
+	g_clear_pointer (&dbus_helper->installed_files, g_array_unref);
+	g_clear_pointer (&dbus_helper->installed_chunk, g_string_chunk_free);
+	dbus_helper->installed_files = g_steal_pointer (&load->files);
+	dbus_helper->installed_chunk = g_steal_pointer (&load->chunk);
+	g_debug ("indexed %u installed files", dbus_helper->installed_files->len);
+	gs_dbus_helper_index_load_free (load);
+}
+
+static void
+gs_dbus_helper_index_get_packages_cb (GObject *source, GAsyncResult *res, gpointer data)
+{
+	GsDbusHelperIndexLoad *load = (GsDbusHelperIndexLoad *) data;
+	GsDbusHelper *dbus_helper;
+	PkClient *client = PK_CLIENT (source);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(PkError) error_code = NULL;
+	g_autoptr(PkResults) results = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+	g_auto(GStrv) package_ids = NULL;
+
+	/* the helper has gone away, or a newer load replaced this one */
+	results = pk_client_generic_finish (client, res, &error);
+	if (g_cancellable_is_cancelled (load->cancellable)) {
+		gs_dbus_helper_index_load_free (load);
+		return;
+	}
+	if (results == NULL) {
+		g_warning ("failed to index installed packages: %s", error->message);
+		gs_dbus_helper_index_load_free (load);
+		return;
+	}
+	error_code = pk_results_get_error_code (results);
+	if (error_code != NULL) {
+		g_warning ("failed to index installed packages: %s",
+			   pk_error_get_details (error_code));
+		gs_dbus_helper_index_load_free (load);
+		return;
+	}
+
+	/* the names can be used while the files are still being indexed */
+	dbus_helper = load->dbus_helper;
+	array = pk_results_get_package_array (results);
+	gs_dbus_helper_index_clear (dbus_helper);
+	dbus_helper->installed_names = g_hash_table_new_full (g_str_hash, g_str_equal,
+							      g_free, NULL);
+	package_ids = g_new0 (gchar *, array->len + 1);
+	for (guint i = 0; i < array->len; i++) {
+		PkPackage *package = g_ptr_array_index (array, i);
+		g_hash_table_add (dbus_helper->installed_names,
+				  g_strdup (pk_package_get_name (package)));
+		package_ids[i] = g_strdup (pk_package_get_id (package));
+	}
+	g_debug ("indexed %u installed packages",
+		 g_hash_table_size (dbus_helper->installed_names));
+	if (array->len == 0) {
+		gs_dbus_helper_index_load_free (load);
+		return;
+	}
+
+	/* all the files in one transaction */
+	load->files = g_array_new (FALSE, FALSE, sizeof (GsDbusHelperFile));
+	load->chunk = g_string_chunk_new (64 * 1024);
+	pk_client_get_files_async (client,
+				   package_ids,
+				   load->cancellable,
+				   gs_dbus_helper_progress_cb, NULL,
+				   gs_dbus_helper_index_get_files_cb, load);
+}
+
+static void
+gs_dbus_helper_index_refresh (GsDbusHelper *dbus_helper)
+{
+	GsDbusHelperIndexLoad *load;
+
+	/* a load in progress may already be out of date */
+	if (dbus_helper->index_cancellable != NULL) {
+		g_cancellable_cancel (dbus_helper->index_cancellable);
+		g_object_unref (dbus_helper->index_cancellable);
+	}
+	dbus_helper->index_cancellable = g_cancellable_new ();
+
+	load = g_new0 (GsDbusHelperIndexLoad, 1);
+	load->dbus_helper = dbus_helper;
+	load->cancellable = g_object_ref (dbus_helper->index_cancellable);
+	pk_client_get_packages_async (dbus_helper->index_client,
+				      pk_bitfield_value (PK_FILTER_ENUM_INSTALLED),
+				      load->cancellable,
+				      gs_dbus_helper_progress_cb, NULL,
+				      gs_dbus_helper_index_get_packages_cb, load);
+}
+
+static void
+gs_dbus_helper_index_ensure (GsDbusHelper *dbus_helper)
+{
+	if (dbus_helper->index_wanted)
+		return;
+	dbus_helper->index_wanted = TRUE;
+	gs_dbus_helper_index_refresh (dbus_helper);
+}
+
+static void
+gs_dbus_helper_updates_changed_cb (PkControl *control, GsDbusHelper *dbus_helper)
+{
+	/* the installed packages may have changed */
+	gs_dbus_helper_index_clear (dbus_helper);
+	if (dbus_helper->index_wanted)
+		gs_dbus_helper_index_refresh (dbus_helper);
+}
+
+/* the index only has names, so package IDs have to be resolved */
+static gboolean
+gs_dbus_helper_is_package_id (const gchar *package_name)
+{
+	return strchr (package_name, ';') != NULL;
+}
+
+/* "name;version;arch", as the data of an installed package ID differs */
+static gchar *
+gs_dbus_helper_package_id_key (const gchar *package_id)
+{
+	g_auto(GStrv) split = pk_package_id_split (package_id);
+	if (split == NULL)
+		return NULL;
+	return g_strdup_printf ("%s;%s;%s",
+				split[PK_PACKAGE_ID_NAME],
+				split[PK_PACKAGE_ID_VERSION],
+				split[PK_PACKAGE_ID_ARCH]);
+}
+
+/* @installed may only be NULL if there are no names */
+static GVariant *
+gs_dbus_helper_is_installed_variant (const gchar * const *package_names,
+				     GHashTable *installed)
+{
+	GVariantBuilder builder;
+
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("ab"));
+	for (guint i = 0; package_names[i] != NULL; i++) {
+		g_autofree gchar *key = NULL;
+		if (gs_dbus_helper_is_package_id (package_names[i])) {
+			key = gs_dbus_helper_package_id_key (package_names[i]);
+			g_variant_builder_add (&builder, "b",
+					       key != NULL && g_hash_table_contains (installed, key));
+			continue;
+		}
+		g_variant_builder_add (&builder, "b",
+				       g_hash_table_contains (installed, package_names[i]));
+	}
+	return g_variant_builder_end (&builder);
+}
+
 static void
 gs_dbus_helper_query_is_installed_cb (GObject *source, GAsyncResult *res, gpointer data)
 {
@@ -168,7 +450,7 @@ gs_dbus_helper_query_search_file_cb (GObject *source, GAsyncResult *res, gpointe
 						       G_IO_ERROR_INVALID_ARGUMENT,
 						       "failed to search: %s",
 						       error->message);
-		return;
+		goto out;
 	}
 
 	/* check error code */
@@ -179,7 +461,7 @@ gs_dbus_helper_query_search_file_cb (GObject *source, GAsyncResult *res, gpointe
 						       G_IO_ERROR_INVALID_ARGUMENT,
 						       "failed to search: %s",
 						       pk_error_get_details (error_code));
-		return;
+		goto out;
 	}
 
 	/* get results */
@@ -190,7 +472,7 @@ gs_dbus_helper_query_search_file_cb (GObject *source, GAsyncResult *res, gpointe
 						       G_IO_ERROR,
 						       G_IO_ERROR_INVALID_ARGUMENT,
 						       "failed to find any packages");
-		return;
+		goto out;
 	}
 
 	/* get first item */
@@ -200,6 +482,283 @@ gs_dbus_helper_query_search_file_cb (GObject *source, GAsyncResult *res, gpointe
 	                                           dtask->invocation,
 	                                           info == PK_INFO_ENUM_INSTALLED,
 	                                           pk_package_get_name (item));
+out:
+	gs_dbus_helper_task_free (dtask);
+}
+
+/* how many files not installed are searched for at the same time */
+#define GS_DBUS_HELPER_SEARCH_MAX_PARALLEL	4
+
+/*
+ * SearchFileMultiple looks the files up in the index when it is ready.
+ * Otherwise it first asks which installed packages own any of the files
+ * in one transaction, and then which of those files each package owns in
+ * another. Only the files left over are searched for one at a time, as a
+ * search does not say which file each result matched.
+ */
+
+typedef struct {
+	GsDbusHelperTask	*dtask;
+	gchar			**file_names;
+	gboolean		*installed;
+	gchar			**package_names;
+	guint			 len;
+	guint			 next;
+	guint			 pending;
+	GError			*error;
+} GsDbusHelperSearch;
+
+typedef struct {
+	GsDbusHelperSearch	*search;
+	guint			 idx;
+} GsDbusHelperSearchItem;
+
+static void
+gs_dbus_helper_search_complete (GsDbusHelperSearch *search)
+{
+	GsDbusHelperTask *dtask = search->dtask;
+	GVariantBuilder builder;
+
+	if (search->error != NULL) {
+		g_dbus_method_invocation_return_error (dtask->invocation,
+						       G_IO_ERROR,
+						       G_IO_ERROR_INVALID_ARGUMENT,
+						       "failed to search: %s",
+						       search->error->message);
+		goto out;
+	}
+	g_variant_builder_init (&builder, G_VARIANT_TYPE ("ab"));
+	for (guint i = 0; i < search->len; i++)
+		g_variant_builder_add (&builder, "b", search->installed[i]);
+	gs_package_kit_query_complete_search_file_multiple (GS_PACKAGE_KIT_QUERY (dtask->dbus_helper->query_interface),
+	                                                    dtask->invocation,
+	                                                    g_variant_builder_end (&builder),
+	                                                    (const gchar * const *) search->package_names);
+out:
+	gs_dbus_helper_task_free (dtask);
+	g_clear_error (&search->error);
+	g_strfreev (search->file_names);
+	g_strfreev (search->package_names);
+	g_free (search->installed);
+	g_free (search);
+}
+
+/* returns FALSE and sets the error of the search if @res failed */
+static gboolean
+gs_dbus_helper_search_check_results (GsDbusHelperSearch *search,
+				     PkResults *results,
+				     GError **error)
+{
+	g_autoptr(PkError) error_code = NULL;
+
+	if (results == NULL) {
+		if (search->error == NULL)
+			search->error = g_steal_pointer (error);
+		return FALSE;
+	}
+	error_code = pk_results_get_error_code (results);
+	if (error_code != NULL) {
+		if (search->error == NULL) {
+			g_set_error_literal (&search->error,
+					     G_IO_ERROR,
+					     G_IO_ERROR_INVALID_ARGUMENT,
+					     pk_error_get_details (error_code));
+		}
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void gs_dbus_helper_search_next (GsDbusHelperSearch *search);
+
+static void
+gs_dbus_helper_search_file_one_cb (GObject *source, GAsyncResult *res, gpointer data)
+{
+	GsDbusHelperSearchItem *item = (GsDbusHelperSearchItem *) data;
+	GsDbusHelperSearch *search = item->search;
+	PkClient *client = PK_CLIENT (source);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	/* a file nothing provides keeps an empty package name */
+	results = pk_client_generic_finish (client, res, &error);
+	if (gs_dbus_helper_search_check_results (search, results, &error)) {
+		array = pk_results_get_package_array (results);
+		if (array->len > 0) {
+			PkPackage *package = g_ptr_array_index (array, 0);
+			search->installed[item->idx] = pk_package_get_info (package) == PK_INFO_ENUM_INSTALLED;
+			g_free (search->package_names[item->idx]);
+			search->package_names[item->idx] = g_strdup (pk_package_get_name (package));
+		}
+	}
+	g_free (item);
+	search->pending--;
+	gs_dbus_helper_search_next (search);
+}
+
+static void
+gs_dbus_helper_search_next (GsDbusHelperSearch *search)
+{
+	GsDbusHelper *dbus_helper = search->dtask->dbus_helper;
+
+	/* the first failure fails the whole call */
+	if (search->error != NULL)
+		search->next = search->len;
+
+	while (search->pending < GS_DBUS_HELPER_SEARCH_MAX_PARALLEL &&
+	       search->next < search->len) {
+		guint idx = search->next++;
+		gchar *values[] = { search->file_names[idx], NULL };
+		GsDbusHelperSearchItem *item;
+
+		if (search->installed[idx])
+			continue;
+		item = g_new0 (GsDbusHelperSearchItem, 1);
+		item->search = search;
+		item->idx = idx;
+		search->pending++;
+		pk_client_search_files_async (PK_CLIENT (dbus_helper->task),
+		                              pk_bitfield_value (PK_FILTER_ENUM_NEWEST),
+		                              values, NULL,
+		                              gs_dbus_helper_progress_cb, NULL,
+		                              gs_dbus_helper_search_file_one_cb, item);
+	}
+	if (search->pending == 0)
+		gs_dbus_helper_search_complete (search);
+}
+
+static void
+gs_dbus_helper_search_get_files_cb (GObject *source, GAsyncResult *res, gpointer data)
+{
+	GsDbusHelperSearch *search = (GsDbusHelperSearch *) data;
+	PkClient *client = PK_CLIENT (source);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) owners = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(PkResults) results = NULL;
+
+	results = pk_client_generic_finish (client, res, &error);
+	if (!gs_dbus_helper_search_check_results (search, results, &error)) {
+		gs_dbus_helper_search_complete (search);
+		return;
+	}
+
+	/* filename : name, only for the packages that matched */
+	owners = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	array = pk_results_get_files_array (results);
+	for (guint i = 0; i < array->len; i++) {
+		PkFiles *item = g_ptr_array_index (array, i);
+		gchar **files = pk_files_get_files (item);
+		g_auto(GStrv) split = NULL;
+
+		split = pk_package_id_split (pk_files_get_package_id (item));
+		if (split == NULL || files == NULL)
+			continue;
+		for (guint j = 0; files[j] != NULL; j++) {
+			g_hash_table_insert (owners,
+					     g_strdup (files[j]),
+					     g_strdup (split[PK_PACKAGE_ID_NAME]));
+		}
+	}
+	for (guint i = 0; i < search->len; i++) {
+		const gchar *name = g_hash_table_lookup (owners, search->file_names[i]);
+		if (name == NULL)
+			continue;
+		search->installed[i] = TRUE;
+		g_free (search->package_names[i]);
+		search->package_names[i] = g_strdup (name);
+	}
+	gs_dbus_helper_search_next (search);
+}
+
+static void
+gs_dbus_helper_search_installed_cb (GObject *source, GAsyncResult *res, gpointer data)
+{
+	GsDbusHelperSearch *search = (GsDbusHelperSearch *) data;
+	GsDbusHelper *dbus_helper = search->dtask->dbus_helper;
+	PkClient *client = PK_CLIENT (source);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+	g_autoptr(PkResults) results = NULL;
+	g_auto(GStrv) package_ids = NULL;
+
+	results = pk_client_generic_finish (client, res, &error);
+	if (!gs_dbus_helper_search_check_results (search, results, &error)) {
+		gs_dbus_helper_search_complete (search);
+		return;
+	}
+
+	/* none of the files are installed */
+	array = pk_results_get_package_array (results);
+	if (array->len == 0) {
+		gs_dbus_helper_search_next (search);
+		return;
+	}
+
+	/* find out which of the files each package owns */
+	package_ids = g_new0 (gchar *, array->len + 1);
+	for (guint i = 0; i < array->len; i++) {
+		PkPackage *package = g_ptr_array_index (array, i);
+		package_ids[i] = g_strdup (pk_package_get_id (package));
+	}
+	pk_client_get_files_async (PK_CLIENT (dbus_helper->task),
+	                           package_ids, NULL,
+	                           gs_dbus_helper_progress_cb, NULL,
+	                           gs_dbus_helper_search_get_files_cb, search);
+}
+
+static gboolean
+handle_query_search_file_multiple (GsPackageKitQuery	 *skeleton,
+                                   GDBusMethodInvocation *invocation,
+                                   const gchar * const	 *file_names,
+                                   const gchar		 *interaction,
+                                   gpointer		  user_data)
+{
+	GsDbusHelper *dbus_helper = user_data;
+	GsDbusHelperSearch *search;
+
+	g_debug ("****** SearchFileMultiple");
+
+	search = g_new0 (GsDbusHelperSearch, 1);
+	search->dtask = g_new0 (GsDbusHelperTask, 1);
+	search->dtask->dbus_helper = g_object_ref (dbus_helper);
+	search->dtask->invocation = invocation;
+	gs_dbus_helper_task_set_interaction (search->dtask, interaction);
+	search->file_names = g_strdupv ((gchar **) file_names);
+	search->len = g_strv_length (search->file_names);
+	search->installed = g_new0 (gboolean, search->len);
+	search->package_names = g_new0 (gchar *, search->len + 1);
+	for (guint i = 0; i < search->len; i++)
+		search->package_names[i] = g_strdup ("");
+	if (search->len == 0) {
+		gs_dbus_helper_search_complete (search);
+		return TRUE;
+	}
+
+	/* only search for the files that are not installed */
+	gs_dbus_helper_index_ensure (dbus_helper);
+	if (dbus_helper->installed_files != NULL) {
+		for (guint i = 0; i < search->len; i++) {
+			const gchar *name;
+			name = gs_dbus_helper_index_lookup_file (dbus_helper,
+								 search->file_names[i]);
+			if (name == NULL)
+				continue;
+			search->installed[i] = TRUE;
+			g_free (search->package_names[i]);
+			search->package_names[i] = g_strdup (name);
+		}
+		gs_dbus_helper_search_next (search);
+		return TRUE;
+	}
+	pk_client_search_files_async (PK_CLIENT (dbus_helper->task),
+	                              pk_bitfield_value (PK_FILTER_ENUM_INSTALLED),
+	                              search->file_names, NULL,
+	                              gs_dbus_helper_progress_cb, NULL,
+	                              gs_dbus_helper_search_installed_cb, search);
+
+	return TRUE;
 }
 
 static gboolean
@@ -215,11 +774,22 @@ handle_query_search_file (GsPackageKitQuery	 *skeleton,
 
 	g_debug ("****** SearchFile");
 
+	/* answer straight away if any of the files are installed */
+	gs_dbus_helper_index_ensure (dbus_helper);
+	names = g_strsplit (file_name, "&", -1);
+	for (guint i = 0; names[i] != NULL; i++) {
+		const gchar *name = gs_dbus_helper_index_lookup_file (dbus_helper, names[i]);
+		if (name != NULL) {
+			gs_package_kit_query_complete_search_file (skeleton, invocation,
+			                                           TRUE, name);
+			return TRUE;
+		}
+	}
+
 	dtask = g_new0 (GsDbusHelperTask, 1);
 	dtask->dbus_helper = g_object_ref (dbus_helper);
 	dtask->invocation = invocation;
 	gs_dbus_helper_task_set_interaction (dtask, interaction);
-	names = g_strsplit (file_name, "&", -1);
 	pk_client_search_files_async (PK_CLIENT (dbus_helper->task),
 	                              pk_bitfield_value (PK_FILTER_ENUM_NEWEST),
 	                              names, NULL,
@@ -229,6 +799,99 @@ handle_query_search_file (GsPackageKitQuery	 *skeleton,
 	return TRUE;
 }
 
+static void
+gs_dbus_helper_query_is_installed_multiple_cb (GObject *source, GAsyncResult *res, gpointer data)
+{
+	GsDbusHelperTask *dtask = (GsDbusHelperTask *) data;
+	PkClient *client = PK_CLIENT (source);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) installed = NULL;
+	g_autoptr(PkError) error_code = NULL;
+	g_autoptr(PkResults) results = NULL;
+	g_autoptr(GPtrArray) array = NULL;
+
+	/* get the results */
+	results = pk_client_generic_finish (client, res, &error);
+	if (results == NULL) {
+		g_dbus_method_invocation_return_error (dtask->invocation,
+						       G_IO_ERROR,
+						       G_IO_ERROR_INVALID_ARGUMENT,
+						       "failed to resolve: %s",
+						       error->message);
+		goto out;
+	}
+
+	/* check error code */
+	error_code = pk_results_get_error_code (results);
+	if (error_code != NULL) {
+		g_dbus_method_invocation_return_error (dtask->invocation,
+						       G_IO_ERROR,
+						       G_IO_ERROR_INVALID_ARGUMENT,
+						       "failed to resolve: %s",
+						       pk_error_get_details (error_code));
+		goto out;
+	}
+
+	/* only installed packages are returned */
+	array = pk_results_get_package_array (results);
+	installed = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	for (guint i = 0; i < array->len; i++) {
+		PkPackage *package = g_ptr_array_index (array, i);
+		gchar *key = gs_dbus_helper_package_id_key (pk_package_get_id (package));
+		g_hash_table_add (installed, g_strdup (pk_package_get_name (package)));
+		if (key != NULL)
+			g_hash_table_add (installed, key);
+	}
+	gs_package_kit_query_complete_is_installed_multiple (GS_PACKAGE_KIT_QUERY (dtask->dbus_helper->query_interface),
+	                                                     dtask->invocation,
+	                                                     gs_dbus_helper_is_installed_variant ((const gchar * const *) dtask->package_names,
+	                                                                                          installed));
+out:
+	gs_dbus_helper_task_free (dtask);
+}
+
+static gboolean
+handle_query_is_installed_multiple (GsPackageKitQuery	 *skeleton,
+                                    GDBusMethodInvocation *invocation,
+                                    const gchar * const	 *package_names,
+                                    const gchar		 *interaction,
+                                    gpointer		  user_data)
+{
+	GsDbusHelper *dbus_helper = user_data;
+	GsDbusHelperTask *dtask;
+	gboolean use_index;
+
+	g_debug ("****** IsInstalledMultiple");
+
+	/* answer straight away if possible */
+	gs_dbus_helper_index_ensure (dbus_helper);
+	use_index = dbus_helper->installed_names != NULL;
+	for (guint i = 0; use_index && package_names[i] != NULL; i++) {
+		if (gs_dbus_helper_is_package_id (package_names[i]))
+			use_index = FALSE;
+	}
+	if (use_index || package_names[0] == NULL) {
+		gs_package_kit_query_complete_is_installed_multiple (skeleton, invocation,
+		                                                     gs_dbus_helper_is_installed_variant (package_names,
+		                                                                                          dbus_helper->installed_names));
+		return TRUE;
+	}
+
+	/* resolve all the names in one transaction */
+	dtask = g_new0 (GsDbusHelperTask, 1);
+	dtask->dbus_helper = g_object_ref (dbus_helper);
+	dtask->invocation = invocation;
+	dtask->package_names = g_strdupv ((gchar **) package_names);
+	gs_dbus_helper_task_set_interaction (dtask, interaction);
+	pk_client_resolve_async (PK_CLIENT (dbus_helper->task),
+	                         pk_bitfield_value (PK_FILTER_ENUM_INSTALLED),
+	                         dtask->package_names, NULL,
+	                         gs_dbus_helper_progress_cb, dtask,
+	                         gs_dbus_helper_query_is_installed_multiple_cb, dtask);
+
+	return TRUE;
+}
+
 static gboolean
 handle_query_is_installed (GsPackageKitQuery	 *skeleton,
                            GDBusMethodInvocation *invocation,
@@ -242,6 +905,16 @@ handle_query_is_installed (GsPackageKitQuery	 *skeleton,
 
 	g_debug ("****** IsInstalled");
 
+	/* answer straight away if possible */
+	gs_dbus_helper_index_ensure (dbus_helper);
+	if (dbus_helper->installed_names != NULL &&
+	    !gs_dbus_helper_is_package_id (package_name)) {
+		gs_package_kit_query_complete_is_installed (skeleton, invocation,
+		                                            g_hash_table_contains (dbus_helper->installed_names,
+		                                                                   package_name));
+		return TRUE;
+	}
+
 	dtask = g_new0 (GsDbusHelperTask, 1);
 	dtask->dbus_helper = g_object_ref (dbus_helper);
 	dtask->invocation = invocation;
@@ -684,6 +1357,10 @@ bus_gotten_cb (GObject      *source_object,
 	                  G_CALLBACK (handle_query_is_installed), dbus_helper);
 	g_signal_connect (dbus_helper->query_interface, "handle-search-file",
 	                  G_CALLBACK (handle_query_search_file), dbus_helper);
+	g_signal_connect (dbus_helper->query_interface, "handle-is-installed-multiple",
+	                  G_CALLBACK (handle_query_is_installed_multiple), dbus_helper);
+	g_signal_connect (dbus_helper->query_interface, "handle-search-file-multiple",
+	                  G_CALLBACK (handle_query_search_file_multiple), dbus_helper);
 
 	if (!g_dbus_interface_skeleton_export (dbus_helper->query_interface,
 	                                       connection,
@@ -773,6 +1450,14 @@ gs_dbus_helper_init (GsDbusHelper *dbus_helper)
 	dbus_helper->task = pk_task_new ();
 	dbus_helper->cancellable = g_cancellable_new ();
 
+	/* the index is kept up to date without getting in the way */
+	dbus_helper->index_client = pk_client_new ();
+	pk_client_set_background (dbus_helper->index_client, TRUE);
+	pk_client_set_interactive (dbus_helper->index_client, FALSE);
+	dbus_helper->control = pk_control_new ();
+	g_signal_connect (dbus_helper->control, "updates-changed",
+	                  G_CALLBACK (gs_dbus_helper_updates_changed_cb), dbus_helper);
+
 	g_bus_get (G_BUS_TYPE_SESSION,
 	           dbus_helper->cancellable,
 	           (GAsyncReadyCallback) bus_gotten_cb,
@@ -809,6 +1494,20 @@ gs_dbus_helper_dispose (GObject *object)
 		g_clear_object (&dbus_helper->modify2_interface);
 	}
 
+	if (dbus_helper->index_cancellable != NULL) {
+		g_cancellable_cancel (dbus_helper->index_cancellable);
+		g_clear_object (&dbus_helper->index_cancellable);
+	}
+
+	if (dbus_helper->control != NULL) {
+		g_signal_handlers_disconnect_by_func (dbus_helper->control,
+		                                      gs_dbus_helper_updates_changed_cb,
+		                                      dbus_helper);
+		g_clear_object (&dbus_helper->control);
+	}
+
+	gs_dbus_helper_index_clear (dbus_helper);
+	g_clear_object (&dbus_helper->index_client);
 	g_clear_object (&dbus_helper->task);
 
 	G_OBJECT_CLASS (gs_dbus_helper_parent_class)->dispose (object);
@@ -272,7 +272,7 @@ app_row_button_clicked_cb (GsAppRow *app_row,
 		g_critical ("extras: app in unexpected state %u", gs_app_get_state (app));
 }
 
-static void
+static GtkWidget *
 gs_extras_page_add_app (GsExtrasPage *self, GsApp *app, SearchData *search_data)
 {
 	GtkWidget *app_row;
@@ -305,6 +305,7 @@ gs_extras_page_add_app (GsExtrasPage *self, GsApp *app, SearchData *search_data)
 				    self->sizegroup_name,
 				    self->sizegroup_button);
 	gtk_widget_show (app_row);
+	return app_row;
 }
 
 static GsApp *
@@ -512,6 +513,45 @@ show_search_results (GsExtrasPage *self)
 	gs_shell_profile_dump (self->shell);
 }
 
+/* rows for packages found while a search is still running */
+static void
+search_partial_cb (GsPluginLoader *plugin_loader,
+		   GsAppList *list,
+		   gpointer user_data)
+{
+	SearchData *search_data = (SearchData *) user_data;
+	GsExtrasPage *self = search_data->self;
+
+	for (guint i = 0; i < gs_app_list_length (list); i++) {
+		GsApp *app = gs_app_list_index (list, i);
+		GtkWidget *app_row;
+
+		/* these are not refined, so cannot be installed yet */
+		app_row = gs_extras_page_add_app (self, app, search_data);
+		g_object_set_data (G_OBJECT (app_row), "partial", search_data);
+		gtk_widget_set_sensitive (app_row, FALSE);
+	}
+
+	/* show something rather than the spinner */
+	if (self->state == GS_EXTRAS_PAGE_STATE_LOADING &&
+	    gs_app_list_length (list) > 0)
+		gs_extras_page_set_state (self, GS_EXTRAS_PAGE_STATE_READY);
+}
+
+static void
+gs_extras_page_remove_partial (GsExtrasPage *self, SearchData *search_data)
+{
+	g_autoptr(GList) children = NULL;
+
+	children = gtk_container_get_children (GTK_CONTAINER (self->list_box_results));
+	for (GList *l = children; l != NULL; l = l->next) {
+		if (g_object_get_data (G_OBJECT (l->data), "partial") != search_data)
+			continue;
+		gtk_container_remove (GTK_CONTAINER (self->list_box_results),
+				      GTK_WIDGET (l->data));
+	}
+}
+
 static void
 search_files_cb (GObject *source_object,
                  GAsyncResult *res,
@@ -531,6 +571,7 @@ search_files_cb (GObject *source_object,
 			g_debug ("extras: search files cancelled");
 			return;
 		}
+		gs_extras_page_remove_partial (self, search_data);
 		g_warning ("failed to find any search results: %s", error->message);
 		str = g_strdup_printf ("%s: %s", _("Failed to find any search results"), error->message);
 		gtk_label_set_label (GTK_LABEL (self->label_failed), str);
@@ -538,6 +579,9 @@ search_files_cb (GObject *source_object,
 		return;
 	}
 
+	/* replace the rows shown while searching */
+	gs_extras_page_remove_partial (self, search_data);
+
 	/* add missing item */
 	if (gs_app_list_length (list) == 0) {
 		g_autoptr(GsApp) app = NULL;
@@ -625,6 +669,7 @@ get_search_what_provides_cb (GObject *source_object,
 			g_debug ("extras: search what provides cancelled");
 			return;
 		}
+		gs_extras_page_remove_partial (self, search_data);
 		g_warning ("failed to find any search results: %s", error->message);
 		str = g_strdup_printf ("%s: %s", _("Failed to find any search results"), error->message);
 		gtk_label_set_label (GTK_LABEL (self->label_failed), str);
@@ -632,6 +677,9 @@ get_search_what_provides_cb (GObject *source_object,
 		return;
 	}
 
+	/* replace the rows shown while searching */
+	gs_extras_page_remove_partial (self, search_data);
+
 	/* add missing item */
 	if (gs_app_list_length (list) == 0) {
 		g_autoptr(GsApp) app = NULL;
@@ -690,6 +738,8 @@ gs_extras_page_load (GsExtrasPage *self, GPtrArray *array_search_data)
 			g_debug ("searching filename: '%s'", search_data->search_filename);
 			gs_plugin_loader_search_files_async (self->plugin_loader,
 			                                     search_data->search_filename,
+			                                     search_partial_cb,
+			                                     search_data,
 			                                     GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON |
 			                                     GS_PLUGIN_REFINE_FLAGS_REQUIRE_RATING |
 			                                     GS_PLUGIN_REFINE_FLAGS_ALLOW_PACKAGES,
@@ -714,6 +764,8 @@ gs_extras_page_load (GsExtrasPage *self, GPtrArray *array_search_data)
 			g_debug ("searching what provides: '%s'", search_data->search);
 			gs_plugin_loader_search_what_provides_async (self->plugin_loader,
 			                                             search_data->search,
+			                                             search_partial_cb,
+			                                             search_data,
 			                                             GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON |
 			                                             GS_PLUGIN_REFINE_FLAGS_REQUIRE_VERSION |
 			                                             GS_PLUGIN_REFINE_FLAGS_REQUIRE_PROVENANCE |
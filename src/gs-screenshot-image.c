@@ -47,16 +47,33 @@ struct _GsScreenshotImage
 	SoupSession	*session;
 	SoupMessage	*message;
 	gchar		*filename;
+	gchar		*url;
 	const gchar	*current_image;
 	gboolean	 use_desktop_background;
 	guint		 width;
 	guint		 height;
 	guint		 scale;
 	gboolean	 showing_image;
+	gboolean	 revalidate_pending;
 };
 
 G_DEFINE_TYPE (GsScreenshotImage, gs_screenshot_image, GTK_TYPE_BIN)
 
+/* how long to wait for other stale screenshots before revalidating */
+#define GS_SCREENSHOT_IMAGE_REVALIDATE_DELAY	250 /* ms */
+
+/* only remember the validators of the most recently downloaded screenshots */
+#define GS_SCREENSHOT_IMAGE_VALIDATORS_MAX	1000
+
+/* ETag and Last-Modified values of the cached screenshots, keyed by the
+ * checksum of the URL and shared between all the widgets */
+static GKeyFile *validators = NULL;
+static guint validators_save_id = 0;
+
+/* stale screenshots waiting to be revalidated */
+static GPtrArray *revalidate_queue = NULL;
+static guint revalidate_id = 0;
+
 AsScreenshot *
 gs_screenshot_image_get_screenshot (GsScreenshotImage *ssimg)
 {
@@ -279,6 +296,126 @@ gs_screenshot_image_save_downloaded_img (GsScreenshotImage *ssimg,
 	return TRUE;
 }
 
+static gchar *
+gs_screenshot_image_get_validators_filename (GError **error)
+{
+	return gs_utils_get_cache_filename ("screenshots",
+					    "validators.ini",
+					    GS_UTILS_CACHE_FLAG_WRITEABLE,
+					    error);
+}
+
+static gboolean
+gs_screenshot_image_save_validators_cb (gpointer user_data)
+{
+	gsize n_groups = 0;
+	g_autofree gchar *fn = NULL;
+	g_auto(GStrv) groups = NULL;
+	g_autoptr(GError) error = NULL;
+
+	validators_save_id = 0;
+
+	/* groups are appended when set, so the first are the oldest */
+	groups = g_key_file_get_groups (validators, &n_groups);
+	for (gsize i = 0; i + GS_SCREENSHOT_IMAGE_VALIDATORS_MAX < n_groups; i++)
+		g_key_file_remove_group (validators, groups[i], NULL);
+
+	fn = gs_screenshot_image_get_validators_filename (&error);
+	if (fn == NULL || !g_key_file_save_to_file (validators, fn, &error))
+		g_warning ("failed to save screenshot validators: %s",
+			   error->message);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+gs_screenshot_image_queue_save_validators (void)
+{
+	/* coalesce the writes when a whole page of screenshots arrives */
+	if (validators_save_id == 0) {
+		validators_save_id = g_timeout_add_seconds (1,
+							    gs_screenshot_image_save_validators_cb,
+							    NULL);
+	}
+}
+
+static GKeyFile *
+gs_screenshot_image_get_validators (void)
+{
+	gboolean changed = FALSE;
+	g_autofree gchar *fn = NULL;
+	g_auto(GStrv) groups = NULL;
+	g_autoptr(GError) error = NULL;
+
+	if (validators != NULL)
+		return validators;
+
+	/* a missing or corrupt index just means unconditional requests */
+	validators = g_key_file_new ();
+	fn = gs_screenshot_image_get_validators_filename (&error);
+	if (fn == NULL) {
+		g_warning ("failed to get screenshot validators: %s",
+			   error->message);
+		return validators;
+	}
+	if (!g_key_file_load_from_file (validators, fn, G_KEY_FILE_NONE, &error) &&
+	    !g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+		g_warning ("failed to load %s: %s", fn, error->message);
+
+	/* forget screenshots that have been removed from the cache */
+	groups = g_key_file_get_groups (validators, NULL);
+	for (guint i = 0; groups[i] != NULL; i++) {
+		g_autofree gchar *filename = NULL;
+		filename = g_key_file_get_string (validators, groups[i],
+						  "Filename", NULL);
+		if (filename == NULL ||
+		    !g_file_test (filename, G_FILE_TEST_EXISTS)) {
+			g_key_file_remove_group (validators, groups[i], NULL);
+			changed = TRUE;
+		}
+	}
+	if (changed)
+		gs_screenshot_image_queue_save_validators ();
+	return validators;
+}
+
+static void
+gs_screenshot_image_set_validators (GsScreenshotImage *ssimg, SoupMessage *msg)
+{
+	GKeyFile *kf = gs_screenshot_image_get_validators ();
+	const gchar *etag;
+	const gchar *last_modified;
+	g_autofree gchar *group = NULL;
+
+	group = g_compute_checksum_for_string (G_CHECKSUM_SHA256, ssimg->url, -1);
+	g_key_file_remove_group (kf, group, NULL);
+	etag = soup_message_headers_get_one (msg->response_headers, "ETag");
+	if (etag != NULL)
+		g_key_file_set_string (kf, group, "ETag", etag);
+	last_modified = soup_message_headers_get_one (msg->response_headers,
+						      "Last-Modified");
+	if (last_modified != NULL)
+		g_key_file_set_string (kf, group, "Last-Modified", last_modified);
+	g_key_file_set_string (kf, group, "Filename", ssimg->filename);
+	gs_screenshot_image_queue_save_validators ();
+}
+
+static void
+gs_screenshot_image_touch (GsScreenshotImage *ssimg)
+{
+	guint64 now = (guint64) g_get_real_time () / G_USEC_PER_SEC;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file = g_file_new_for_path (ssimg->filename);
+
+	/* reset the cache age so we do not ask again for a while */
+	if (!g_file_set_attribute_uint64 (file,
+					  G_FILE_ATTRIBUTE_TIME_MODIFIED,
+					  now,
+					  G_FILE_QUERY_INFO_NONE,
+					  NULL,
+					  &error))
+		g_debug ("failed to touch %s: %s", ssimg->filename, error->message);
+}
+
 static void
 gs_screenshot_image_complete_cb (SoupSession *session,
 				 SoupMessage *msg,
@@ -297,7 +434,9 @@ gs_screenshot_image_complete_cb (SoupSession *session,
 
 	if (msg->status_code == SOUP_STATUS_NOT_MODIFIED) {
 		g_debug ("screenshot has not been modified");
-		as_screenshot_show_image (ssimg);
+		gs_screenshot_image_touch (ssimg);
+		if (!ssimg->showing_image)
+			as_screenshot_show_image (ssimg);
 		return;
 	}
 	if (msg->status_code != SOUP_STATUS_OK) {
@@ -347,6 +486,9 @@ gs_screenshot_image_complete_cb (SoupSession *session,
 		return;
 	}
 
+	/* remember how to revalidate this next time */
+	gs_screenshot_image_set_validators (ssimg, msg);
+
 	/* got image, so show */
 	as_screenshot_show_image (ssimg);
 }
@@ -424,6 +566,91 @@ gs_screenshot_soup_msg_set_modified_request (SoupMessage *msg, GFile *file)
 				     mod_date);
 }
 
+static void
+gs_screenshot_image_set_conditional_request (GsScreenshotImage *ssimg)
+{
+	GKeyFile *kf = gs_screenshot_image_get_validators ();
+	g_autofree gchar *etag = NULL;
+	g_autofree gchar *group = NULL;
+	g_autofree gchar *last_modified = NULL;
+
+	group = g_compute_checksum_for_string (G_CHECKSUM_SHA256, ssimg->url, -1);
+	etag = g_key_file_get_string (kf, group, "ETag", NULL);
+	if (etag != NULL) {
+		soup_message_headers_append (ssimg->message->request_headers,
+					     "If-None-Match", etag);
+	}
+	last_modified = g_key_file_get_string (kf, group, "Last-Modified", NULL);
+	if (last_modified != NULL) {
+		soup_message_headers_append (ssimg->message->request_headers,
+					     "If-Modified-Since", last_modified);
+	} else {
+		g_autoptr(GFile) file = g_file_new_for_path (ssimg->filename);
+		gs_screenshot_soup_msg_set_modified_request (ssimg->message, file);
+	}
+}
+
+static void
+gs_screenshot_image_queue_message (GsScreenshotImage *ssimg)
+{
+	soup_session_queue_message (ssimg->session,
+				    g_object_ref (ssimg->message) /* transfer full */,
+				    gs_screenshot_image_complete_cb,
+				    g_object_ref (ssimg));
+}
+
+static gboolean
+gs_screenshot_image_revalidate_cb (gpointer user_data)
+{
+	g_autoptr(GPtrArray) queue = revalidate_queue;
+	guint i;
+
+	/* all the stale images go out together so the session can reuse
+	 * the same kept-alive connections to each host */
+	revalidate_queue = NULL;
+	revalidate_id = 0;
+	g_debug ("revalidating %u cached screenshots", queue->len);
+	for (i = 0; i < queue->len; i++) {
+		GsScreenshotImage *ssimg = g_ptr_array_index (queue, i);
+		ssimg->revalidate_pending = FALSE;
+		gs_screenshot_image_queue_message (ssimg);
+	}
+	return G_SOURCE_REMOVE;
+}
+
+static void
+gs_screenshot_image_queue_revalidate (GsScreenshotImage *ssimg)
+{
+	if (revalidate_queue == NULL) {
+		revalidate_queue = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	}
+	g_ptr_array_add (revalidate_queue, g_object_ref (ssimg));
+	ssimg->revalidate_pending = TRUE;
+	if (revalidate_id == 0) {
+		revalidate_id = g_timeout_add (GS_SCREENSHOT_IMAGE_REVALIDATE_DELAY,
+					       gs_screenshot_image_revalidate_cb,
+					       NULL);
+	}
+}
+
+static void
+gs_screenshot_image_cancel_message (GsScreenshotImage *ssimg)
+{
+	if (ssimg->message == NULL)
+		return;
+
+	/* never sent, so just drop it from the batch */
+	if (ssimg->revalidate_pending) {
+		ssimg->revalidate_pending = FALSE;
+		g_ptr_array_remove (revalidate_queue, ssimg);
+	} else {
+		soup_session_cancel_message (ssimg->session,
+		                             ssimg->message,
+		                             SOUP_STATUS_CANCELLED);
+	}
+	g_clear_object (&ssimg->message);
+}
+
 void
 gs_screenshot_image_load_async (GsScreenshotImage *ssimg,
 				GCancellable *cancellable)
@@ -542,6 +769,8 @@ gs_screenshot_image_load_async (GsScreenshotImage *ssimg,
 						       NULL);
 
 	/* download file */
+	g_free (ssimg->url);
+	ssimg->url = g_strdup (url);
 	g_debug ("downloading %s to %s", url, ssimg->filename);
 	base_uri = soup_uri_new (url);
 	if (base_uri == NULL || !SOUP_URI_VALID_FOR_HTTP (base_uri)) {
@@ -552,12 +781,7 @@ gs_screenshot_image_load_async (GsScreenshotImage *ssimg,
 	}
 
 	/* cancel any previous messages */
-	if (ssimg->message != NULL) {
-		soup_session_cancel_message (ssimg->session,
-		                             ssimg->message,
-		                             SOUP_STATUS_CANCELLED);
-		g_clear_object (&ssimg->message);
-	}
+	gs_screenshot_image_cancel_message (ssimg);
 
 	ssimg->message = soup_message_new_from_uri (SOUP_METHOD_GET, base_uri);
 	if (ssimg->message == NULL) {
@@ -566,18 +790,20 @@ gs_screenshot_image_load_async (GsScreenshotImage *ssimg,
 		return;
 	}
 
-	/* not all servers support If-Modified-Since, but worst case we just
-	 * re-download the entire file again every 30 days */
-	if (g_file_test (ssimg->filename, G_FILE_TEST_EXISTS)) {
-		g_autoptr(GFile) file = g_file_new_for_path (ssimg->filename);
-		gs_screenshot_soup_msg_set_modified_request (ssimg->message, file);
+	/* not all servers support If-None-Match or If-Modified-Since, but
+	 * worst case we just re-download the entire file again every 30 days */
+	if (g_file_test (ssimg->filename, G_FILE_TEST_EXISTS))
+		gs_screenshot_image_set_conditional_request (ssimg);
+
+	/* the stale image is already visible, so revalidate in the
+	 * background along with any other screenshots on the page */
+	if (ssimg->showing_image) {
+		gs_screenshot_image_queue_revalidate (ssimg);
+		return;
 	}
 
 	/* send async */
-	soup_session_queue_message (ssimg->session,
-				    g_object_ref (ssimg->message) /* transfer full */,
-				    gs_screenshot_image_complete_cb,
-				    g_object_ref (ssimg));
+	gs_screenshot_image_queue_message (ssimg);
 }
 
 static void
@@ -585,17 +811,13 @@ gs_screenshot_image_destroy (GtkWidget *widget)
 {
 	GsScreenshotImage *ssimg = GS_SCREENSHOT_IMAGE (widget);
 
-	if (ssimg->message != NULL) {
-		soup_session_cancel_message (ssimg->session,
-		                             ssimg->message,
-		                             SOUP_STATUS_CANCELLED);
-		g_clear_object (&ssimg->message);
-	}
+	gs_screenshot_image_cancel_message (ssimg);
 	g_clear_object (&ssimg->screenshot);
 	g_clear_object (&ssimg->session);
 	g_clear_object (&ssimg->settings);
 
 	g_clear_pointer (&ssimg->filename, g_free);
+	g_clear_pointer (&ssimg->url, g_free);
 
 	GTK_WIDGET_CLASS (gs_screenshot_image_parent_class)->destroy (widget);
 }
@@ -30,6 +30,7 @@
 
 typedef struct {
 	gchar		*title;
+	gchar		*subtitle;
 	gchar		*stack_page;
 	GtkWidget	*focus;
 } BackEntry;
@@ -65,6 +66,7 @@ save_back_entry (GsUpdateDialog *dialog)
 	entry = g_slice_new0 (BackEntry);
 	entry->stack_page = g_strdup (gtk_stack_get_visible_child_name (GTK_STACK (dialog->stack)));
 	entry->title = g_strdup (gtk_window_get_title (GTK_WINDOW (dialog)));
+	entry->subtitle = g_strdup (gtk_header_bar_get_subtitle (GTK_HEADER_BAR (gtk_dialog_get_header_bar (GTK_DIALOG (dialog)))));
 
 	entry->focus = gtk_window_get_focus (GTK_WINDOW (dialog));
 	if (entry->focus != NULL)
@@ -82,9 +84,32 @@ back_entry_free (BackEntry *entry)
 		                              (gpointer *) &entry->focus);
 	g_free (entry->stack_page);
 	g_free (entry->title);
+	g_free (entry->subtitle);
 	g_slice_free (BackEntry, entry);
 }
 
+static void
+set_updates_size_ui (GsUpdateDialog *dialog, GsApp *app)
+{
+	GtkWidget *header_bar;
+	guint64 size_download;
+	g_autoptr(GsAppList) list = gs_app_list_new ();
+
+	/* packages shared by the related updates are only counted once */
+	gs_app_list_add (list, app);
+	size_download = gs_app_list_get_size_download (list);
+	header_bar = gtk_dialog_get_header_bar (GTK_DIALOG (dialog));
+	if (size_download > 0) {
+		g_autofree gchar *size_str = g_format_size (size_download);
+		g_autofree gchar *subtitle = NULL;
+		/* TRANSLATORS: the amount to download, e.g. "12.3 MB" */
+		subtitle = g_strdup_printf (_("%s to download"), size_str);
+		gtk_header_bar_set_subtitle (GTK_HEADER_BAR (header_bar), subtitle);
+	} else {
+		gtk_header_bar_set_subtitle (GTK_HEADER_BAR (header_bar), NULL);
+	}
+}
+
 static void
 set_updates_description_ui (GsUpdateDialog *dialog, GsApp *app)
 {
@@ -273,6 +298,7 @@ gs_update_dialog_show_update_details (GsUpdateDialog *dialog, GsApp *app)
 
 	/* set update header */
 	set_updates_description_ui (dialog, app);
+	set_updates_size_ui (dialog, app);
 
 	/* workaround a gtk+ issue where the dialog comes up with a label selected,
 	 * https://bugzilla.gnome.org/show_bug.cgi?id=734033 */
@@ -371,6 +397,8 @@ button_back_cb (GtkWidget *widget, GsUpdateDialog *dialog)
 	gtk_stack_set_transition_type (GTK_STACK (dialog->stack), GTK_STACK_TRANSITION_TYPE_NONE);
 
 	gtk_window_set_title (GTK_WINDOW (dialog), entry->title);
+	gtk_header_bar_set_subtitle (GTK_HEADER_BAR (gtk_dialog_get_header_bar (GTK_DIALOG (dialog))),
+				     entry->subtitle);
 	if (entry->focus)
 		gtk_widget_grab_focus (entry->focus);
 	back_entry_free (entry);
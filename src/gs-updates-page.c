@@ -76,6 +76,7 @@ struct _GsUpdatesPage
 	gboolean		 any_require_reboot;
 	GsShell			*shell;
 	GsPluginStatus		 last_status;
+	GsApp			*download_app;
 	GsUpdatesPageState	 state;
 	GsUpdatesPageFlags	 result_flags;
 	GtkWidget		*button_refresh;
@@ -231,16 +232,22 @@ gs_updates_page_last_checked_time_string (GsUpdatesPage *self)
 	return time_string;
 }
 
-static const gchar *
-gs_updates_page_get_state_string (GsPluginStatus status)
+static gchar *
+gs_updates_page_get_state_string (GsPluginStatus status, guint percentage)
 {
 	if (status == GS_PLUGIN_STATUS_DOWNLOADING) {
+		if (percentage > 0) {
+			/* TRANSLATORS: the updates are being downloaded,
+			 * and %u is how far through, e.g. 45 */
+			return g_strdup_printf (_("Downloading new updates… %u%%"),
+						percentage);
+		}
 		/* TRANSLATORS: the updates are being downloaded */
-		return _("Downloading new updates…");
+		return g_strdup (_("Downloading new updates…"));
 	}
 
 	/* TRANSLATORS: the update panel is doing *something* vague */
-	return _("Looking for new updates…");
+	return g_strdup (_("Looking for new updates…"));
 }
 
 static void
@@ -249,7 +256,9 @@ gs_updates_page_update_ui_state (GsUpdatesPage *self)
 	GsUpdateList *update_list;
 	gboolean allow_mobile_refresh = TRUE;
 	g_autofree gchar *checked_str = NULL;
+	g_autofree gchar *estimate_str = NULL;
 	g_autofree gchar *spinner_str = NULL;
+	g_autofree gchar *state_str = NULL;
 
 	if (gs_shell_get_mode (self->shell) != GS_SHELL_MODE_UPDATES)
 		return;
@@ -285,8 +294,13 @@ gs_updates_page_update_ui_state (GsUpdatesPage *self)
 		gtk_label_set_label (GTK_LABEL (self->label_updates_spinner), spinner_str);
 		break;
 	case GS_UPDATES_PAGE_STATE_ACTION_REFRESH:
+		state_str = gs_updates_page_get_state_string (self->last_status,
+							      gs_plugin_loader_get_percentage (self->plugin_loader));
+		if (self->download_app != NULL)
+			estimate_str = gs_utils_get_download_estimate (self->download_app);
 		spinner_str = g_strdup_printf ("%s\n%s",
-				       gs_updates_page_get_state_string (self->last_status),
+				       state_str,
+				       estimate_str != NULL ? estimate_str :
 				       /* TRANSLATORS: the updates panel is starting up */
 				       _("(This could take a while)"));
 		gtk_label_set_label (GTK_LABEL (self->label_updates_spinner), spinner_str);
@@ -440,12 +454,21 @@ gs_updates_page_network_available_notify_cb (GsPluginLoader *plugin_loader,
 	gs_updates_page_update_ui_state (self);
 }
 
+static void
+gs_updates_page_percentage_notify_cb (GsPluginLoader *plugin_loader,
+                                      GParamSpec *pspec,
+                                      GsUpdatesPage *self)
+{
+	gs_updates_page_update_ui_state (self);
+}
+
 static void
 gs_updates_page_get_updates_cb (GsPluginLoader *plugin_loader,
                                 GAsyncResult *res,
                                 GsUpdatesPage *self)
 {
 	guint i;
+	guint64 size_download;
 	GtkWidget *widget;
 	g_autoptr(GError) error = NULL;
 	g_autoptr(GsAppList) list = NULL;
@@ -492,6 +515,19 @@ gs_updates_page_get_updates_cb (GsPluginLoader *plugin_loader,
 				      _("_Restart & Update"));
 	}
 
+	/* say how much has to be downloaded, counting shared runtimes and
+	 * packages once */
+	size_download = gs_app_list_get_size_download (list);
+	if (size_download > 0) {
+		g_autofree gchar *size_str = g_format_size (size_download);
+		g_autofree gchar *tooltip = NULL;
+		/* TRANSLATORS: the amount to download, e.g. "12.3 MB" */
+		tooltip = g_strdup_printf (_("%s to download"), size_str);
+		gtk_widget_set_tooltip_text (self->button_update_all, tooltip);
+	} else {
+		gtk_widget_set_tooltip_text (self->button_update_all, NULL);
+	}
+
 	/* update the counter */
 	widget = GTK_WIDGET (gtk_builder_get_object (self->builder,
 						     "button_updates_counter"));
@@ -567,6 +603,7 @@ gs_updates_page_load (GsUpdatesPage *self)
 	refine_flags = GS_PLUGIN_REFINE_FLAGS_REQUIRE_ICON |
 		       GS_PLUGIN_REFINE_FLAGS_REQUIRE_UPDATE_DETAILS |
 		       GS_PLUGIN_REFINE_FLAGS_REQUIRE_PROVENANCE |
+		       GS_PLUGIN_REFINE_FLAGS_REQUIRE_SIZE |
 		       GS_PLUGIN_REFINE_FLAGS_REQUIRE_VERSION;
 	gs_updates_page_set_state (self, GS_UPDATES_PAGE_STATE_ACTION_GET_UPDATES);
 	self->action_cnt++;
@@ -1270,12 +1307,42 @@ gs_updates_page_changed_cb (GsPluginLoader *plugin_loader,
 	gs_updates_page_reload (GS_PAGE (self));
 }
 
+static void
+gs_updates_page_download_progress_cb (GsApp *app,
+                                      GParamSpec *pspec,
+                                      GsUpdatesPage *self)
+{
+	gs_updates_page_update_ui_state (self);
+}
+
+static void
+gs_updates_page_set_download_app (GsUpdatesPage *self, GsApp *app)
+{
+	if (self->download_app == app)
+		return;
+	if (self->download_app != NULL) {
+		g_signal_handlers_disconnect_by_func (self->download_app,
+						      gs_updates_page_download_progress_cb,
+						      self);
+	}
+	g_set_object (&self->download_app, app);
+	if (self->download_app != NULL) {
+		g_signal_connect (self->download_app, "notify::progress",
+				  G_CALLBACK (gs_updates_page_download_progress_cb),
+				  self);
+	}
+}
+
 static void
 gs_updates_page_status_changed_cb (GsPluginLoader *plugin_loader,
                                    GsApp *app,
                                    GsPluginStatus status,
                                    GsUpdatesPage *self)
 {
+	/* plugins can show the rate and time left on the app downloading */
+	gs_updates_page_set_download_app (self,
+					  status == GS_PLUGIN_STATUS_DOWNLOADING ? app : NULL);
+
 	switch (status) {
 	case GS_PLUGIN_STATUS_INSTALLING:
 	case GS_PLUGIN_STATUS_REMOVING:
@@ -1344,6 +1411,9 @@ gs_updates_page_setup (GsPage *page,
 	g_signal_connect_object (self->plugin_loader, "notify::network-available",
 				 G_CALLBACK (gs_updates_page_network_available_notify_cb),
 				 self, 0);
+	g_signal_connect_object (self->plugin_loader, "notify::percentage",
+				 G_CALLBACK (gs_updates_page_percentage_notify_cb),
+				 self, 0);
 	self->builder = g_object_ref (builder);
 	self->cancellable = g_object_ref (cancellable);
 
@@ -1420,6 +1490,7 @@ gs_updates_page_dispose (GObject *object)
 		g_clear_object (&self->cancellable_upgrade_download);
 	}
 
+	gs_updates_page_set_download_app (self, NULL);
 	g_clear_object (&self->builder);
 	g_clear_object (&self->plugin_loader);
 	g_clear_object (&self->cancellable);
@@ -60,6 +60,7 @@ gs_upgrade_banner_refresh (GsUpgradeBanner *self)
 {
 	GsUpgradeBannerPrivate *priv = gs_upgrade_banner_get_instance_private (self);
 	const gchar *uri;
+	g_autofree gchar *estimate = NULL;
 	g_autofree gchar *name_bold = NULL;
 	g_autofree gchar *version_bold = NULL;
 	g_autofree gchar *str = NULL;
@@ -146,8 +147,12 @@ gs_upgrade_banner_refresh (GsUpgradeBanner *self)
 	/* do a fill bar for the current progress */
 	switch (gs_app_get_state (priv->app)) {
 	case AS_APP_STATE_INSTALLING:
+		estimate = gs_utils_get_download_estimate (priv->app);
 		gtk_progress_bar_set_fraction (GTK_PROGRESS_BAR (priv->progressbar),
 		                               (gdouble) gs_app_get_progress (priv->app) / 100.0f);
+		gtk_progress_bar_set_text (GTK_PROGRESS_BAR (priv->progressbar), estimate);
+		gtk_progress_bar_set_show_text (GTK_PROGRESS_BAR (priv->progressbar),
+		                                estimate != NULL);
 		gtk_widget_show (priv->progressbar);
 		break;
 	default: